@@ -29,8 +29,10 @@
 #include "dde.hpp"
 #include "mesh.hpp"
 #include <string>
+#include <memory>
 namespace arcsim
 {
+	class PersistentLLT;
 
 	struct Cloth
 	{
@@ -52,6 +54,7 @@ namespace arcsim
 			double size_min, size_max; // size limits
 			double aspect_min; // aspect ratio control
 		} remeshing;
+		std::shared_ptr<PersistentLLT> factor; // of the implicit update, kept between steps
 	};
 
 	void compute_masses(Cloth &cloth);
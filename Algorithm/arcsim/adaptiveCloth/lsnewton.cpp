@@ -52,6 +52,7 @@ namespace arcsim
 		int n = problem.nvar;
 		vector<double> x(n), g(n);
 		SpMat<double> H(n, n);
+		std::shared_ptr<PersistentLLT> factor = taucs_create_factor();
 		problem.initialize(&x[0]);
 		double f_old = infinity;
 		int iter;
@@ -75,7 +76,7 @@ namespace arcsim
 					<< "is not available!" << endl;
 				exit(1);
 			}
-			vector<double> p = taucs_linear_solve(H, g);
+			vector<double> p = taucs_linear_solve(H, g, factor.get());
 			if (verbose)
 				REPORT(norm(p));
 			scalar_mult(p, -1, p);
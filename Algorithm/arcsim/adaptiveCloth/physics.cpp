@@ -621,7 +621,9 @@ namespace arcsim
 		add_constraint_forces(cloth, cons, A, b, dt);
 		add_friction_forces(cloth, cons, A, b, dt);
 
-		vector<Vec3> dv = taucs_linear_solve(A, b);
+		if (!cloth.factor)
+			cloth.factor = taucs_create_factor();
+		vector<Vec3> dv = taucs_linear_solve(A, b, cloth.factor.get());
 		for (int n = 0; n < mesh.nodes.size(); n++)
 		{
 			Node *node = mesh.nodes[n];
@@ -229,13 +229,13 @@ namespace arcsim
 
 	void add_proximity(const Node *node, const ldp::LevelSet3D *obj)
 	{
-		Vec3 n;
-		double w[4];
-		double d = obj->globalValue(node->x[0], node->x[1], node->x[2]); 
-		d = abs(d);
-		bool inside = (min(-w[1], -w[2], -w[3]) >= -1e-6);
-		if (!inside)
-			return;
+		ldp::LevelSet3D::ValueType v = 0;
+		ldp::LevelSet3D::Vec3 g;
+		obj->globalSample(ldp::LevelSet3D::Vec3(node->x[0], node->x[1], node->x[2]), &v, &g);
+		Vec3 n(g[0], g[1], g[2]);
+		if (v < 0)
+			n = -n;
+		double d = abs(v);
 		if (is_free(node))
 		{
 			int side = dot(n, node->n) >= 0 ? 0 : 1;
@@ -346,9 +346,9 @@ namespace arcsim
 		con->a = area(node);
 		con->obj = (ldp::LevelSet3D *)obj;
 		con->stiff = arcsim::magic.collision_stiffness*con->a;
-		double d = obj->globalValue(node->x[0], node->x[1], node->x[2]);
+		ldp::LevelSet3D::ValueType d = 0;
 		ldp::LevelSet3D::Vec3 g;
-		obj->localGradient(node->x[0], node->x[1], node->x[2], g[0], g[1], g[2]);
+		obj->globalSample(ldp::LevelSet3D::Vec3(node->x[0], node->x[1], node->x[2]), &d, &g);
 		con->n = Vec3(g[0], g[1], g[2]);
 		if (d < 0)
 			con->n = -con->n;
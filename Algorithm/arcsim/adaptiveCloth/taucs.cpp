@@ -27,53 +27,22 @@
 #include "taucs.hpp"
 #include "timer.hpp"
 #include <cstdlib>
+#include <cmath>
+#include <algorithm>
 #include <iostream>
 
 //#define USE_EIGEN_INSTEADOF_TAUCS
 
-using namespace std;
-
-namespace arcsim
-{
 #ifdef USE_EIGEN_INSTEADOF_TAUCS
 #include <eigen\Sparse>
 #include <eigen\Dense>
+#endif
 
-	void sparse_to_eigen(const SpMat<double> &As, Eigen::SparseMatrix<double>& A)
-	{
-		vector<Eigen::Triplet<double>> cooSys;
-		// assumption: A is square and symmetric
-		A.resize(As.n, As.n);
-		for (int i = 0; i < As.n; i++)
-		{
-			for (int k = 0; k < As.rows[i].indices.size(); k++)
-				cooSys.push_back(Eigen::Triplet<double>(As.rows[i].indices[k], i, As.rows[i].entries[k]));
-		}
-		if (cooSys.size())
-			A.setFromTriplets(cooSys.begin(), cooSys.end());
-	}	
-	template <int m> void sparse_to_eigen(const SpMat< Mat<m, m> > &As, Eigen::SparseMatrix<double>& A)
-	{
-		vector<Eigen::Triplet<double>> cooSys;
-		// assumption: A is square and symmetric
-		A.resize(As.n * m, As.n * m);
-		for (int i = 0; i < As.n; i++)
-		{
-			for (int k = 0; k < m; k++)
-			{
-				for (int jj = 0; jj < As.rows[i].indices.size(); jj++)
-				{
-					int j = As.rows[i].indices[jj];
-					const Mat<m, m> &Aij = As.rows[i].entries[jj];
-					for (int l = 0; l < m; l++)
-						cooSys.push_back(Eigen::Triplet<double>(j*m + l, i*m + k, Aij(k, l)));
-				}
-			}
-		}
-		if (cooSys.size())
-			A.setFromTriplets(cooSys.begin(), cooSys.end());
-	}
-#else
+using namespace std;
+
+namespace arcsim
+{
+#ifndef USE_EIGEN_INSTEADOF_TAUCS
 	extern "C" {
 #include "taucs\include\taucs.h"
 		int taucs_linsolve(taucs_ccs_matrix* A, // input matrix
@@ -108,160 +77,362 @@ namespace arcsim
 		out << endl;
 		return out;
 	}
+#endif
+
+	// lower triangular part of a symmetric matrix, compressed by columns;
+	// the row indices of each column are sorted, so that the pattern can be compared between calls.
+	struct CcsLower
+	{
+		int n;
+		vector<int> colptr;
+		vector<int> rowind;
+		vector<double> values;
+	};
 
-	taucs_ccs_matrix *sparse_to_taucs(const SpMat<double> &As)
+	void sparse_to_ccs(const SpMat<double> &As, CcsLower &A)
 	{
 		// assumption: A is square and symmetric
-		int n = As.n;
-		int nnz = 0;
+		const int n = As.n;
+		A.n = n;
+		A.colptr.resize(n + 1);
+		A.rowind.clear();
+		A.values.clear();
+		vector<pair<int, int>> col;
 		for (int i = 0; i < n; i++)
 		{
+			A.colptr[i] = (int)A.rowind.size();
+			col.clear();
 			for (int k = 0; k < As.rows[i].indices.size(); k++)
 			{
 				int j = As.rows[i].indices[k];
 				if (j < i)
 					continue;
-				nnz++;
+				col.push_back(make_pair(j, k));
 			}
-		}
-		taucs_ccs_matrix *At = taucs_ccs_create(n, n, nnz, TAUCS_DOUBLE | TAUCS_SYMMETRIC | TAUCS_LOWER);
-		int pos = 0;
-		for (int i = 0; i < n; i++)
-		{
-			At->colptr[i] = pos;
-			for (int k = 0; k < As.rows[i].indices.size(); k++)
+			sort(col.begin(), col.end());
+			for (size_t c = 0; c < col.size(); c++)
 			{
-				int j = As.rows[i].indices[k];
-				if (j < i)
-					continue;
-				At->rowind[pos] = j;
-				At->values.d[pos] = As.rows[i].entries[k];
-				pos++;
+				A.rowind.push_back(col[c].first);
+				A.values.push_back(As.rows[i].entries[col[c].second]);
 			}
 		}
-		At->colptr[n] = pos;
-		return At;
-	}	
-	template <int m> taucs_ccs_matrix *sparse_to_taucs(const SpMat< Mat<m, m> > &As)
+		A.colptr[n] = (int)A.rowind.size();
+	}
+
+	template <int m> void sparse_to_ccs(const SpMat< Mat<m, m> > &As, CcsLower &A)
 	{
 		// assumption: A is square and symmetric
-		int n = As.n;
-		int nnz = 0;
+		const int n = As.n;
+		A.n = n * m;
+		A.colptr.resize(n * m + 1);
+		A.rowind.clear();
+		A.values.clear();
+		vector<pair<int, int>> col;
 		for (int i = 0; i < n; i++)
 		{
+			col.clear();
 			for (int jj = 0; jj < As.rows[i].indices.size(); jj++)
 			{
 				int j = As.rows[i].indices[jj];
 				if (j < i)
 					continue;
-				nnz += (j == i) ? m*(m + 1) / 2 : m*m;
+				col.push_back(make_pair(j, jj));
 			}
-		}
-		taucs_ccs_matrix *At = taucs_ccs_create
-			(n*m, n*m, nnz, TAUCS_DOUBLE | TAUCS_SYMMETRIC | TAUCS_LOWER);
-		int pos = 0;
-		for (int i = 0; i < n; i++)
-		{
+			sort(col.begin(), col.end());
 			for (int k = 0; k < m; k++)
 			{
-				At->colptr[i*m + k] = pos;
-				for (int jj = 0; jj < As.rows[i].indices.size(); jj++)
+				A.colptr[i*m + k] = (int)A.rowind.size();
+				for (size_t c = 0; c < col.size(); c++)
 				{
-					int j = As.rows[i].indices[jj];
-					if (j < i)
-						continue;
-					const Mat<m, m> &Aij = As.rows[i].entries[jj];
+					const int j = col[c].first;
+					const Mat<m, m> &Aij = As.rows[i].entries[col[c].second];
 					for (int l = (i == j) ? k : 0; l < m; l++)
 					{
-						At->rowind[pos] = j*m + l;
-						At->values.d[pos] = Aij(k, l);
-						pos++;
+						A.rowind.push_back(j*m + l);
+						A.values.push_back(Aij(k, l));
 					}
 				}
 			}
 		}
-		At->colptr[n*m] = pos;
-		return At;
+		A.colptr[n*m] = (int)A.rowind.size();
 	}
-#endif
 
-
-	vector<double> taucs_linear_solve(const SpMat<double> &A, const vector<double> &b)
+	// LLT factorization kept between calls:
+	// the ordering and symbolic factorization are redone only when the sparsity pattern changes,
+	// otherwise only the numeric factorization is; or, if the factor reusing is enabled and A changed
+	// little, the old factor is used as the preconditioner of a pcg.
+	class PersistentLLT
 	{
+	public:
+		PersistentLLT(double reuseTol = 0, int pcgMaxIter = 20, double pcgTol = 1e-10);
+		~PersistentLLT();
+		void clear();
+		// solve A*x=b, A is non-const since taucs takes non-const pointers
+		void solve(CcsLower &A, double *x, const double *b);
+	protected:
+		bool samePattern(const CcsLower &A)const;
+		double relativeChange(const CcsLower &A)const;
+		bool pcg(const CcsLower &A, double *x, const double *b);
+		void analyzePattern(CcsLower &A);
+		bool factorize(CcsLower &A);
+		void applyFactor(const double *r, double *z);	// z = inv(LL')*r
+	private:
+		double m_reuseTol;
+		int m_pcgMaxIter;
+		double m_pcgTol;
+		int m_n;
+		vector<int> m_colptr;
+		vector<int> m_rowind;
+		vector<double> m_values;	// the values factorized
+		bool m_factored;
 #ifdef USE_EIGEN_INSTEADOF_TAUCS
-		typedef Eigen::SparseMatrix<double> SpMat;
-		typedef Eigen::MatrixXd DMat;
-		typedef Eigen::VectorXd DVec;
-		typedef Eigen::SimplicialCholesky<SpMat> Solver;
-		SpMat eA;
-		DVec eb(b.size());
-		for (size_t i = 0; i < b.size(); i++)
-			eb[i] = b[i];
-		sparse_to_eigen(A, eA);
-		Solver solver(eA);
-		DVec ex = solver.solve(eb);
-		vector<double> x(ex.size());
-		for(size_t i=0; i<x.size(); i++)
-			x[i] = ex[i];
-		return x;
+		Eigen::SimplicialLLT<Eigen::SparseMatrix<double>, Eigen::Lower> m_solver;
 #else
-		// taucs_logfile("stdout");
-		taucs_ccs_matrix *Ataucs = sparse_to_taucs(A);
-		vector<double> x(b.size());
-		char *options[] = { (char*)"taucs.factor.LLT=true", NULL };
-		//debug_save_spmat(A);
-		int retval = taucs_linsolve(Ataucs, NULL, 1, &x[0], (double*)&b[0], options, NULL);
-		if (retval != TAUCS_SUCCESS)
+		int *m_perm;
+		int *m_invperm;
+		void *m_L;
+		vector<double> m_pr, m_pz;
+#endif
+	};
+
+	PersistentLLT::PersistentLLT(double reuseTol, int pcgMaxIter, double pcgTol)
+	{
+		m_reuseTol = reuseTol;
+		m_pcgMaxIter = pcgMaxIter;
+		m_pcgTol = pcgTol;
+		m_n = 0;
+		m_factored = false;
+#ifndef USE_EIGEN_INSTEADOF_TAUCS
+		m_perm = NULL;
+		m_invperm = NULL;
+		m_L = NULL;
+#endif
+	}
+
+	PersistentLLT::~PersistentLLT()
+	{
+		clear();
+	}
+
+	void PersistentLLT::clear()
+	{
+		m_n = 0;
+		m_colptr.clear();
+		m_rowind.clear();
+		m_values.clear();
+		m_factored = false;
+#ifndef USE_EIGEN_INSTEADOF_TAUCS
+		if (m_L)
+			taucs_supernodal_factor_free(m_L);
+		if (m_perm)
+			free(m_perm);
+		if (m_invperm)
+			free(m_invperm);
+		m_L = NULL;
+		m_perm = NULL;
+		m_invperm = NULL;
+#endif
+	}
+
+	bool PersistentLLT::samePattern(const CcsLower &A)const
+	{
+		return m_n == A.n && m_colptr == A.colptr && m_rowind == A.rowind;
+	}
+
+	double PersistentLLT::relativeChange(const CcsLower &A)const
+	{
+		double diff = 0, norm = 0;
+		for (size_t i = 0; i < m_values.size(); i++)
 		{
-			cerr << "Error: TAUCS failed with return value " << retval << endl;
-			exit(EXIT_FAILURE);
+			diff += (A.values[i] - m_values[i]) * (A.values[i] - m_values[i]);
+			norm += m_values[i] * m_values[i];
 		}
-		taucs_ccs_free(Ataucs);
-		return x;
-#endif
+		return sqrt(diff / std::max(norm, 1e-30));
 	}
 
-	template <int m> vector< Vec<m> > taucs_linear_solve
-		(const SpMat< Mat<m, m> > &A, const vector< Vec<m> > &b)
+	// y = A*x, A symmetric with only the lower part stored
+	static void ccs_sym_times_vec(const CcsLower &A, const double *x, double *y)
+	{
+		for (int i = 0; i < A.n; i++)
+			y[i] = 0;
+		for (int c = 0; c < A.n; c++)
+		{
+			for (int pos = A.colptr[c]; pos < A.colptr[c + 1]; pos++)
+			{
+				const int r = A.rowind[pos];
+				y[r] += A.values[pos] * x[c];
+				if (r != c)
+					y[c] += A.values[pos] * x[r];
+			}
+		}
+	}
+
+	static double vec_dot(int n, const double *a, const double *b)
 	{
+		double s = 0;
+		for (int i = 0; i < n; i++)
+			s += a[i] * b[i];
+		return s;
+	}
+
+	bool PersistentLLT::pcg(const CcsLower &A, double *x, const double *b)
+	{
+		const int n = A.n;
+		const double norm_b = sqrt(vec_dot(n, b, b));
+		vector<double> r(b, b + n), z(n), p(n), Ap(n);
+		for (int i = 0; i < n; i++)
+			x[i] = 0;
+		if (norm_b == 0)
+			return true;
+		applyFactor(&r[0], &z[0]);
+		p = z;
+		double rz = vec_dot(n, &r[0], &z[0]);
+		for (int iter = 0; iter < m_pcgMaxIter; iter++)
+		{
+			ccs_sym_times_vec(A, &p[0], &Ap[0]);
+			const double pAp = vec_dot(n, &p[0], &Ap[0]);
+			const double alpha = (pAp == 0) ? 0 : rz / pAp;
+			for (int i = 0; i < n; i++)
+			{
+				x[i] += alpha * p[i];
+				r[i] -= alpha * Ap[i];
+			}
+			if (sqrt(vec_dot(n, &r[0], &r[0])) < m_pcgTol * norm_b)
+				return true;
+			applyFactor(&r[0], &z[0]);
+			const double old_rz = rz;
+			rz = vec_dot(n, &r[0], &z[0]);
+			const double beta = (old_rz == 0) ? 0 : rz / old_rz;
+			for (int i = 0; i < n; i++)
+				p[i] = z[i] + beta * p[i];
+		} // end for iter
+		return false;
+	}
+
 #ifdef USE_EIGEN_INSTEADOF_TAUCS
-		typedef Eigen::SparseMatrix<double> SpMat;
-		typedef Eigen::MatrixXd DMat;
-		typedef Eigen::VectorXd DVec;
-		typedef Eigen::SimplicialCholesky<SpMat> Solver;
-		SpMat eA;
-		DVec eb(b.size()*m);
-		for (size_t i = 0; i < b.size(); i++)
+	void PersistentLLT::analyzePattern(CcsLower &A)
+	{
+		Eigen::MappedSparseMatrix<double> eA(A.n, A.n, (int)A.values.size(),
+			&A.colptr[0], &A.rowind[0], &A.values[0]);
+		m_solver.analyzePattern(eA);
+	}
+
+	bool PersistentLLT::factorize(CcsLower &A)
+	{
+		Eigen::MappedSparseMatrix<double> eA(A.n, A.n, (int)A.values.size(),
+			&A.colptr[0], &A.rowind[0], &A.values[0]);
+		m_solver.factorize(eA);
+		return m_solver.info() == Eigen::Success;
+	}
+
+	void PersistentLLT::applyFactor(const double *r, double *z)
+	{
+		Eigen::Map<Eigen::VectorXd>(z, m_n) = m_solver.solve(Eigen::Map<const Eigen::VectorXd>(r, m_n));
+	}
+#else
+	static taucs_ccs_matrix ccs_to_taucs(CcsLower &A)
+	{
+		taucs_ccs_matrix At;
+		At.n = A.n;
+		At.m = A.n;
+		At.flags = TAUCS_DOUBLE | TAUCS_SYMMETRIC | TAUCS_LOWER;
+		At.colptr = &A.colptr[0];
+		At.rowind = A.rowind.empty() ? NULL : &A.rowind[0];
+		At.values.d = A.values.empty() ? NULL : &A.values[0];
+		return At;
+	}
+
+	void PersistentLLT::analyzePattern(CcsLower &A)
+	{
+		taucs_ccs_matrix At = ccs_to_taucs(A);
+		taucs_ccs_order(&At, &m_perm, &m_invperm, (char*)"metis");
+		taucs_ccs_matrix *PAPt = taucs_ccs_permute_symmetrically(&At, m_perm, m_invperm);
+		m_L = taucs_ccs_factor_llt_symbolic(PAPt);
+		taucs_ccs_free(PAPt);
+		m_pr.resize(A.n);
+		m_pz.resize(A.n);
+	}
+
+	bool PersistentLLT::factorize(CcsLower &A)
+	{
+		taucs_ccs_matrix At = ccs_to_taucs(A);
+		taucs_ccs_matrix *PAPt = taucs_ccs_permute_symmetrically(&At, m_perm, m_invperm);
+		if (m_factored)
+			taucs_supernodal_factor_free_numeric(m_L);
+		int retval = taucs_ccs_factor_llt_numeric(PAPt, m_L);
+		taucs_ccs_free(PAPt);
+		return retval == TAUCS_SUCCESS;
+	}
+
+	void PersistentLLT::applyFactor(const double *r, double *z)
+	{
+		taucs_vec_permute(m_n, TAUCS_DOUBLE, (void*)r, &m_pr[0], m_perm);
+		taucs_supernodal_solve_llt(m_L, &m_pz[0], &m_pr[0]);
+		taucs_vec_ipermute(m_n, TAUCS_DOUBLE, &m_pz[0], z, m_perm);
+	}
+#endif
+
+	void PersistentLLT::solve(CcsLower &A, double *x, const double *b)
+	{
+		if (A.n == 0)
+			return;
+
+		// pattern changed: ordering and symbolic factorization
+		if (!samePattern(A))
 		{
-			for (int k = 0; k < m; k++)
-				eb[i*m + k] = b[i][k];
+			clear();
+			analyzePattern(A);
+			m_n = A.n;
+			m_colptr = A.colptr;
+			m_rowind = A.rowind;
 		}
-		sparse_to_eigen(A, eA);
-		Solver solver(eA);
-		DVec ex = solver.solve(eb);
-		vector<Vec<m>> x(ex.size()/m);
-		for (size_t i = 0; i < x.size(); i++)
+
+		// changed little: the old factor as the preconditioner
+		if (m_factored && m_reuseTol > 0 && relativeChange(A) < m_reuseTol)
 		{
-			for (int k = 0; k < m; k++)
-				x[i][k] = ex[i*m + k];
+			if (pcg(A, x, b))
+				return;
 		}
-		return x;
-#else
-		// taucs_logfile("stdout");
-		taucs_ccs_matrix *Ataucs = sparse_to_taucs(A);
-		vector< Vec<m> > x(b.size());
-		char *options[] = { (char*)"taucs.factor.LLT=true", NULL };
-		int retval = taucs_linsolve(Ataucs, NULL, 1, &x[0], (double*)&b[0], options, NULL);
-		if (retval != TAUCS_SUCCESS)
+
+		// numeric factorization
+		if (!factorize(A))
 		{
-			cerr << "Error: TAUCS failed with return value " << retval << endl;
+			cerr << "Error: LLT numeric factorization failed" << endl;
 			exit(EXIT_FAILURE);
 		}
-		taucs_ccs_free(Ataucs);
+		m_factored = true;
+		m_values = A.values;
+		applyFactor(b, x);
+	}
+
+	std::shared_ptr<PersistentLLT> taucs_create_factor(double reuseTol, int pcgMaxIter, double pcgTol)
+	{
+		return std::shared_ptr<PersistentLLT>(new PersistentLLT(reuseTol, pcgMaxIter, pcgTol));
+	}
+
+	vector<double> taucs_linear_solve(const SpMat<double> &A, const vector<double> &b, PersistentLLT *factor)
+	{
+		PersistentLLT local;
+		PersistentLLT &solver = factor ? *factor : local;
+		CcsLower Accs;
+		sparse_to_ccs(A, Accs);
+		vector<double> x(b.size());
+		solver.solve(Accs, &x[0], &b[0]);
+		return x;
+	}
+
+	template <int m> vector< Vec<m> > taucs_linear_solve
+		(const SpMat< Mat<m, m> > &A, const vector< Vec<m> > &b, PersistentLLT *factor)
+	{
+		PersistentLLT local;
+		PersistentLLT &solver = factor ? *factor : local;
+		CcsLower Accs;
+		sparse_to_ccs(A, Accs);
+		vector< Vec<m> > x(b.size());
+		solver.solve(Accs, (double*)&x[0], (const double*)&b[0]);
 		return x;
-#endif
 	}
 
 	template vector<Vec3> taucs_linear_solve(const SpMat<Mat3x3> &A,
-		const vector<Vec3> &b);
-}
\ No newline at end of file
+		const vector<Vec3> &b, PersistentLLT *factor);
+}
@@ -26,14 +26,25 @@
 #pragma once
 #include "sparse.hpp"
 #include "vectors.hpp"
+#include <memory>
 
 namespace arcsim
 {
 
+	// the factorization of the last solve, kept by the caller between its calls: the ordering and
+	// symbolic factorization are recomputed only when the sparsity pattern of A changes.
+	// not thread safe, each concurrent caller should own its own factor.
+	// reuseTol: if A changed less than reuseTol (relative, Frobenius norm) since its last factorization,
+	// the old factor is used as a pcg preconditioner instead of refactorizing. reuseTol <= 0 disables it.
+	class PersistentLLT;
+	std::shared_ptr<PersistentLLT> taucs_create_factor(double reuseTol = 0, int pcgMaxIter = 20,
+		double pcgTol = 1e-10);
+
+	// factor: the factorization kept from the last call of the caller, NULL to factorize from scratch
 	std::vector<double> taucs_linear_solve(const SpMat<double> &A,
-		const std::vector<double> &b);
+		const std::vector<double> &b, PersistentLLT *factor = NULL);
 
 	template <int m> std::vector< Vec<m> > taucs_linear_solve
-		(const SpMat< Mat<m, m> > &A, const std::vector< Vec<m> > &b);
+		(const SpMat< Mat<m, m> > &A, const std::vector< Vec<m> > &b, PersistentLLT *factor = NULL);
 
 }
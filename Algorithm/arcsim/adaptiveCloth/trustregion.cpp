@@ -49,7 +49,7 @@ namespace arcsim
 	static double norm(const vector<double> &x);
 
 	bool minimize_in_ball(const vector<double> &g, const SpMat<double> &H,
-		double radius, vector<double> &p);
+		double radius, vector<double> &p, PersistentLLT *factor);
 
 	void trust_region_method(const NLOpt &problem, OptOptions opt, bool verbose)
 	{
@@ -63,6 +63,7 @@ namespace arcsim
 		double f = problem.objective(&x[0]);
 		vector<double> g(n);
 		SpMat<double> H(n, n);
+		std::shared_ptr<PersistentLLT> factor = taucs_create_factor();
 		assert(problem.hessian(&x[0], H));
 		for (int iter = 0; iter < opt.max_iter(); iter++)
 		{
@@ -70,7 +71,7 @@ namespace arcsim
 			if (norm(g) < opt.eps_g())
 				break;
 			problem.hessian(&x[0], H);
-			bool boundary = minimize_in_ball(g, H, radius, p);
+			bool boundary = minimize_in_ball(g, H, radius, p, factor.get());
 			add(x_new, x, p);
 			problem.precompute(&x_new[0]);
 			double f_new = problem.objective(&x_new[0]);
@@ -97,12 +98,12 @@ namespace arcsim
 	double line_circle_intersection(double n1, double n2, double d, double r);
 
 	bool minimize_in_ball(const vector<double> &g, const SpMat<double> &H,
-		double radius, vector<double> &p)
+		double radius, vector<double> &p, PersistentLLT *factor)
 	{
 		int n = g.size();
 		static vector<double> p1, p2;
 		scalar_mult(p1, -dot(g, g) / dot(g, H, g), g);
-		p2 = taucs_linear_solve(H, g);
+		p2 = taucs_linear_solve(H, g, factor);
 		scalar_mult(p2, -1, p2);
 		double n1 = norm(p1), n2 = norm(p2);
 		if (n2 < radius)
@@ -0,0 +1,19 @@
+#include "AbstractClothSimulator.h"
+#include "GpuSim.h"
+#include "CpuSim.h"
+
+namespace ldp
+{
+	AbstractClothSimulator* AbstractClothSimulator::create(SimulationBackend backend)
+	{
+		switch (backend)
+		{
+		case SimulationBackendGpu:
+			return new GpuSim();
+		case SimulationBackendCpu:
+			return new CpuSim();
+		default:
+			return nullptr;
+		}
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "ldpMat\ldp_basic_vec.h"
+#include "definations.h"
+#include "EquilibriumMonitor.h"
+#include "SparseStructureCache.h"
+#include "SimulationProfiler.h"
+class ObjMesh;
+namespace ldp
+{
+	class ClothManager;
+	class SimulationCheckpoint;
+	// the common interface of cloth simulators driven by the ClothManager,
+	// so that the execution backend (gpu or cpu) can be selected at runtime.
+	class AbstractClothSimulator
+	{
+	public:
+		virtual ~AbstractClothSimulator(){}
+		virtual SimulationBackend backend()const = 0;
+
+		virtual void clear() = 0;
+		virtual void init(ClothManager* clothManager) = 0;
+		virtual void run_one_step() = 0;
+		virtual void restart() = 0;
+		virtual void updateParam() = 0;
+		virtual void updateTopology() = 0;
+		virtual void updateStitch() = 0;
+		virtual void updateMaterial() = 0;
+		virtual void updateBodyCollider() = 0;	// take the body level set or proxy of the ClothManager, no restart
+		virtual void setFixPositions(int nFixed, const int* ids, const Float3* targets) = 0;
+	public:
+		virtual float getFps()const = 0;
+		virtual float getStepTime()const = 0;
+		virtual std::string getSolverInfo()const = 0;
+		virtual TopologyFingerprint::ValueType getTopologyFingerprint()const = 0;	// valid after the sparse structure is built
+		virtual EquilibriumMonitor& getEquilibriumMonitor() = 0;	// updated in each run_one_step()
+		virtual const EquilibriumMonitor& getEquilibriumMonitor()const = 0;
+		virtual SimulationProfiler& getProfiler() = 0;	// stage timers and counters of each run_one_step()
+		virtual const SimulationProfiler& getProfiler()const = 0;
+		virtual ObjMesh& getResultClothMesh() = 0;
+		virtual void getResultClothPieces() = 0;	//only valid for cloth manager init.
+		virtual const std::vector<Float2>& getVertTexCoords()const = 0;
+		virtual const std::vector<Float3>& getCurrentVertPositions()const = 0;
+		virtual const std::vector<Float3>& getInitVertPositions()const = 0;
+		virtual const std::vector<Int4>& getFaceIndices()const = 0;
+		virtual const std::vector<int>& getVertMergeIdxMap()const = 0;
+		virtual void setCurrentVertPositions(const std::vector<Float3>& X) = 0;
+		virtual void setInitVertPositions(const std::vector<Float3>& X) = 0;
+		// the numeric state of the current topology; the pending updates are applied first
+		virtual void getCheckpoint(SimulationCheckpoint& cp) = 0;
+		// throws if the checkpoint was taken on another topology
+		virtual void setCheckpoint(const SimulationCheckpoint& cp) = 0;
+
+		// create a simulator of the given backend
+		static AbstractClothSimulator* create(SimulationBackend backend);
+	};
+}
@@ -0,0 +1,276 @@
+#include "ArticulatedLevelSet.h"
+#include "SmplManager.h"
+#include "Renderable\ObjMesh.h"
+#include "kdtree\PointTree.h"
+#include "ldpMat\ldpdef.h"
+#include <omp.h>
+
+namespace ldp
+{
+	const ArticulatedLevelSet::ValueType ArticulatedLevelSet::OWNER_WEIGHT = ValueType(0.1);
+	const ArticulatedLevelSet::ValueType ArticulatedLevelSet::BLEND_WIDTH = ValueType(0.3);
+
+	ArticulatedLevelSet::ArticulatedLevelSet()
+	{
+		m_step = ValueType(0);
+		m_band = ValueType(0);
+	}
+
+	ArticulatedLevelSet::~ArticulatedLevelSet()
+	{
+
+	}
+
+	void ArticulatedLevelSet::clear()
+	{
+		m_bones.clear();
+		m_step = ValueType(0);
+		m_band = ValueType(0);
+	}
+
+	size_t ArticulatedLevelSet::memoryBytes()const
+	{
+		size_t bytes = 0;
+		for (const auto& bone : m_bones)
+			bytes += bone.field.memoryBytes();
+		return bytes;
+	}
+
+	void ArticulatedLevelSet::build(SmplManager& smpl, int resolution, ValueType band)
+	{
+		clear();
+		const int nJoints = smpl.numPoses();
+		if (nJoints > MAX_BONES)
+			throw std::exception("ArticulatedLevelSet::build(): too many joints");
+
+		// the rest pose of the current shape
+		ObjMesh rest;
+		std::vector<SmplManager::real> poses(nJoints * 3);
+		for (int j = 0; j < nJoints; j++)
+		for (int k = 0; k < 3; k++)
+		{
+			poses[j * 3 + k] = smpl.getCurPoseCoef(j, k);
+			smpl.setCurPoseCoef(j, k, 0);
+		}
+		smpl.updateCurMesh();
+		smpl.toObjMesh(rest);
+		for (int j = 0; j < nJoints; j++)
+		for (int k = 0; k < 3; k++)
+			smpl.setCurPoseCoef(j, k, poses[j * 3 + k]);
+		smpl.updateCurMesh();
+
+		// the rest pose level set, the same grid with ClothManager::calcLevelSet()
+		rest.updateBoundingBox();
+		Vec3 bmin = rest.boundingBox[0];
+		Vec3 bmax = rest.boundingBox[1];
+		const Vec3 brag = bmax - bmin;
+		bmin -= 0.2f * brag;
+		bmax += 0.2f * brag;
+		m_step = powf(brag[0] * brag[1] * brag[2], 1.f / 3.f) / float(resolution);
+		m_band = band;
+		LevelSet3D restSet;
+		restSet.create(ldp::Int3((bmax - bmin) / m_step), bmin, m_step);
+		restSet.fromMesh(rest, true, LevelSet3D::RedistanceFastSweeping);
+		const ldp::Int3 sz = restSet.size();
+
+		// the owner bones of each vertex and each cell
+		const SmplManager::SpMat& W = smpl.weights();
+		std::vector<unsigned int> vertOwners(rest.vertex_list.size(), 0);
+		for (int iVert = 0; iVert < (int)vertOwners.size(); iVert++)
+		for (int iw = W.outerIndexPtr()[iVert]; iw < W.outerIndexPtr()[iVert + 1]; iw++)
+		if (W.valuePtr()[iw] >= OWNER_WEIGHT)
+			vertOwners[iVert] |= 1u << W.innerIndexPtr()[iw];
+
+		typedef kdtree::PointTree<ValueType, 3> KdTree;
+		std::vector<KdTree::Point> kdpoints;
+		for (size_t i = 0; i < rest.vertex_list.size(); i++)
+			kdpoints.push_back(KdTree::Point(rest.vertex_list[i], (int)i));
+		KdTree tree;
+		tree.build(kdpoints);
+		std::vector<unsigned int> owners(restSet.sizeXYZ(), 0);
+#pragma omp parallel for
+		for (int x = 0; x < sz[0]; x++)
+		for (int y = 0; y < sz[1]; y++)
+		for (int z = 0; z < sz[2]; z++)
+		{
+			const int id = restSet.index(x, y, z);
+			if (restSet.value()[id] >= band)
+				continue;
+			ValueType dist = 0;
+			auto nv = tree.nearestPoint(KdTree::Point(bmin + Vec3(x, y, z) * m_step), dist);
+			owners[id] = vertOwners[nv.idx];
+		} // end for x
+
+		// dilate by OWNER_DILATION cells, separable along x, y and z, so that a bone keeps the straight continuation
+		//	of the body a bit beyond its joints, which closes the convex side of a bent joint
+		std::vector<unsigned int> dilated(owners.size(), 0);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const int a1 = (axis + 1) % 3, a2 = (axis + 2) % 3;
+#pragma omp parallel for
+			for (int u = 0; u < sz[a1]; u++)
+			for (int v = 0; v < sz[a2]; v++)
+			{
+				ldp::Int3 c;
+				c[a1] = u;
+				c[a2] = v;
+				for (int w = 0; w < sz[axis]; w++)
+				{
+					unsigned int m = 0;
+					for (c[axis] = Max(w - OWNER_DILATION, 0); c[axis] <= Min(w + OWNER_DILATION, sz[axis] - 1); c[axis]++)
+						m |= owners[restSet.index(c[0], c[1], c[2])];
+					c[axis] = w;
+					dilated[restSet.index(c[0], c[1], c[2])] = m;
+				}
+			} // end for u
+			owners.swap(dilated);
+		} // end for axis
+
+		// the cell range of each bone
+		std::vector<ldp::Int3> lo(nJoints, sz), hi(nJoints, ldp::Int3(-1));
+		for (int x = 0; x < sz[0]; x++)
+		for (int y = 0; y < sz[1]; y++)
+		for (int z = 0; z < sz[2]; z++)
+		{
+			const unsigned int m = owners[restSet.index(x, y, z)];
+			for (int j = 0; j < nJoints; j++)
+			if (m & (1u << j))
+			{
+				lo[j] = ldp::Int3(Min(lo[j][0], x), Min(lo[j][1], y), Min(lo[j][2], z));
+				hi[j] = ldp::Int3(Max(hi[j][0], x), Max(hi[j][1], y), Max(hi[j][2], z));
+			}
+		} // end for x
+
+		// the per-bone level sets, padded by 3 cells for the valid range of LevelSet3D::localValue()
+		for (int j = 0; j < nJoints; j++)
+		{
+			if (hi[j][0] < 0)
+				continue;
+			m_bones.push_back(Bone());
+			Bone& bone = m_bones.back();
+			bone.joint = j;
+			for (int k = 0; k < 3; k++)
+			{
+				lo[j][k] = Max(lo[j][k] - 3, 0);
+				hi[j][k] = Min(hi[j][k] + 3, sz[k] - 1);
+			}
+			const ldp::Int3 bsz = hi[j] - lo[j] + 1;
+			bone.field.create(bsz, bmin + Vec3(lo[j]) * m_step, m_step);
+#pragma omp parallel for
+			for (int x = 0; x < bsz[0]; x++)
+			for (int y = 0; y < bsz[1]; y++)
+			for (int z = 0; z < bsz[2]; z++)
+			{
+				const int id = restSet.index(x + lo[j][0], y + lo[j][1], z + lo[j][2]);
+				if (owners[id] & (1u << j))
+					*bone.field.value(x, y, z) = restSet.value()[id];
+			} // end for x
+			bone.field.toTiled(band);
+			bone.bmin = bone.field.getStartPos();
+			bone.bmax = bone.bmin + Vec3(bsz - 1) * m_step;
+			bone.R = Mat3().eye();
+			bone.T = Vec3(0);
+			bone.posedMin = bone.bmin;
+			bone.posedMax = bone.bmax;
+		} // end for j
+	}
+
+	void ArticulatedLevelSet::updatePose(const SmplManager& smpl)
+	{
+		for (auto& bone : m_bones)
+		{
+			const SmplManager::Mat3& R = smpl.getCurNodeRots(bone.joint);
+			const SmplManager::Vec3& T = smpl.getCurNodeTrans(bone.joint);
+			for (int r = 0; r < 3; r++)
+			{
+				bone.T[r] = T[r];
+				for (int c = 0; c < 3; c++)
+					bone.R(r, c) = R(r, c);
+			}
+			bone.posedMin = ValueType(MY_INFINITE);
+			bone.posedMax = -ValueType(MY_INFINITE);
+			for (int i = 0; i < 8; i++)
+			{
+				const Vec3 c((i & 1) ? bone.bmax[0] : bone.bmin[0], (i & 2) ? bone.bmax[1] : bone.bmin[1],
+					(i & 4) ? bone.bmax[2] : bone.bmin[2]);
+				const Vec3 p = bone.R * c + bone.T;
+				for (int k = 0; k < 3; k++)
+				{
+					bone.posedMin[k] = Min(bone.posedMin[k], p[k]);
+					bone.posedMax[k] = Max(bone.posedMax[k], p[k]);
+				}
+			}
+		} // end for bone
+	}
+
+	void ArticulatedLevelSet::sample(Vec3 p, ValueType* value, Vec3* grad)const
+	{
+		ValueType vals[MAX_BONES];
+		Vec3 grads[MAX_BONES];
+		int n = 0, iMin = -1;
+		for (const auto& bone : m_bones)
+		{
+			if (p[0] < bone.posedMin[0] || p[1] < bone.posedMin[1] || p[2] < bone.posedMin[2]
+				|| p[0] > bone.posedMax[0] || p[1] > bone.posedMax[1] || p[2] > bone.posedMax[2])
+				continue;
+			const Vec3 q = bone.R.trans() * (p - bone.T);
+			bone.field.globalSample(q, vals + n, grad ? grads + n : nullptr);
+			if (grad)
+				grads[n] = bone.R * grads[n];
+			if (iMin < 0 || vals[n] < vals[iMin])
+				iMin = n;
+			n++;
+		} // end for bone
+
+		// far from the surface, no blending
+		if (iMin < 0 || vals[iMin] >= m_band)
+		{
+			if (value)
+				*value = iMin < 0 ? ValueType(MY_INFINITE) : vals[iMin];
+			if (grad)
+				*grad = iMin < 0 ? Vec3(0) : grads[iMin];
+			return;
+		}
+
+		// soft minimum, the bone distances weighted by exp(-(v - min) / w),
+		//	such that overlapping bones of the same distance, e.g., in the rest pose, are not biased
+		ValueType wsum = 0, vsum = 0;
+		Vec3 gsum = 0;
+		for (int i = 0; i < n; i++)
+		{
+			const ValueType d = (vals[i] - vals[iMin]) / BLEND_WIDTH;
+			if (d > ValueType(20))
+				continue;
+			const ValueType w = exp(-d);
+			wsum += w;
+			vsum += w * vals[i];
+			if (grad)
+				gsum += w * grads[i];
+		}
+		if (value)
+			*value = vsum / wsum;
+		if (grad)
+			*grad = gsum / wsum;
+	}
+
+	void ArticulatedLevelSet::resample(LevelSet3D& lvSet, ldp::Int3 res, Vec3 start, ValueType step,
+		const ldp::Mat4f& bodyTransform)const
+	{
+		lvSet.create(res, start, step);
+		const ldp::Mat4f inv = bodyTransform.inv();
+		const Mat3 A = inv.getRotationPart();
+		const Vec3 t = inv.getTranslationPart();
+		// distances are scaled with the (uniform) scale of the body transform
+		const ValueType ratio = m_step * powf(fabs(bodyTransform.getRotationPart().det()), 1.f / 3.f) / step;
+#pragma omp parallel for
+		for (int x = 0; x < res[0]; x++)
+		for (int y = 0; y < res[1]; y++)
+		for (int z = 0; z < res[2]; z++)
+		{
+			ValueType v = 0;
+			sample(A * (start + Vec3(x, y, z) * step) + t, &v, nullptr);
+			v *= ratio;
+			*lvSet.value(x, y, z) = v >= m_band ? ValueType(MY_INFINITE) : v;
+		} // end for x
+	}
+}
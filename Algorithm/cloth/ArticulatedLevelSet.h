@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include "LevelSet3D.h"
+#include "ldpMat\ldp_basic_mat.h"
+
+class SmplManager;
+namespace ldp
+{
+	// The signed distance of a posed smpl body, made of rigid per-bone level sets.
+	// build() converts the rest pose body of the current shape into a level set once. Each cell is then owned by
+	//	the bones that skin its nearest vertex with weight >= OWNER_WEIGHT, dilated by OWNER_DILATION cells, and
+	//	each bone keeps a tiled copy of its own cells, other cells are infinite.
+	// A posed query transforms the point into the rest pose frame of each bone by the inverse of
+	//	getCurNodeRots()/getCurNodeTrans(), and blends the bone distances by a soft minimum.
+	// Pose correctives (posedirs) of smpl are ignored, thus the result is a rigid-skinning approximation.
+	class ArticulatedLevelSet
+	{
+	public:
+		typedef LevelSet3D::ValueType ValueType;
+		typedef LevelSet3D::Vec3 Vec3;
+		typedef ldp::ldp_basic_mat3<ValueType> Mat3;
+		enum{ MAX_BONES = 32, OWNER_DILATION = 6 };
+		static const ValueType OWNER_WEIGHT;
+		static const ValueType BLEND_WIDTH;		// of the soft minimum, in cells
+	public:
+		ArticulatedLevelSet();
+		~ArticulatedLevelSet();
+
+		void clear();
+		bool isValid()const { return !m_bones.empty(); }
+
+		// the rest pose of the current shape of smpl is used, its pose is restored after
+		// the grid step is powf(bbox volume, 1/3) / resolution, the same with ClothManager::calcLevelSet()
+		void build(SmplManager& smpl, int resolution, ValueType band = 6);
+
+		// take the current bone transforms of smpl, cheap
+		void updatePose(const SmplManager& smpl);
+
+		// the blended signed distance at p of the posed smpl space, value and grad in cells of the rest level set
+		// either value or grad can be nullptr
+		void sample(Vec3 p, ValueType* value, Vec3* grad)const;
+
+		// resample the posed distance on a grid of the body space, in cells of the grid,
+		//	far outside cells are infinite as in LevelSet3D::redistance()
+		// bodyTransform maps the smpl space to the body space, e.g., ClothManager::getBodyMeshTransform()
+		void resample(LevelSet3D& lvSet, ldp::Int3 res, Vec3 start, ValueType step,
+			const ldp::Mat4f& bodyTransform)const;
+
+		ValueType getStep()const { return m_step; }
+		ValueType getBand()const { return m_band; }
+		int numBones()const { return (int)m_bones.size(); }
+		size_t memoryBytes()const;
+	protected:
+		struct Bone
+		{
+			int joint = -1;
+			LevelSet3D field;				// rest pose, the cells not owned are infinite
+			Vec3 bmin, bmax;				// rest pose bounding box of the field
+			Mat3 R;							// current bone transform, posed = R * rest + T
+			Vec3 T;
+			Vec3 posedMin, posedMax;		// posed bounding box of the field
+		};
+	private:
+		std::vector<Bone> m_bones;
+		ValueType m_step;
+		ValueType m_band;
+	};
+}
@@ -0,0 +1,561 @@
+#include "BatchSimulationEngine.h"
+#include "clothManager.h"
+#include "SmplManager.h"
+#include "SparseStructureCache.h"
+#include "LevelSetCache.h"
+#include "SimulationProfiler.h"
+#include "PoseDatabase.h"
+#include "Renderable\ObjMesh.h"
+#include "tinyxml\tinyxml.h"
+#include "ldputil.h"
+#include <thread>
+#include <random>
+#include <fstream>
+#include <algorithm>
+#include <map>
+#include <omp.h>
+#include <cstdio>
+
+namespace ldp
+{
+	// the graph objects (id map, name set) are shared by all cloth managers,
+	//	thus pattern loading and triangulation must be serialized among the workers.
+	static std::mutex g_batch_sim_graphMutex;
+
+	struct BatchSimulationEngine::Worker
+	{
+		int id = 0;
+		int nOmpThreads = 1;
+		int patternId = -1;					// the pattern currently loaded in the manager
+		std::shared_ptr<ClothManager> manager;
+		std::shared_ptr<std::thread> thread;
+	};
+
+	static std::string toLower(std::string s)
+	{
+		std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+		return s;
+	}
+
+	void BatchSimulationEngine::Param::setDefault()
+	{
+		patternList = "";
+		shapeXml = "./data/spring/sprint_femal.smpl.xml";
+		poseRoot = "./data/Mocap/poses/";
+		poseDatabase = "";
+		outputRoot = "./data/Body_Cloth/";
+		maxBodyNum = 1000;
+		numWorkers = 0;
+		maxSimSteps = 2000;
+		exportSepMesh = true;
+		levelSetCacheMB = 2048;
+		articulatedBody = false;
+		proxySteps = 0;
+		poseSteps = 0;
+		poseKeyframes = 8;
+		randSeed = 1234;
+		backend = SimulationBackendCpu;
+	}
+
+	BatchSimulationEngine::BatchSimulationEngine()
+	{
+
+	}
+
+	BatchSimulationEngine::~BatchSimulationEngine()
+	{
+		clear();
+	}
+
+	void BatchSimulationEngine::clear()
+	{
+		m_workers.clear();
+		m_patternXmls.clear();
+		m_poseFiles.clear();
+		m_poseDb.reset((PoseDatabase*)nullptr);
+		m_shapeElms.clear();
+		m_shapeDoc.reset((TiXmlDocument*)nullptr);
+		m_tasks.clear();
+		m_taskBodyElms.clear();
+		m_patternRemainTasks.clear();
+		m_nextTask = 0;
+		m_nFinished = 0;
+		m_nFailed = 0;
+	}
+
+	void BatchSimulationEngine::init(const Param& param)
+	{
+		clear();
+		m_param = param;
+		LevelSetCache::instance().setFolder(m_param.levelSetCacheFolder);
+		LevelSetCache::instance().setBudget(size_t(std::max(m_param.levelSetCacheMB, 0)) << 20);
+
+		// pattern list
+		std::ifstream in(m_param.patternList);
+		if (in.fail())
+			throw std::exception(("IOError: " + m_param.patternList).c_str());
+		std::string patternPath;
+		while (std::getline(in, patternPath))
+		{
+			if (patternPath.size() && patternPath.back() == '\r')
+				patternPath.pop_back();
+			if (patternPath.empty())
+				continue;
+			if (!ldp::file_exist(patternPath.c_str()))
+				throw std::exception(("Don't exist pattern xml: " + patternPath).c_str());
+			m_patternXmls.push_back(patternPath);
+		}
+		in.close();
+		if (m_patternXmls.empty())
+			throw std::exception(("no pattern given in " + m_param.patternList).c_str());
+
+		// shapes
+		m_shapeDoc.reset(new TiXmlDocument);
+		if (!m_shapeDoc->LoadFile(m_param.shapeXml.c_str()))
+			throw std::exception(("IOError" + m_param.shapeXml + "]: " + m_shapeDoc->ErrorDesc()).c_str());
+		for (auto elm = m_shapeDoc->FirstChildElement()->FirstChildElement(); elm; elm = elm->NextSiblingElement())
+			m_shapeElms.push_back(elm);
+		if (m_shapeElms.empty())
+			throw std::exception(("no shape given in " + m_param.shapeXml).c_str());
+
+		// poses, the same order with QDir::entryList(), the packed database has the same order
+		std::string poseDbFile = m_param.poseDatabase;
+		if (poseDbFile.empty() && ldp::file_exist(PoseDatabase::defaultFilename(m_param.poseRoot).c_str()))
+			poseDbFile = PoseDatabase::defaultFilename(m_param.poseRoot);
+		if (!poseDbFile.empty())
+		{
+			m_poseDb.reset(new PoseDatabase);
+			m_poseDb->open(poseDbFile);
+			for (int i = 0; i < m_poseDb->numClips(); i++)
+				m_poseFiles.push_back(m_poseDb->clipName(i));
+		}
+		else
+		{
+			std::vector<std::string> poseFiles;
+			ldp::getAllFilesInDir(m_param.poseRoot, poseFiles, ".xml");
+			const std::string poseRoot = ldp::fullfile(m_param.poseRoot, "");
+			for (const auto& f : poseFiles)
+			{
+				std::string name = f.substr(poseRoot.size());
+				if (name.find_first_of("/\\") == std::string::npos)
+					m_poseFiles.push_back(name);
+			}
+			std::sort(m_poseFiles.begin(), m_poseFiles.end(), [](const std::string& a, const std::string& b){
+				return toLower(a) < toLower(b);
+			});
+		}
+		if (m_poseFiles.empty())
+			throw std::exception(("no pose given in " + m_param.poseRoot).c_str());
+
+		generateTasks();
+		printf("batch simulation: %d patterns, %d shapes, %d poses, %d tasks\n", (int)m_patternXmls.size(),
+			(int)m_shapeElms.size(), (int)m_poseFiles.size(), (int)m_tasks.size());
+	}
+
+	void BatchSimulationEngine::generateTasks()
+	{
+		std::uniform_int_distribution<> randintdist;
+		std::mt19937 rgen;
+		std::map<std::string, int> poseFrameNums;
+		const int nBodies = std::max(0, m_param.maxBodyNum);
+		m_patternRemainTasks.resize(m_patternXmls.size(), 0);
+		for (int iPattern = 0; iPattern < (int)m_patternXmls.size(); iPattern++)
+		{
+			// the same random sequence with the GUI batch simulation
+			randintdist.reset();
+			rgen.seed(m_param.randSeed);
+			std::vector<int> shapeIndexes(nBodies);
+			for (int i = 0; i < nBodies; i++)
+				shapeIndexes[i] = randintdist(rgen) % (int)m_shapeElms.size();
+			std::sort(shapeIndexes.begin(), shapeIndexes.end());
+
+			for (int iBody = 0; iBody < nBodies; iBody++)
+			{
+				Task task;
+				task.patternId = iPattern;
+				task.bodyId = iBody;
+				task.shapeId = shapeIndexes[iBody];
+				task.poseFile = m_poseFiles[randintdist(rgen) % (int)m_poseFiles.size()];
+				auto frameIter = poseFrameNums.find(task.poseFile);
+				if (frameIter == poseFrameNums.end() && m_poseDb.get())
+				{
+					const int clip = m_poseDb->findClip(task.poseFile);
+					const int num = clip < 0 ? 0 : m_poseDb->clipNumFrames(clip);
+					if (num <= 0)
+						throw std::exception(("no frame of " + task.poseFile + " in the pose database").c_str());
+					frameIter = poseFrameNums.insert(std::make_pair(task.poseFile, num)).first;
+				}
+				if (frameIter == poseFrameNums.end())
+				{
+					std::string txtFile = task.poseFile;
+					txtFile.replace(txtFile.rfind(".xml"), 4, "_info.txt");
+					std::ifstream info(ldp::fullfile(m_param.poseRoot, txtFile));
+					if (!info.is_open())
+						throw std::exception(("IOError" + txtFile + "]: File doesn't exist!\n").c_str());
+					int num = 0;
+					info >> num;
+					info.close();
+					if (num <= 0)
+						throw std::exception(("invalid frame number in " + txtFile).c_str());
+					frameIter = poseFrameNums.insert(std::make_pair(task.poseFile, num)).first;
+				}
+				task.poseFrame = randintdist(rgen) % frameIter->second;
+				m_tasks.push_back(task);
+				m_patternRemainTasks[iPattern]++;
+			} // end for iBody
+
+			ldp::mkdir(patternOutputFolder(iPattern));
+			if (!m_param.checkpointFolder.empty())
+				ldp::mkdir(patternFolder(m_param.checkpointFolder, iPattern));
+		} // end for iPattern
+		m_taskBodyElms.resize(m_tasks.size());
+	}
+
+	std::string BatchSimulationEngine::patternFolder(std::string root, int patternId)const
+	{
+		// root/a/b/c/ for a pattern .../a/b/c.xml
+		std::string path, name, ext;
+		ldp::fileparts(m_patternXmls.at(patternId), path, name, ext);
+		std::vector<std::string> folders;
+		std::string folder;
+		for (size_t i = 0; i < path.size(); i++)
+		{
+			if (path[i] == '/' || path[i] == '\\')
+			{
+				if (folder.size())
+					folders.push_back(folder);
+				folder.clear();
+			}
+			else
+				folder.push_back(path[i]);
+		}
+		if (folder.size())
+			folders.push_back(folder);
+		folders.push_back(name);
+		root = ldp::fullfile(root, "");
+		for (size_t i = folders.size() - std::min(folders.size(), size_t(3)); i < folders.size(); i++)
+			root = ldp::fullfile(root, folders[i] + "/");
+		return root;
+	}
+
+	std::string BatchSimulationEngine::phase1CheckpointPath(const Task& task, const ClothManager* manager)const
+	{
+		// the key of everything the settled drape depends on besides the pattern:
+		//	the shaped body mesh, the simulation params and the phase 1 settings of the engine
+		TopologyFingerprint key;
+		const ObjMesh* body = manager->bodyMesh();
+		key.add((int)body->vertex_list.size());
+		if (!body->vertex_list.empty())
+			key.add(body->vertex_list.data(), body->vertex_list.size() * sizeof(Float3));
+		const SimulationParam simParam = manager->getSimulationParam();
+		key.add(&simParam.bending_k, sizeof(float));
+		key.add(&simParam.spring_k, sizeof(float));
+		key.add((int)simParam.enable_self_collistion);
+		key.add(simParam.gravity);
+		key.add((int)simParam.pcg_warm_start);
+		key.add(&g_designParam.triangulateThre, sizeof(float));
+		key.add((int)m_param.backend);
+		key.add(m_param.maxSimSteps);
+		key.add((int)m_param.articulatedBody);
+		key.add(m_param.proxySteps);
+		char hex[32] = { 0 };
+		sprintf(hex, "%016llx", key.value());
+		return patternFolder(m_param.checkpointFolder, task.patternId) + "shape_" + std::to_string(task.shapeId)
+			+ "_" + hex + ".sim1";
+	}
+
+	void BatchSimulationEngine::run()
+	{
+		if (m_tasks.empty())
+			return;
+		const int nCores = std::max(1, (int)std::thread::hardware_concurrency());
+		int nWorkers = m_param.numWorkers > 0 ? m_param.numWorkers : nCores;
+		if (m_param.backend == SimulationBackendGpu && nWorkers > 1)
+		{
+			// the body level set is bound to a global cuda texture
+			printf("warning: BatchSimulationEngine, gpu backend supports only one worker\n");
+			nWorkers = 1;
+		}
+		nWorkers = std::min(nWorkers, (int)m_tasks.size());
+
+		// the managers are created in serial, each smpl model is loaded by the first worker using it
+		m_workers.clear();
+		for (int i = 0; i < nWorkers; i++)
+		{
+			std::shared_ptr<Worker> worker(new Worker);
+			worker->id = i;
+			worker->nOmpThreads = std::max(1, nCores / nWorkers);
+			worker->manager.reset(new ClothManager);
+			worker->manager->setSimulationBackend(m_param.backend);
+			worker->manager->usePrivateSmplModels();
+			worker->manager->setArticulatedBodyCollision(m_param.articulatedBody);
+			worker->manager->setBodyProxySteps(m_param.proxySteps);
+			auto eqParam = worker->manager->getEquilibriumParam();
+			eqParam.maxSteps = m_param.maxSimSteps;
+			worker->manager->setEquilibriumParam(eqParam);
+			SimulationProfiler* profiler = worker->manager->simulationProfiler();
+			if (profiler)
+			{
+				profiler->setEnabled(!m_param.profileFolder.empty());
+				profiler->setCapacity(m_param.profileFolder.empty() ? 1 : (1 << 20));
+			}
+			m_workers.push_back(worker);
+		} // end for i
+
+		printf("batch simulation: %d workers, %d threads each\n", nWorkers, m_workers[0]->nOmpThreads);
+		gtime_t t_begin = gtime_now();
+		for (auto& worker : m_workers)
+			worker->thread.reset(new std::thread(&BatchSimulationEngine::workerLoop, this, worker.get()));
+		for (auto& worker : m_workers)
+		if (worker->thread->joinable())
+			worker->thread->join();
+		gtime_t t_end = gtime_now();
+
+		if (!m_param.profileFolder.empty())
+		{
+			ldp::mkdir(m_param.profileFolder);
+			for (auto& worker : m_workers)
+			{
+				const SimulationProfiler* profiler = worker->manager->simulationProfiler();
+				if (profiler == nullptr)
+					continue;
+				const std::string name = ldp::fullfile(m_param.profileFolder, "worker_" + std::to_string(worker->id));
+				try
+				{
+					profiler->exportCsv(name + ".csv");
+					profiler->exportChromeTrace(name + ".json");
+				} catch (std::exception e)
+				{
+					printf("warning: %s\n", e.what());
+				}
+				printf("worker %d: %s\n", worker->id, profiler->getSummary().c_str());
+			} // end for worker
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(g_batch_sim_graphMutex);
+			m_workers.clear();
+		}
+		printf("batch simulation finished: %d tasks, %d failed, %.1f seconds\n",
+			m_nFinished, m_nFailed, gtime_seconds(t_begin, t_end));
+		printf("sparse structure cache: %d hits, %d misses\n", SparseStructureCache::instance().numHits(),
+			SparseStructureCache::instance().numMisses());
+		if (LevelSetCache::instance().isEnabled())
+			printf("level set cache: %d hits, %d misses\n", LevelSetCache::instance().numHits(),
+				LevelSetCache::instance().numMisses());
+	}
+
+	void BatchSimulationEngine::workerLoop(Worker* worker)
+	{
+		omp_set_num_threads(worker->nOmpThreads);
+		for (;;)
+		{
+			int taskId = -1;
+			{
+				std::lock_guard<std::mutex> lock(m_taskMutex);
+				if (m_nextTask >= (int)m_tasks.size())
+					break;
+				taskId = m_nextTask++;
+			}
+
+			const Task& task = m_tasks[taskId];
+			bool succeed = false;
+			try
+			{
+				simulateTask(worker, task);
+				recordTask(worker, task);
+				succeed = true;
+			} catch (std::exception e)
+			{
+				printf("error: worker %d, pattern %d, body %d: %s\n", worker->id, task.patternId, task.bodyId, e.what());
+			} catch (...)
+			{
+				printf("error: worker %d, pattern %d, body %d: unknown error\n", worker->id, task.patternId, task.bodyId);
+			}
+			if (!succeed)
+				worker->patternId = -1;	// reload the pattern for the next task
+
+			bool patternFinished = false;
+			{
+				std::lock_guard<std::mutex> lock(m_taskMutex);
+				m_nFinished++;
+				if (!succeed)
+					m_nFailed++;
+				patternFinished = (--m_patternRemainTasks[task.patternId] == 0);
+				printf("[%d/%d] worker %d, pattern %d, body %d %s\n", m_nFinished, (int)m_tasks.size(),
+					worker->id, task.patternId, task.bodyId, succeed ? "finished" : "failed");
+			}
+			if (patternFinished)
+				finishPattern(task.patternId);
+		} // end for
+	}
+
+	void BatchSimulationEngine::simulateTask(Worker* worker, const Task& task)
+	{
+		ClothManager* manager = worker->manager.get();
+
+		// load the pattern, and reset the cloth for the new body
+		{
+			std::lock_guard<std::mutex> lock(g_batch_sim_graphMutex);
+			if (worker->patternId != task.patternId)
+			{
+				worker->patternId = -1;
+				manager->clear();
+				manager->fromXml(m_patternXmls[task.patternId]);
+				worker->patternId = task.patternId;
+			}
+			manager->setSimulationMode(SimulationPause);
+			manager->clearBindClothesToSmplJoints();
+			manager->simulationInit();
+		}
+		SmplManager* smpl = manager->bodySmplManager();
+		if (smpl == nullptr)
+			throw std::exception(("no smpl body in pattern: " + m_patternXmls[task.patternId]).c_str());
+
+		// phase 1: the given shape with the rest pose
+		std::vector<float> shapes(smpl->numShapes(), 0.f);
+		std::vector<float> poses(smpl->numPoses()*smpl->numVarEachPose(), 0.f);
+		smpl->setPoseShapeVals(&poses, &shapes);
+		smpl->loadCoeffsFromXml(m_shapeElms[task.shapeId], true, false);
+		manager->updateSmplBody();
+		manager->resetEquilibrium();
+		manager->setSimulationMode(SimulationOn);
+		const std::string checkpoint = m_param.checkpointFolder.empty() ? "" : phase1CheckpointPath(task, manager);
+		bool restored = false;
+		if (!checkpoint.empty() && std::ifstream(checkpoint).good())
+		{
+			// the settled drape of the same (pattern, body, params), by another task or a crashed run
+			try
+			{
+				manager->loadSimulationCheckpoint(checkpoint);
+				restored = true;
+			} catch (std::exception e)
+			{
+				printf("worker %d, ignore checkpoint %s: %s\n", worker->id, checkpoint.c_str(), e.what());
+			}
+		}
+		if (!restored)
+		{
+			simulateUntilSettled(manager);
+			if (!checkpoint.empty())
+			{
+				// write then rename, so that a crash never leaves a broken checkpoint
+				const std::string tmpName = checkpoint + ".w" + std::to_string(worker->id);
+				manager->saveSimulationCheckpoint(tmpName);
+				std::remove(checkpoint.c_str());
+				std::rename(tmpName.c_str(), checkpoint.c_str());
+			}
+		} // end if not restored
+
+		// phase 2: bind the cloth to the body and change the pose
+		manager->setSimulationMode(SimulationPause);
+		manager->bindClothesToSmplJoints();
+		manager->updateClothBySmplJoints();
+		if (m_poseDb.get())
+		{
+			std::vector<float> pose;
+			m_poseDb->getPose(m_poseDb->findClip(task.poseFile), task.poseFrame, pose);
+			smpl->setPoseShapeVals(&pose, nullptr);
+		}
+		else
+		{
+			TiXmlDocument poseDoc;
+			const std::string poseFile = ldp::fullfile(m_param.poseRoot, task.poseFile);
+			if (!poseDoc.LoadFile(poseFile.c_str()))
+				throw std::exception(("IOError" + poseFile + "]: " + poseDoc.ErrorDesc()).c_str());
+			auto poseElm = poseDoc.FirstChildElement()->FirstChildElement();
+			for (int j = 0; j < task.poseFrame && poseElm; j++, poseElm = poseElm->NextSiblingElement());
+			if (poseElm == nullptr)
+				throw std::exception(("frame out of range: " + poseFile).c_str());
+			smpl->loadCoeffsFromXml(poseElm, false, true);
+		}
+		if (m_param.poseSteps > 0)
+		{
+			// from the rest pose of phase 1, the cloth follows the moving body
+			std::vector<float> targetPoses(poses.size());
+			for (int j = 0; j < smpl->numPoses(); j++)
+			for (int k = 0; k < smpl->numVarEachPose(); k++)
+				targetPoses[j * smpl->numVarEachPose() + k] = (float)smpl->getCurPoseCoef(j, k);
+			smpl->setPoseShapeVals(&poses, nullptr);
+			manager->animateSmplBodyPose(targetPoses, m_param.poseSteps, m_param.poseKeyframes);
+		}
+		else
+			manager->updateSmplBody();
+		manager->resetEquilibrium();
+		manager->setSimulationMode(SimulationOn);
+		simulateUntilSettled(manager);
+		manager->setSimulationMode(SimulationPause);
+	}
+
+	void BatchSimulationEngine::simulateUntilSettled(ClothManager* manager)const
+	{
+		// maxSteps of the equilibrium monitor guarantees the termination
+		while (manager->getSimulationMode() == SimulationOn && !manager->isSimulationSettled())
+			manager->simulationUpdate();
+	}
+
+	void BatchSimulationEngine::recordTask(Worker* worker, const Task& task)
+	{
+		ClothManager* manager = worker->manager.get();
+		const std::string rootPath = patternOutputFolder(task.patternId);
+		const std::string clothFolder = rootPath + std::to_string(task.bodyId);
+		const std::string clothPath = clothFolder + ".obj";
+		if (m_param.exportSepMesh)
+		{
+			ldp::mkdir(clothFolder);
+			std::vector<ObjMesh> meshes;
+			manager->exportClothsSeparated(meshes);
+			for (size_t i = 0; i < meshes.size(); i++)
+				meshes[i].saveObj(ldp::fullfile(clothFolder, std::to_string(i) + ".obj").c_str());
+		}
+		else
+		{
+			ObjMesh mesh;
+			manager->exportClothsMerged(mesh, true);
+			mesh.saveObj(clothPath.c_str());
+		}
+
+		std::shared_ptr<TiXmlElement> bodyElement(new TiXmlElement("Body"));
+		TiXmlElement* clothPathElm = new TiXmlElement("ClothPath");
+		TiXmlElement* posePathElm = new TiXmlElement("PosePath");
+		clothPathElm->LinkEndChild(new TiXmlText(clothPath.c_str()));
+		posePathElm->LinkEndChild(new TiXmlText(task.poseFile.c_str()));
+		bodyElement->LinkEndChild(clothPathElm);
+		bodyElement->LinkEndChild(posePathElm);
+		manager->bodySmplManager()->saveCoeffsToXml(bodyElement.get(), true, true);
+
+		// the single xml per-mesh
+		if (m_param.exportSepMesh)
+		{
+			TiXmlDocument document;
+			TiXmlElement* rootElement = new TiXmlElement("BodyInfoDocument");
+			rootElement->SetAttribute("source_folder", rootPath.c_str());
+			document.LinkEndChild(rootElement);
+			rootElement->InsertEndChild(*bodyElement);
+			document.SaveFile((clothFolder + "/Bodyinfo.xml").c_str());
+		}
+
+		std::lock_guard<std::mutex> lock(m_taskMutex);
+		m_taskBodyElms[&task - m_tasks.data()] = bodyElement;
+	}
+
+	void BatchSimulationEngine::finishPattern(int patternId)
+	{
+		// all bodies of a pattern, in the task order
+		const std::string rootPath = patternOutputFolder(patternId);
+		TiXmlDocument document;
+		TiXmlElement* rootElement = new TiXmlElement("BodyInfoDocument");
+		rootElement->SetAttribute("source_folder", rootPath.c_str());
+		document.LinkEndChild(rootElement);
+		std::lock_guard<std::mutex> lock(m_taskMutex);
+		for (size_t i = 0; i < m_tasks.size(); i++)
+		{
+			if (m_tasks[i].patternId != patternId || m_taskBodyElms[i].get() == nullptr)
+				continue;
+			rootElement->InsertEndChild(*m_taskBodyElms[i]);
+			m_taskBodyElms[i].reset((TiXmlElement*)nullptr);
+		} // end for i
+		document.SaveFile((rootPath + "Bodyinfo.xml").c_str());
+		printf("pattern finished: %s\n", m_patternXmls[patternId].c_str());
+	}
+}
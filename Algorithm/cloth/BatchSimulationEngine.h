@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include "definations.h"
+
+class TiXmlDocument;
+class TiXmlElement;
+namespace ldp
+{
+	class ClothManager;
+	class PoseDatabase;
+	// Headless batch simulation, i.e., the dataset generation of ClothDesigner without any Qt/GL window:
+	//	for each pattern xml in the list, maxBodyNum bodies are simulated;
+	//	each body takes a random shape from shapeXml, settles the cloth (phase 1),
+	//	binds the cloth to the smpl joints, takes a random mocap pose from poseRoot and settles again (phase 2).
+	// The bodies are simulated by a pool of workers, each owns its ClothManager and simulator.
+	// All random choices are made before running, with the same order as the GUI version,
+	//	thus the result is independent of the number of workers.
+	class BatchSimulationEngine
+	{
+	public:
+		struct Param
+		{
+			std::string patternList;		// batch_simulate_pattern_xmls.txt, one project xml per line
+			std::string shapeXml;			// pre-recorded smpl shapes
+			std::string poseRoot;			// folder of mocap pose xmls, each with a "_info.txt" of its frame number
+			std::string poseDatabase;		// the packed poseRoot, see PoseDatabase; <poseRoot>/poses.pdb if exists by default
+			std::string outputRoot;			// outputRoot/<the last 3 folders of the pattern>/<body id>.obj
+			int maxBodyNum = 0;				// bodies simulated for each pattern
+			int numWorkers = 0;				// <= 0 to use all cores
+			int maxSimSteps = 0;			// each phase ends after so many steps, even if not settled
+			bool exportSepMesh = true;		// export each piece separately, as the GUI default
+			std::string profileFolder;		// if not empty, the step profile of each worker is exported here
+			std::string checkpointFolder;	// if not empty, the settled phase 1 of each (pattern, shape) is saved here,
+											//	and reused by the later tasks and runs of the same body and params
+			std::string levelSetCacheFolder;	// if not empty, the body level sets are cached here over runs
+			int levelSetCacheMB = 0;			// the size budget of levelSetCacheFolder, least recently used files dropped
+			bool articulatedBody = false;		// posed body level sets from the per-bone ones, see ArticulatedLevelSet
+			int proxySteps = 0;					// collide with a body proxy in the first steps, see BodyProxy
+			int poseSteps = 0;					// if > 0, phase 2 moves the body to the pose in so many steps
+			int poseKeyframes = 0;				//	with the level sets of so many poses on the way blended
+			unsigned int randSeed = 0;
+			SimulationBackend backend = SimulationBackendCpu;
+			Param(){ setDefault(); }
+			void setDefault();
+		};
+		// a body to simulate
+		struct Task
+		{
+			int patternId = 0;
+			int bodyId = 0;
+			int shapeId = 0;				// index of element in shapeXml
+			std::string poseFile;			// relative to poseRoot
+			int poseFrame = 0;
+		};
+	public:
+		BatchSimulationEngine();
+		~BatchSimulationEngine();
+
+		void clear();
+
+		// read the pattern list, shapes and poses, then generate all the tasks
+		void init(const Param& param);
+
+		// simulate all the tasks, blocked until all workers finished
+		void run();
+
+		const Param& getParam()const{ return m_param; }
+		int numTasks()const{ return (int)m_tasks.size(); }
+		int numFinishedTasks()const{ return m_nFinished; }
+		int numFailedTasks()const{ return m_nFailed; }
+	protected:
+		struct Worker;
+		void generateTasks();
+		void workerLoop(Worker* worker);
+		void simulateTask(Worker* worker, const Task& task);
+		void simulateUntilSettled(ClothManager* manager)const;
+		void recordTask(Worker* worker, const Task& task);
+		void finishPattern(int patternId);
+		std::string patternOutputFolder(int patternId)const{ return patternFolder(m_param.outputRoot, patternId); }
+		std::string patternFolder(std::string root, int patternId)const;
+		// keyed by the shaped body and the simulation params, thus never reused if they change
+		std::string phase1CheckpointPath(const Task& task, const ClothManager* manager)const;
+	private:
+		Param m_param;
+		std::vector<std::string> m_patternXmls;
+		std::vector<std::string> m_poseFiles;
+		std::shared_ptr<PoseDatabase> m_poseDb;		// if opened, the poses are read from it instead of the xmls
+		std::shared_ptr<TiXmlDocument> m_shapeDoc;
+		std::vector<TiXmlElement*> m_shapeElms;
+		std::vector<Task> m_tasks;
+		std::vector<std::shared_ptr<TiXmlElement>> m_taskBodyElms;	// the record of each task, for Bodyinfo.xml
+		std::vector<int> m_patternRemainTasks;
+		std::vector<std::shared_ptr<Worker>> m_workers;
+
+		std::mutex m_taskMutex;
+		int m_nextTask = 0;
+		int m_nFinished = 0;
+		int m_nFailed = 0;
+	};
+}
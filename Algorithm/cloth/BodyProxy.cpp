@@ -0,0 +1,138 @@
+#include "BodyProxy.h"
+#include "SmplManager.h"
+#include "Renderable\ObjMesh.h"
+#include <eigen\Dense>
+
+namespace ldp
+{
+	const float BodyProxy::OWNER_WEIGHT = 0.1f;
+
+	BodyProxy::BodyProxy()
+	{
+
+	}
+
+	BodyProxy::~BodyProxy()
+	{
+
+	}
+
+	void BodyProxy::clear()
+	{
+		m_primitives.clear();
+	}
+
+	void BodyProxy::fromSmpl(const SmplManager& smpl, const ObjMesh& bodyMesh, const ldp::Mat4f& bodyTransform)
+	{
+		clear();
+		const int nJoints = smpl.numPoses();
+		const SmplManager::SpMat& W = smpl.weights();
+		if ((int)bodyMesh.vertex_list.size() != W.outerSize())
+			throw std::exception("BodyProxy::fromSmpl(): the body mesh is not of the smpl topology");
+
+		// the kinematic tree and the posed joint centers in the body space
+		const ldp::Mat3f R = bodyTransform.getRotationPart();
+		const Float3 T = bodyTransform.getTranslationPart();
+		std::vector<Float3> centers(nJoints);
+		std::vector<std::vector<int>> children(nJoints);
+		for (int j = 0; j < nJoints; j++)
+		{
+			const SmplManager::Vec3 c = smpl.getCurNodeCenter(j);
+			centers[j] = R * Float3(float(c[0]), float(c[1]), float(c[2])) + T;
+			const int parent = smpl.getNodeParent(j);
+			if (parent >= 0 && parent < nJoints)
+				children[parent].push_back(j);
+		}
+		std::vector<int> nLeaves(nJoints, 0);
+		for (int j = nJoints - 1; j >= 0; j--)
+		{
+			if (children[j].empty())
+				nLeaves[j] = 1;
+			for (int c : children[j])
+				nLeaves[j] += nLeaves[c];
+		}
+
+		// the vertices of each joint: its dominant ones for capsules, and the ones
+		//	skinned with weight >= OWNER_WEIGHT for ellipsoids, to overlap the neighbors
+		std::vector<std::vector<int>> dominantVerts(nJoints), ownedVerts(nJoints);
+		for (int iVert = 0; iVert < W.outerSize(); iVert++)
+		{
+			int jMax = -1;
+			SmplManager::real wMax = 0;
+			for (int iw = W.outerIndexPtr()[iVert]; iw < W.outerIndexPtr()[iVert + 1]; iw++)
+			{
+				const int j = W.innerIndexPtr()[iw];
+				const SmplManager::real w = W.valuePtr()[iw];
+				if (w >= OWNER_WEIGHT)
+					ownedVerts[j].push_back(iVert);
+				if (w > wMax)
+				{
+					wMax = w;
+					jMax = j;
+				}
+			}
+			if (jMax >= 0)
+				dominantVerts[jMax].push_back(iVert);
+		} // end for iVert
+
+		for (int j = 0; j < nJoints; j++)
+		{
+			Primitive prim;
+			prim.joint = j;
+
+			// a single chain of joints, capsule of the mean radius
+			if (children[j].size() == 1 && nLeaves[j] == 1)
+			{
+				const std::vector<int>& verts = dominantVerts[j];
+				prim.type = Primitive::Capsule;
+				prim.center = centers[j];
+				prim.axis[0] = centers[children[j][0]] - centers[j];
+				float sum = 0.f;
+				for (int iVert : verts)
+				{
+					float v = 0.f;
+					Float3 g;
+					sampleCapsule(prim, bodyMesh.vertex_list[iVert], v, g);
+					sum += v;
+				}
+				prim.radius = verts.empty() ? 0.f : sum / float(verts.size());
+				if (prim.radius[0] > 0.f)
+					m_primitives.push_back(prim);
+				continue;
+			}
+
+			// else, ellipsoid of the principal axes, the radii are the max extents along them
+			const std::vector<int>& verts = ownedVerts[j];
+			if (verts.size() < 4)
+				continue;
+			Eigen::Vector3f mean = Eigen::Vector3f::Zero();
+			for (int iVert : verts)
+			{
+				const Float3& v = bodyMesh.vertex_list[iVert];
+				mean += Eigen::Vector3f(v[0], v[1], v[2]);
+			}
+			mean /= float(verts.size());
+			Eigen::Matrix3f cov = Eigen::Matrix3f::Zero();
+			for (int iVert : verts)
+			{
+				const Float3& v = bodyMesh.vertex_list[iVert];
+				const Eigen::Vector3f d = Eigen::Vector3f(v[0], v[1], v[2]) - mean;
+				cov += d * d.transpose();
+			}
+			Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f> solver(cov);
+			prim.type = Primitive::Ellipsoid;
+			prim.center = Float3(mean[0], mean[1], mean[2]);
+			for (int k = 0; k < 3; k++)
+				prim.axis[k] = Float3(solver.eigenvectors()(0, k), solver.eigenvectors()(1, k), solver.eigenvectors()(2, k));
+			prim.radius = 0.f;
+			for (int iVert : verts)
+			{
+				const Float3 d = bodyMesh.vertex_list[iVert] - prim.center;
+				for (int k = 0; k < 3; k++)
+					prim.radius[k] = std::max(prim.radius[k], fabsf(d.dot(prim.axis[k])));
+			}
+			if (prim.radius[0] > 0.f && prim.radius[1] > 0.f && prim.radius[2] > 0.f)
+				m_primitives.push_back(prim);
+		} // end for j
+	}
+}
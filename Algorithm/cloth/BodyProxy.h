@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+#include "ldpMat\ldp_basic_vec.h"
+#include "ldpMat\ldp_basic_mat.h"
+
+class SmplManager;
+class ObjMesh;
+namespace ldp
+{
+	// An analytic collider of a smpl body, for coarse preview and the early drape steps.
+	// Each joint of a single chain of joints (limbs, neck) is a capsule from its center to its child center,
+	//	other joints (torso, head, hands and feet) are ellipsoids along the principal axes of their vertices.
+	// The distance and gradient are in closed form, the same code for the cpu and gpu simulators. The distance
+	//	of an ellipsoid is approximated by k0 * (k0 - 1) / k1, k0 = |x / r|, k1 = |x / r^2|, exact on the surface.
+	class BodyProxy
+	{
+	public:
+		struct Primitive
+		{
+			enum Type{ Capsule, Ellipsoid };
+			int type = Capsule;
+			int joint = -1;
+			Float3 center;			// capsule: one end of the segment
+			Float3 axis[3];			// capsule: axis[0] is the segment; ellipsoid: the unit principal axes
+			Float3 radius;			// capsule: radius[0]; ellipsoid: radii along the axes
+		};
+		static const float OWNER_WEIGHT;
+	public:
+		BodyProxy();
+		~BodyProxy();
+
+		void clear();
+		bool empty()const { return m_primitives.empty(); }
+		int size()const { return (int)m_primitives.size(); }
+		const Primitive* data()const { return m_primitives.data(); }
+		const std::vector<Primitive>& primitives()const { return m_primitives; }
+
+		// fit the current posed body of smpl
+		// bodyMesh is the smpl mesh transformed by bodyTransform, e.g., ClothManager::bodyMesh()
+		void fromSmpl(const SmplManager& smpl, const ObjMesh& bodyMesh, const ldp::Mat4f& bodyTransform);
+
+		// the signed distance and its unit gradient, in the body space, either value or grad can be nullptr
+		void sample(Float3 p, float* value, Float3* grad)const
+		{
+			float v = 0.f;
+			Float3 g;
+			sample(data(), size(), p, v, g);
+			if (value)
+				*value = v;
+			if (grad)
+				*grad = g;
+		}
+
+		// the union of n primitives, infinite if n == 0
+		__device__ __host__ static void sample(const Primitive* prims, int n, Float3 p, float& value, Float3& grad)
+		{
+			value = 1e30f;
+			grad = 0.f;
+			for (int i = 0; i < n; i++)
+			{
+				float v = 0.f;
+				Float3 g;
+				if (prims[i].type == Primitive::Capsule)
+					sampleCapsule(prims[i], p, v, g);
+				else
+					sampleEllipsoid(prims[i], p, v, g);
+				if (v < value)
+				{
+					value = v;
+					grad = g;
+				}
+			} // end for i
+		}
+		__device__ __host__ static void sampleCapsule(const Primitive& c, Float3 p, float& value, Float3& grad)
+		{
+			const Float3 d = p - c.center;
+			const float len2 = c.axis[0].sqrLength();
+			float t = len2 > 0.f ? d.dot(c.axis[0]) / len2 : 0.f;
+			t = t < 0.f ? 0.f : (t > 1.f ? 1.f : t);
+			const Float3 q = d - t * c.axis[0];
+			const float l = q.length();
+			value = l - c.radius[0];
+			grad = l > 0.f ? q / l : Float3(0.f);
+		}
+		__device__ __host__ static void sampleEllipsoid(const Primitive& e, Float3 p, float& value, Float3& grad)
+		{
+			const Float3 d = p - e.center;
+			const Float3 q(d.dot(e.axis[0]), d.dot(e.axis[1]), d.dot(e.axis[2]));
+			const Float3 q1 = q / e.radius;
+			const Float3 q2 = q1 / e.radius;
+			const float k0 = q1.length();
+			const float k1 = q2.length();
+			if (k1 == 0.f)
+			{
+				const float rmin = e.radius[0] < e.radius[1] ? e.radius[0] : e.radius[1];
+				value = -(rmin < e.radius[2] ? rmin : e.radius[2]);
+				grad = 0.f;
+				return;
+			}
+			value = k0 * (k0 - 1.f) / k1;
+			grad = (q2[0] * e.axis[0] + q2[1] * e.axis[1] + q2[2] * e.axis[2]) / k1;
+		}
+	private:
+		std::vector<Primitive> m_primitives;
+	};
+}
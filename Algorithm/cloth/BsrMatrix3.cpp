@@ -0,0 +1,531 @@
+#include "BsrMatrix3.h"
+#include <algorithm>
+#include <omp.h>
+
+#define BSR_MATRIX3_ENABLE_SSE
+
+#ifdef BSR_MATRIX3_ENABLE_SSE
+#include <xmmintrin.h>      // __m128 data type and SSE functions
+#endif
+
+namespace ldp
+{
+	BsrMatrix3::BsrMatrix3()
+	{
+		m_blocksInRow = 0;
+		m_blocksInCol = 0;
+		m_nnzBlocks = 0;
+		m_structure.reset(new Structure);
+	}
+
+	BsrMatrix3::~BsrMatrix3()
+	{
+		clear();
+	}
+
+	void BsrMatrix3::clear()
+	{
+		m_blocksInRow = 0;
+		m_blocksInCol = 0;
+		m_nnzBlocks = 0;
+		m_structure.reset(new Structure);
+		m_values.clear();
+		m_pcg_invDiag.clear();
+		m_pcg_r.clear();
+		m_pcg_z.clear();
+		m_pcg_p.clear();
+		m_pcg_Ap.clear();
+	}
+
+	void BsrMatrix3::resize(int blocksInRow, int blocksInCol)
+	{
+		m_blocksInRow = blocksInRow;
+		m_blocksInCol = blocksInCol;
+		m_nnzBlocks = 0;
+		m_structure.reset(new Structure);
+		m_structure->rowPtr.assign(blocksInRow + 1, 0);
+		m_structure->diagPos.assign(blocksInRow, -1);
+		m_values.assign(1, ldp::Mat3f().zeros());
+	}
+
+	void BsrMatrix3::setStructure(const int* bsrRowPtr, const int* bsrColIdx)
+	{
+		// never modify the old structure in place, it may be shared
+		m_nnzBlocks = bsrRowPtr[m_blocksInRow];
+		m_structure.reset(new Structure);
+		m_structure->rowPtr.assign(bsrRowPtr, bsrRowPtr + m_blocksInRow + 1);
+		m_structure->colIdx.assign(bsrColIdx, bsrColIdx + m_nnzBlocks);
+		m_structure->diagPos.assign(m_blocksInRow, -1);
+		m_values.assign(m_nnzBlocks + 1, ldp::Mat3f().zeros());
+		for (int r = 0; r < m_blocksInRow; r++)
+			m_structure->diagPos[r] = findBlock(r, r);
+	}
+
+	void BsrMatrix3::shareStructure(const BsrMatrix3& rhs)
+	{
+		m_blocksInRow = rhs.m_blocksInRow;
+		m_blocksInCol = rhs.m_blocksInCol;
+		m_nnzBlocks = rhs.m_nnzBlocks;
+		m_structure = rhs.m_structure;
+		m_values.assign(m_nnzBlocks + 1, ldp::Mat3f().zeros());
+	}
+
+	void BsrMatrix3::setStructureFromBoo(const int* booRow, const int* booCol, int nnzBlocks)
+	{
+		std::vector<int> rowPtr(m_blocksInRow + 1, 0);
+		for (int i = 0; i < nnzBlocks; i++)
+			rowPtr[booRow[i] + 1]++;
+		for (int r = 0; r < m_blocksInRow; r++)
+			rowPtr[r + 1] += rowPtr[r];
+		setStructure(rowPtr.data(), booCol);
+	}
+
+	int BsrMatrix3::findBlock(int row, int col)const
+	{
+		const int* colIdx = m_structure->colIdx.data();
+		const int* cb = colIdx + m_structure->rowPtr[row];
+		const int* ce = colIdx + m_structure->rowPtr[row + 1];
+		const int* pos = std::lower_bound(cb, ce, col);
+		if (pos == ce || *pos != col)
+			return -1;
+		return int(pos - colIdx);
+	}
+
+	BsrMatrix3& BsrMatrix3::operator = (float constVal)
+	{
+		const int n = (int)m_nnzBlocks;
+#pragma omp parallel for
+		for (int i = 0; i < n; i++)
+			m_values[i] = constVal;
+		return *this;
+	}
+
+	inline void BsrMatrix3::rowMv(int row, const float* x, float* y)const
+	{
+		const int* colIdx = m_structure->colIdx.data();
+		const int pb = m_structure->rowPtr[row], pe = m_structure->rowPtr[row + 1];
+#ifdef BSR_MATRIX3_ENABLE_SSE
+		// each row of a block is loaded as 4 floats, the 4th one multiplies 0 and is dropped;
+		// the padded last block makes the loading safe.
+		__m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps();
+		for (int pos = pb; pos < pe; pos++)
+		{
+			const float* A = m_values[pos].ptr();
+			const float* xc = x + colIdx[pos] * 3;
+			const __m128 xv = _mm_setr_ps(xc[0], xc[1], xc[2], 0.f);
+			s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(A), xv));
+			s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(A + 3), xv));
+			s2 = _mm_add_ps(s2, _mm_mul_ps(_mm_loadu_ps(A + 6), xv));
+		}
+		float tmp[3][4];
+		_mm_storeu_ps(tmp[0], s0);
+		_mm_storeu_ps(tmp[1], s1);
+		_mm_storeu_ps(tmp[2], s2);
+		for (int k = 0; k < 3; k++)
+			y[k] = tmp[k][0] + tmp[k][1] + tmp[k][2];
+#else
+		float sum[3] = { 0.f, 0.f, 0.f };
+		for (int pos = pb; pos < pe; pos++)
+		{
+			const float* A = m_values[pos].ptr();
+			const float* xc = x + colIdx[pos] * 3;
+			for (int k = 0; k < 3; k++)
+				sum[k] += A[k * 3 + 0] * xc[0] + A[k * 3 + 1] * xc[1] + A[k * 3 + 2] * xc[2];
+		}
+		for (int k = 0; k < 3; k++)
+			y[k] = sum[k];
+#endif
+	}
+
+	void BsrMatrix3::Mv(const float* x, float* y, float alpha, float beta)const
+	{
+		const int nRows = m_blocksInRow;
+#pragma omp parallel for
+		for (int r = 0; r < nRows; r++)
+		{
+			float Ax[3];
+			rowMv(r, x, Ax);
+			for (int k = 0; k < 3; k++)
+				y[r * 3 + k] = alpha * Ax[k] + (beta == 0.f ? 0.f : beta * y[r * 3 + k]);
+		} // end for r
+	}
+
+	int BsrMatrix3::pcg(const float* b, float* x, int maxIter, float tol, float* err, float* err0)const
+	{
+		if (m_blocksInRow != m_blocksInCol)
+			throw std::exception("BsrMatrix3::pcg(): matrix must be square!");
+		const int nRows = m_blocksInRow;
+		const int nVal = nRows * 3;
+		m_pcg_invDiag.resize(nRows);
+		m_pcg_r.resize(nVal);
+		m_pcg_z.resize(nVal);
+		m_pcg_p.assign(nVal, 0.f);
+		m_pcg_Ap.resize(nVal);
+		float* r = m_pcg_r.data();
+		float* z = m_pcg_z.data();
+		float* p = m_pcg_p.data();
+		float* Ap = m_pcg_Ap.data();
+		const Mat3f* invD = m_pcg_invDiag.data();
+
+		// all scalars are shared, they are only written in reductions or single sections
+		float norm_b2 = 0.f, rz = 0.f, old_rz = 0.f, pAp = 0.f, rr = 0.f, rr0 = 0.f;
+		float relErr = 0.f;
+		bool converged = false;
+		int nIter = 0;
+#pragma omp parallel
+		{
+			// invD = inv(diag(A)), r = b-Ax, |b|^2, |r|^2
+#pragma omp for reduction(+:norm_b2, rr0)
+			for (int row = 0; row < nRows; row++)
+			{
+				const int dpos = m_structure->diagPos[row];
+				m_pcg_invDiag[row] = dpos >= 0 ? m_values[dpos].inv() : ldp::Mat3f().eye();
+				float Ax[3];
+				rowMv(row, x, Ax);
+				for (int k = 0; k < 3; k++)
+				{
+					r[row * 3 + k] = b[row * 3 + k] - Ax[k];
+					norm_b2 += b[row * 3 + k] * b[row * 3 + k];
+					rr0 += r[row * 3 + k] * r[row * 3 + k];
+				}
+			} // end for row
+
+			for (int iter = 0; iter < maxIter && norm_b2 != 0.f; iter++)
+			{
+#pragma omp single
+				{
+					rz = pAp = rr = 0.f;
+				}
+
+				// z = invD * r, rz = r'*z
+#pragma omp for reduction(+:rz)
+				for (int row = 0; row < nRows; row++)
+				{
+					const float* D = invD[row].ptr();
+					const float* ri = r + row * 3;
+					for (int k = 0; k < 3; k++)
+					{
+						z[row * 3 + k] = D[k * 3 + 0] * ri[0] + D[k * 3 + 1] * ri[1] + D[k * 3 + 2] * ri[2];
+						rz += ri[k] * z[row * 3 + k];
+					}
+				} // end for row
+
+				// p = z+beta*p, beta = rz/old_rz
+				const float beta = (old_rz == 0.f) ? 0.f : rz / old_rz;
+#pragma omp for
+				for (int i = 0; i < nVal; i++)
+					p[i] = beta * p[i] + z[i];
+
+				// Ap = A*p, pAp = p'*Ap
+#pragma omp for reduction(+:pAp)
+				for (int row = 0; row < nRows; row++)
+				{
+					rowMv(row, p, Ap + row * 3);
+					pAp += p[row * 3 + 0] * Ap[row * 3 + 0] + p[row * 3 + 1] * Ap[row * 3 + 1]
+						+ p[row * 3 + 2] * Ap[row * 3 + 2];
+				} // end for row
+
+				// x = x + alpha*p, r = r - alpha*Ap, rr = r'*r, alpha = rz / pAp
+				const float alpha = (pAp == 0.f) ? 0.f : rz / pAp;
+#pragma omp for reduction(+:rr)
+				for (int i = 0; i < nVal; i++)
+				{
+					x[i] += alpha * p[i];
+					r[i] -= alpha * Ap[i];
+					rr += r[i] * r[i];
+				}
+
+#pragma omp single
+				{
+					old_rz = rz;
+					nIter = iter + 1;
+					relErr = sqrt(rr / norm_b2);
+					converged = relErr < tol;
+				}
+
+				// the recursive residual says converged, verify it with the true residual b-Ax;
+				// if not, the true residual replaces the recursive one and we continue.
+				if (converged)
+				{
+#pragma omp single
+					{
+						rr = 0.f;
+					}
+#pragma omp for reduction(+:rr)
+					for (int row = 0; row < nRows; row++)
+					{
+						float Ax[3];
+						rowMv(row, x, Ax);
+						for (int k = 0; k < 3; k++)
+						{
+							r[row * 3 + k] = b[row * 3 + k] - Ax[k];
+							rr += r[row * 3 + k] * r[row * 3 + k];
+						}
+					} // end for row
+#pragma omp single
+					{
+						relErr = sqrt(rr / norm_b2);
+						converged = relErr < tol;
+					}
+					if (converged)
+						break;
+				} // end if converged
+			} // end for iter
+		} // end omp parallel
+
+		if (err)
+			*err = relErr;
+		if (err0)
+			*err0 = norm_b2 == 0.f ? 0.f : sqrt(rr0 / norm_b2);
+		return nIter;
+	}
+
+	void BsrMatrix3::pcgBatch(int nMats, const BsrMatrix3* const* A, const float* const* b, float* const* x,
+		int maxIter, float tol, int* iters, float* errs, float* errs0)
+	{
+		if (nMats <= 0)
+			return;
+		for (int m = 0; m < nMats; m++)
+		{
+			if (A[m]->m_blocksInRow != A[m]->m_blocksInCol)
+				throw std::exception("BsrMatrix3::pcgBatch(): matrix must be square!");
+			if (!A[m]->isStructureShared(*A[0]))
+				throw std::exception("BsrMatrix3::pcgBatch(): matrices must share the structure!");
+		}
+		const int nRows = A[0]->m_blocksInRow;
+		const int nVal = nRows * 3;
+		const int nTotalRows = nRows * nMats;
+		const int nTotalVal = nVal * nMats;
+		const int* diagPos = A[0]->m_structure->diagPos.data();
+		std::vector<ldp::Mat3f> invDiag(nTotalRows);
+		std::vector<float> r(nTotalVal), z(nTotalVal), p(nTotalVal, 0.f), Ap(nTotalVal);
+
+		// per-matrix scalars, accumulated by each thread then added atomically
+		std::vector<float> norm_b2(nMats, 0.f), rz(nMats, 0.f), old_rz(nMats, 0.f), pAp(nMats, 0.f);
+		std::vector<float> rr(nMats, 0.f), rr0(nMats, 0.f), relErr(nMats, 0.f);
+		std::vector<int> nIter(nMats, 0);
+		std::vector<char> active(nMats, 1);	// the convergence mask
+		int nActive = nMats;
+#pragma omp parallel
+		{
+			std::vector<float> loc0(nMats), loc1(nMats);
+
+			// invD = inv(diag(A)), r = b-Ax, |b|^2, |r|^2
+			std::fill(loc0.begin(), loc0.end(), 0.f);
+			std::fill(loc1.begin(), loc1.end(), 0.f);
+#pragma omp for
+			for (int i = 0; i < nTotalRows; i++)
+			{
+				const int m = i / nRows, row = i - m * nRows;
+				const int dpos = diagPos[row];
+				invDiag[i] = dpos >= 0 ? A[m]->m_values[dpos].inv() : ldp::Mat3f().eye();
+				float Ax[3];
+				A[m]->rowMv(row, x[m], Ax);
+				for (int k = 0; k < 3; k++)
+				{
+					const float bk = b[m][row * 3 + k];
+					r[i * 3 + k] = bk - Ax[k];
+					loc0[m] += bk * bk;
+					loc1[m] += r[i * 3 + k] * r[i * 3 + k];
+				}
+			} // end for i
+			for (int m = 0; m < nMats; m++)
+			{
+#pragma omp atomic
+				norm_b2[m] += loc0[m];
+#pragma omp atomic
+				rr0[m] += loc1[m];
+			}
+#pragma omp barrier
+#pragma omp single
+			{
+				for (int m = 0; m < nMats; m++)
+				if (norm_b2[m] == 0.f)
+				{
+					active[m] = 0;
+					nActive--;
+				}
+			}
+
+			for (int iter = 0; iter < maxIter && nActive > 0; iter++)
+			{
+#pragma omp single
+				{
+					std::fill(rz.begin(), rz.end(), 0.f);
+					std::fill(pAp.begin(), pAp.end(), 0.f);
+					std::fill(rr.begin(), rr.end(), 0.f);
+				}
+
+				// z = invD * r, rz = r'*z
+				std::fill(loc0.begin(), loc0.end(), 0.f);
+#pragma omp for
+				for (int i = 0; i < nTotalRows; i++)
+				{
+					const int m = i / nRows;
+					if (!active[m])
+						continue;
+					const float* D = invDiag[i].ptr();
+					const float* ri = r.data() + i * 3;
+					for (int k = 0; k < 3; k++)
+					{
+						z[i * 3 + k] = D[k * 3 + 0] * ri[0] + D[k * 3 + 1] * ri[1] + D[k * 3 + 2] * ri[2];
+						loc0[m] += ri[k] * z[i * 3 + k];
+					}
+				} // end for i
+				for (int m = 0; m < nMats; m++)
+				{
+#pragma omp atomic
+					rz[m] += loc0[m];
+				}
+#pragma omp barrier
+
+				// p = z+beta*p, beta = rz/old_rz
+#pragma omp for
+				for (int i = 0; i < nTotalVal; i++)
+				{
+					const int m = i / nVal;
+					if (!active[m])
+						continue;
+					const float beta = (old_rz[m] == 0.f) ? 0.f : rz[m] / old_rz[m];
+					p[i] = beta * p[i] + z[i];
+				}
+
+				// Ap = A*p, pAp = p'*Ap
+				std::fill(loc0.begin(), loc0.end(), 0.f);
+#pragma omp for
+				for (int i = 0; i < nTotalRows; i++)
+				{
+					const int m = i / nRows, row = i - m * nRows;
+					if (!active[m])
+						continue;
+					A[m]->rowMv(row, p.data() + m * nVal, Ap.data() + i * 3);
+					loc0[m] += p[i * 3 + 0] * Ap[i * 3 + 0] + p[i * 3 + 1] * Ap[i * 3 + 1]
+						+ p[i * 3 + 2] * Ap[i * 3 + 2];
+				} // end for i
+				for (int m = 0; m < nMats; m++)
+				{
+#pragma omp atomic
+					pAp[m] += loc0[m];
+				}
+#pragma omp barrier
+
+				// x = x + alpha*p, r = r - alpha*Ap, rr = r'*r, alpha = rz / pAp
+				std::fill(loc0.begin(), loc0.end(), 0.f);
+#pragma omp for
+				for (int i = 0; i < nTotalVal; i++)
+				{
+					const int m = i / nVal;
+					if (!active[m])
+						continue;
+					const float alpha = (pAp[m] == 0.f) ? 0.f : rz[m] / pAp[m];
+					x[m][i - m * nVal] += alpha * p[i];
+					r[i] -= alpha * Ap[i];
+					loc0[m] += r[i] * r[i];
+				}
+				for (int m = 0; m < nMats; m++)
+				{
+#pragma omp atomic
+					rr[m] += loc0[m];
+				}
+#pragma omp barrier
+
+				// the converged ones are verified with the true residual b-Ax, as pcg() does
+#pragma omp single
+				{
+					for (int m = 0; m < nMats; m++)
+					{
+						if (!active[m])
+							continue;
+						old_rz[m] = rz[m];
+						nIter[m] = iter + 1;
+						relErr[m] = sqrt(rr[m] / norm_b2[m]);
+						active[m] = relErr[m] < tol ? 2 : 1;	// 2: to be verified
+						rr[m] = 0.f;
+					}
+				}
+				std::fill(loc0.begin(), loc0.end(), 0.f);
+#pragma omp for
+				for (int i = 0; i < nTotalRows; i++)
+				{
+					const int m = i / nRows, row = i - m * nRows;
+					if (active[m] != 2)
+						continue;
+					float Ax[3];
+					A[m]->rowMv(row, x[m], Ax);
+					for (int k = 0; k < 3; k++)
+					{
+						r[i * 3 + k] = b[m][row * 3 + k] - Ax[k];
+						loc0[m] += r[i * 3 + k] * r[i * 3 + k];
+					}
+				} // end for i
+				for (int m = 0; m < nMats; m++)
+				{
+#pragma omp atomic
+					rr[m] += loc0[m];
+				}
+#pragma omp barrier
+#pragma omp single
+				{
+					for (int m = 0; m < nMats; m++)
+					{
+						if (active[m] != 2)
+							continue;
+						relErr[m] = sqrt(rr[m] / norm_b2[m]);
+						if (relErr[m] < tol)
+						{
+							active[m] = 0;
+							nActive--;
+						}
+						else
+							active[m] = 1;
+					}
+				}
+			} // end for iter
+		} // end omp parallel
+
+		for (int m = 0; m < nMats; m++)
+		{
+			if (iters)
+				iters[m] = nIter[m];
+			if (errs)
+				errs[m] = relErr[m];
+			if (errs0)
+				errs0[m] = norm_b2[m] == 0.f ? 0.f : sqrt(rr0[m] / norm_b2[m]);
+		}
+	}
+
+	void BsrMatrix3::toCsr(std::vector<int>& csrRowPtr, std::vector<int>& csrColIdx,
+		std::vector<float>& csrValue)const
+	{
+		csrRowPtr.resize(rows() + 1);
+		csrColIdx.resize(nnz());
+		csrValue.resize(nnz());
+		const std::vector<int>& rowPtr = m_structure->rowPtr;
+		const std::vector<int>& colIdx = m_structure->colIdx;
+		csrRowPtr[0] = 0;
+		for (int row = 0; row < m_blocksInRow; row++)
+		{
+			const int nBlocks = rowPtr[row + 1] - rowPtr[row];
+			for (int k = 0; k < 3; k++)
+				csrRowPtr[row * 3 + k + 1] = rowPtr[row] * 9 + (k + 1) * nBlocks * 3;
+		}
+#pragma omp parallel for
+		for (int row = 0; row < m_blocksInRow; row++)
+		{
+			for (int pos = rowPtr[row]; pos < rowPtr[row + 1]; pos++)
+			{
+				const int col = colIdx[pos];
+				const float* A = m_values[pos].ptr();
+				for (int k = 0; k < 3; k++)
+				{
+					int cpos = csrRowPtr[row * 3 + k] + (pos - rowPtr[row]) * 3;
+					for (int c = 0; c < 3; c++)
+					{
+						csrColIdx[cpos + c] = col * 3 + c;
+						csrValue[cpos + c] = A[k * 3 + c];
+					}
+				}
+			} // end for pos
+		} // end for row
+	}
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include "ldpMat\ldp_basic_mat.h"
+
+namespace ldp
+{
+	// host version of CudaBsrMatrix, with fixed 3x3 blocks
+	// the same layout: bsrRowPtr[blocksInRow+1], bsrColIdx[nnzBlocks] and
+	// values[nnzBlocks], each block is row majored (that is, A(i,j) = value[pos][i*3+j]).
+	class BsrMatrix3
+	{
+	public:
+		BsrMatrix3();
+		~BsrMatrix3();
+
+		void clear();
+		void resize(int blocksInRow, int blocksInCol);
+
+		//// to construct a bsr matrix
+		// 0. call resize
+		// 1. call setStructure() with the bsr row ptr and col idx, or
+		//	  call setStructureFromBoo() with the sorted unique block coordinates
+		// 2. once structure defined, you can fill values by free into value()
+		void setStructure(const int* bsrRowPtr, const int* bsrColIdx);
+		void setStructureFromBoo(const int* booRow, const int* booCol, int nnzBlocks);
+		// use the same structure with rhs without copying it, the values are set to zero
+		void shareStructure(const BsrMatrix3& rhs);
+		bool isStructureShared(const BsrMatrix3& rhs)const{ return m_structure == rhs.m_structure; }
+
+		int blocksInRow()const{ return m_blocksInRow; }
+		int blocksInCol()const{ return m_blocksInCol; }
+		int rows()const{ return m_blocksInRow * 3; }
+		int cols()const{ return m_blocksInCol * 3; }
+		int nnz()const{ return m_nnzBlocks * 9; }
+		int nnzBlocks()const{ return m_nnzBlocks; }
+		const int* bsrRowPtr()const{ return m_structure->rowPtr.data(); }
+		const int* bsrColIdx()const{ return m_structure->colIdx.data(); }
+		const ldp::Mat3f* value()const{ return m_values.data(); }
+		ldp::Mat3f* value(){ return m_values.data(); }
+		const ldp::Mat3f& block(int pos)const{ return m_values[pos]; }
+		ldp::Mat3f& block(int pos){ return m_values[pos]; }
+
+		// position of block (row, col) in value(), -1 if not exist
+		int findBlock(int row, int col)const;
+		// position of the diagonal block of each row, -1 if not exist
+		int diagPos(int row)const{ return m_structure->diagPos[row]; }
+
+		BsrMatrix3& operator = (float constVal);
+
+		// mult-vector: y = alpha * this * x + beta * y
+		void Mv(const float* x, float* y, float alpha = 1.f, float beta = 0.f)const;
+
+		// block-jacobi preconditioned conjugate gradient, solving this * x = b
+		// x: the initial guess as input and the solution as output
+		// the dot products, axpys and the residual norm are fused into the matrix/preconditioner passes
+		// return the number of iterations and the relative residual |b-Ax|/|b| in err,
+		// err0 is the relative residual of the initial guess
+		int pcg(const float* b, float* x, int maxIter, float tol, float* err = nullptr, float* err0 = nullptr)const;
+
+		// the batched version of pcg(), solving A[i] * x[i] = b[i] for all i in one parallel region;
+		// all A[i] must share the same structure, an instance drops out once converged.
+		// iters/errs/errs0 can be nullptr, otherwise they are of size nMats.
+		static void pcgBatch(int nMats, const BsrMatrix3* const* A, const float* const* b, float* const* x,
+			int maxIter, float tol, int* iters = nullptr, float* errs = nullptr, float* errs0 = nullptr);
+
+		// convert to scalar csr
+		void toCsr(std::vector<int>& csrRowPtr, std::vector<int>& csrColIdx, std::vector<float>& csrValue)const;
+	protected:
+		// y[0:3] = block row * x
+		inline void rowMv(int row, const float* x, float* y)const;
+	private:
+		struct Structure
+		{
+			std::vector<int> rowPtr;
+			std::vector<int> colIdx;
+			std::vector<int> diagPos;
+		};
+		int m_blocksInRow;
+		int m_blocksInCol;
+		int m_nnzBlocks;
+		std::shared_ptr<Structure> m_structure;	// may be shared by several matrices
+		std::vector<ldp::Mat3f> m_values;	// one more block is padded for sse loading
+
+		// pcg buffers
+		mutable std::vector<ldp::Mat3f> m_pcg_invDiag;
+		mutable std::vector<float> m_pcg_r;
+		mutable std::vector<float> m_pcg_z;
+		mutable std::vector<float> m_pcg_p;
+		mutable std::vector<float> m_pcg_Ap;
+	};
+}
@@ -0,0 +1,1844 @@
+#include "CpuSim.h"
+#include "ldputil.h"
+#include "clothManager.h"
+#include "Renderable\ObjMesh.h"
+#include "cloth\LevelSet3D.h"
+#include "cloth\BodyProxy.h"
+#include "cloth\clothPiece.h"
+#include "cloth\graph\Graph.h"
+#include "SimulationCheckpoint.h"
+#include "arcsim\adaptiveCloth\conf.hpp"
+#include <algorithm>
+#include <numeric>
+#include <omp.h>
+
+namespace ldp
+{
+#pragma region -- utils
+	typedef ldp_basic_vec<float, 9> Float9;
+	typedef ldp_basic_vec<float, 12> FloatC;
+	typedef ldp_basic_mat_sqr<float, 9> Mat9f;
+	typedef ldp_basic_mat_sqr<float, 12> MatCf;
+	typedef ldp_basic_mat<float, 3, 2> Mat32f;
+	typedef ldp_basic_mat<float, 3, 9> Mat39f;
+	typedef ldp_basic_mat<float, 2, 3> Mat23f;
+	typedef ldp_basic_mat_col<float, 3> Mat31f;
+
+	template<class T, int n>
+	static inline ldp::ldp_basic_vec<T, n> convert(arcsim::Vec<n, T> v)
+	{
+		ldp::ldp_basic_vec<T, n> r;
+		for (int k = 0; k < n; k++)
+			r[k] = v[k];
+		return r;
+	}
+
+	template<size_t N, size_t M>
+	static inline ldp_basic_mat<float, N, M> outer(ldp::ldp_basic_vec<float, N> x, ldp::ldp_basic_vec<float, M> y)
+	{
+		ldp_basic_mat<float, N, M> A;
+		for (int row = 0; row < N; row++)
+		for (int col = 0; col < M; col++)
+			A(row, col) = x[row] * y[col];
+		return A;
+	}
+	template<class T, size_t N>
+	static inline ldp_basic_vec<T, N> floor(ldp_basic_vec<T, N> a)
+	{
+		ldp_basic_vec<T, N> c;
+		for (int i = 0; i < N; i++)
+			c[i] = ::floor(a[i]);
+		return c;
+	}
+	template<class T, size_t N>
+	static inline ldp_basic_vec<T, N> ceil(ldp_basic_vec<T, N> a)
+	{
+		ldp_basic_vec<T, N> c;
+		for (int i = 0; i < N; i++)
+			c[i] = ::ceil(a[i]);
+		return c;
+	}
+	static inline Float3 mat_getCol(Mat32f A, int col)
+	{
+		return Float3(A(0, col), A(1, col), A(2, col));
+	}
+	static inline Mat23f make_rows(Float3 a, Float3 b)
+	{
+		Mat23f C;
+		for (int k = 0; k < 3; k++)
+		{
+			C(0, k) = a[k];
+			C(1, k) = b[k];
+		}
+		return C;
+	}
+	static inline Float9 make_Float9(Float3 a, Float3 b, Float3 c)
+	{
+		Float9 d;
+		for (int k = 0; k < 3; k++)
+		{
+			d[k] = a[k];
+			d[3 + k] = b[k];
+			d[6 + k] = c[k];
+		}
+		return d;
+	}
+	static inline FloatC make_Float12(Float3 a, Float3 b, Float3 c, Float3 d)
+	{
+		FloatC v;
+		for (int k = 0; k < 3; k++)
+		{
+			v[k] = a[k];
+			v[3 + k] = b[k];
+			v[6 + k] = c[k];
+			v[9 + k] = d[k];
+		}
+		return v;
+	}
+	static inline Mat32f derivative(const Float3 x[3], const Float2 t[3])
+	{
+		return Mat32f(Mat31f(x[1] - x[0]), Mat31f(x[2] - x[0])) * Mat2f(t[1] - t[0], t[2] - t[0]).inv();
+	}
+	static inline Mat23f derivative(const Float2 t[3])
+	{
+		return Mat2f(t[1] - t[0], t[2] - t[0]).inv().trans()*
+			make_rows(Float3(-1, 1, 0), Float3(-1, 0, 1));
+	}
+	template<class V>
+	static inline Float3 get_subFloat3(V a, int i)
+	{
+		return Float3(a[i * 3], a[i * 3 + 1], a[i * 3 + 2]);
+	}
+	template<class M>
+	static inline Mat3f get_subMat3f(const M& A, int row, int col)
+	{
+		Mat3f B;
+		for (int r = 0; r < 3; r++)
+		for (int c = 0; c < 3; c++)
+			B(r, c) = A(r + row * 3, c + col * 3);
+		return B;
+	}
+	static inline float unwrap_angle(float theta, float theta_ref)
+	{
+		if (theta - theta_ref > ldp::PI_S)
+			theta -= 2 * ldp::PI_S;
+		if (theta - theta_ref < -ldp::PI_S)
+			theta += 2 * ldp::PI_S;
+		return theta;
+	}
+	static inline Mat39f kronecker_eye_row(const Mat23f &A, int iRow)
+	{
+		Mat39f C;
+		C.zeros();
+		for (int k = 0; k < 3; k++)
+			C(0, k * 3) = C(1, k * 3 + 1) = C(2, k * 3 + 2) = A(iRow, k);
+		return C;
+	}
+	static inline float dihedral_angle(Float3 a, Float3 b, Float3 n0, Float3 n1, float ref_theta)
+	{
+		if ((a - b).length() == 0.f || n0.length() == 0.f || n1.length() == 0.f)
+			return 0.f;
+		const Float3 e = (a - b).normalize();
+		const float cosine = n0.dot(n1);
+		const float sine = e.dot(n0.cross(n1));
+		const float theta = atan2(sine, cosine);
+		return unwrap_angle(theta, ref_theta);
+	}
+	static inline float distance(const Float3 &x, const Float3 &a, const Float3 &b)
+	{
+		Float3 e = b - a;
+		Float3 xp = e*e.dot(x - a) / e.dot(e);
+		return std::max((x - a - xp).length(), 1e-3f*e.length());
+	}
+	static inline Float2 barycentric_weights(Float3 x, Float3 a, Float3 b)
+	{
+		double t = (b - a).dot(x - a) / (b - a).sqrLength();
+		return Float2(1 - t, t);
+	}
+	static inline bool isValid(Float3 x)
+	{
+		for (int k = 0; k < 3; k++)
+		if (_isnan(x[k]) || !_finite(x[k]))
+			return false;
+		return true;
+	}
+
+	// the same with the cuda texture fetching of linear filter mode and clamp address mode
+	static inline Float4 texRead_strechSample(const CpuSim::Material& mat, float x, float y, float z)
+	{
+		const int N = CpuSim::Material::STRETCH_SAMPLES;
+		x -= 0.5f, y -= 0.5f, z -= 0.5f;
+		const int i = (int)::floor(x), j = (int)::floor(y), k = (int)::floor(z);
+		const float a = x - i, b = y - j, c = z - k;
+		const int i0 = std::min(N - 1, std::max(0, i)), i1 = std::min(N - 1, std::max(0, i + 1));
+		const int j0 = std::min(N - 1, std::max(0, j)), j1 = std::min(N - 1, std::max(0, j + 1));
+		const int k0 = std::min(N - 1, std::max(0, k)), k1 = std::min(N - 1, std::max(0, k + 1));
+		const Float4* s = mat.stretchSample.data();
+#define STRETCH_SAMPLE(x, y, z) s[((z)*N + (y))*N + (x)]
+		return (1 - a)*(1 - b)*(1 - c)*STRETCH_SAMPLE(i0, j0, k0) + a*(1 - b)*(1 - c)*STRETCH_SAMPLE(i1, j0, k0)
+			+ (1 - a)*b*(1 - c)*STRETCH_SAMPLE(i0, j1, k0) + a*b*(1 - c)*STRETCH_SAMPLE(i1, j1, k0)
+			+ (1 - a)*(1 - b)*c*STRETCH_SAMPLE(i0, j0, k1) + a*(1 - b)*c*STRETCH_SAMPLE(i1, j0, k1)
+			+ (1 - a)*b*c*STRETCH_SAMPLE(i0, j1, k1) + a*b*c*STRETCH_SAMPLE(i1, j1, k1);
+#undef STRETCH_SAMPLE
+	}
+
+	// the same with the cuda texture fetching of point filter mode and clamp address mode
+	static inline float texRead_bendData(const CpuSim::Material& mat, int x, int y)
+	{
+		x = std::min(CpuSim::Material::BEND_DIMS - 1, std::max(0, x));
+		y = std::min(CpuSim::Material::BEND_POINTS - 1, std::max(0, y));
+		return mat.bendData[y*CpuSim::Material::BEND_DIMS + x];
+	}
+
+	static inline Float4 stretching_stiffness(const Mat2f &G, const CpuSim::Material& mat)
+	{
+		float a = (G(0, 0) + 0.25f)*CpuSim::Material::STRETCH_SAMPLES;
+		float b = (G(1, 1) + 0.25f)*CpuSim::Material::STRETCH_SAMPLES;
+		float c = fabsf(G(0, 1))*CpuSim::Material::STRETCH_SAMPLES;
+		return texRead_strechSample(mat, a, b, c);
+	}
+
+	static inline float bending_stiffness(const CpuSim::EdgeData& eData, float dihe_angle, float area,
+		const CpuSim::Material& mat, int side)
+	{
+		// because samples are per 0.05 cm^-1 = 5 m^-1
+		const float len = 0.5f * (sqrt(eData.length_sqr[0]) + sqrt(eData.length_sqr[1]));
+		float value = std::min(4.f, dihe_angle*len / area * 0.5f*0.2f);
+		float bias_angle = fabs((eData.theta_uv[side] + eData.theta_initial) * 4.f / ldp::PI_S);
+		int value_i = std::min(3, std::max(0, (int)value));
+		value -= value_i;
+		const int bias_id = (int)bias_angle;
+		bias_angle -= bias_id;
+		float actual_ke = texRead_bendData(mat, bias_id, value_i) * (1 - bias_angle)*(1 - value)
+			+ texRead_bendData(mat, bias_id + 1, value_i) * (bias_angle)*(1 - value)
+			+ texRead_bendData(mat, bias_id, value_i + 1) * (1 - bias_angle)*(value)
+			+texRead_bendData(mat, bias_id + 1, value_i + 1) * (bias_angle)*(value);
+		if (actual_ke < 0) actual_ke = 0;
+		return actual_ke;
+	}
+
+	static inline float signed_vf_distance(const Float3 &x, const Float3 &y0,
+		const Float3 &y1, const Float3 &y2, Float3& n, float *w)
+	{
+		if ((y1 - y0).length() == 0.f || (y2 - y0).length() == 0.f)
+			return FLT_MAX;
+		n = Float3((y1 - y0).normalize()).cross((y2 - y0).normalize());
+		if (n.length() < 1e-6f)
+			return FLT_MAX;
+		n.normalizeLocal();
+		float b0 = (y1 - x).dot(Float3(y2 - x).cross(n));
+		float b1 = (y2 - x).dot(Float3(y0 - x).cross(n));
+		float b2 = (y0 - x).dot(Float3(y1 - x).cross(n));
+		w[3] = 1.f;
+		w[0] = -b0 / (b0 + b1 + b2);
+		w[1] = -b1 / (b0 + b1 + b2);
+		w[2] = -b2 / (b0 + b1 + b2);
+		if (w[0] > 1e-6f || w[1] > 1e-6f || w[2] > 1e-6f)
+			return FLT_MAX;
+		return (x - y0).dot(n);
+	}
+
+	static inline bool face_edge_same_order(BMesh& bmesh, BMEdge* e, BMFace* f)
+	{
+		BMVert* v[3] = { nullptr };
+		int cnt = 0;
+		BMESH_V_OF_F(vtmp, f, v_of_f_iter, bmesh)
+		{
+			v[cnt++] = vtmp;
+			if (cnt >= 3)
+				break;
+		}
+		BMVert* bv[2] = { bmesh.vofe_first(e), bmesh.vofe_last(e) };
+		if (v[0] == bv[0] && v[1] == bv[1]
+			|| v[1] == bv[0] && v[2] == bv[1]
+			|| v[2] == bv[0] && v[0] == bv[1])
+			return true;
+		else if (v[0] == bv[1] && v[1] == bv[0]
+			|| v[1] == bv[1] && v[2] == bv[0]
+			|| v[2] == bv[1] && v[0] == bv[0])
+			return false;
+		throw std::exception("edge not on face!");
+	}
+
+	static inline bool overlap(Int2 edges[2])
+	{
+		Int4 idx(edges[0][0], edges[0][1], edges[1][0], edges[1][1]);
+		for (int r = 0; r < 4; r++)
+		for (int c = r + 1; c < 4; c++)
+		if (idx[r] == idx[c])
+			return true;
+		return false;
+	}
+
+	// build csr of (row, col) pairs, the pairs should be sorted and unique
+	static void pairsToCsr(const std::vector<Int2>& pairs, int nRows,
+		std::vector<int>& rowPtr, std::vector<int>& colIdx)
+	{
+		rowPtr.assign(nRows + 1, 0);
+		colIdx.resize(pairs.size());
+		for (size_t i = 0; i < pairs.size(); i++)
+		{
+			rowPtr[pairs[i][0] + 1]++;
+			colIdx[i] = pairs[i][1];
+		}
+		for (int r = 0; r < nRows; r++)
+			rowPtr[r + 1] += rowPtr[r];
+	}
+
+	// sort the scattered ids, then for each unique id, record the range of its scattered positions
+	template<class T>
+	static void buildScanStructure(const std::vector<T>& ids, std::vector<T>& uniqueIds,
+		std::vector<int>& scanPtr, std::vector<int>& scanIdx)
+	{
+		scanIdx.resize(ids.size());
+		std::iota(scanIdx.begin(), scanIdx.end(), 0);
+		std::stable_sort(scanIdx.begin(), scanIdx.end(), [&](int a, int b){ return ids[a] < ids[b]; });
+		uniqueIds.clear();
+		scanPtr.clear();
+		for (size_t i = 0; i < scanIdx.size(); i++)
+		{
+			if (i == 0 || ids[scanIdx[i]] != ids[scanIdx[i - 1]])
+			{
+				uniqueIds.push_back(ids[scanIdx[i]]);
+				scanPtr.push_back((int)i);
+			}
+		}
+		scanPtr.push_back((int)scanIdx.size());
+	}
+#pragma endregion
+
+	CpuSim::CpuSim()
+	{
+		m_bmesh.reset(new BMesh());
+		m_resultClothMesh.reset(new ObjMesh);
+		m_instances.resize(1);
+	}
+
+	CpuSim::~CpuSim()
+	{
+		clear();
+	}
+
+	void CpuSim::init(ClothManager* clothManager)
+	{
+		clear();
+		release_assert(ldp::is_float<ClothManager::ValueType>::value);
+		m_clothManager = clothManager;
+		initParam();
+		resetDependency(true);
+		initFaceEdgeVertArray();
+		m_solverInfo = "cpu solver intialized from cloth manager";
+	}
+
+	void CpuSim::run_one_step()
+	{
+		if (m_clothManager == nullptr)
+			return;
+
+		m_solverInfo = "[cpu, ";
+
+		gtime_t t_start = gtime_now();
+		m_profiler.beginStep();
+		SimulationProfiler::ScopedTimer stepTimer(m_profiler, "run_one_step");
+
+		{
+			SimulationProfiler::ScopedTimer timer(m_profiler, "updateSystem");
+			updateSystem();
+		}
+
+		std::vector<int> insIds;
+		for (int i = 0; i < (int)m_instances.size(); i++)
+		{
+			if (i > 0)
+				m_instances[i].equilibrium.setParam(m_instances[0].equilibrium.getParam());
+			if (m_instances[i].active)
+				insIds.push_back(i);
+		}
+		const int nActive = (int)insIds.size();
+
+		// build A and b of each instance; with multiple instances, each thread owns one instance,
+		//	and the inner parallel loops are serialized
+		const double t_numeric = m_profiler.now();
+#pragma omp parallel for schedule(dynamic, 1) if(nActive > 1)
+		for (int k = 0; k < nActive; k++)
+		{
+			Instance& ins = m_instances[insIds[k]];
+
+			// stitching: during stitching, we do not want the speed to high
+			ins.curStitchRatio = std::max(0.f, 1.f - ins.curSimulationTime * m_simParam.stitch_ratio);
+			if (ins.curStitchRatio > 0.f)
+			{
+				std::fill(ins.v_h.begin(), ins.v_h.end(), Float3(0.f));
+				ins.last_v_h = ins.v_h;
+			}
+
+			// build A and b
+			updateNumeric(ins);
+
+			// prepare the linear system
+			ins.last_x_h = ins.x_h;
+			ins.last_v_h = ins.v_h;
+			initPcgGuess(ins);
+		} // end for k
+		m_profiler.addTimer("updateNumeric", t_numeric, m_profiler.now());
+
+		// solve the linear systems together
+		{
+			SimulationProfiler::ScopedTimer timer(m_profiler, "linearSolve");
+			linearSolve(insIds);
+		}
+
+		// finish, prepare for next.
+		int nSettled = 0, maxIter = 0, nPairs = 0;
+		float maxErr = 0.f;
+		for (int k = 0; k < nActive; k++)
+		{
+			Instance& ins = m_instances[insIds[k]];
+			nPairs += ins.nPairs;
+			update_x_v_by_dv(ins);
+			ins.curSimulationTime += m_simParam.dt;
+			updateEquilibrium(ins);
+			maxIter = std::max(maxIter, ins.lastSolveIter);
+			maxErr = std::max(maxErr, ins.lastSolveErr);
+
+			// settled instances are skipped in the following steps, until restarted
+			if (m_instances.size() > 1 && ins.equilibrium.isSettled())
+			{
+				ins.active = false;
+				nSettled++;
+			}
+		} // end for k
+		m_profiler.addCounter("pcg_iter", maxIter);
+		if (m_simParam.enable_selfCollision)
+			m_profiler.addCounter("selfColli_pairs", nPairs);
+		m_profiler.addCounter("active_instances", nActive);
+
+		if (m_instances.size() == 1)
+		{
+			const Instance& ins = m_instances[0];
+			m_solverInfo += std::string("pcg, iter ") + std::to_string(ins.lastSolveIter)
+				+ ", err " + std::to_string(ins.lastSolveErr);
+			if (m_simParam.pcg_warm_start != PcgWarmStartZero)
+				m_solverInfo += GpuSim::pcgWarmStartInfo(ins.lastSolveIter, ins.lastSolveErr, ins.lastSolveErr0);
+			m_solverInfo += ", " + ins.equilibrium.getInfo();
+		}
+		else
+		{
+			m_solverInfo += std::to_string(m_instances.size()) + " instances, " + std::to_string(nActive)
+				+ " stepped, " + std::to_string(nSettled) + " settled, pcg, max iter " + std::to_string(maxIter)
+				+ ", max err " + std::to_string(maxErr);
+		}
+
+		m_shouldExportMesh = true;
+		gtime_t t_end = gtime_now();
+		m_fps = 1.f / gtime_seconds(t_start, t_end);
+
+		char fps_ary[10];
+		sprintf(fps_ary, "%.1f", m_fps);
+		m_solverInfo += std::string(", fps ") + fps_ary + "]";
+	}
+
+	void CpuSim::restart()
+	{
+		m_shouldRestart = true;
+		updateDependency();
+		for (auto& ins : m_instances)
+			resetInstance(ins);
+		m_shouldRestart = false;
+	}
+
+	void CpuSim::updateParam()
+	{
+		if (m_clothManager)
+		{
+			auto par = m_clothManager->getSimulationParam();
+			m_simParam.gravity = par.gravity;
+			m_simParam.strecth_mult = par.spring_k;
+			m_simParam.bend_mult = par.bending_k;
+			m_simParam.enable_selfCollision = par.enable_self_collistion;
+			m_simParam.pcg_warm_start = par.pcg_warm_start;
+		} // end clothManager
+		updateMaterialDataToFaceNode();
+	}
+
+	void CpuSim::updateTopology()
+	{
+		initFaceEdgeVertArray();
+	}
+
+	void CpuSim::updateStitch()
+	{
+		buildStitch();
+	}
+
+	void CpuSim::updateMaterial()
+	{
+		updateMaterialDataToFaceNode();
+	}
+
+	void CpuSim::updateBodyCollider()
+	{
+		if (m_clothManager == nullptr)
+			return;
+		for (auto& ins : m_instances)
+		if (!ins.customLvSet)
+			ins.bodyLvSet_h = m_clothManager->bodyLevelSet();
+		m_bodyProxy_h = m_clothManager->isBodyProxyActive() ? m_clothManager->bodyProxy() : nullptr;
+	}
+
+	ObjMesh& CpuSim::getResultClothMesh()
+	{
+		exportResultClothToObjMesh();
+		return *m_resultClothMesh;
+	}
+
+	void CpuSim::setCurrentVertPositions(const std::vector<Float3>& X)
+	{
+		if (X.size() != m_instances[0].x_h.size())
+			throw std::exception("CpuSim::setCurrentVertPosition, size not matched!");
+		m_instances[0].x_h = X;
+	}
+
+	void CpuSim::setInitVertPositions(const std::vector<Float3>& X)
+	{
+		if (X.size() != m_x_init_h.size())
+			throw std::exception("CpuSim::setCurrentVertPosition, size not matched!");
+		m_x_init_h = X;
+		m_shouldRestart = true;
+	}
+
+	void CpuSim::getResultClothPieces()
+	{
+		if (m_clothManager == nullptr)
+			return;
+		exportResultClothToObjMesh();
+
+		int vbegin = 0;
+		int fbegin = 0;
+		for (int iCloth = 0; iCloth < m_clothManager->numClothPieces(); iCloth++)
+		{
+			ObjMesh& mesh = m_clothManager->clothPiece(iCloth)->mesh3d();
+			for (size_t iVert = 0; iVert < mesh.vertex_list.size(); iVert++)
+			{
+				const int oVert = m_vertMerge_in_out_idxMap_h[vbegin + iVert];
+				mesh.vertex_list[iVert] = m_resultClothMesh->vertex_list[oVert];
+				mesh.vertex_normal_list[iVert] = m_resultClothMesh->vertex_normal_list[oVert];
+			} // end for iVert
+			for (size_t iFace = 0; iFace < mesh.face_normal_list.size(); iFace++)
+			{
+				mesh.face_normal_list[iFace] = m_resultClothMesh->face_normal_list[fbegin + iFace];
+			} // end for iFace
+			mesh.updateBoundingBox();
+			mesh.requireRenderUpdate();
+			vbegin += mesh.vertex_list.size();
+			fbegin += mesh.face_list.size();
+		} // end for iCloth
+	}
+
+	void CpuSim::clear()
+	{
+		resetDependency(false);
+		m_clothManager = nullptr;
+		m_simParam.setDefault();
+		m_fps = 0.f;
+		m_solverInfo = "";
+		m_instances.clear();
+		m_instances.resize(1);
+		m_bodyProxy_h = nullptr;
+		m_resultClothMesh->clear();
+		m_materials.clear();
+
+		m_bmesh->clear();
+		m_bmVerts.clear();
+		m_faces_idxWorld_h.clear();
+		m_faces_idxTex_h.clear();
+		m_faces_material_h.clear();
+		m_faces_materialSpace_h.clear();
+		m_nodes_materialSpace_h.clear();
+		m_edgeData_h.clear();
+		m_vert_FaceList_rowPtr_h.clear();
+		m_vert_FaceList_colIdx_h.clear();
+		m_stitch_vertPairs_h.clear();
+		m_stitch_vertPairs_rowPtr_h.clear();
+		m_stitch_vertPairs_colIdx_h.clear();
+		m_stitch_vertMerge_idxMap_h.clear();
+		m_vertMerge_in_out_idxMap_h.clear();
+		m_stitch_edgeData_h.clear();
+
+		m_topologyFingerprint = 0;
+		m_A_Ids_start_h.clear();
+		m_A_scanPtr_h.clear();
+		m_A_scanIdx_h.clear();
+		m_b_Ids_start_h.clear();
+		m_b_scanPtr_h.clear();
+		m_b_scanIdx_h.clear();
+
+		m_texCoord_init_h.clear();
+		m_x_init_h.clear();
+		m_fixPosition_vw_h.clear();
+	}
+
+	void CpuSim::setFixPositions(int nFixed, const int* ids, const Float3* targets)
+	{
+		std::fill(m_fixPosition_vw_h.begin(), m_fixPosition_vw_h.end(), 0.f);
+		for (int i = 0; i < nFixed; i++)
+		{
+			const int id = ids[i];
+			if (id >= 0 && id < m_fixPosition_vw_h.size())
+				m_fixPosition_vw_h[id] = Float4(targets[i][0], targets[i][1], targets[i][2], 1.f);
+		}
+	}
+
+#pragma region -- instances
+	void CpuSim::resetInstance(Instance& ins)
+	{
+		const size_t nVerts = m_x_init_h.size();
+		ins.x_h = m_x_init_h;
+		ins.last_x_h = ins.x_h;
+		ins.v_h.assign(nVerts, Float3(0.f));
+		ins.last_v_h.assign(nVerts, Float3(0.f));
+		ins.dv_h.assign(nVerts, Float3(0.f));
+		ins.last_dv_h.assign(nVerts, Float3(0.f));
+		ins.b_h.assign(nVerts, Float3(0.f));
+		ins.curSimulationTime = 0.f;
+		ins.curStitchRatio = 1.f;
+		ins.lastSolveIter = 0;
+		ins.lastSolveErr = 0.f;
+		ins.lastSolveErr0 = 0.f;
+		ins.equilibrium.reset();
+		ins.active = true;
+	}
+
+	void CpuSim::setNumInstances(int n)
+	{
+		if (n < 1)
+			throw std::exception("CpuSim::setNumInstances(): at least one instance is required!");
+		const int nOld = (int)m_instances.size();
+		m_instances.resize(n);
+		const Instance& ins0 = m_instances[0];
+		for (int i = nOld; i < n; i++)
+		{
+			Instance& ins = m_instances[i];
+			resetInstance(ins);
+			ins.equilibrium.setParam(ins0.equilibrium.getParam());
+			if (m_clothManager && !m_shouldLevelsetUpdate)
+				ins.bodyLvSet_h = m_clothManager->bodyLevelSet();
+			ins.A_h.shareStructure(ins0.A_h);
+			ins.beforScan_A.resize(ins0.beforScan_A.size());
+			ins.beforScan_b.resize(ins0.beforScan_b.size());
+		} // end for i
+	}
+
+	void CpuSim::setInstanceBodyLevelSet(int i, const ldp::LevelSet3D* lvSet)
+	{
+		Instance& ins = m_instances.at(i);
+		ins.customLvSet = lvSet != nullptr;
+		ins.bodyLvSet_h = lvSet;
+		if (!ins.customLvSet && m_clothManager && !m_shouldLevelsetUpdate)
+			ins.bodyLvSet_h = m_clothManager->bodyLevelSet();
+	}
+
+	void CpuSim::setInstanceActive(int i, bool active)
+	{
+		m_instances.at(i).active = active;
+	}
+
+	int CpuSim::numActiveInstances()const
+	{
+		int n = 0;
+		for (const auto& ins : m_instances)
+			n += ins.active;
+		return n;
+	}
+
+	void CpuSim::restartInstance(int i)
+	{
+		resetInstance(m_instances.at(i));
+	}
+
+	void CpuSim::getInstanceCheckpoint(int i, SimulationCheckpoint& cp)
+	{
+		updateSystem();
+		const Instance& ins = m_instances.at(i);
+		cp.fingerprint = m_topologyFingerprint;
+		cp.curSimulationTime = ins.curSimulationTime;
+		cp.curStitchRatio = ins.curStitchRatio;
+		cp.x = ins.x_h;
+		cp.v = ins.v_h;
+		cp.last_x = ins.last_x_h;
+		cp.last_v = ins.last_v_h;
+		cp.dv = ins.dv_h;
+		cp.fixPosition_vw = m_fixPosition_vw_h;
+	}
+
+	void CpuSim::setInstanceCheckpoint(int i, const SimulationCheckpoint& cp)
+	{
+		updateSystem();
+		Instance& ins = m_instances.at(i);
+		if (!cp.isValid() || cp.numVerts() != (int)m_x_init_h.size() || cp.fingerprint != m_topologyFingerprint)
+			throw std::exception("CpuSim::setInstanceCheckpoint, topology not matched!");
+		ins.curSimulationTime = cp.curSimulationTime;
+		ins.curStitchRatio = cp.curStitchRatio;
+		ins.x_h = cp.x;
+		ins.v_h = cp.v;
+		ins.last_x_h = cp.last_x;
+		ins.last_v_h = cp.last_v;
+		ins.dv_h = cp.dv;
+		ins.last_dv_h = cp.dv;
+		ins.lastSolveIter = 0;
+		ins.lastSolveErr = 0.f;
+		ins.lastSolveErr0 = 0.f;
+		ins.equilibrium.reset();
+		ins.active = true;
+		m_fixPosition_vw_h = cp.fixPosition_vw;
+		if (i == 0)
+			m_shouldExportMesh = true;
+	}
+#pragma endregion
+
+#pragma region -- level set
+	void CpuSim::initLevelSet()
+	{
+		m_shouldLevelsetUpdate = true;
+		updateDependency();
+		if (m_clothManager)
+		{
+			if (m_clothManager->m_shouldLevelSetUpdate)
+				m_clothManager->calcLevelSet();
+			updateBodyCollider();
+		} // end for clothManager
+		m_shouldLevelsetUpdate = false;
+	}
+#pragma endregion
+
+#pragma region -- param
+	void CpuSim::initParam()
+	{
+		m_simParam.setDefault();
+		auto par = m_clothManager->getSimulationParam();
+		m_simParam.gravity = par.gravity;
+		m_simParam.stitch_ratio = 4.f;
+		m_simParam.strecth_mult = par.spring_k;
+		m_simParam.bend_mult = par.bending_k;
+		m_simParam.enable_selfCollision = par.enable_self_collistion;
+		m_simParam.pcg_warm_start = par.pcg_warm_start;
+	}
+#pragma endregion
+
+#pragma region -- init topology
+	void CpuSim::initFaceEdgeVertArray()
+	{
+		m_shouldTopologyUpdate = true;
+		updateDependency();
+		if (m_clothManager == nullptr)
+			throw std::exception("CpuSim, not initialized!");
+
+		m_faces_idxWorld_h.clear();
+		m_faces_idxTex_h.clear();
+		m_edgeData_h.clear();
+		m_x_init_h.clear();
+		m_texCoord_init_h.clear();
+		int node_index_begin = 0;
+		int tex_index_begin = 0;
+		int face_index_begin = 0;
+		for (int iCloth = 0; iCloth < m_clothManager->numClothPieces(); iCloth++)
+		{
+			auto cloth = m_clothManager->clothPiece(iCloth);
+			for (const auto& f : cloth->mesh3d().face_list)
+			{
+				m_faces_idxWorld_h.push_back(ldp::Int4(
+					f.vertex_index[0] + node_index_begin,
+					f.vertex_index[1] + node_index_begin,
+					f.vertex_index[2] + node_index_begin, iCloth));
+				m_faces_idxTex_h.push_back(ldp::Int4(f.vertex_index[0],
+					f.vertex_index[1], f.vertex_index[2], 0) + tex_index_begin);
+			} // end for f
+
+			BMesh bmesh = *cloth->mesh3d().get_bmesh(false);
+			BMESH_ALL_EDGES(e, e_of_m_iter, bmesh)
+			{
+				const int id0 = bmesh.vofe_first(e)->getIndex();
+				const int id1 = bmesh.vofe_last(e)->getIndex();
+				EdgeData ed;
+				ed.edge_idxWorld = ldp::Int4(id0 + node_index_begin, id1 + node_index_begin, -1, -1);
+				ed.faceIdx[0] = ed.faceIdx[1] = -1;
+				const Float3 v0 = cloth->mesh2d().vertex_list[id0];
+				const Float3 v1 = cloth->mesh2d().vertex_list[id1];
+				const Float2 t0(v0[0], -v0[1]), t1(v1[0], -v1[1]); // arcsim requires this conversion
+				const float lenSqr = (t0 - t1).sqrLength();
+				const float theta = atan2f(t1[1] - t0[1], t1[0] - t0[0]);
+				int fcnt = 0;
+				BMFace* faces[2] = { nullptr, nullptr };
+				BMESH_F_OF_E(f, e, f_of_e_iter, bmesh)
+				{
+					faces[fcnt++] = f;
+					if (fcnt >= 2)
+						break;
+				}
+
+				// the order is important for the simulation
+				if (!face_edge_same_order(bmesh, e, faces[0]))
+					std::swap(faces[0], faces[1]);
+				for (int k = 0; k < 2; k++)
+				if (faces[k])
+				{
+					ed.faceIdx[k] = faces[k]->getIndex() + face_index_begin;
+					ed.edge_idxTex[k] = ldp::Int2(id0, id1) + tex_index_begin;
+					BMESH_V_OF_F(v, faces[k], v_of_f_iter, bmesh)
+					{
+						if (v->getIndex() != id0 && v->getIndex() != id1)
+							ed.edge_idxWorld[k + 2] = v->getIndex() + node_index_begin;
+					}
+					ed.length_sqr[k] = lenSqr;
+					ed.theta_uv[k] = theta;
+				} // end for k
+				m_edgeData_h.push_back(ed);
+			} // end for e
+
+			for (const auto& v : cloth->mesh3d().vertex_list)
+				m_x_init_h.push_back(v);
+			for (const auto& v : cloth->mesh2d().vertex_list)
+				m_texCoord_init_h.push_back(Float2(v[0], -v[1]));	// arcsim requires this conversion
+			node_index_begin += cloth->mesh3d().vertex_list.size();
+			tex_index_begin += cloth->mesh2d().vertex_list.size();
+			face_index_begin += cloth->mesh3d().face_list.size();
+		} // end for iCloth
+
+		initBMesh();
+		const size_t nVerts = m_x_init_h.size();
+		for (auto& ins : m_instances)
+			resetInstance(ins);
+		m_stitch_vertMerge_idxMap_h.resize(nVerts);
+		for (size_t i = 0; i < m_stitch_vertMerge_idxMap_h.size(); i++)
+			m_stitch_vertMerge_idxMap_h[i] = i;
+		m_vertMerge_in_out_idxMap_h = m_stitch_vertMerge_idxMap_h;
+		m_fixPosition_vw_h.assign(nVerts, Float4(0.f));
+
+		m_shouldTopologyUpdate = false;
+	}
+
+	void CpuSim::initBMesh()
+	{
+		std::vector<Int3> flist(m_faces_idxWorld_h.size());
+		for (size_t i = 0; i < flist.size(); i++)
+		for (int k = 0; k < 3; k++)
+			flist[i][k] = m_faces_idxWorld_h[i][k];
+		m_bmesh->init_triangles((int)m_x_init_h.size(), (float*)m_x_init_h.data(),
+			(int)flist.size(), (int*)flist.data());
+		m_bmVerts.clear();
+		BMESH_ALL_VERTS(v, v_of_m_iter, *m_bmesh)
+		{
+			m_bmVerts.push_back(v);
+		}
+	}
+#pragma endregion
+
+#pragma region -- material
+	const CpuSim::Material* CpuSim::findMaterial(std::string name)
+	{
+		auto iter = m_materials.find(name);
+		if (iter != m_materials.end())
+			return iter->second.get();
+
+		std::shared_ptr<arcsim::Cloth::Material> mat(new arcsim::Cloth::Material);
+		arcsim::load_material_data(*mat, ldp::fullfile(PieceParam::default_material_folder, name + ".json"));
+
+		std::shared_ptr<Material> material(new Material);
+		material->density = mat->density;
+
+		// stretch sample
+		const int S = Material::STRETCH_SAMPLES;
+		material->stretchSample.resize(S*S*S);
+		for (int x = 0; x < S; x++)
+		for (int y = 0; y < S; y++)
+		for (int z = 0; z < S; z++)
+			material->stretchSample[(z*S + y)*S + x] = convert(mat->stretching.s[x][y][z]);
+
+		// bend data
+		material->bendData.resize(Material::BEND_POINTS * Material::BEND_DIMS);
+		for (int x = 0; x < Material::BEND_DIMS; x++)
+		{
+			int wrap_x = x;
+			if (wrap_x>4)
+				wrap_x = 8 - wrap_x;
+			if (wrap_x > 2)
+				wrap_x = 4 - wrap_x;
+			for (int y = 0; y < Material::BEND_POINTS; y++)
+				material->bendData[y*Material::BEND_DIMS + x] = mat->bending.d[wrap_x][y];
+		}
+
+		m_materials.insert(std::make_pair(name, material));
+		return material.get();
+	}
+
+	void CpuSim::updateMaterialDataToFaceNode()
+	{
+		m_shouldMaterialUpdate = true;
+		updateDependency();
+
+		// face material related
+		m_faces_material_h.resize(m_faces_idxTex_h.size());
+		m_faces_materialSpace_h.resize(m_faces_idxTex_h.size());
+		for (size_t iFace = 0; iFace < m_faces_idxTex_h.size(); iFace++)
+		{
+			const auto& pieceParam = m_clothManager->clothPiece(m_faces_idxWorld_h[iFace][3])->param();
+			const Material* mat = findMaterial(pieceParam.material_name);
+			m_faces_material_h[iFace] = mat;
+			const auto& f = m_faces_idxTex_h[iFace];
+			const auto& t = m_texCoord_init_h;
+			FaceMaterailSpaceData& fData = m_faces_materialSpace_h[iFace];
+			fData.area = fabs(Float2(t[f[1]] - t[f[0]]).cross(t[f[2]] - t[f[0]])) / 2;
+			fData.mass = fData.area * mat->density;
+			fData.stretch_mult = m_simParam.strecth_mult * pieceParam.spring_k_mult;
+			fData.bend_mult = m_simParam.bend_mult * pieceParam.bending_k_mult;
+		}
+
+		// node material related
+		m_nodes_materialSpace_h.assign(m_x_init_h.size(), NodeMaterailSpaceData());
+		for (size_t iFace = 0; iFace < m_faces_idxTex_h.size(); iFace++)
+		{
+			const FaceMaterailSpaceData& fData = m_faces_materialSpace_h[iFace];
+			const auto& f = m_faces_idxWorld_h[iFace];
+			for (int k = 0; k < 3; k++)
+			{
+				NodeMaterailSpaceData& nData = m_nodes_materialSpace_h[f[k]];
+				nData.area += fData.area / 3.f;
+				nData.mass += fData.mass / 3.f;
+			}
+		} // end for iFace
+
+		m_shouldMaterialUpdate = false;
+	}
+#pragma endregion
+
+#pragma region -- stitch
+	void CpuSim::buildStitch()
+	{
+		m_shouldStitchUpdate = true;
+		updateDependency();
+		buildStitchVertPairs();
+		buildStitchEdges();
+		m_shouldStitchUpdate = false;
+	}
+
+	void CpuSim::buildStitchVertPairs()
+	{
+		m_stitch_vertPairs_h.clear();
+		m_stitch_vertMerge_idxMap_h.clear();
+		for (int i_stp = 0; i_stp < m_clothManager->numStitches(); i_stp++)
+		{
+			const auto stp = m_clothManager->getStitchPointPair(i_stp);
+			m_stitch_vertPairs_h.push_back(std::make_pair(ldp::Int2(stp.first, stp.second), stp.angle));
+			m_stitch_vertPairs_h.push_back(std::make_pair(ldp::Int2(stp.second, stp.first), stp.angle));
+		} // i_stp
+		std::sort(m_stitch_vertPairs_h.begin(), m_stitch_vertPairs_h.end());
+		m_stitch_vertPairs_h.resize(std::unique(m_stitch_vertPairs_h.begin(),
+			m_stitch_vertPairs_h.end()) - m_stitch_vertPairs_h.begin());
+		std::vector<Int2> tmpPairs;
+		for (const auto& stp : m_stitch_vertPairs_h)
+			tmpPairs.push_back(stp.first);
+		pairsToCsr(tmpPairs, (int)m_x_init_h.size(), m_stitch_vertPairs_rowPtr_h, m_stitch_vertPairs_colIdx_h);
+
+		// ------------------------------------------------------------------------------
+		// find idx map that remove all stitched vertices
+		m_stitch_vertMerge_idxMap_h.resize(m_x_init_h.size());
+		for (size_t i = 0; i < m_stitch_vertMerge_idxMap_h.size(); i++)
+			m_stitch_vertMerge_idxMap_h[i] = i;
+		for (const auto& stp : m_stitch_vertPairs_h)
+		{
+			int sm = std::min(stp.first[0], stp.first[1]);
+			int lg = std::max(stp.first[0], stp.first[1]);
+			while (m_stitch_vertMerge_idxMap_h[lg] != lg)
+				lg = m_stitch_vertMerge_idxMap_h[lg];
+			if (lg < sm) std::swap(sm, lg);
+			m_stitch_vertMerge_idxMap_h[lg] = sm;
+		}
+		for (size_t i = 0; i < m_stitch_vertMerge_idxMap_h.size(); i++)
+		{
+			int m = i;
+			while (m_stitch_vertMerge_idxMap_h[m] != m)
+				m = m_stitch_vertMerge_idxMap_h[m];
+			m_stitch_vertMerge_idxMap_h[i] = m;
+		}
+	}
+
+	void CpuSim::buildStitchEdges()
+	{
+		m_stitch_edgeData_h.clear();
+
+		for (size_t idx_stp_i = 0; idx_stp_i < m_stitch_vertPairs_h.size(); idx_stp_i++)
+		{
+			const Int2 stp_i = m_stitch_vertPairs_h[idx_stp_i].first;
+			const float degree_i = m_stitch_vertPairs_h[idx_stp_i].second;
+			for (size_t idx_stp_j = idx_stp_i + 1; idx_stp_j < m_stitch_vertPairs_h.size(); idx_stp_j++)
+			{
+				const Int2 stp_j = m_stitch_vertPairs_h[idx_stp_j].first;
+				const float degree_j = m_stitch_vertPairs_h[idx_stp_j].second;
+				Int2 eIdx[2] = { Int2(stp_i[0], stp_j[0]), Int2(stp_i[1], stp_j[1]) };
+				BMEdge* e[2] = { findEdge(eIdx[0][0], eIdx[0][1]), findEdge(eIdx[1][0], eIdx[1][1]) };
+				if (e[0] == nullptr || e[1] == nullptr || overlap(eIdx))
+					continue;
+				if (m_bmesh->fofe_count(e[0]) != 1 || m_bmesh->fofe_count(e[1]) != 1)
+					continue;
+				BMFace* f[2] = { nullptr, nullptr };
+				int op_vid[2] = { 0, 0 };
+				for (int k = 0; k < 2; k++)
+				{
+					eIdx[k][0] = m_bmesh->vofe_first(e[k])->getIndex();
+					eIdx[k][1] = m_bmesh->vofe_last(e[k])->getIndex();
+					BMIter iter;
+					iter.init(e[k]);
+					f[k] = m_bmesh->fofe_begin(iter);
+					BMESH_V_OF_F(v, f[k], v_of_f_iter, *m_bmesh)
+					if (v != m_bmesh->vofe_first(e[k]) && v != m_bmesh->vofe_last(e[k]))
+						op_vid[k] = v->getIndex();
+				} // end for k
+
+				// the order is important for simulation
+				if (!face_edge_same_order(*m_bmesh, e[0], f[0]))
+				{
+					std::swap(f[0], f[1]);
+					std::swap(op_vid[0], op_vid[1]);
+					std::swap(e[0], e[1]);
+					std::swap(eIdx[0], eIdx[1]);
+				}
+
+				EdgeData eData;
+				eData.edge_idxWorld = Int4(eIdx[0][0], eIdx[0][1], op_vid[0], op_vid[1]);
+				for (int k = 0; k < 2; k++)
+				{
+					eData.faceIdx[k] = f[k]->getIndex();
+					eData.edge_idxTex[k] = Int2(eIdx[k][0], eIdx[k][1]);
+					const Float2 uv = m_texCoord_init_h[eIdx[k][1]] - m_texCoord_init_h[eIdx[k][0]];
+					eData.length_sqr[k] = uv.sqrLength();
+					eData.theta_uv[k] = atan2f(uv[1], uv[0]);
+					eData.dihedral_ideal = (degree_i + degree_j) * 0.5f / 180.f * ldp::PI_S;
+				}
+				m_stitch_edgeData_h.push_back(eData);
+			} // end for idx_stp_j
+		} // end for idx_stp_i
+	}
+#pragma endregion
+
+#pragma region -- sparse structure
+	void CpuSim::setup_sparse_structure()
+	{
+		m_shouldSparseStructureUpdate = true;
+		updateDependency();
+		const int nVerts = m_x_init_h.size();
+
+		// a known topology just reuses the cached structure
+		m_topologyFingerprint = TopologyFingerprint::compute(nVerts, m_faces_idxWorld_h, m_edgeData_h,
+			m_stitch_vertPairs_h, m_stitch_edgeData_h);
+		SparseStructureCache::EntryPtr entry = SparseStructureCache::instance().find(
+			SimulationBackendCpu, m_topologyFingerprint);
+		if (entry == nullptr || entry->nVerts != nVerts)
+		{
+			entry = buildSparseStructure();
+			SparseStructureCache::instance().insert(SimulationBackendCpu, m_topologyFingerprint, entry);
+		}
+
+		pairsToCsr(entry->vertFacePairs, nVerts, m_vert_FaceList_rowPtr_h, m_vert_FaceList_colIdx_h);
+		m_A_Ids_start_h = entry->A_Ids_start;
+		m_A_scanPtr_h = entry->A_scanPtr;
+		m_A_scanIdx_h = entry->A_scanIdx;
+		m_b_Ids_start_h = entry->b_Ids_start;
+		m_b_scanPtr_h = entry->b_scanPtr;
+		m_b_scanIdx_h = entry->b_scanIdx;
+
+		// build the bsr matrix
+		std::vector<int> A_rowPtr, A_colIdx;
+		pairsToCsr(entry->A_blocks, nVerts, A_rowPtr, A_colIdx);
+		BsrMatrix3& A0 = m_instances[0].A_h;
+		A0.resize(nVerts, nVerts);
+		A0.setStructure(A_rowPtr.data(), A_colIdx.data());
+		for (auto& ins : m_instances)
+		{
+			if (&ins.A_h != &A0)
+				ins.A_h.shareStructure(A0);
+			ins.beforScan_A.resize(m_A_Ids_start_h.back());
+			ins.beforScan_b.resize(m_b_Ids_start_h.back());
+		}
+
+		m_shouldSparseStructureUpdate = false;
+	}
+
+	SparseStructureCache::EntryPtr CpuSim::buildSparseStructure()const
+	{
+		const int nVerts = m_x_init_h.size();
+		std::shared_ptr<SparseStructureCache::Entry> entry(new SparseStructureCache::Entry());
+		entry->nVerts = nVerts;
+
+		// collect one-ring face list of each vertex
+		std::vector<Int2>& vert_face_pair_h = entry->vertFacePairs;
+		for (size_t i = 0; i < m_faces_idxWorld_h.size(); i++)
+		for (int k = 0; k < 3; k++)
+			vert_face_pair_h.push_back(Int2(m_faces_idxWorld_h[i][k], i));
+		std::sort(vert_face_pair_h.begin(), vert_face_pair_h.end());
+		vert_face_pair_h.resize(std::unique(vert_face_pair_h.begin(),
+			vert_face_pair_h.end()) - vert_face_pair_h.begin());
+
+		// ---------------------------------------------------------------------------------------------
+		// the same filling order with GpuSim::setup_sparse_structure()
+		std::vector<size_t> A_Ids_h;
+		std::vector<int> b_Ids_h;
+		std::vector<int>& A_Ids_start_h = entry->A_Ids_start;
+		std::vector<int>& b_Ids_start_h = entry->b_Ids_start;
+		for (const auto& f : m_faces_idxWorld_h)
+		{
+			A_Ids_start_h.push_back(A_Ids_h.size());
+			b_Ids_start_h.push_back(b_Ids_h.size());
+			for (int r = 0; r < 3; r++)
+			{
+				for (int c = 0; c < 3; c++)
+					A_Ids_h.push_back(ldp::vertPair_to_idx(ldp::Int2(f[r], f[c]), nVerts));
+				b_Ids_h.push_back(f[r]);
+			}
+		}
+		for (const auto& ed : m_edgeData_h)
+		{
+			A_Ids_start_h.push_back(A_Ids_h.size());
+			b_Ids_start_h.push_back(b_Ids_h.size());
+			if (ed.faceIdx[0] >= 0 && ed.faceIdx[1] >= 0)
+			{
+				for (int r = 0; r < 4; r++)
+				{
+					for (int c = 0; c < 4; c++)
+						A_Ids_h.push_back(ldp::vertPair_to_idx(ldp::Int2(
+						ed.edge_idxWorld[r], ed.edge_idxWorld[c]), nVerts));
+					b_Ids_h.push_back(ed.edge_idxWorld[r]);
+				}
+			}
+		} // end for edgeData
+		for (const auto& stp : m_stitch_vertPairs_h)
+		{
+			A_Ids_start_h.push_back(A_Ids_h.size());
+			b_Ids_start_h.push_back(b_Ids_h.size());
+			A_Ids_h.push_back(ldp::vertPair_to_idx(Int2(stp.first[0], stp.first[0]), nVerts));
+			A_Ids_h.push_back(ldp::vertPair_to_idx(Int2(stp.first[0], stp.first[1]), nVerts));
+			b_Ids_h.push_back(stp.first[0]);
+		} // i_stp
+		for (const auto& ed : m_stitch_edgeData_h)
+		{
+			A_Ids_start_h.push_back(A_Ids_h.size());
+			b_Ids_start_h.push_back(b_Ids_h.size());
+			if (ed.faceIdx[0] >= 0 && ed.faceIdx[1] >= 0)
+			{
+				for (int r = 0; r < 4; r++)
+				{
+					for (int c = 0; c < 4; c++)
+						A_Ids_h.push_back(ldp::vertPair_to_idx(ldp::Int2(
+						ed.edge_idxWorld[r], ed.edge_idxWorld[c]), nVerts));
+					b_Ids_h.push_back(ed.edge_idxWorld[r]);
+				}
+			}
+		} // end for edgeData
+		A_Ids_start_h.push_back(A_Ids_h.size());
+		b_Ids_start_h.push_back(b_Ids_h.size());
+
+		// ---------------------------------------------------------------------------------------------
+		// sort and unique, then each nnz block just sums its scattered positions
+		std::vector<size_t> A_Ids_unique;
+		std::vector<int> b_Ids_unique;
+		buildScanStructure(A_Ids_h, A_Ids_unique, entry->A_scanPtr, entry->A_scanIdx);
+		buildScanStructure(b_Ids_h, b_Ids_unique, entry->b_scanPtr, entry->b_scanIdx);
+		release_assert(b_Ids_unique.size() == nVerts);
+		entry->A_blocks.resize(A_Ids_unique.size());
+		for (size_t i = 0; i < A_Ids_unique.size(); i++)
+			entry->A_blocks[i] = ldp::vertPair_from_idx(A_Ids_unique[i], nVerts);
+		return entry;
+	}
+#pragma endregion
+
+#pragma region -- dependency
+	void CpuSim::updateDependency()
+	{
+		if (m_shouldLevelsetUpdate)
+			m_shouldRestart = true;
+		if (m_shouldTopologyUpdate)
+		{
+			m_shouldStitchUpdate = true;
+			m_shouldMaterialUpdate = true;
+		}
+		if (m_shouldStitchUpdate)
+			m_shouldSparseStructureUpdate = true;
+		if (m_shouldSparseStructureUpdate)
+			m_shouldRestart = true;
+		if (m_shouldRestart)
+			m_shouldExportMesh = true;
+	}
+
+	void CpuSim::resetDependency(bool on)
+	{
+		m_shouldTopologyUpdate = on;
+		m_shouldLevelsetUpdate = on;
+		m_shouldMaterialUpdate = on;
+		m_shouldStitchUpdate = on;
+		m_shouldSparseStructureUpdate = on;
+		m_shouldRestart = on;
+		m_shouldExportMesh = on;
+	}
+
+	void CpuSim::updateSystem()
+	{
+		updateDependency();
+		if (m_shouldTopologyUpdate)
+			initFaceEdgeVertArray();
+		if (m_shouldLevelsetUpdate)
+			initLevelSet();
+		if (m_shouldMaterialUpdate)
+			updateMaterial();
+		if (m_shouldStitchUpdate)
+			buildStitch();
+		if (m_shouldSparseStructureUpdate)
+			setup_sparse_structure();
+		if (m_shouldRestart)
+			restart();
+	}
+#pragma endregion
+
+#pragma region --update numeric
+	void CpuSim::computeStretchForces(Instance& ins, int iFace)
+	{
+		const int A_start = m_A_Ids_start_h[iFace];
+		const int b_start = m_b_Ids_start_h[iFace];
+		const ldp::Int4 face_idxWorld = m_faces_idxWorld_h[iFace];
+		const ldp::Int4 face_idxTex = m_faces_idxTex_h[iFace];
+		const ldp::Float3 x[3] = { ins.x_h[face_idxWorld[0]], ins.x_h[face_idxWorld[1]], ins.x_h[face_idxWorld[2]] };
+		const ldp::Float2 t[3] = { m_texCoord_init_h[face_idxTex[0]],
+			m_texCoord_init_h[face_idxTex[1]], m_texCoord_init_h[face_idxTex[2]] };
+		const float area = m_faces_materialSpace_h[iFace].area;
+		const float stretchMult = m_faces_materialSpace_h[iFace].stretch_mult;
+		const float dt = m_simParam.dt;
+
+		// arcsim::stretching_force()---------------------------
+		const Mat32f F = derivative(x, t);
+		const Mat2f G = (F.trans()*F - Mat2f().eye()) * 0.5f;
+		const Float4 k = stretching_stiffness(G, *m_faces_material_h[iFace]) * stretchMult;
+		const Mat23f D = derivative(t);
+		const Mat39f Du = kronecker_eye_row(D, 0);
+		const Mat39f Dv = kronecker_eye_row(D, 1);
+		const Float3 xu = mat_getCol(F, 0);
+		const Float3 xv = mat_getCol(F, 1); // should equal Du*mat_to_vec(X)
+		const Float9 fuu = Du.trans()*xu;
+		const Float9 fvv = Dv.trans()*xv;
+		const Float9 fuv = (Du.trans()*xv + Dv.trans()*xu) * 0.5f;
+		Float9 grad_e = k[0] * G(0, 0)*fuu + k[2] * G(1, 1)*fvv
+			+ k[1] * (G(0, 0)*fvv + G(1, 1)*fuu) + 2 * k[3] * G(0, 1)*fuv;
+		Mat9f hess_e = k[0] * (outer(fuu, fuu) + std::max(G(0, 0), 0.f)*Du.trans()*Du)
+			+ k[2] * (outer(fvv, fvv) + std::max(G(1, 1), 0.f)*Dv.trans()*Dv)
+			+ k[1] * (outer(fuu, fvv) + std::max(G(0, 0), 0.f)*Dv.trans()*Dv
+			+ outer(fvv, fuu) + std::max(G(1, 1), 0.f)*Du.trans()*Du)
+			+ 2.f*k[3] * (outer(fuv, fuv));
+
+		const Float9 vs = make_Float9(ins.v_h[face_idxWorld[0]], ins.v_h[face_idxWorld[1]], ins.v_h[face_idxWorld[2]]);
+		hess_e = (dt*dt*area) * hess_e;
+		grad_e = -area * dt * grad_e - hess_e*vs;
+
+		// output to the scattered array
+		for (int row = 0; row < 3; row++)
+		for (int col = 0; col < 3; col++)
+			ins.beforScan_A[A_start + row * 3 + col] = get_subMat3f(hess_e, row, col);
+		for (int row = 0; row < 3; row++)
+			ins.beforScan_b[b_start + row] = get_subFloat3(grad_e, row);
+	}
+
+	void CpuSim::computeBendForces(Instance& ins, int iEdge, const EdgeData& edgeData, int A_start, int b_start)
+	{
+		if (edgeData.faceIdx[0] < 0 || edgeData.faceIdx[1] < 0)
+			return;
+		const float dt = m_simParam.dt;
+		const ldp::Float3 ex[4] = { ins.x_h[edgeData.edge_idxWorld[0]], ins.x_h[edgeData.edge_idxWorld[1]],
+			ins.x_h[edgeData.edge_idxWorld[2]], ins.x_h[edgeData.edge_idxWorld[3]] };
+		Float3 n[2];
+		for (int k = 0; k < 2; k++)
+		{
+			const Int4 f = m_faces_idxWorld_h[edgeData.faceIdx[k]];
+			n[k] = Float3(ins.x_h[f[1]] - ins.x_h[f[0]]).cross(ins.x_h[f[2]] - ins.x_h[f[0]]);
+			if (n[k].length() != 0.f)
+				n[k].normalizeLocal();
+		}
+		const Float3 n0 = n[0], n1 = n[1];
+		const FaceMaterailSpaceData fData[2] = { m_faces_materialSpace_h[edgeData.faceIdx[0]],
+			m_faces_materialSpace_h[edgeData.faceIdx[1]] };
+		const float area = fData[0].area + fData[1].area;
+		const float dihe_theta = dihedral_angle(ex[0], ex[1], n0, n1, edgeData.dihedral_ideal);
+		const float h0 = distance(ex[2], ex[0], ex[1]), h1 = distance(ex[3], ex[0], ex[1]);
+		const Float2 w_f0 = barycentric_weights(ex[2], ex[0], ex[1]);
+		const Float2 w_f1 = barycentric_weights(ex[3], ex[0], ex[1]);
+		const FloatC dtheta = make_Float12(-(w_f0[0] * n0 / h0 + w_f1[0] * n1 / h1),
+			-(w_f0[1] * n0 / h0 + w_f1[1] * n1 / h1), n0 / h0, n1 / h1);
+
+		const float ke = std::min(
+			bending_stiffness(edgeData, dihe_theta, area, *m_faces_material_h[edgeData.faceIdx[0]], 0)
+			* fData[0].bend_mult,
+			bending_stiffness(edgeData, dihe_theta, area, *m_faces_material_h[edgeData.faceIdx[1]], 1)
+			* fData[1].bend_mult
+			);
+		const float len = 0.5f * (sqrt(edgeData.length_sqr[0]) + sqrt(edgeData.length_sqr[1]));
+		const float shape = ldp::sqr(len) / (2.f * area);
+		const FloatC vs = make_Float12(ins.v_h[edgeData.edge_idxWorld[0]], ins.v_h[edgeData.edge_idxWorld[1]],
+			ins.v_h[edgeData.edge_idxWorld[2]], ins.v_h[edgeData.edge_idxWorld[3]]);
+		FloatC F = -dt*0.5f * ke*shape*(dihe_theta - edgeData.dihedral_ideal)*dtheta;
+		MatCf J = dt*dt*0.5f*ke*shape*outer(dtheta, dtheta);
+		F -= J*vs;
+
+		// output to the scattered array
+		for (int row = 0; row < 4; row++)
+		for (int col = 0; col < 4; col++)
+			ins.beforScan_A[A_start + row * 4 + col] = get_subMat3f(J, row, col);
+		for (int row = 0; row < 4; row++)
+			ins.beforScan_b[b_start + row] = get_subFloat3(F, row);
+	}
+
+	void CpuSim::computeStitchVertForces(Instance& ins, int iStitch, int A_start, int b_start)
+	{
+		const Int2 stp = m_stitch_vertPairs_h[iStitch].first;
+		const float dt = m_simParam.dt;
+		const float stiff = m_simParam.stitch_stiffness;
+		const Float3 xinit[2] = { m_x_init_h[stp[0]], m_x_init_h[stp[1]] };
+		const Float3 x[2] = { ins.x_h[stp[0]], ins.x_h[stp[1]] };
+		const Float3 v[2] = { ins.v_h[stp[0]], ins.v_h[stp[1]] };
+
+		const float len_init = (xinit[1] - xinit[0]).length();
+		const float len_cur = (x[1] - x[0]).length() + 1e-16f;
+		const float ratio = ins.curStitchRatio * len_init / len_cur;
+		ins.beforScan_A[A_start + 0] = dt * dt * stiff * ldp::Mat3f().eye();
+		ins.beforScan_A[A_start + 1] = -dt * dt * stiff * ldp::Mat3f().eye();
+		ins.beforScan_b[b_start] = -dt*stiff*(1 - ratio)*(x[0] - x[1] + dt*(v[0] - v[1]));
+	}
+
+	void CpuSim::updateNumeric(Instance& ins)
+	{
+		const int nVerts = (int)ins.x_h.size();
+		const int nFaces = (int)m_faces_idxWorld_h.size();
+		const int nEdges = (int)m_edgeData_h.size();
+		const int nStitchVertPairs = (int)m_stitch_vertPairs_h.size();
+		const int nStitchEdges = (int)m_stitch_edgeData_h.size();
+		const int nTotal = nFaces + nEdges + nStitchVertPairs + nStitchEdges;
+		const float dt = m_simParam.dt;
+		const float drag_stiff = m_simParam.handle_stiffness;
+		const Float3 gravity = m_simParam.gravity;
+		std::fill(ins.beforScan_A.begin(), ins.beforScan_A.end(), Mat3f().zeros());
+		std::fill(ins.beforScan_b.begin(), ins.beforScan_b.end(), Float3(0.f));
+
+		// each face/edge/stitch writes its own segment of the scattered array, thus no conflict
+#pragma omp parallel for schedule(dynamic, 256)
+		for (int i = 0; i < nTotal; i++)
+		{
+			if (i < nFaces)
+				computeStretchForces(ins, i);
+			else if (i < nFaces + nEdges)
+				computeBendForces(ins, i - nFaces, m_edgeData_h[i - nFaces], m_A_Ids_start_h[i], m_b_Ids_start_h[i]);
+			else if (i < nFaces + nEdges + nStitchVertPairs)
+				computeStitchVertForces(ins, i - nFaces - nEdges, m_A_Ids_start_h[i], m_b_Ids_start_h[i]);
+			else
+				computeBendForces(ins, i - nFaces - nEdges - nStitchVertPairs, m_stitch_edgeData_h[i - nFaces - nEdges
+				- nStitchVertPairs], m_A_Ids_start_h[i], m_b_Ids_start_h[i]);
+		} // end for i
+
+		// scanning into the sparse matrix
+#pragma omp parallel for
+		for (int row = 0; row < nVerts; row++)
+		{
+			for (int pos = ins.A_h.bsrRowPtr()[row]; pos < ins.A_h.bsrRowPtr()[row + 1]; pos++)
+			{
+				Mat3f sum = Mat3f().zeros();
+				for (int scan_i = m_A_scanPtr_h[pos]; scan_i < m_A_scanPtr_h[pos + 1]; scan_i++)
+					sum += ins.beforScan_A[m_A_scanIdx_h[scan_i]];
+				if (pos == ins.A_h.diagPos(row))
+				{
+					// external forces and diag term; fix positions as diag term
+					sum += ldp::Mat3f().eye() * m_nodes_materialSpace_h[row].mass;
+					sum += ldp::Mat3f().eye() * m_fixPosition_vw_h[row][3] * drag_stiff * dt;
+				}
+				// A is row majored while Mat3f is col majored
+				ins.A_h.block(pos) = sum.trans();
+			} // end for pos
+
+			Float3 sum = 0.f;
+			for (int scan_i = m_b_scanPtr_h[row]; scan_i < m_b_scanPtr_h[row + 1]; scan_i++)
+				sum += ins.beforScan_b[m_b_scanIdx_h[scan_i]];
+
+			// gravity forces
+			const float mass = m_nodes_materialSpace_h[row].mass;
+			sum += gravity * mass * dt;
+
+			// fix positions
+			const Float4 fixXw = m_fixPosition_vw_h[row];
+			const Float3 fix_x(fixXw[0], fixXw[1], fixXw[2]);
+			sum += fixXw[3] * drag_stiff * (fix_x - ins.x_h[row] - ins.v_h[row] * dt);
+
+			// wind forces
+			for (int fpos = m_vert_FaceList_rowPtr_h[row]; fpos < m_vert_FaceList_rowPtr_h[row + 1]; ++fpos)
+			{
+				const int fid = m_vert_FaceList_colIdx_h[fpos];
+				const Int4 f = m_faces_idxWorld_h[fid];
+				Float3 fn = Float3(ins.x_h[f[1]] - ins.x_h[f[0]]).cross(ins.x_h[f[2]] - ins.x_h[f[0]]);
+				if (fn.length() == 0.f)
+					continue;
+				fn.normalizeLocal();
+				const Float3 vrel = -(ins.v_h[f[0]] + ins.v_h[f[1]] + ins.v_h[f[2]]) / 3.f;
+				const float vn = fn.dot(vrel);
+				sum += dt * m_faces_materialSpace_h[fid].area*fabs(vn)*vn / 3.f * fn;
+			} // end for fid
+			ins.b_h[row] = sum;
+		} // end for row
+
+		// add body-cloth force term using level set; the stages of multiple instances are not profiled
+		{
+			const bool profiling = !omp_in_parallel();
+			const double t_begin = profiling ? m_profiler.now() : 0.0;
+			linearBodyCollision(ins);
+			if (profiling)
+				m_profiler.addTimer("linearBodyCollision", t_begin, m_profiler.now());
+		}
+
+		// add cloth-cloth force term using uniform grid
+		if (m_simParam.enable_selfCollision)
+		{
+			const bool profiling = !omp_in_parallel();
+			const double t_begin = profiling ? m_profiler.now() : 0.0;
+			linearSelfCollision(ins);
+			if (profiling)
+				m_profiler.addTimer("linearSelfCollision", t_begin, m_profiler.now());
+		}
+	}
+#pragma endregion
+
+#pragma region --body collision
+	void CpuSim::linearBodyCollision(Instance& ins)
+	{
+		const BodyProxy* proxy = (!ins.customLvSet && m_bodyProxy_h && !m_bodyProxy_h->empty()) ? m_bodyProxy_h : nullptr;
+		if (proxy == nullptr && (ins.bodyLvSet_h == nullptr || ins.bodyLvSet_h->sizeXYZ() == 0))
+			return;
+		const int nVerts = (int)ins.x_h.size();
+		const float dt = m_simParam.dt;
+		const float lvStep = proxy ? 1.f : ins.bodyLvSet_h->getStep();
+		const Float3 lvStart = proxy ? Float3(0.f) : ins.bodyLvSet_h->getStartPos();
+		const float repulsion_thickness = m_simParam.repulsion_thickness;
+		const float collision_stiffness = m_simParam.collision_stiffness;
+		const float friction_stiffness = m_simParam.friction_stiffness;
+
+#pragma omp parallel for
+		for (int iVert = 0; iVert < nVerts; iVert++)
+		{
+			const Float3 x = ins.x_h[iVert];
+			const Float3 v = ins.v_h[iVert];
+			const NodeMaterailSpaceData xData = m_nodes_materialSpace_h[iVert];
+
+			// the same with NodeCon::value() and NodeCon::gradient() of GpuSim,
+			// thus the central difference gradient instead of localSample()
+			float value = 0.f;
+			Float3 grad;
+			const Float3 t = (x - lvStart) / lvStep;
+			if (proxy)
+				proxy->sample(x, &value, &grad);
+			else
+				value = ins.bodyLvSet_h->localValue(t);
+			value = value * lvStep - repulsion_thickness;
+			const float violation = std::max(-value, 0.f);
+			if (violation == 0.f)
+				continue;
+			if (!proxy)
+				ins.bodyLvSet_h->localGradient(t, grad);
+			const float g = -xData.area * collision_stiffness*violation*violation / repulsion_thickness / 2.f;
+			const float h = xData.area * collision_stiffness*violation / repulsion_thickness;
+			const float v_dot_grad = v.dot(grad);
+
+			// friction
+			const float fn = fabs(g);
+			const Float3 n = -grad;
+			const Mat3f T = Mat3f().eye() - outer(n, n);
+			const Float3 Tv = T*v;
+			const float f_by_v = (v.length() == 0.f || Tv.length() == 0.f) ? 0.f :
+				std::min(friction_stiffness*fn / Tv.length(), xData.mass / dt);
+			const Mat3f fric_jac = -f_by_v*T;
+			const Float3 fric_force = fric_jac*v;
+
+			const Mat3f thisA = dt*dt*h*outer(grad, grad) - dt * fric_jac;
+			const Float3 thisb = -dt*(g + dt*h*v_dot_grad)*grad + dt * fric_force;
+
+			// each vertex only touches its own row, thus no conflict
+			ins.A_h.block(ins.A_h.diagPos(iVert)) += thisA.trans();
+			ins.b_h[iVert] += thisb;
+		} // end for iVert
+	}
+#pragma endregion
+
+#pragma region --self collision
+	void CpuSim::linearSelfCollision(Instance& ins)
+	{
+		const int nVerts = m_x_init_h.size();
+		const int nTri = m_faces_idxWorld_h.size();
+		const float dt = m_simParam.dt;
+		const float repulsion_thickness = m_simParam.repulsion_thickness;
+		const float collision_stiffness = m_simParam.collision_stiffness;
+		ldp::Float3 bmin = FLT_MAX;
+		ldp::Float3 bmax = -bmin;
+		for (int i = 0; i<nVerts; i++)
+		for (int k = 0; k < 3; k++)
+		{
+			bmin[k] = std::min(bmin[k], ins.x_h[i][k]);
+			bmax[k] = std::max(bmax[k], ins.x_h[i][k]);
+		}
+		const Float3 gridStart = bmin - 0.01f * (bmax - bmin);
+		const Float3 gridEnd = bmax + 0.01f * (bmax - bmin);
+		const Float3 gd = gridEnd - gridStart;
+		const float h = powf(gd[0] * gd[1] * gd[2], 1.f / 3.f) *
+			std::max(1.f / float(m_simParam.selfCollision_maxGridSize), m_simParam.dt * 2.f);
+		const float inv_h = 1.f / h;
+
+		// Initialize the culling grid sizes
+		const Int3 gridSize(floor((bmax - gridStart)*inv_h) + 2);
+		const int nBuckets = gridSize[0] * gridSize[1] * gridSize[2];
+		auto xyz2id = [&](Int3 xyz){ return (xyz[0] * gridSize[1] + xyz[1]) * gridSize[2] + xyz[2]; };
+		auto v2xyz_floor = [&](Float3 v){ return Int3(floor((v - gridStart)*inv_h)); };
+		auto v2xyz_ceil = [&](Float3 v){ return Int3(ceil((v - gridStart)*inv_h)); };
+
+		// assign vertex_id and vertex_bucket, sort by bucket and calculate bucket ranges
+		ins.selfColli_vertIds.resize(nVerts);
+		ins.selfColli_bucketIds.resize(nVerts);
+		ins.selfColli_bucketRanges.assign(nBuckets, Int2(0));
+		for (int i = 0; i < nVerts; i++)
+		{
+			ins.selfColli_vertIds[i] = i;
+			ins.selfColli_bucketIds[i] = xyz2id(v2xyz_floor(ins.x_h[i]));
+		}
+		std::sort(ins.selfColli_vertIds.begin(), ins.selfColli_vertIds.end(), [&](int a, int b){
+			return ins.selfColli_bucketIds[a] < ins.selfColli_bucketIds[b]
+				|| ins.selfColli_bucketIds[a] == ins.selfColli_bucketIds[b] && a < b; });
+		for (int i = 0; i < nVerts; i++)
+		{
+			const int vi = ins.selfColli_bucketIds[ins.selfColli_vertIds[i]];
+			if (i == 0 || vi != ins.selfColli_bucketIds[ins.selfColli_vertIds[i - 1]])
+				ins.selfColli_bucketRanges[vi][0] = i;
+			if (i == nVerts - 1 || vi != ins.selfColli_bucketIds[ins.selfColli_vertIds[i + 1]])
+				ins.selfColli_bucketRanges[vi][1] = i + 1;
+		}
+
+		// find the triangle-vertex pairs, each thread owns its pair list
+		std::vector<std::vector<Int2>> threadPairs(omp_get_max_threads());
+#pragma omp parallel for schedule(dynamic, 64)
+		for (int iTri = 0; iTri < nTri; iTri++)
+		{
+			std::vector<Int2>& pairs = threadPairs[omp_get_thread_num()];
+			const Int4 vabc = m_faces_idxWorld_h[iTri];
+			const Float3 x[3] = { ins.x_h[vabc[0]], ins.x_h[vabc[1]], ins.x_h[vabc[2]] };
+			if (!isValid(x[0]) || !isValid(x[1]) || !isValid(x[2]))
+				continue;
+			Float3 tmin = x[0], tmax = x[0];
+			for (int k = 1; k < 3; k++)
+			for (int c = 0; c < 3; c++)
+			{
+				tmin[c] = std::min(tmin[c], x[k][c]);
+				tmax[c] = std::max(tmax[c], x[k][c]);
+			}
+			Int3 min_ijk = v2xyz_floor(tmin) - 1, max_ijk = v2xyz_ceil(tmax) + 1;
+			for (int c = 0; c < 3; c++)
+			{
+				min_ijk[c] = std::max(0, std::min(gridSize[c] - 1, min_ijk[c]));
+				max_ijk[c] = std::max(0, std::min(gridSize[c] - 1, max_ijk[c]));
+			}
+			for (int pos_i = min_ijk[0]; pos_i <= max_ijk[0]; pos_i++)
+			for (int pos_j = min_ijk[1]; pos_j <= max_ijk[1]; pos_j++)
+			for (int pos_k = min_ijk[2]; pos_k <= max_ijk[2]; pos_k++)
+			{
+				const Int2 range = ins.selfColli_bucketRanges[xyz2id(Int3(pos_i, pos_j, pos_k))];
+				for (int k = range[0]; k < range[1]; k++)
+				{
+					const int pid = ins.selfColli_vertIds[k];
+					const Float3 p = ins.x_h[pid];
+					bool shouldContinue = (pid != vabc[0] && pid != vabc[1] && pid != vabc[2])
+						&& p[0] >= tmin[0] - repulsion_thickness && p[0] < tmax[0] + repulsion_thickness
+						&& p[1] >= tmin[1] - repulsion_thickness && p[1] < tmax[1] + repulsion_thickness
+						&& p[2] >= tmin[2] - repulsion_thickness && p[2] < tmax[2] + repulsion_thickness
+						&& isValid(p);
+					for (int pos = m_stitch_vertPairs_rowPtr_h[pid]; pos < m_stitch_vertPairs_rowPtr_h[pid + 1]; pos++)
+					{
+						const int svi = m_stitch_vertPairs_colIdx_h[pos];
+						shouldContinue &= (svi != vabc[0] && svi != vabc[1] && svi != vabc[2]);
+					} // pos
+					if (shouldContinue)
+						pairs.push_back(Int2(iTri, pid));
+				} // k
+			} // end for pos_i, j, k
+		} // end for iTri
+		ins.selfColli_tri_vertPair.clear();
+		for (const auto& pairs : threadPairs)
+			ins.selfColli_tri_vertPair.insert(ins.selfColli_tri_vertPair.end(), pairs.begin(), pairs.end());
+
+		// the dynamic schedule hands out the triangles in a random order; sort the pairs so that
+		// the serial scatter below always sums in the same order and the results are repeatable
+		std::sort(ins.selfColli_tri_vertPair.begin(), ins.selfColli_tri_vertPair.end(), [](Int2 a, Int2 b){
+			return a[0] < b[0] || a[0] == b[0] && a[1] < b[1]; });
+		ins.nPairs = (int)ins.selfColli_tri_vertPair.size();
+		if (ins.nPairs == 0)
+			return;
+
+		// compute the intersection info; the same with Triangle_compute_Kernel of GpuSim,
+		// but scattered serially instead of atomicAdd
+		for (int iPair = 0; iPair < ins.nPairs; iPair++)
+		{
+			const int iTri = ins.selfColli_tri_vertPair[iPair][0];
+			const int iVert = ins.selfColli_tri_vertPair[iPair][1];
+			const Int4 vabcp(m_faces_idxWorld_h[iTri][0], m_faces_idxWorld_h[iTri][1],
+				m_faces_idxWorld_h[iTri][2], iVert);
+			const Float3 x[4] = { ins.x_h[vabcp[0]], ins.x_h[vabcp[1]], ins.x_h[vabcp[2]], ins.x_h[vabcp[3]] };
+			const float area = std::min(m_faces_materialSpace_h[iTri].area, m_nodes_materialSpace_h[iVert].area);
+
+			Float4 w = 0.f;
+			Float3 N;
+			const float d = signed_vf_distance(x[3], x[0], x[1], x[2], N, w.ptr());
+			if (d < 0.f)
+				N = -N;
+			if (fabs(d) > repulsion_thickness)
+				continue;
+			float value = 0.f;
+			for (int i = 0; i < 4; i++)
+				value += w[i] * N.dot(x[i]);
+			value -= repulsion_thickness;
+			const float violation = std::max(-value, 0.f);
+			const float g = -area * collision_stiffness*violation*violation / repulsion_thickness / 2.f;
+			const float hs = area * collision_stiffness*violation / repulsion_thickness;
+			float v_dot_grad = 0.f;
+			for (int k = 0; k < 4; k++)
+				v_dot_grad += w[k] * N.dot(ins.v_h[vabcp[k]]);
+			const Mat3f ot = outer(N, N);
+
+			// only the existed blocks of A are added, the same with GpuSim
+			for (int k1 = 0; k1 < 4; k1++)
+			{
+				for (int k2 = 0; k2 < 4; k2++)
+				{
+					const int pos = ins.A_h.findBlock(vabcp[k1], vabcp[k2]);
+					if (pos >= 0)
+						ins.A_h.block(pos) += (dt*dt*hs* w[k1] * w[k2] * ot).trans();
+				} // end for k2
+				ins.b_h[vabcp[k1]] += -dt*(g + dt*hs*v_dot_grad)*w[k1] * N;
+			} // end for k1
+		} // end for iPair
+	}
+#pragma endregion
+
+#pragma region --solving
+	void CpuSim::initPcgGuess(Instance& ins)
+	{
+		const int nVerts = (int)ins.dv_h.size();
+		if (ins.last_dv_h.size() != ins.dv_h.size())
+			ins.last_dv_h.assign(nVerts, Float3(0.f));
+		switch (m_simParam.pcg_warm_start)
+		{
+		case PcgWarmStartLast:
+			// ins.dv_h still holds the last dv
+			ins.last_dv_h = ins.dv_h;
+			break;
+		case PcgWarmStartExtrapolate:
+			// dv = 2*dv[n-1] - dv[n-2], then dv[n-2] = dv[n-1]
+#pragma omp parallel for
+			for (int i = 0; i < nVerts; i++)
+			{
+				const Float3 dv = ins.dv_h[i];
+				ins.dv_h[i] = 2.f * dv - ins.last_dv_h[i];
+				ins.last_dv_h[i] = dv;
+			}
+			break;
+		default:
+			std::fill(ins.dv_h.begin(), ins.dv_h.end(), Float3(0.f));
+			break;
+		}
+	}
+
+	void CpuSim::linearSolve(const std::vector<int>& insIds)
+	{
+		const int nIns = (int)insIds.size();
+		if (nIns == 1)
+		{
+			Instance& ins = m_instances[insIds[0]];
+			ins.lastSolveIter = ins.A_h.pcg((const float*)ins.b_h.data(), (float*)ins.dv_h.data(),
+				m_simParam.pcg_iter, m_simParam.pcg_tol, &ins.lastSolveErr, &ins.lastSolveErr0);
+			return;
+		}
+		if (nIns == 0)
+			return;
+
+		// all instances in one parallel region, the converged ones are masked out
+		std::vector<const BsrMatrix3*> A(nIns);
+		std::vector<const float*> b(nIns);
+		std::vector<float*> x(nIns);
+		std::vector<int> iters(nIns);
+		std::vector<float> errs(nIns), errs0(nIns);
+		for (int k = 0; k < nIns; k++)
+		{
+			Instance& ins = m_instances[insIds[k]];
+			A[k] = &ins.A_h;
+			b[k] = (const float*)ins.b_h.data();
+			x[k] = (float*)ins.dv_h.data();
+		}
+		BsrMatrix3::pcgBatch(nIns, A.data(), b.data(), x.data(), m_simParam.pcg_iter, m_simParam.pcg_tol,
+			iters.data(), errs.data(), errs0.data());
+		for (int k = 0; k < nIns; k++)
+		{
+			Instance& ins = m_instances[insIds[k]];
+			ins.lastSolveIter = iters[k];
+			ins.lastSolveErr = errs[k];
+			ins.lastSolveErr0 = errs0[k];
+		}
+	}
+
+	void CpuSim::update_x_v_by_dv(Instance& ins)
+	{
+		// v += dv; x += dt*v;
+		const int nVerts = (int)ins.x_h.size();
+		const float dt = m_simParam.dt;
+#pragma omp parallel for
+		for (int i = 0; i < nVerts; i++)
+		{
+			ins.v_h[i] += ins.dv_h[i];
+			ins.x_h[i] += dt * ins.v_h[i];
+		}
+	}
+#pragma endregion
+
+#pragma region -- equilibrium
+	void CpuSim::updateEquilibrium(Instance& ins)
+	{
+		const int nVerts = (int)ins.x_h.size();
+		const bool valid = (int)ins.last_x_h.size() == nVerts && (int)ins.v_h.size() == nVerts
+			&& (int)m_nodes_materialSpace_h.size() == nVerts;
+		EquilibriumMonitor::Sample s;
+		s.residual = ins.lastSolveErr;
+		if (valid)
+		{
+			float sumMass = 0.f, sumKe = 0.f, maxDisp2 = 0.f;
+			for (int i = 0; i < nVerts; i++)
+			{
+				const float mass = m_nodes_materialSpace_h[i].mass;
+				maxDisp2 = std::max(maxDisp2, (ins.x_h[i] - ins.last_x_h[i]).sqrLength());
+				sumKe += 0.5f * mass * ins.v_h[i].sqrLength();
+				sumMass += mass;
+			}
+			s.kineticEnergy = sumKe / std::max(sumMass, 1e-12f);
+			s.maxDisplacement = sqrt(maxDisp2);
+		}
+
+		// during stitching, the cloth is not allowed to settle
+		ins.equilibrium.push(s, valid && ins.curStitchRatio == 0.f);
+	}
+#pragma endregion
+
+#pragma region -- exportmesh
+	void CpuSim::exportResultClothToObjMesh()
+	{
+		m_shouldExportMesh = true;
+		updateDependency();
+		exportResultClothToObjMesh(m_instances[0], *m_resultClothMesh, m_vertMerge_in_out_idxMap_h);
+		m_shouldExportMesh = false;
+	}
+
+	void CpuSim::exportInstanceToObjMesh(int i, ObjMesh& mesh)const
+	{
+		std::vector<int> idxMap;
+		exportResultClothToObjMesh(m_instances.at(i), mesh, idxMap);
+	}
+
+	void CpuSim::exportResultClothToObjMesh(const Instance& ins, ObjMesh& mesh, std::vector<int>& idxMap)const
+	{
+		mesh.clear();
+
+		if (ins.curStitchRatio > 0.f)
+		{
+			ObjMesh::obj_material mat;
+			mesh.material_list.push_back(mat);
+
+			idxMap.resize(m_x_init_h.size());
+			for (size_t i = 0; i < idxMap.size(); i++)
+				idxMap[i] = i;
+			mesh.vertex_list = ins.x_h;
+			mesh.vertex_texture_list = m_texCoord_init_h;
+			for (size_t iFace = 0; iFace < m_faces_idxWorld_h.size(); iFace++)
+			{
+				ObjMesh::obj_face f;
+				f.vertex_count = 3;
+				f.material_index = 0;
+				for (int k = 0; k < 3; k++)
+				{
+					f.vertex_index[k] = m_faces_idxWorld_h[iFace][k];
+					f.texture_index[k] = m_faces_idxTex_h[iFace][k];
+				}
+				f.material_index = -1;
+				mesh.face_list.push_back(f);
+			} // end for iFace
+			mesh.updateNormals();
+			mesh.updateBoundingBox();
+		} // end if stitching
+		else // we merge pices if they have been stiched together
+		{
+			ObjMesh::obj_material mat_default, mat_sel, mat_high;
+			mat_default.diff = Float3(1.f, 1.f, 1.f);
+			mat_sel.diff = Float3(0.8f, 0.6f, 0.0f);
+			mat_high.diff = Float3(0.0f, 0.6f, 0.8f);
+			mesh.material_list.push_back(mat_default);
+			mesh.material_list.push_back(mat_sel);
+			mesh.material_list.push_back(mat_high);
+
+			idxMap = m_stitch_vertMerge_idxMap_h;
+			for (size_t id = 0; id < ins.x_h.size(); id++)
+			{
+				if (idxMap[id] == id)
+				{
+					idxMap[id] = (int)mesh.vertex_list.size();
+					mesh.vertex_list.push_back(ins.x_h[id]);
+				}
+				else
+					idxMap[id] = idxMap[idxMap[id]];
+				mesh.vertex_texture_list.push_back(m_texCoord_init_h[id]);
+			} // end for x
+
+			// write faces
+			for (const auto& t : m_faces_idxWorld_h)
+			{		
+				ObjMesh::obj_face f;
+				f.vertex_count = 3;
+				f.material_index = -1;
+				const auto piece = m_clothManager->clothPiece(t[3]);
+				if (piece)
+				{
+					f.material_index = std::min(0, (int)mesh.material_list.size() - 1);
+					if (piece->graphPanel().isHighlighted())
+						f.material_index = std::min(2, (int)mesh.material_list.size() - 1);
+					else if (piece->graphPanel().isSelected())
+						f.material_index = std::min(1, (int)mesh.material_list.size() - 1);
+				}
+				for (int k = 0; k < t.size(); k++)
+					f.vertex_index[k] = idxMap[t[k]];
+				if (f.vertex_index[0] != f.vertex_index[1] && f.vertex_index[0] != f.vertex_index[2]
+					&& f.vertex_index[1] != f.vertex_index[2])
+				{
+					for (int k = 0; k < t.size(); k++)
+						f.texture_index[k] = t[k];
+					mesh.face_list.push_back(f);
+				}
+			} // end for t
+			mesh.updateBoundingBox();
+			mesh.updateNormals();
+		} // end else clothManger
+	}
+#pragma endregion
+
+#pragma region --helper functions
+	BMEdge* CpuSim::findEdge(int v1, int v2)
+	{
+		if (m_bmVerts.size() == 0)
+			throw std::exception("bmesh not initialzed");
+		BMVert* bv1 = m_bmVerts[v1];
+		BMVert* bv2 = m_bmVerts[v2];
+		BMESH_E_OF_V(e, bv1, v1iter, *m_bmesh)
+		{
+			if (m_bmesh->vofe_first(e) == bv2 || m_bmesh->vofe_last(e) == bv2)
+				return e;
+		}
+		return nullptr;
+	}
+#pragma endregion
+}
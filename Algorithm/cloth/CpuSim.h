@@ -0,0 +1,229 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <map>
+#include "ldpMat\ldp_basic_mat.h"
+#include "AbstractClothSimulator.h"
+#include "GpuSim.h"
+#include "BsrMatrix3.h"
+#include "SparseStructureCache.h"
+
+class ObjMesh;
+namespace ldp
+{
+	class ClothManager;
+	class LevelSet3D;
+	class BodyProxy;
+	class BMesh;
+	class BMVert;
+	class BMEdge;
+	class BMFace;
+	// The host (cpu) version of GpuSim, with the same numerics:
+	//	updateNumeric(), linearBodyCollision(), linearSelfCollision() and linearSolve() are
+	//	implemented with openmp-parallel kernels over flat host arrays, no cuda/cusparse/cublas call is made.
+	// Only the ClothManager initialization is supported.
+	// Several instances of the same cloth can be simulated together, e.g., on different bodies:
+	//	they share the topology, stitches, materials and the sparse structure,
+	//	while each has its own body level set, positions, velocities and matrix values.
+	//	Instance 0 is the one of ClothManager; all active instances are stepped in one parallel region
+	//	and solved by a batched pcg, settled instances are deactivated and skipped.
+	class CpuSim : public AbstractClothSimulator
+	{
+	public:
+		typedef GpuSim::EdgeData EdgeData;
+		typedef GpuSim::FaceMaterailSpaceData FaceMaterailSpaceData;
+		typedef GpuSim::NodeMaterailSpaceData NodeMaterailSpaceData;
+		typedef GpuSim::SimParam SimParam;
+		// host copy of MaterialCache::Material, without any cuda array.
+		struct Material
+		{
+			enum{
+				STRETCH_SAMPLES = 30,
+				BEND_POINTS = 5,
+				BEND_DIMS = 9,
+			};
+			std::vector<ldp::Float4> stretchSample;		// [z][y][x], x fastest
+			std::vector<float> bendData;				// [point][dim], dim fastest
+			float density = 0.f;
+		};
+		// per-instance simulation state
+		struct Instance
+		{
+			const ldp::LevelSet3D* bodyLvSet_h = nullptr;
+			bool customLvSet = false;							// else use the body of ClothManager
+			bool active = true;
+			float curSimulationTime = 0.f;
+			float curStitchRatio = 0.f;
+			std::vector<ldp::Mat3f> beforScan_A;
+			std::vector<ldp::Float3> beforScan_b;
+			BsrMatrix3 A_h;										// the structure is shared by all instances
+			std::vector<ldp::Float3> b_h;
+			std::vector<ldp::Float3> x_h;						// position of current step
+			std::vector<ldp::Float3> last_x_h;					// position of last step
+			std::vector<ldp::Float3> v_h;						// velocity of current step
+			std::vector<ldp::Float3> last_v_h;					// velocity of last step
+			std::vector<ldp::Float3> dv_h;						// velocity changed in this step
+			std::vector<ldp::Float3> last_dv_h;					// velocity changed in the last step, for pcg warm start
+			int lastSolveIter = 0;
+			float lastSolveErr = 0.f;							// relative residual of the last linear solve
+			float lastSolveErr0 = 0.f;							// relative residual of the initial guess
+			EquilibriumMonitor equilibrium;
+			// self collision buffers
+			std::vector<int> selfColli_vertIds;
+			std::vector<int> selfColli_bucketIds;
+			std::vector<ldp::Int2> selfColli_bucketRanges;
+			std::vector<ldp::Int2> selfColli_tri_vertPair;
+			int nPairs = 0;
+		};
+	public:
+		CpuSim();
+		~CpuSim();
+		SimulationBackend backend()const{ return SimulationBackendCpu; }
+
+		void clear();
+		void init(ClothManager* clothManager);
+		void run_one_step();
+		void restart();
+		void updateParam();
+		void updateTopology();
+		void updateStitch();
+		void updateMaterial();
+		void updateBodyCollider();
+		void setFixPositions(int nFixed, const int* ids, const Float3* targets);
+	public:
+		float getFps()const{ return m_fps; }
+		float getStepTime()const{ return m_simParam.dt; }
+		std::string getSolverInfo()const{ return m_solverInfo; }
+		TopologyFingerprint::ValueType getTopologyFingerprint()const{ return m_topologyFingerprint; }
+		EquilibriumMonitor& getEquilibriumMonitor(){ return m_instances[0].equilibrium; }
+		const EquilibriumMonitor& getEquilibriumMonitor()const{ return m_instances[0].equilibrium; }
+		SimulationProfiler& getProfiler(){ return m_profiler; }
+		const SimulationProfiler& getProfiler()const{ return m_profiler; }
+		ObjMesh& getResultClothMesh();
+		void getResultClothPieces();
+		const std::vector<Float2>& getVertTexCoords()const{ return m_texCoord_init_h; }
+		const std::vector<Float3>& getCurrentVertPositions()const{ return m_instances[0].x_h; }
+		const std::vector<Float3>& getInitVertPositions()const{ return m_x_init_h; }
+		const std::vector<Int4>& getFaceIndices()const{ return m_faces_idxWorld_h; }
+		const std::vector<int>& getVertMergeIdxMap()const{ return m_vertMerge_in_out_idxMap_h; }
+		void setCurrentVertPositions(const std::vector<Float3>& X);
+		void setInitVertPositions(const std::vector<Float3>& X);
+		void getCheckpoint(SimulationCheckpoint& cp){ getInstanceCheckpoint(0, cp); }
+		void setCheckpoint(const SimulationCheckpoint& cp){ setInstanceCheckpoint(0, cp); }
+	public:
+		// multiple instances, n >= 1; the new ones start from the initial positions
+		void setNumInstances(int n);
+		int numInstances()const{ return (int)m_instances.size(); }
+		// nullptr to use the body of ClothManager; the level set should be alive during simulation
+		void setInstanceBodyLevelSet(int i, const ldp::LevelSet3D* lvSet);
+		void setInstanceActive(int i, bool active);
+		bool isInstanceActive(int i)const{ return m_instances.at(i).active; }
+		int numActiveInstances()const;
+		void restartInstance(int i);
+		const std::vector<Float3>& getInstanceVertPositions(int i)const{ return m_instances.at(i).x_h; }
+		const EquilibriumMonitor& getInstanceEquilibriumMonitor(int i)const{ return m_instances.at(i).equilibrium; }
+		void exportInstanceToObjMesh(int i, ObjMesh& mesh)const;
+		// e.g., fork a settled state to all instances; the fixed positions are shared by all instances
+		void getInstanceCheckpoint(int i, SimulationCheckpoint& cp);
+		void setInstanceCheckpoint(int i, const SimulationCheckpoint& cp);
+	protected:
+		// update the whole system based on the current changes
+		void updateSystem();
+
+		// parameters
+		void initParam();
+
+		// body level set
+		void initLevelSet();
+
+		// basic topology
+		void initFaceEdgeVertArray();
+		void initBMesh();
+
+		// stitching
+		void buildStitch();
+		void buildStitchVertPairs();
+		void buildStitchEdges();
+
+		// sparse system setup, the structure is cached by the topology fingerprint
+		void setup_sparse_structure();
+		SparseStructureCache::EntryPtr buildSparseStructure()const;
+
+		// instances
+		void resetInstance(Instance& ins);
+
+		// material
+		void updateMaterialDataToFaceNode();
+		const Material* findMaterial(std::string name);
+
+		// solving related
+		void updateNumeric(Instance& ins);
+		void initPcgGuess(Instance& ins);
+		void linearSolve(const std::vector<int>& insIds);
+		void linearBodyCollision(Instance& ins);
+		void linearSelfCollision(Instance& ins);
+		void update_x_v_by_dv(Instance& ins);
+
+		// equilibrium detection, after each step
+		void updateEquilibrium(Instance& ins);
+
+		// exporting related
+		void exportResultClothToObjMesh();
+		void exportResultClothToObjMesh(const Instance& ins, ObjMesh& mesh, std::vector<int>& idxMap)const;
+	protected:
+		BMEdge* findEdge(int v1, int v2); // edge with end point v1,v2
+		void computeStretchForces(Instance& ins, int iFace);
+		void computeBendForces(Instance& ins, int iEdge, const EdgeData& edgeData, int A_start, int b_start);
+		void computeStitchVertForces(Instance& ins, int iStitch, int A_start, int b_start);
+	private:
+		ClothManager* m_clothManager = nullptr;
+		SimParam m_simParam;
+		float m_fps = 0.f;
+		std::string m_solverInfo;
+		SimulationProfiler m_profiler;
+		std::vector<Instance> m_instances;
+		const BodyProxy* m_bodyProxy_h = nullptr;		// used instead of the level set of ClothManager if not empty
+		std::shared_ptr<ObjMesh> m_resultClothMesh;
+		std::map<std::string, std::shared_ptr<Material>> m_materials;
+
+		bool m_shouldTopologyUpdate = false;
+		bool m_shouldLevelsetUpdate = false;
+		bool m_shouldMaterialUpdate = false;
+		bool m_shouldStitchUpdate = false;
+		bool m_shouldSparseStructureUpdate = false;
+		bool m_shouldRestart = false;
+		bool m_shouldExportMesh = false;
+		void updateDependency();
+		void resetDependency(bool on);
+		///////////////// mesh structure related /////////////////////////////////////////////////////////////
+		std::shared_ptr<BMesh> m_bmesh;
+		std::vector<BMVert*> m_bmVerts;
+		std::vector<ldp::Int4> m_faces_idxWorld_h;				// the last value is its cloth index
+		std::vector<ldp::Int4> m_faces_idxTex_h;				// the last value is its vert start index
+		std::vector<const Material*> m_faces_material_h;
+		std::vector<FaceMaterailSpaceData> m_faces_materialSpace_h;
+		std::vector<NodeMaterailSpaceData> m_nodes_materialSpace_h;
+		std::vector<EdgeData> m_edgeData_h;
+		std::vector<int> m_vert_FaceList_rowPtr_h;				// one-ring faces of each vertex, csr
+		std::vector<int> m_vert_FaceList_colIdx_h;
+		std::vector<std::pair<Int2, float>> m_stitch_vertPairs_h;
+		std::vector<int> m_stitch_vertPairs_rowPtr_h;			// stitched vertices of each vertex, csr
+		std::vector<int> m_stitch_vertPairs_colIdx_h;
+		std::vector<int> m_stitch_vertMerge_idxMap_h;
+		std::vector<int> m_vertMerge_in_out_idxMap_h;
+		std::vector<EdgeData> m_stitch_edgeData_h;
+		///////////////// precomputed data /////////////////////////////////////////////////////////////
+		TopologyFingerprint::ValueType m_topologyFingerprint = 0;
+		std::vector<int> m_A_Ids_start_h;		// the starting position of each face/edge/stitch in beforScan_A
+		std::vector<int> m_A_scanPtr_h;			// for each nnz block, the range in m_A_scanIdx_h
+		std::vector<int> m_A_scanIdx_h;			// beforScan_A positions, sorted by (row, col)
+		std::vector<int> m_b_Ids_start_h;
+		std::vector<int> m_b_scanPtr_h;
+		std::vector<int> m_b_scanIdx_h;
+		///////////////// shared by all instances ////////////////////////////////////////////////////
+		std::vector<ldp::Float2> m_texCoord_init_h;				// material (tex) space vertex texCoord
+		std::vector<ldp::Float3> m_x_init_h;					// world space vertex position
+		std::vector<ldp::Float4> m_fixPosition_vw_h;
+	};
+}
@@ -0,0 +1,84 @@
+#include "EquilibriumMonitor.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace ldp
+{
+	void EquilibriumMonitor::Param::setDefault()
+	{
+		window = 20;
+		kineticEnergy = 1e-4f;
+		maxDisplacement = 1e-4f;
+		residual = 5e-2f;
+		maxSteps = 2000;
+	}
+
+	EquilibriumMonitor::EquilibriumMonitor()
+	{
+		reset();
+	}
+
+	EquilibriumMonitor::~EquilibriumMonitor()
+	{
+
+	}
+
+	void EquilibriumMonitor::reset()
+	{
+		m_window.clear();
+		m_nSteps = 0;
+		m_settled = false;
+		m_timeout = false;
+	}
+
+	EquilibriumMonitor::Sample EquilibriumMonitor::windowMax()const
+	{
+		Sample m;
+		for (const auto& s : m_window)
+		{
+			m.kineticEnergy = std::max(m.kineticEnergy, s.kineticEnergy);
+			m.maxDisplacement = std::max(m.maxDisplacement, s.maxDisplacement);
+			m.residual = std::max(m.residual, s.residual);
+		}
+		return m;
+	}
+
+	bool EquilibriumMonitor::withinThresholds()const
+	{
+		if ((int)m_window.size() < std::max(1, m_param.window))
+			return false;
+		const Sample m = windowMax();
+		return m.kineticEnergy < m_param.kineticEnergy && m.maxDisplacement < m_param.maxDisplacement
+			&& m.residual < m_param.residual;
+	}
+
+	bool EquilibriumMonitor::push(const Sample& s, bool canSettle)
+	{
+		m_nSteps++;
+		if (canSettle)
+		{
+			m_window.push_back(s);
+			while ((int)m_window.size() > std::max(1, m_param.window))
+				m_window.pop_front();
+		}
+		else
+			m_window.clear();
+
+		if (m_settled)
+			return false;
+		if (withinThresholds())
+			m_settled = true;
+		else if (m_param.maxSteps > 0 && m_nSteps >= m_param.maxSteps)
+			m_settled = m_timeout = true;
+		return m_settled;
+	}
+
+	std::string EquilibriumMonitor::getInfo()const
+	{
+		const Sample m = windowMax();
+		char info[256];
+		sprintf(info, "step %d, ke %.1e, disp %.1e, res %.1e%s", m_nSteps, m.kineticEnergy,
+			m.maxDisplacement, m.residual, m_settled ? (m_timeout ? ", timeout" : ", settled") : "");
+		return info;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <deque>
+#include <string>
+
+namespace ldp
+{
+	// Detects the static equilibrium of a cloth simulation:
+	//	for each step, the kinetic energy (per unit mass), the max vertex displacement and the pcg residual are pushed;
+	//	the cloth is settled when all of them keep under the thresholds over a sliding window of steps.
+	//	If it never settles, maxSteps is used as the fallback.
+	class EquilibriumMonitor
+	{
+	public:
+		struct Param
+		{
+			int window = 0;						// number of steps that all criteria should hold
+			float kineticEnergy = 0.f;			// 0.5*sum(m*v^2)/sum(m), in m^2/s^2
+			float maxDisplacement = 0.f;		// max vertex displacement of a step, in meters
+			float residual = 0.f;				// relative residual of the linear solver
+			int maxSteps = 0;					// settled anyway after this many steps, <= 0 to disable
+			Param(){ setDefault(); }
+			void setDefault();
+		};
+		struct Sample
+		{
+			float kineticEnergy = 0.f;
+			float maxDisplacement = 0.f;
+			float residual = 0.f;
+		};
+	public:
+		EquilibriumMonitor();
+		~EquilibriumMonitor();
+
+		// call when the simulation restarts or the body/pose changes
+		void reset();
+
+		void setParam(const Param& param){ m_param = param; }
+		const Param& getParam()const{ return m_param; }
+
+		// push the state of a step; canSettle=false if the simulation is not allowed to settle now, e.g., during stitching
+		// return true only on the step the settled event raises
+		bool push(const Sample& s, bool canSettle = true);
+
+		bool isSettled()const{ return m_settled; }
+		bool isTimeout()const{ return m_timeout; }
+		int numSteps()const{ return m_nSteps; }
+		Sample windowMax()const;
+		std::string getInfo()const;
+	protected:
+		bool withinThresholds()const;
+	private:
+		Param m_param;
+		std::deque<Sample> m_window;
+		int m_nSteps;
+		bool m_settled;
+		bool m_timeout;
+	};
+}
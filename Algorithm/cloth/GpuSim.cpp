@@ -11,11 +11,14 @@
 #include "arcsim\ArcSimManager.h"
 #include "arcsim\adaptiveCloth\conf.hpp"
 #include "MaterialCache.h"
+#include "PersistentSparseSolver.h"
+#include "SimulationCheckpoint.h"
 
 #include <eigen\Dense>
 #include <eigen\Sparse>
 
 //#define SOLVE_USE_EIGEN
+//#define SOLVE_USE_HOST_PCG
 const static char* g_default_arcsim_material = "data/arcsim/materials/gray-interlock.json";
 
 namespace ldp
@@ -120,6 +123,7 @@ namespace ldp
 		m_bmesh.reset(new BMesh());
 		m_resultClothMesh.reset(new ObjMesh);
 		m_materials.reset(new MaterialCache);
+		m_A_solver.reset(new PersistentSparseSolver());
 	}
 
 	GpuSim::~GpuSim()
@@ -163,8 +167,15 @@ namespace ldp
 		m_solverInfo = "[";
 
 		gtime_t t_start = gtime_now();
+		m_profiler.beginStep();
+		SimulationProfiler::ScopedTimer stepTimer(m_profiler, "run_one_step");
 
-		updateSystem();
+		// kernels are asynchronous, thus each stage is synchronized when profiling
+		const bool syncStages = m_profiler.isEnabled();
+		{
+			SimulationProfiler::ScopedTimer timer(m_profiler, "updateSystem");
+			updateSystem();
+		}
 
 		// stitching: during stitching, we do not want the speed to high
 		m_curStitchRatio = std::max(0.f, 1.f - m_curSimulationTime * m_simParam.stitch_ratio);
@@ -175,21 +186,39 @@ namespace ldp
 		}
 
 		// build m_A and m_b
-		bindTextures();
-		updateNumeric();
+		{
+			SimulationProfiler::ScopedTimer timer(m_profiler, "bindTextures");
+			bindTextures();
+			if (syncStages)
+				cudaSafeCall(cudaThreadSynchronize());
+		}
+		{
+			SimulationProfiler::ScopedTimer timer(m_profiler, "updateNumeric");
+			updateNumeric();
+			if (syncStages)
+				cudaSafeCall(cudaThreadSynchronize());
+		}
 
 		// solve the linear system
 		m_x_d.copyTo(m_last_x_d);
 		m_v_d.copyTo(m_last_v_d);
-		m_dv_d.create(m_dv_d.size());
-		linearSolve();
+		initPcgGuess();
+		{
+			SimulationProfiler::ScopedTimer timer(m_profiler, "linearSolve");
+			linearSolve();
+		}
 
 		// post-process collisions
 		//collisionSolve();
 
 		// finish, get the result back to cpu and prepare for next.
-		m_x_d.download(m_x_h);
+		{
+			SimulationProfiler::ScopedTimer timer(m_profiler, "download_x");
+			m_x_d.download(m_x_h);
+		}
+		m_profiler.addCounter("download_bytes", double(m_x_h.size() * sizeof(Float3)));
 		m_curSimulationTime += m_simParam.dt;
+		updateEquilibrium();
 
 		m_shouldExportMesh = true;
 		gtime_t t_end = gtime_now();
@@ -210,9 +239,12 @@ namespace ldp
 		m_v_d.create(m_x_init_d.size());
 		m_last_v_d.create(m_x_init_d.size());
 		m_dv_d.create(m_x_init_d.size());
+		m_last_dv_d.create(m_x_init_d.size());
 		m_b_d.create(m_x_init_d.size());
 		m_curSimulationTime = 0.f;
 		m_curStitchRatio = 1.f;
+		m_last_x_h.clear();
+		m_equilibrium.reset();
 		m_shouldRestart = false;
 	}
 
@@ -233,6 +265,7 @@ namespace ldp
 			m_simParam.strecth_mult = par.spring_k;
 			m_simParam.bend_mult = par.bending_k;
 			m_simParam.enable_selfCollision = par.enable_self_collistion;
+			m_simParam.pcg_warm_start = par.pcg_warm_start;
 		} // end else clothManager
 		updateMaterialDataToFaceNode();
 	}
@@ -252,6 +285,18 @@ namespace ldp
 		updateMaterialDataToFaceNode();
 	}
 
+	void GpuSim::updateBodyCollider()
+	{
+		if (m_clothManager == nullptr)
+			return;
+		m_bodyLvSet_h = m_clothManager->bodyLevelSet();
+		m_bodyLvSet_d = m_clothManager->bodyLevelSetDevice();
+		if (m_clothManager->isBodyProxyActive())
+			m_bodyProxy_d.upload(m_clothManager->bodyProxy()->primitives());
+		else
+			m_bodyProxy_d.release();
+	}
+
 	ObjMesh& GpuSim::getResultClothMesh()
 	{
 		exportResultClothToObjMesh();
@@ -275,6 +320,41 @@ namespace ldp
 		m_shouldRestart = true;
 	}
 
+	void GpuSim::getCheckpoint(SimulationCheckpoint& cp)
+	{
+		updateSystem();
+		cp.fingerprint = m_topologyFingerprint;
+		cp.curSimulationTime = m_curSimulationTime;
+		cp.curStitchRatio = m_curStitchRatio;
+		m_x_d.download(cp.x);
+		m_v_d.download(cp.v);
+		m_last_x_d.download(cp.last_x);
+		m_last_v_d.download(cp.last_v);
+		m_dv_d.download(cp.dv);
+		cp.fixPosition_vw = m_fixPosition_vw_h;
+	}
+
+	void GpuSim::setCheckpoint(const SimulationCheckpoint& cp)
+	{
+		updateSystem();
+		if (!cp.isValid() || cp.numVerts() != (int)m_x_init_h.size() || cp.fingerprint != m_topologyFingerprint)
+			throw std::exception("GpuSim::setCheckpoint, topology not matched!");
+		m_curSimulationTime = cp.curSimulationTime;
+		m_curStitchRatio = cp.curStitchRatio;
+		m_x_h = cp.x;
+		m_x_d.upload(cp.x);
+		m_v_d.upload(cp.v);
+		m_last_x_d.upload(cp.last_x);
+		m_last_v_d.upload(cp.last_v);
+		m_dv_d.upload(cp.dv);
+		m_dv_d.copyTo(m_last_dv_d);
+		m_fixPosition_vw_h = cp.fixPosition_vw;
+		m_fixPosition_vw_d.upload(m_fixPosition_vw_h);
+		m_last_x_h.clear();
+		m_equilibrium.reset();
+		m_shouldExportMesh = true;
+	}
+
 	void GpuSim::getResultClothPieces()
 	{
 		if (m_clothManager == nullptr)
@@ -313,8 +393,13 @@ namespace ldp
 		m_curSimulationTime = 0.f;
 		m_curStitchRatio = 0.f;
 		m_solverInfo = "";
+		m_last_x_h.clear();
+		m_vert_mass_h.clear();
+		m_lastSolveErr = 0.f;
+		m_equilibrium.reset();
 		m_bodyLvSet_h = nullptr;
 		m_bodyLvSet_d.release();
+		m_bodyProxy_d.release();
 		m_resultClothMesh->clear();
 
 		m_bmesh->clear();
@@ -339,6 +424,7 @@ namespace ldp
 		m_stitch_edgeData_d.release();
 		m_materials->clear();
 
+		m_topologyFingerprint = 0;
 		m_A_Ids_d.release();
 		m_A_Ids_d_unique.release();
 		m_A_Ids_d_unique_pos.release();
@@ -356,6 +442,8 @@ namespace ldp
 
 		m_A_d->clear();
 		m_A_diag_d->clear();
+		m_A_h.clear();
+		m_A_solver->clear();
 		m_b_d.release();
 		m_texCoord_init_h.clear();
 		m_texCoord_init_d.release();
@@ -367,6 +455,7 @@ namespace ldp
 		m_v_d.release();
 		m_last_v_d.release();
 		m_dv_d.release();
+		m_last_dv_d.release();
 		m_fixPosition_vw_h.clear();
 		m_fixPosition_vw_d.release();
 
@@ -404,12 +493,13 @@ namespace ldp
 			if (m_arcSimManager->getSimulator()->obstacles.size() >= 1)
 			{
 				m_bodyLvSet_h = m_arcSimManager->getSimulator()->obstacles[0].base_objLevelSet.get();
-				auto sz = m_bodyLvSet_h->size();
-				std::vector<float> transposeLv(m_bodyLvSet_h->sizeXYZ(), 0.f);
+				const ldp::LevelSet3D& lvSet = *m_bodyLvSet_h;	// const access, not to allocate the far tiles
+				auto sz = lvSet.size();
+				std::vector<float> transposeLv(lvSet.sizeXYZ(), 0.f);
 				for (int z = 0; z < sz[2]; z++)
 				for (int y = 0; y < sz[1]; y++)
 				for (int x = 0; x < sz[0]; x++)
-					transposeLv[x + y*sz[0] + z*sz[0] * sz[1]] = m_bodyLvSet_h->value(x, y, z)[0];
+					transposeLv[x + y*sz[0] + z*sz[0] * sz[1]] = lvSet.value(x, y, z)[0];
 				m_bodyLvSet_d.fromHost(transposeLv.data(), make_int3(sz[0], sz[1], sz[2]));
 				if (m_arcSimManager->getSimulator()->obstacles.size() > 1)
 					printf("warning: more than one obstacles given, only 1 used!\n");
@@ -419,8 +509,7 @@ namespace ldp
 		{
 			if (m_clothManager->m_shouldLevelSetUpdate)
 				m_clothManager->calcLevelSet();
-			m_bodyLvSet_h = m_clothManager->bodyLevelSet();
-			m_bodyLvSet_d = m_clothManager->bodyLevelSetDevice();
+			updateBodyCollider();
 		} // end for clothManager
 		m_shouldLevelsetUpdate = false;
 	}
@@ -433,6 +522,8 @@ namespace ldp
 		gravity = Float3(0.f, 0.f, -9.8f);
 		pcg_tol = 1e-2f;
 		pcg_iter = 400;
+		pcg_warm_start = PcgWarmStartZero;
+		factor_reuse_tol = 0.f;
 
 		strecth_mult = 1.f;
 		bend_mult = 1.f;
@@ -465,6 +556,7 @@ namespace ldp
 			m_simParam.strecth_mult = par.spring_k;
 			m_simParam.bend_mult = par.bending_k;
 			m_simParam.enable_selfCollision = par.enable_self_collistion;
+			m_simParam.pcg_warm_start = par.pcg_warm_start;
 		} // end else clothManager
 	}
 #pragma endregion
@@ -493,6 +585,7 @@ namespace ldp
 		m_v_d.create(m_x_d.size());
 		m_last_v_d.create(m_v_d.size());
 		m_dv_d.create(m_x_d.size());
+		m_last_dv_d.create(m_x_d.size());
 		m_b_d.create(m_x_d.size());
 		m_project_vw_d.create(m_x_d.size());
 		m_stitch_vertMerge_idxMap_h.resize(m_x_init_h.size());
@@ -735,6 +828,9 @@ namespace ldp
 			}
 		} // end for iFace
 		m_nodes_materialSpace_d.upload(nodeData);
+		m_vert_mass_h.resize(nodeData.size());
+		for (size_t i = 0; i < nodeData.size(); i++)
+			m_vert_mass_h[i] = nodeData[i].mass;
 
 		m_shouldMaterialUpdate = false;
 	}
@@ -877,26 +973,46 @@ namespace ldp
 	{
 		m_shouldSparseStructureUpdate = true;
 		updateDependency();
-		// compute sparse structure via sorting---------------------------------
 		const int nVerts = m_x_init_h.size();
 		const int nFaces = m_faces_idxWorld_h.size();
 
-		// collect one-ring face list of each vertex
+		// a known topology just uploads the cached structure, no sorting is needed
+		m_topologyFingerprint = TopologyFingerprint::compute(nVerts, m_faces_idxWorld_h, m_edgeData_h,
+			m_stitch_vertPairs_h, m_stitch_edgeData_h);
+		SparseStructureCache::EntryPtr entry = SparseStructureCache::instance().find(
+			SimulationBackendGpu, m_topologyFingerprint);
+		if (entry == nullptr || entry->nVerts != nVerts)
+		{
+			entry = buildSparseStructure();
+			SparseStructureCache::instance().insert(SimulationBackendGpu, m_topologyFingerprint, entry);
+		}
+		else
+		{
+			m_A_Ids_d.upload(entry->A_Ids);
+			m_A_Ids_d_unique.upload(entry->A_Ids_unique);
+			m_A_Ids_d_unique_pos.upload(entry->A_Ids_unique_pos);
+			m_A_Ids_start_d.upload(entry->A_Ids_start);
+			m_A_order_d.upload(entry->A_order);
+			m_A_invOrder_d.upload(entry->A_invOrder);
+			m_b_Ids_d.upload(entry->b_Ids);
+			m_b_Ids_d_unique.upload(entry->b_Ids_unique);
+			m_b_Ids_d_unique_pos.upload(entry->b_Ids_unique_pos);
+			m_b_Ids_start_d.upload(entry->b_Ids_start);
+			m_b_order_d.upload(entry->b_order);
+			m_b_invOrder_d.upload(entry->b_invOrder);
+		}
+		m_beforScan_A.create(m_A_order_d.size());
+		m_beforScan_b.create(m_b_order_d.size());
+
+		// one-ring face list of each vertex
 		if (nVerts > 0 && nFaces > 0)
 		{
-			std::vector<Int2> vert_face_pair_h;
-			for (size_t i = 0; i < m_faces_idxWorld_h.size(); i++)
-			for (int k = 0; k < 3; k++)
-				vert_face_pair_h.push_back(Int2(m_faces_idxWorld_h[i][k], i));
-			std::sort(vert_face_pair_h.begin(), vert_face_pair_h.end());
-			vert_face_pair_h.resize(std::unique(vert_face_pair_h.begin(),
-				vert_face_pair_h.end()) - vert_face_pair_h.begin());
-			std::vector<int> vert_face_pair_v_h(vert_face_pair_h.size(), 0);
-			std::vector<int> vert_face_pair_f_h(vert_face_pair_h.size(), 0);
-			for (size_t i = 0; i < vert_face_pair_h.size(); i++)
+			std::vector<int> vert_face_pair_v_h(entry->vertFacePairs.size(), 0);
+			std::vector<int> vert_face_pair_f_h(entry->vertFacePairs.size(), 0);
+			for (size_t i = 0; i < entry->vertFacePairs.size(); i++)
 			{
-				vert_face_pair_v_h[i] = vert_face_pair_h[i][0];
-				vert_face_pair_f_h[i] = vert_face_pair_h[i][1];
+				vert_face_pair_v_h[i] = entry->vertFacePairs[i][0];
+				vert_face_pair_f_h[i] = entry->vertFacePairs[i][1];
 			}
 			CachedDeviceArray<int> vert_face_pair_v_d;
 			vert_face_pair_v_d.fromHost(vert_face_pair_v_h);
@@ -907,12 +1023,49 @@ namespace ldp
 			cudaSafeCall(cudaThreadSynchronize());
 		} // end collect one-ring face list of each vertex
 
+		// ---------------------------------------------------------------------------------------------
+		// build the sparse matrix via coo
+		const int nUniqueNnz = (int)entry->A_blocks.size();
+		std::vector<int> booRow_h(nUniqueNnz), booCol_h(nUniqueNnz);
+		for (int i = 0; i < nUniqueNnz; i++)
+		{
+			booRow_h[i] = entry->A_blocks[i][0];
+			booCol_h[i] = entry->A_blocks[i][1];
+		}
+		CachedDeviceArray<int> booRow, booCol;
+		booRow.fromHost(booRow_h);
+		booCol.fromHost(booCol_h);
+		m_A_d->resize(nVerts, nVerts, 3);
+		m_A_d->setRowFromBooRowPtr(booRow.data(), nUniqueNnz);
+		cudaSafeCall(cudaMemcpy(m_A_d->bsrColIdx(), booCol.data(), nUniqueNnz*sizeof(int), cudaMemcpyDeviceToDevice));
+		cudaSafeCall(cudaMemset(m_A_d->value(), 0, m_A_d->nnz()*sizeof(float)));
+		m_A_diag_d->resize(m_A_d->blocksInRow(), m_A_d->rowsPerBlock());
+
+		m_shouldSparseStructureUpdate = false;
+	}
+
+	SparseStructureCache::EntryPtr GpuSim::buildSparseStructure()
+	{
+		// compute sparse structure via sorting---------------------------------
+		const int nVerts = m_x_init_h.size();
+		std::shared_ptr<SparseStructureCache::Entry> entry(new SparseStructureCache::Entry());
+		entry->nVerts = nVerts;
+
+		// collect one-ring face list of each vertex
+		std::vector<Int2>& vert_face_pair_h = entry->vertFacePairs;
+		for (size_t i = 0; i < m_faces_idxWorld_h.size(); i++)
+		for (int k = 0; k < 3; k++)
+			vert_face_pair_h.push_back(Int2(m_faces_idxWorld_h[i][k], i));
+		std::sort(vert_face_pair_h.begin(), vert_face_pair_h.end());
+		vert_face_pair_h.resize(std::unique(vert_face_pair_h.begin(),
+			vert_face_pair_h.end()) - vert_face_pair_h.begin());
+
 		// ---------------------------------------------------------------------------------------------
 		// collect face adjacents
 		std::vector<size_t> A_Ids_h;
-		std::vector<int> A_Ids_start_h;
+		std::vector<int>& A_Ids_start_h = entry->A_Ids_start;
 		std::vector<int> b_Ids_h;
-		std::vector<int> b_Ids_start_h;
+		std::vector<int>& b_Ids_start_h = entry->b_Ids_start;
 		for (const auto& f : m_faces_idxWorld_h)
 		{
 			A_Ids_start_h.push_back(A_Ids_h.size());
@@ -992,7 +1145,6 @@ namespace ldp
 		m_A_Ids_d.copyTo(m_A_Ids_d_unique);
 		auto nUniqueNnz = thrust_wrapper::unique_by_key(m_A_Ids_d_unique.ptr(), 
 			m_A_Ids_d_unique_pos.ptr(), m_A_Ids_d_unique.size());
-		m_beforScan_A.create(m_A_order_d.size());
 
 		// rhs b
 		m_b_Ids_d.upload(b_Ids_h);
@@ -1009,22 +1161,24 @@ namespace ldp
 		m_b_Ids_d.copyTo(m_b_Ids_d_unique);
 		auto nUniqueb = thrust_wrapper::unique_by_key(m_b_Ids_d_unique.ptr(),
 			m_b_Ids_d_unique_pos.ptr(), m_b_Ids_d_unique.size());
-		m_beforScan_b.create(m_b_order_d.size());
 		release_assert(nUniqueb == nVerts);
 
 		// ---------------------------------------------------------------------------------------------
-		// convert vertex-pair idx to coo array
-		CachedDeviceArray<int> booRow(nUniqueNnz), booCol(nUniqueNnz);
-		vertPair_from_idx(booRow.data(), booCol.data(), m_A_Ids_d_unique.ptr(), nVerts, nUniqueNnz);
-
-		// build the sparse matrix via coo
-		m_A_d->resize(nVerts, nVerts, 3);
-		m_A_d->setRowFromBooRowPtr(booRow.data(), nUniqueNnz);
-		cudaSafeCall(cudaMemcpy(m_A_d->bsrColIdx(), booCol.data(), nUniqueNnz*sizeof(int), cudaMemcpyDeviceToDevice));
-		cudaSafeCall(cudaMemset(m_A_d->value(), 0, m_A_d->nnz()*sizeof(float)));
-		m_A_diag_d->resize(m_A_d->blocksInRow(), m_A_d->rowsPerBlock());
-
-		m_shouldSparseStructureUpdate = false;
+		// keep host copies for the cache
+		m_A_Ids_d.download(entry->A_Ids);
+		m_A_Ids_d_unique.download(entry->A_Ids_unique);
+		m_A_Ids_d_unique_pos.download(entry->A_Ids_unique_pos);
+		m_A_order_d.download(entry->A_order);
+		m_A_invOrder_d.download(entry->A_invOrder);
+		m_b_Ids_d.download(entry->b_Ids);
+		m_b_Ids_d_unique.download(entry->b_Ids_unique);
+		m_b_Ids_d_unique_pos.download(entry->b_Ids_unique_pos);
+		m_b_order_d.download(entry->b_order);
+		m_b_invOrder_d.download(entry->b_invOrder);
+		entry->A_blocks.resize(nUniqueNnz);
+		for (size_t i = 0; i < entry->A_blocks.size(); i++)
+			entry->A_blocks[i] = ldp::vertPair_from_idx(entry->A_Ids_unique[i], nVerts);
+		return entry;
 	}
 #pragma endregion
 
@@ -1076,9 +1230,79 @@ namespace ldp
 #pragma endregion
 
 #pragma region --solving
+	void GpuSim::initPcgGuess()
+	{
+		const int nVal = m_dv_d.size() * 3;
+		if (m_last_dv_d.size() != m_dv_d.size())
+			m_last_dv_d.create(m_dv_d.size());
+		switch (m_simParam.pcg_warm_start)
+		{
+		case PcgWarmStartLast:
+			// m_dv_d still holds the last dv
+			m_dv_d.copyTo(m_last_dv_d);
+			break;
+		case PcgWarmStartExtrapolate:
+		{
+			// dv = 2*dv[n-1] - dv[n-2], then dv[n-2] = dv[n-1]
+			const float const_two = 2.f;
+			const float const_one_neg = -1.f;
+			CachedDeviceArray<float> tmp(nVal);
+			cudaSafeCall(cudaMemcpy(tmp.data(), m_dv_d.ptr(), tmp.bytes(), cudaMemcpyDeviceToDevice));
+			cublasCheck(cublasSetPointerMode_v2(m_cublasHandle, CUBLAS_POINTER_MODE_HOST));
+			cublasCheck(cublasSscal_v2(m_cublasHandle, nVal, &const_two, (float*)m_dv_d.ptr(), 1));
+			cublasCheck(cublasSaxpy_v2(m_cublasHandle, nVal, &const_one_neg, (const float*)m_last_dv_d.ptr(), 1,
+				(float*)m_dv_d.ptr(), 1));
+			cudaSafeCall(cudaMemcpy(m_last_dv_d.ptr(), tmp.data(), tmp.bytes(), cudaMemcpyDeviceToDevice));
+			break;
+		}
+		default:
+			m_dv_d.create(m_dv_d.size());
+			break;
+		}
+	}
+
+	std::string GpuSim::pcgWarmStartInfo(int iter, float err, float err0)
+	{
+		// pcg reduces the residual by a nearly constant rate, estimated from this solve;
+		// starting from zero (err0 = 1), about iter*log(err)/log(err/err0) iterations would be needed.
+		int saved = 0;
+		if (iter > 0 && err > 0.f && err0 > 0.f && err != err0)
+			saved = int(iter * log(err0) / log(err / err0));
+		char info[64];
+		sprintf(info, ", warm r0 %.1e, saved ~%d", err0, saved);
+		return info;
+	}
+
 	void GpuSim::linearSolve()
 	{
-#ifndef SOLVE_USE_EIGEN
+#if defined(SOLVE_USE_HOST_PCG)
+		// download A, b and the initial dv, then solve with the host block-jacobi pcg
+		std::vector<int> A_rowPtr(m_A_d->blocksInRow() + 1), A_colIdx(m_A_d->nnzBlocks());
+		cudaSafeCall(cudaMemcpy(A_rowPtr.data(), m_A_d->bsrRowPtr(), A_rowPtr.size()*sizeof(int),
+			cudaMemcpyDeviceToHost));
+		cudaSafeCall(cudaMemcpy(A_colIdx.data(), m_A_d->bsrColIdx(), A_colIdx.size()*sizeof(int),
+			cudaMemcpyDeviceToHost));
+		m_A_h.resize(m_A_d->blocksInRow(), m_A_d->blocksInCol());
+		m_A_h.setStructure(A_rowPtr.data(), A_colIdx.data());
+		cudaSafeCall(cudaMemcpy(m_A_h.value(), m_A_d->value(), m_A_d->nnz()*sizeof(float),
+			cudaMemcpyDeviceToHost));
+
+		std::vector<ldp::Float3> bvec, dvvec;
+		m_b_d.download(bvec);
+		m_dv_d.download(dvvec);
+
+		float err = 0.f, err0 = 0.f;
+		const int iter = m_A_h.pcg((const float*)bvec.data(), (float*)dvvec.data(),
+			m_simParam.pcg_iter, m_simParam.pcg_tol, &err, &err0);
+		m_dv_d.upload(dvvec);
+		m_lastSolveErr = err;
+		m_profiler.addCounter("pcg_iter", iter);
+		m_profiler.addCounter("transfer_bytes", double(m_A_d->nnz()*sizeof(float) + (A_rowPtr.size()
+			+ A_colIdx.size())*sizeof(int) + (bvec.size() + dvvec.size() * 2)*sizeof(Float3)));
+		m_solverInfo += std::string("pcg, iter ") + std::to_string(iter) + ", err " + std::to_string(err);
+		if (m_simParam.pcg_warm_start != PcgWarmStartZero)
+			m_solverInfo += pcgWarmStartInfo(iter, err, err0);
+#elif !defined(SOLVE_USE_EIGEN)
 		const int nPoint = m_x_d.size();
 		const int nVal = nPoint * 3;
 		const float const_one = 1.f;
@@ -1097,6 +1321,7 @@ namespace ldp
 		float norm_b = 0.f;
 		cublasCheck(cublasSetPointerMode_v2(m_cublasHandle, CUBLAS_POINTER_MODE_HOST));
 		cublasSnrm2_v2(m_cublasHandle, nVal, (float*)m_b_d.ptr(), 1, &norm_b);
+		m_lastSolveErr = 0.f;
 		if (norm_b == 0.f)
 			return;
 
@@ -1107,6 +1332,15 @@ namespace ldp
 		cudaSafeCall(cudaMemcpy(r.data(), m_b_d.ptr(), r.bytes(), cudaMemcpyDeviceToDevice));
 		m_A_d->Mv((float*)m_dv_d.ptr(), r.data(), -1.f, 1.f);
 
+		// the relative residual of the warm started guess
+		float err0 = 1.f;
+		if (m_simParam.pcg_warm_start != PcgWarmStartZero)
+		{
+			float norm_r = 0.f;
+			cublasSnrm2_v2(m_cublasHandle, nVal, r.data(), 1, &norm_r);
+			err0 = norm_r / (norm_b + 1e-15f);
+		}
+
 		int iter = 0;
 		float err = 0.f;
 		for (iter = 0; iter<m_simParam.pcg_iter; iter++)
@@ -1143,11 +1377,14 @@ namespace ldp
 					break;
 			}
 		} // end for iter
+		m_lastSolveErr = err;
+		m_profiler.addCounter("pcg_iter", iter);
 		m_solverInfo += std::string("pcg, iter ") + std::to_string(iter) + ", err " + std::to_string(err);
+		if (m_simParam.pcg_warm_start != PcgWarmStartZero)
+			m_solverInfo += pcgWarmStartInfo(iter, err, err0);
 #else
 		SpMat A;
 		cudaSpMat_to_EigenMat(*m_A_d, A);
-		Eigen::SimplicialCholesky<SpMat> solver(A);
 		
 		std::vector<ldp::Float3> bvec;
 		m_b_d.download(bvec);
@@ -1157,7 +1394,18 @@ namespace ldp
 		for (int k = 0; k < 3; k++)
 			b[i * 3 + k] = bvec[i][k];
 		
-		EgVec dv = solver.solve(b);
+		// the symbolic factorization is kept until the sparse structure changes
+		EgVec dv;
+		m_A_solver->setFactorReuseTolerance(m_simParam.factor_reuse_tol);
+		m_A_solver->setPcgParam(20, m_simParam.pcg_tol);
+		m_lastSolveErr = 0.f;
+		if (!m_A_solver->solve(A, b, dv))
+		{
+			printf("warning: GpuSim::linearSolve(), %s\n", m_A_solver->getInfo().c_str());
+			dv.setZero(b.size());
+			m_lastSolveErr = 1.f;
+		}
+		m_solverInfo += m_A_solver->getInfo();
 
 		std::vector<ldp::Float3> dvvec(dv.size() / 3);
 		for (int i = 0; i < dvvec.size(); i++)
@@ -1165,12 +1413,43 @@ namespace ldp
 			dvvec[i][k] = dv[i * 3 + k];
 
 		m_dv_d.upload(dvvec);
+		m_profiler.addCounter("transfer_bytes", double(m_A_d->nnz()*sizeof(float) + (m_A_d->blocksInRow() + 1
+			+ m_A_d->nnzBlocks())*sizeof(int) + (bvec.size() + dvvec.size())*sizeof(Float3)));
 #endif
 		update_x_v_by_dv();
 		cudaSafeCall(cudaThreadSynchronize());
 	}
 #pragma endregion
 
+#pragma region -- equilibrium
+	void GpuSim::updateEquilibrium()
+	{
+		const int nVerts = (int)m_x_h.size();
+		const bool valid = (int)m_last_x_h.size() == nVerts && (int)m_vert_mass_h.size() == nVerts;
+		EquilibriumMonitor::Sample s;
+		s.residual = m_lastSolveErr;
+		if (valid)
+		{
+			// v = (x - last_x) / dt
+			float sumMass = 0.f, sumKe = 0.f, maxDisp2 = 0.f;
+			for (int i = 0; i < nVerts; i++)
+			{
+				const float d2 = (m_x_h[i] - m_last_x_h[i]).sqrLength();
+				maxDisp2 = std::max(maxDisp2, d2);
+				sumKe += 0.5f * m_vert_mass_h[i] * d2;
+				sumMass += m_vert_mass_h[i];
+			}
+			s.kineticEnergy = sumKe / (m_simParam.dt * m_simParam.dt) / std::max(sumMass, 1e-12f);
+			s.maxDisplacement = sqrt(maxDisp2);
+		}
+		m_last_x_h = m_x_h;
+
+		// during stitching, the cloth is not allowed to settle
+		m_equilibrium.push(s, valid && m_curStitchRatio == 0.f);
+		m_solverInfo += ", " + m_equilibrium.getInfo();
+	}
+#pragma endregion
+
 #pragma region -- exportmesh
 	void GpuSim::exportResultClothToObjMesh()
 	{
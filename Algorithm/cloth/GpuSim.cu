@@ -893,11 +893,22 @@ namespace ldp
 		cudaSafeCall(cudaGetLastError()); 
 
 		// add body-cloth force term using level set
-		linearBodyCollision(); 
+		{
+			SimulationProfiler::ScopedTimer timer(m_profiler, "linearBodyCollision");
+			linearBodyCollision();
+			if (m_profiler.isEnabled())
+				cudaSafeCall(cudaThreadSynchronize());
+		}
 
 		// add cloth-cloth force term using uniform grid
 		if (m_simParam.enable_selfCollision)
+		{
+			SimulationProfiler::ScopedTimer timer(m_profiler, "linearSelfCollision");
 			linearSelfCollision();
+			if (m_profiler.isEnabled())
+				cudaSafeCall(cudaThreadSynchronize());
+			m_profiler.addCounter("selfColli_pairs", m_nPairs);
+		}
 	}
 #pragma endregion
 
@@ -911,16 +922,31 @@ namespace ldp
 		float lvStep = 0.f;
 		Float3 lvStart = 0.f;
 		cudaTextureObject_t lvTex = 0;
+		const BodyProxy::Primitive* proxy = nullptr;	// used instead of the level set if nProxy > 0
+		int nProxy = 0;
 		__device__ inline float violation(const float value)const { return ::max(-value, 0.f); }
 		__device__ inline float value(Float3 p)const
 		{
+			if (nProxy)
+			{
+				float v = 0.f;
+				Float3 g;
+				BodyProxy::sample(proxy, nProxy, p, v, g);
+				return v - repulsion_thickness;
+			}
 			const Float3 t = (p - lvStart) / lvStep + 0.5f;
 			return Level_Set_Depth(lvTex, t[0], t[1], t[2], repulsion_thickness / lvStep)*lvStep;
 		}
 		__device__ inline Float3 gradient(Float3 p)const
 		{
-			const Float3 t = (p - lvStart) / lvStep + 0.5f;
 			Float3 g;
+			if (nProxy)
+			{
+				float v = 0.f;
+				BodyProxy::sample(proxy, nProxy, p, v, g);
+				return g;
+			}
+			const Float3 t = (p - lvStart) / lvStep + 0.5f;
 			Level_Set_Gradient(lvTex, t[0], t[1], t[2], g[0], g[1], g[2]);
 			return g;
 		}
@@ -1059,6 +1085,8 @@ namespace ldp
 		con.lvTex = m_bodyLvSet_d.getCudaTexture();
 		con.lvStep = m_bodyLvSet_h->getStep();
 		con.lvStart = m_bodyLvSet_h->getStartPos();
+		con.proxy = m_bodyProxy_d.ptr();
+		con.nProxy = (int)m_bodyProxy_d.size();
 		con.projection_thickness = m_simParam.projection_thickness;
 		con.repulsion_thickness = m_simParam.repulsion_thickness;
 		con.collision_stiffness = m_simParam.collision_stiffness;
@@ -7,6 +7,10 @@
 #include "ldpMat\ldp_basic_mat.h"
 #include "cudpp\Cuda3DArray.h"
 #include "cudpp\Cuda2DArray.h"
+#include "AbstractClothSimulator.h"
+#include "BsrMatrix3.h"
+#include "EquilibriumMonitor.h"
+#include "BodyProxy.h"
 #include <cublas.h>
 namespace arcsim
 {
@@ -23,6 +27,7 @@ namespace ldp
 	class BMEdge;
 	class BMFace;
 	class MaterialCache;
+	class PersistentSparseSolver;
 	__device__ __host__ inline size_t vertPair_to_idx(ldp::Int2 v, int n)
 	{
 		return size_t(v[0]) * size_t(n) + size_t(v[1]);
@@ -31,7 +36,7 @@ namespace ldp
 	{
 		return ldp::Int2(int(idx / n), int(idx%n));
 	}
-	class GpuSim
+	class GpuSim : public AbstractClothSimulator
 	{
 	public:
 		//		 c
@@ -76,6 +81,8 @@ namespace ldp
 			Float3 gravity;
 			int pcg_iter = 0;			// iteration of pcg solvers
 			float pcg_tol = 0.f;		// tolerance of pcg method
+			PcgWarmStart pcg_warm_start = PcgWarmStartZero;
+			float factor_reuse_tol = 0.f;	// for direct solvers, reuse the last factor if A changed less than this, 0 to disable
 			float stitch_ratio = 0.f;	// for stitching edges length reduction, L -= ratio * dt
 			float strecth_mult = 0.f;
 			float bend_mult = 0.f;
@@ -94,6 +101,7 @@ namespace ldp
 	public:
 		GpuSim();
 		~GpuSim();
+		SimulationBackend backend()const{ return SimulationBackendGpu; }
 
 		void clear();
 		void init(ClothManager* clothManager);
@@ -104,11 +112,19 @@ namespace ldp
 		void updateTopology();
 		void updateStitch();
 		void updateMaterial();
+		void updateBodyCollider();
 		void setFixPositions(int nFixed, const int* ids, const Float3* targets);
 	public:
 		float getFps()const{ return m_fps; }
 		float getStepTime()const{ return m_simParam.dt; }
 		std::string getSolverInfo()const{ return m_solverInfo; }
+		TopologyFingerprint::ValueType getTopologyFingerprint()const{ return m_topologyFingerprint; }
+		EquilibriumMonitor& getEquilibriumMonitor(){ return m_equilibrium; }
+		const EquilibriumMonitor& getEquilibriumMonitor()const{ return m_equilibrium; }
+		SimulationProfiler& getProfiler(){ return m_profiler; }
+		const SimulationProfiler& getProfiler()const{ return m_profiler; }
+		// report of a warm started pcg solve: the initial residual err0 and the estimated iterations saved
+		static std::string pcgWarmStartInfo(int iter, float err, float err0);
 		ObjMesh& getResultClothMesh();
 		void getResultClothPieces();	//only valid for cloth manager init.
 		const std::vector<Float2>& getVertTexCoords()const{ return m_texCoord_init_h; }
@@ -118,6 +134,8 @@ namespace ldp
 		const std::vector<int>& getVertMergeIdxMap()const{ return m_vertMerge_in_out_idxMap_h; }
 		void setCurrentVertPositions(const std::vector<Float3>& X);
 		void setInitVertPositions(const std::vector<Float3>& X);
+		void getCheckpoint(SimulationCheckpoint& cp);
+		void setCheckpoint(const SimulationCheckpoint& cp);
 	protected:
 		// update the whole system based on the current changes
 		void updateSystem();
@@ -141,12 +159,14 @@ namespace ldp
 
 		// sparse system setup
 		void setup_sparse_structure();
+		SparseStructureCache::EntryPtr buildSparseStructure();
 
 		// material
 		void updateMaterialDataToFaceNode();
 
 		// solving related
 		void updateNumeric();
+		void initPcgGuess();
 		void linearSolve();
 		void linearBodyCollision();
 		void linearSelfCollision();
@@ -154,6 +174,9 @@ namespace ldp
 		void update_x_v_by_dv();
 		void project_outside();
 
+		// equilibrium detection, after each step
+		void updateEquilibrium();
+
 		// exporting related
 		void exportResultClothToObjMesh();
 	protected:
@@ -169,8 +192,10 @@ namespace ldp
 		float m_curSimulationTime = 0.f;
 		float m_curStitchRatio = 0.f;
 		std::string m_solverInfo;
+		SimulationProfiler m_profiler;
 		ldp::LevelSet3D* m_bodyLvSet_h = nullptr;
 		Cuda3DArray<float> m_bodyLvSet_d;
+		DeviceArray<BodyProxy::Primitive> m_bodyProxy_d;	// used instead of the level set if not empty
 		std::shared_ptr<ObjMesh> m_resultClothMesh;
 
 		bool m_shouldTopologyUpdate = false;
@@ -205,6 +230,7 @@ namespace ldp
 		DeviceArray<EdgeData> m_stitch_edgeData_d;
 		std::shared_ptr<MaterialCache> m_materials;
 		///////////////// precomputed data /////////////////////////////////////////////////////////////	
+		TopologyFingerprint::ValueType m_topologyFingerprint = 0;
 		DeviceArray<size_t> m_A_Ids_d;			// for sparse matrix, encode the (row, col) pairs, sorted
 		DeviceArray<size_t> m_A_Ids_d_unique;
 		DeviceArray<int> m_A_Ids_d_unique_pos;	// the array position kept after unique
@@ -222,6 +248,8 @@ namespace ldp
 		///////////////// solve for the simulation linear system: A*dv=b////////////////////////////////
 		std::shared_ptr<CudaBsrMatrix> m_A_d;
 		std::shared_ptr<CudaDiagBlockMatrix> m_A_diag_d;
+		BsrMatrix3 m_A_h;										// host copy of m_A_d, for SOLVE_USE_HOST_PCG
+		std::shared_ptr<PersistentSparseSolver> m_A_solver;		// for SOLVE_USE_EIGEN
 		DeviceArray<ldp::Float3> m_b_d;
 		std::vector<ldp::Float2> m_texCoord_init_h;				// material (tex) space vertex texCoord							
 		DeviceArray<ldp::Float2> m_texCoord_init_d;				// material (tex) space vertex texCoord	
@@ -233,6 +261,11 @@ namespace ldp
 		DeviceArray<ldp::Float3> m_v_d;							// velocity of current step
 		DeviceArray<ldp::Float3> m_last_v_d;					// velocity of last step	
 		DeviceArray<ldp::Float3> m_dv_d;						// velocity changed in this step
+		DeviceArray<ldp::Float3> m_last_dv_d;					// velocity changed in the last step, for pcg warm start
+		std::vector<ldp::Float3> m_last_x_h;					// position of last step, for equilibrium detection
+		std::vector<float> m_vert_mass_h;
+		float m_lastSolveErr = 0.f;								// relative residual of the last linear solve
+		EquilibriumMonitor m_equilibrium;
 		DeviceArray<ldp::Float4> m_project_vw_d;
 		std::vector<ldp::Float4> m_fixPosition_vw_h;
 		DeviceArray<ldp::Float4> m_fixPosition_vw_d;
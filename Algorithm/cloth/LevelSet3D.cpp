@@ -1,12 +1,20 @@
 #include "LevelSet3D.h"
+#include "MappedFile.h"
 #include <fstream>
+#include <cstring>
 #include "Renderable\ObjMesh.h"
 #include "PROGRESSING_BAR.h"
+#include "ldpMat\ldpdef.h"
+#include "ldpMat\half.hpp"
+#include <omp.h>
+#include <xmmintrin.h>      // __m128 data type and SSE functions
 namespace ldp
 {
 #pragma region --utils
 //#define EXPORT_WANG_HUAMING_FORMAT
 //#define IMPORT_WANG_HUAMING_FORMAT
+	// run both the serial and parallel fromMesh, compare the results and report the speedup
+//#define CHECK_PARALLEL_FROM_MESH
 	// Differencing schemes
 #define UPWIND_DIFFERENCING		0
 #define CENTRAL_DIFFERENCING	1
@@ -17,6 +25,8 @@ namespace ldp
 #define UNPROCESSED				0
 #define PROCESSING				1
 #define PROCESSED				2
+	// Tile width of the parallel fast sweeping
+#define SWEEP_TILE				8
 #define FOR_EVERY_CELL		\
 	for (int i = 0, id = 0; i<m_size[0]; i++)	\
 	for (int j = 0; j<m_size[1]; j++)			\
@@ -87,11 +97,43 @@ namespace ldp
 		ValueType c = SQR(theta1) + SQR(theta2) + SQR(theta3) - 1;
 		return (-b + sign*sqrt(b*b - 4 * a*c)) / (2 * a);
 	}
+
+	// the Godunov upwind solution of |grad u| = 1, given the smaller neighbor value of each axis
+	inline ValueType Eikonal_Update(ValueType a, ValueType b, ValueType c)
+	{
+		if (a > b) std::swap(a, b);
+		if (b > c) std::swap(b, c);
+		if (a > b) std::swap(a, b);
+		ValueType u = a + 1;
+		if (u > b)
+		{
+			u = (a + b + sqrt(Max(ValueType(2) - SQR(a - b), ValueType(0)))) / 2;
+			if (u > c)
+			{
+				const ValueType s = a + b + c;
+				u = (s + sqrt(Max(s*s - 3 * (a*a + b*b + c*c - 1), ValueType(0)))) / 3;
+			}
+		}
+		return u;
+	}
+
+	// the smaller magnitude along an axis, and the signed value of the nearest neighbor
+	inline void Sweep_Neighbor(ValueType q, ValueType& axis, ValueType& nearest)
+	{
+		const ValueType aq = fabsf(q);
+		if (aq < axis) axis = aq;
+		if (aq < fabsf(nearest)) nearest = q;
+	}
 #pragma endregion
 
 	LevelSet3D::LevelSet3D()
 	{
 		m_step = ValueType(0);
+		m_size = ldp::Int3(0);
+		m_tileSize = ldp::Int3(0);
+		m_tileBand = ValueType(0);
+		m_mappedTiles = nullptr;
+		m_nMappedTiles = 0;
 	}
 
 	LevelSet3D::~LevelSet3D()
@@ -102,6 +144,14 @@ namespace ldp
 	void LevelSet3D::clear()
 	{
 		m_value.clear();
+		m_tileSize = ldp::Int3(0);
+		m_tileBand = ValueType(0);
+		m_tileOffset.clear();
+		m_tileFar.clear();
+		m_tileValues.clear();
+		m_mappedFile.reset();
+		m_mappedTiles = nullptr;
+		m_nMappedTiles = 0;
 		m_step = ValueType(0);
 		m_size = ldp::Int3(0);
 		m_start = Vec3(0);
@@ -121,34 +171,347 @@ namespace ldp
 		m_start = start;
 	}
 
-	void LevelSet3D::fromMesh(const ObjMesh& mesh)
+#pragma region --tiles
+	void LevelSet3D::toTiled(ValueType band)
+	{
+		if (isTiled() || m_value.empty())
+			return;
+		for (int k = 0; k < 3; k++)
+			m_tileSize[k] = (m_size[k] + TILE_SIZE - 1) / TILE_SIZE;
+		const int nTiles = m_tileSize[0] * m_tileSize[1] * m_tileSize[2];
+		m_tileBand = band;
+		m_tileOffset.assign(nTiles, -1);
+		m_tileFar.assign(nTiles, ValueType(0));
+
+		// find the band tiles, and the value nearest to the surface of the others
+#pragma omp parallel for
+		for (int t = 0; t < nTiles; t++)
+		{
+			const int tx = t / (m_tileSize[1] * m_tileSize[2]);
+			const int ty = (t / m_tileSize[2]) % m_tileSize[1];
+			const int tz = t % m_tileSize[2];
+			ValueType nearest = ValueType(MY_INFINITE);
+			for (int x = tx*TILE_SIZE; x < Min((tx + 1)*TILE_SIZE, m_size[0]); x++)
+			for (int y = ty*TILE_SIZE; y < Min((ty + 1)*TILE_SIZE, m_size[1]); y++)
+			for (int z = tz*TILE_SIZE; z < Min((tz + 1)*TILE_SIZE, m_size[2]); z++)
+			{
+				const ValueType v = m_value[index(x, y, z)];
+				if (fabs(v) < fabs(nearest))
+					nearest = v;
+			}
+			m_tileFar[t] = nearest;
+			if (fabs(nearest) < band)
+				m_tileOffset[t] = 0;
+		} // end for t
+
+		int nAllocated = 0;
+		for (int t = 0; t < nTiles; t++)
+		if (m_tileOffset[t] == 0)
+			m_tileOffset[t] = TILE_CELLS * nAllocated++;
+		m_tileValues.resize(TILE_CELLS * nAllocated);
+
+		// the cells out of the grid are padded with the far value
+#pragma omp parallel for
+		for (int t = 0; t < nTiles; t++)
+		{
+			if (m_tileOffset[t] < 0)
+				continue;
+			const int tx = t / (m_tileSize[1] * m_tileSize[2]);
+			const int ty = (t / m_tileSize[2]) % m_tileSize[1];
+			const int tz = t % m_tileSize[2];
+			ValueType* dst = m_tileValues.data() + m_tileOffset[t];
+			for (int x = 0; x < TILE_SIZE; x++)
+			for (int y = 0; y < TILE_SIZE; y++)
+			for (int z = 0; z < TILE_SIZE; z++, dst++)
+			{
+				const int gx = tx*TILE_SIZE + x, gy = ty*TILE_SIZE + y, gz = tz*TILE_SIZE + z;
+				if (gx < m_size[0] && gy < m_size[1] && gz < m_size[2])
+					*dst = m_value[index(gx, gy, gz)];
+				else
+					*dst = m_tileFar[t];
+			}
+		} // end for t
+		std::vector<ValueType>().swap(m_value);
+	}
+
+	void LevelSet3D::createTiled(ldp::Int3 sz, Vec3 start, ValueType step, ValueType band, const int* tileOffsets,
+		const ValueType* tileFarValues, const ValueType* tileValues, int nAllocatedTiles)
+	{
+		setTileLayout(sz, start, step, band, tileOffsets, tileFarValues, nAllocatedTiles);
+		m_tileValues.assign(tileValues, tileValues + nAllocatedTiles * TILE_CELLS);
+	}
+
+	void LevelSet3D::setTileLayout(ldp::Int3 sz, Vec3 start, ValueType step, ValueType band, const int* tileOffsets,
+		const ValueType* tileFarValues, int nAllocatedTiles)
+	{
+		clear();
+		m_size = sz;
+		m_start = start;
+		m_step = step;
+		m_tileBand = band;
+		for (int k = 0; k < 3; k++)
+			m_tileSize[k] = (m_size[k] + TILE_SIZE - 1) / TILE_SIZE;
+		const int nTiles = m_tileSize[0] * m_tileSize[1] * m_tileSize[2];
+		for (int t = 0; t < nTiles; t++)
+		if (tileOffsets[t] >= nAllocatedTiles * TILE_CELLS || (tileOffsets[t] >= 0 && tileOffsets[t] % TILE_CELLS != 0))
+			throw std::exception("LevelSet3D: invalid tile offset");
+		m_tileOffset.assign(tileOffsets, tileOffsets + nTiles);
+		m_tileFar.assign(tileFarValues, tileFarValues + nTiles);
+	}
+
+	void LevelSet3D::toDense()
+	{
+		if (!isTiled())
+			return;
+		std::vector<ValueType> dense(sizeXYZ());
+		const LevelSet3D& self = *this;
+#pragma omp parallel for
+		for (int x = 0; x < m_size[0]; x++)
+		for (int y = 0; y < m_size[1]; y++)
+		for (int z = 0; z < m_size[2]; z++)
+			dense[index(x, y, z)] = self.value(x, y, z)[0];
+		m_tileSize = ldp::Int3(0);
+		std::vector<int>().swap(m_tileOffset);
+		std::vector<ValueType>().swap(m_tileFar);
+		std::vector<ValueType>().swap(m_tileValues);
+		m_mappedFile.reset();
+		m_mappedTiles = nullptr;
+		m_nMappedTiles = 0;
+		m_value.swap(dense);
+	}
+
+	void LevelSet3D::allocateTile(int t)
+	{
+		// copy on write of the mapped tiles
+		if (isMapped())
+		{
+			m_tileValues.assign(m_mappedTiles, m_mappedTiles + m_nMappedTiles * TILE_CELLS);
+			m_mappedFile.reset();
+			m_mappedTiles = nullptr;
+			m_nMappedTiles = 0;
+		}
+		if (m_tileOffset[t] >= 0)
+			return;
+		m_tileOffset[t] = (int)m_tileValues.size();
+		m_tileValues.resize(m_tileValues.size() + TILE_CELLS, m_tileFar[t]);
+	}
+
+	size_t LevelSet3D::memoryBytes()const
+	{
+		return (m_value.size() + m_tileFar.size() + m_tileValues.size() + m_nMappedTiles * TILE_CELLS) * sizeof(ValueType)
+			+ m_tileOffset.size() * sizeof(int);
+	}
+#pragma endregion
+
+#pragma region -- sampling
+	void LevelSet3D::globalSampleMany(const Vec3* p, int n, ValueType* values, Vec3* grads)const
+	{
+		// small batches are not worth the thread startup
+		const int nGroups = n / 4;
+		const int nThreads = n >= 4096 ? omp_get_max_threads() : 1;
+#pragma omp parallel for num_threads(nThreads)
+		for (int g = 0; g < nGroups; g++)
+			globalSampleFour(p + g * 4, values ? values + g * 4 : nullptr, grads ? grads + g * 4 : nullptr);
+		for (int i = nGroups * 4; i < n; i++)
+			globalSample(p[i], values ? values + i : nullptr, grads ? grads + i : nullptr);
+	}
+
+	void LevelSet3D::globalSampleFour(const Vec3* p, ValueType* values, Vec3* grads)const
+	{
+		// the local coordinates and the range of localSample(), one sse register for each axis
+		__m128 x[3];
+		__m128 valid = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+		for (int k = 0; k < 3; k++)
+		{
+			x[k] = _mm_div_ps(_mm_sub_ps(_mm_setr_ps(p[0][k], p[1][k], p[2][k], p[3][k]), _mm_set1_ps(m_start[k])),
+				_mm_set1_ps(m_step));
+			valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(x[k], _mm_set1_ps(2.f)),
+				_mm_cmple_ps(x[k], _mm_set1_ps(ValueType(m_size[k] - 3)))));
+		}
+		const int validMask = _mm_movemask_ps(valid);
+
+		// the corners of each point, transposed to a register for each corner
+		float lx[3][4], fx[3][4], corners[8][4];
+		for (int k = 0; k < 3; k++)
+			_mm_storeu_ps(lx[k], x[k]);
+		for (int l = 0; l < 4; l++)
+		{
+			if (!(validMask & (1 << l)))
+			{
+				for (int k = 0; k < 3; k++)
+					fx[k][l] = lx[k][l];
+				for (int c = 0; c < 8; c++)
+					corners[c][l] = 0.f;
+				continue;
+			}
+			const int i = std::floor(lx[0][l]), j = std::floor(lx[1][l]), k = std::floor(lx[2][l]);
+			fx[0][l] = ValueType(i);
+			fx[1][l] = ValueType(j);
+			fx[2][l] = ValueType(k);
+			ValueType v[8];
+			fetchCorners(i, j, k, v);
+			for (int c = 0; c < 8; c++)
+				corners[c][l] = v[c];
+		} // end for l
+		__m128 v[8];
+		for (int c = 0; c < 8; c++)
+			v[c] = _mm_loadu_ps(corners[c]);
+
+		// the same interpolation with localSample()
+		const __m128 one = _mm_set1_ps(1.f);
+		const __m128 a = _mm_sub_ps(x[0], _mm_loadu_ps(fx[0]));
+		const __m128 b = _mm_sub_ps(x[1], _mm_loadu_ps(fx[1]));
+		const __m128 c = _mm_sub_ps(x[2], _mm_loadu_ps(fx[2]));
+		const __m128 dz00 = _mm_sub_ps(v[1], v[0]), dz01 = _mm_sub_ps(v[3], v[2]);
+		const __m128 dz10 = _mm_sub_ps(v[5], v[4]), dz11 = _mm_sub_ps(v[7], v[6]);
+		const __m128 v00 = _mm_add_ps(v[0], _mm_mul_ps(dz00, c)), v01 = _mm_add_ps(v[2], _mm_mul_ps(dz01, c));
+		const __m128 v10 = _mm_add_ps(v[4], _mm_mul_ps(dz10, c)), v11 = _mm_add_ps(v[6], _mm_mul_ps(dz11, c));
+		const __m128 v0 = _mm_add_ps(v00, _mm_mul_ps(_mm_sub_ps(v01, v00), b));
+		const __m128 v1 = _mm_add_ps(v10, _mm_mul_ps(_mm_sub_ps(v11, v10), b));
+		if (values)
+		{
+			const __m128 val = _mm_add_ps(v0, _mm_mul_ps(_mm_sub_ps(v1, v0), a));
+			_mm_storeu_ps(values, _mm_or_ps(_mm_and_ps(valid, val),
+				_mm_andnot_ps(valid, _mm_set1_ps(ValueType(MY_INFINITE)))));
+		}
+		if (grads)
+		{
+			const __m128 a1 = _mm_sub_ps(one, a), b1 = _mm_sub_ps(one, b);
+			float g[3][4];
+			_mm_storeu_ps(g[0], _mm_and_ps(valid, _mm_sub_ps(v1, v0)));
+			_mm_storeu_ps(g[1], _mm_and_ps(valid, _mm_add_ps(_mm_mul_ps(a1, _mm_sub_ps(v01, v00)),
+				_mm_mul_ps(a, _mm_sub_ps(v11, v10)))));
+			_mm_storeu_ps(g[2], _mm_and_ps(valid, _mm_add_ps(
+				_mm_mul_ps(a1, _mm_add_ps(_mm_mul_ps(b1, dz00), _mm_mul_ps(b, dz01))),
+				_mm_mul_ps(a, _mm_add_ps(_mm_mul_ps(b1, dz10), _mm_mul_ps(b, dz11))))));
+			for (int l = 0; l < 4; l++)
+				grads[l] = Vec3(g[0][l], g[1][l], g[2][l]);
+		}
+	}
+#pragma endregion
+
+	// the xy footprint of a triangle, for the +z parity rays
+	inline ldp::Int4 Parity_Footprint(const LevelSet3D& lv, const LevelSet3D::Vec3& v0, 
+		const LevelSet3D::Vec3& v1, const LevelSet3D::Vec3& v2)
+	{
+		const auto start = lv.getStartPos();
+		const auto step = lv.getStep();
+		const auto sz = lv.size();
+		return ldp::Int4(MAX(int((Min(v0[0], v1[0], v2[0]) - start[0]) / step) - 1, 0),
+			MAX(int((Min(v0[1], v1[1], v2[1]) - start[1]) / step) - 1, 0),
+			MIN(int((Max(v0[0], v1[0], v2[0]) - start[0]) / step) + 1, sz[0] - 1),
+			MIN(int((Max(v0[1], v1[1], v2[1]) - start[1]) / step) + 1, sz[1] - 1));
+	}
+
+	// the first cell above the intersection of the +z ray at (i, j), or -1 if not intersected
+	inline int Parity_Ray_Cell(const LevelSet3D& lv, int i, int j, 
+		LevelSet3D::Vec3 v0, LevelSet3D::Vec3 v1, LevelSet3D::Vec3 v2)
+	{
+		const auto step = lv.getStep();
+		LevelSet3D::Vec3 p0 = lv.getStartPos() + LevelSet3D::Vec3(i*step, j*step, -100);
+		LevelSet3D::Vec3 dir(0, 0, 1);
+		ValueType mint;
+		if (!Ray_Triangle_Intersection(v0.ptr(), v1.ptr(), v2.ptr(), p0.ptr(), dir.ptr(), mint))
+			return -1;
+		mint = MAX((mint - 100) / step, 0);
+		return (int)mint + 1;
+	}
+
+	// the cells within 4 of the triangle bounding box, [min, max]
+	inline void Distance_Box(const LevelSet3D& lv, const LevelSet3D::Vec3& v0, const LevelSet3D::Vec3& v1,
+		const LevelSet3D::Vec3& v2, ldp::Int3& bmin, ldp::Int3& bmax)
+	{
+		const auto start = lv.getStartPos();
+		const auto step = lv.getStep();
+		const auto sz = lv.size();
+		for (int k = 0; k < 3; k++)
+		{
+			bmin[k] = Max<int>((Min(v0[k], v1[k], v2[k]) - start[k]) / step - 4, 0);
+			bmax[k] = Min<int>((Max(v0[k], v1[k], v2[k]) - start[k]) / step + 4, sz[k] - 1);
+		}
+	}
+
+	void LevelSet3D::redistance(RedistanceMethod method, int band_width)
+	{
+		if (isTiled())
+		{
+			const ValueType band = m_tileBand;
+			toDense();
+			redistance(method, band_width);
+			toTiled(band);
+			return;
+		}
+		switch (method)
+		{
+		case RedistanceFastMarching:
+			fastMarching(band_width);
+			break;
+		case RedistanceFastSweeping:
+			fastSweeping(band_width);
+			break;
+		default:
+			throw std::exception("LevelSet3D::redistance: unknown method!");
+		}
+	}
+
+	void LevelSet3D::fromMesh(const ObjMesh& mesh, bool parallel, RedistanceMethod method)
+	{
+#ifdef CHECK_PARALLEL_FROM_MESH
+		gtime_t t_begin = gtime_now();
+#endif
+		if (parallel)
+			narrowBandFromMeshParallel(mesh);
+		else
+			narrowBandFromMesh(mesh);
+#ifdef CHECK_PARALLEL_FROM_MESH
+		gtime_t t_band = gtime_now();
+		{
+			std::vector<ValueType> band = m_value;
+			gtime_t t_other = gtime_now();
+			if (parallel)
+				narrowBandFromMesh(mesh);
+			else
+				narrowBandFromMeshParallel(mesh);
+			const double other_time = gtime_seconds(t_other, gtime_now());
+			const double this_time = gtime_seconds(t_begin, t_band);
+			int nDiff = 0;
+			for (size_t i = 0; i < band.size(); i++)
+				nDiff += band[i] != m_value[i];
+			printf("LevelSet3D::fromMesh: serial %fs, parallel %fs, speedup %.2f, %d cells differ\n",
+				parallel ? other_time : this_time, parallel ? this_time : other_time,
+				parallel ? other_time / this_time : this_time / other_time, nDiff);
+			m_value.swap(band);
+		}
+		gtime_t t_march = gtime_now();
+#endif
+
+		// Part 4: Propagate the signed distances
+		redistance(method);
+#ifdef CHECK_PARALLEL_FROM_MESH
+		printf("LevelSet3D::fromMesh(%s): narrow band %fs, %s %fs\n", parallel ? "parallel" : "serial",
+			gtime_seconds(t_begin, t_band), method == RedistanceFastMarching ? "fast marching" : "fast sweeping",
+			gtime_seconds(t_march, gtime_now()));
+#endif
+	}
+
+	void LevelSet3D::narrowBandFromMesh(const ObjMesh& mesh)
 	{
 		// 2: Set up inside/outside
 		std::vector<int> counters(m_value.size(), 0);
-		int t = 0;
 		for (const auto& f : mesh.face_list)
 		{
 			assert(f.vertex_count == 3);
 			Vec3 v0 = mesh.vertex_list[f.vertex_index[0]];
 			Vec3 v1 = mesh.vertex_list[f.vertex_index[1]];
 			Vec3 v2 = mesh.vertex_list[f.vertex_index[2]];
-			int min_ti = MAX(int((Min(v0[0], v1[0], v2[0]) - m_start[0]) / m_step) - 1, 0);
-			int min_tj = MAX(int((Min(v0[1], v1[1], v2[1]) - m_start[1]) / m_step) - 1, 0);
-			int max_ti = MIN(int((Max(v0[0], v1[0], v2[0]) - m_start[0]) / m_step) + 1, m_size[0] - 1);
-			int max_tj = MIN(int((Max(v0[1], v1[1], v2[1]) - m_start[1]) / m_step) + 1, m_size[1] - 1);
-			for (int i = min_ti; i <= max_ti; i++)
-			for (int j = min_tj; j <= max_tj; j++)
+			const ldp::Int4 fp = Parity_Footprint(*this, v0, v1, v2);
+			for (int i = fp[0]; i <= fp[2]; i++)
+			for (int j = fp[1]; j <= fp[3]; j++)
 			{
-				Vec3 p0 = m_start + Vec3(i*m_step, j*m_step, -100);
-				Vec3 dir(0, 0, 1);
-
-				ValueType mint;
-				if (Ray_Triangle_Intersection(v0.ptr(), v1.ptr(), v2.ptr(), p0.ptr(), dir.ptr(), mint))
-				{
-					mint = MAX((mint - 100) / m_step, 0);
-					for (int k = (int)mint + 1; k<m_size[2]; k++) 
-						counters[index(i, j, k)]++;
-				}
+				const int k0 = Parity_Ray_Cell(*this, i, j, v0, v1, v2);
+				if (k0 >= 0)
+				for (int k = k0; k<m_size[2]; k++) 
+					counters[index(i, j, k)]++;
 			}
 		}
 		for (size_t i = 0; i<counters.size(); i++)
@@ -168,16 +531,11 @@ namespace ldp
 			Vec3 v0 = mesh.vertex_list[f.vertex_index[0]];
 			Vec3 v1 = mesh.vertex_list[f.vertex_index[1]];
 			Vec3 v2 = mesh.vertex_list[f.vertex_index[2]];
-
-			int min_ti = Max<int>((Min(v0[0], v1[0], v2[0]) - m_start[0]) / m_step - 4, 0);
-			int min_tj = Max<int>((Min(v0[1], v1[1], v2[1]) - m_start[1]) / m_step - 4, 0);
-			int min_tk = Max<int>((Min(v0[2], v1[2], v2[2]) - m_start[2]) / m_step - 4, 0);
-			int max_ti = Min<int>((Max(v0[0], v1[0], v2[0]) - m_start[0]) / m_step + 4, m_size[0] - 1);
-			int max_tj = Min<int>((Max(v0[1], v1[1], v2[1]) - m_start[1]) / m_step + 4, m_size[1] - 1);
-			int max_tk = Min<int>((Max(v0[2], v1[2], v2[2]) - m_start[2]) / m_step + 4, m_size[2] - 1);
-			for (int i = min_ti; i <= max_ti; i++)
-			for (int j = min_tj; j <= max_tj; j++)
-			for (int k = min_tk; k <= max_tk; k++)
+			ldp::Int3 bmin, bmax;
+			Distance_Box(*this, v0, v1, v2, bmin, bmax);
+			for (int i = bmin[0]; i <= bmax[0]; i++)
+			for (int j = bmin[1]; j <= bmax[1]; j++)
+			for (int k = bmin[2]; k <= bmax[2]; k++)
 			{
 				Vec3 p0 = m_start + Vec3(i, j, k)*m_step;
 				ValueType bb, bc;
@@ -188,9 +546,101 @@ namespace ldp
 			bar.Add();
 		}
 		bar.End();
+	}
 
-		// Part 4: Propagate the signed distances
-		fastMarching();
+	void LevelSet3D::narrowBandFromMeshParallel(const ObjMesh& mesh)
+	{
+		// bucket the triangles by the x-slabs they touch, in the face order;
+		//	each slab is then processed by one thread, and each cell sees the triangles in the same order 
+		//	as the serial version, thus the results are bitwise identical.
+		const int nFaces = (int)mesh.face_list.size();
+		std::vector<Vec3> tris(nFaces * 3);
+		std::vector<std::vector<int>> paritySlabs(m_size[0]), distSlabs(m_size[0]);
+		for (int fid = 0; fid < nFaces; fid++)
+		{
+			const auto& f = mesh.face_list[fid];
+			assert(f.vertex_count == 3);
+			for (int k = 0; k < 3; k++)
+				tris[fid * 3 + k] = mesh.vertex_list[f.vertex_index[k]];
+			const Vec3& v0 = tris[fid * 3 + 0];
+			const Vec3& v1 = tris[fid * 3 + 1];
+			const Vec3& v2 = tris[fid * 3 + 2];
+			const ldp::Int4 fp = Parity_Footprint(*this, v0, v1, v2);
+			for (int i = fp[0]; i <= fp[2]; i++)
+				paritySlabs[i].push_back(fid);
+			ldp::Int3 bmin, bmax;
+			Distance_Box(*this, v0, v1, v2, bmin, bmax);
+			for (int i = bmin[0]; i <= bmax[0]; i++)
+				distSlabs[i].push_back(fid);
+		} // end for fid
+
+#pragma omp parallel
+		{
+			// per-thread counters of the ray starting cells of one slab
+			std::vector<int> counters(sizeYZ(), 0);
+#pragma omp for schedule(dynamic)
+			for (int i = 0; i < m_size[0]; i++)
+			{
+				// 2: Set up inside/outside
+				std::fill(counters.begin(), counters.end(), 0);
+				for (const int fid : paritySlabs[i])
+				{
+					const Vec3& v0 = tris[fid * 3 + 0];
+					const Vec3& v1 = tris[fid * 3 + 1];
+					const Vec3& v2 = tris[fid * 3 + 2];
+					const ldp::Int4 fp = Parity_Footprint(*this, v0, v1, v2);
+					for (int j = fp[1]; j <= fp[3]; j++)
+					{
+						const int k0 = Parity_Ray_Cell(*this, i, j, v0, v1, v2);
+						if (k0 >= 0 && k0 < m_size[2])
+							counters[j*m_size[2] + k0]++;
+					}
+				} // end for fid
+				for (int j = 0; j < m_size[1]; j++)
+				{
+					int cnt = 0;
+					for (int k = 0; k < m_size[2]; k++)
+					{
+						cnt += counters[j*m_size[2] + k];
+						m_value[index(i, j, k)] = (cnt % 2 == 0) ? 999999 : -999999;
+					}
+				} // end for j
+
+				// Part 3: Compute the distances
+				//	a triangle is skipped for a cell if its bounding box is already farther than the current value, 
+				//	with a margin to cover the rounding, so the min is not changed.
+				for (const int fid : distSlabs[i])
+				{
+					const Vec3& v0 = tris[fid * 3 + 0];
+					const Vec3& v1 = tris[fid * 3 + 1];
+					const Vec3& v2 = tris[fid * 3 + 2];
+					ldp::Int3 bmin, bmax;
+					Distance_Box(*this, v0, v1, v2, bmin, bmax);
+					const Vec3 tmin = (Vec3(Min(v0[0], v1[0], v2[0]), Min(v0[1], v1[1], v2[1]), 
+						Min(v0[2], v1[2], v2[2])) - m_start) / m_step;
+					const Vec3 tmax = (Vec3(Max(v0[0], v1[0], v2[0]), Max(v0[1], v1[1], v2[1]), 
+						Max(v0[2], v1[2], v2[2])) - m_start) / m_step;
+					const ValueType dx = Max(tmin[0] - i, i - tmax[0], ValueType(0));
+					for (int j = bmin[1]; j <= bmax[1]; j++)
+					{
+						const ValueType dy = Max(tmin[1] - j, j - tmax[1], ValueType(0));
+						for (int k = bmin[2]; k <= bmax[2]; k++)
+						{
+							const ValueType dz = Max(tmin[2] - k, k - tmax[2], ValueType(0));
+							const ValueType bound = fabs(m_value[index(i, j, k)]) * ValueType(1.001) + ValueType(1e-3);
+							if (dx*dx + dy*dy + dz*dz > bound*bound)
+								continue;
+							Vec3 p0 = m_start + Vec3(i, j, k)*m_step;
+							ValueType bb, bc;
+							ValueType distance = sqrt(Squared_VT_Distance(p0.ptr(), v0.ptr(),
+								v1.ptr(), v2.ptr(), bb, bc)) / m_step;
+							ValueType& v = m_value[index(i, j, k)];
+							v = SIGN(v)* Min(distance, fabs(v));
+						} // end for k
+					} // end for j
+				} // end for fid
+			} // end for i
+		} // end omp parallel
 	}
 
 	void LevelSet3D::marchingCubeToMesh(ObjMesh& mesh)const
@@ -457,88 +907,378 @@ namespace ldp
 		};
 #pragma endregion
 
-		std::vector<int> x_vertices(sizeXYZ(), 0);
-		std::vector<int> y_vertices(sizeXYZ(), 0);
-		std::vector<int> z_vertices(sizeXYZ(), 0);
+		// The grid is extended by one layer of outside nodes, so the surface is closed where it meets the boundary.
+		// In the shifted coordinates u = grid + 1, the cells are [0, size], each named by its min node, and the 
+		//	vertex on an edge is owned by the min node of the edge, shared by the cells around the edge.
+		// The cells are grouped into TILE_SIZE^3 blocks, a slab is the blocks of the same x, processed by one thread.
+		const int T = TILE_SIZE, T1 = TILE_SIZE + 1, BLOCK_EDGES = TILE_CELLS * 3;
+		const ldp::Int3 nTiles((m_size[0] + T - 1) >> TILE_BITS, (m_size[1] + T - 1) >> TILE_BITS,
+			(m_size[2] + T - 1) >> TILE_BITS);
+		const ldp::Int3 nBlocks((m_size[0] >> TILE_BITS) + 1, (m_size[1] >> TILE_BITS) + 1, (m_size[2] >> TILE_BITS) + 1);
+		const int nTilesXYZ = nTiles[0] * nTiles[1] * nTiles[2];
+		const int nBlocksYZ = nBlocks[1] * nBlocks[2];
 
-		mesh.clear();
+		// the node and the axis of the 12 edges of a cell
+		const static int edgeNode[12][4] = 
+		{
+			{ 0, 0, 0, 0 }, { 1, 0, 0, 1 }, { 0, 1, 0, 0 }, { 0, 0, 0, 1 },
+			{ 0, 0, 1, 0 }, { 1, 0, 1, 1 }, { 0, 1, 1, 0 }, { 0, 0, 1, 1 },
+			{ 0, 0, 0, 2 }, { 1, 0, 0, 2 }, { 1, 1, 0, 2 }, { 0, 1, 0, 2 },
+		};
+		int nTriangles[256] = { 0 };
+		for (int c = 0; c < 256; c++)
+		{
+			while (nTriangles[c] < 16 && triTable[c][nTriangles[c]] != -1)
+				nTriangles[c]++;
+			nTriangles[c] /= 3;
+		}
 
-		FOR_EVERY_CELL
+		// the nodes of a block, [-1, TILE_SIZE] of the grid around it
+		auto fetchBlock = [&](int bx, int by, int bz, ValueType* v)
+		{
+			for (int a = 0; a < T1; a++)
+			for (int b = 0; b < T1; b++)
+			for (int c = 0; c < T1; c++)
+			{
+				const int x = bx*T - 1 + a, y = by*T - 1 + b, z = bz*T - 1 + c;
+				if (x < 0 || y < 0 || z < 0 || x >= m_size[0] || y >= m_size[1] || z >= m_size[2])
+					v[(a*T1 + b)*T1 + c] = ValueType(MY_INFINITE);
+				else
+					v[(a*T1 + b)*T1 + c] = *value(x, y, z);
+			}
+		};
+		auto cubeIndex = [&](const ValueType* v)->int
 		{
-			// Add x_vertices
-			if (i + 1 != m_size[0])	
-			if (m_value[index(i, j, k)] <= 0 && m_value[index(i + 1, j, k)] >= 0 || 
-				m_value[index(i, j, k)] >= 0 && m_value[index(i + 1, j, k)] <= 0)
+			return (v[0] > 0) | (v[T1*T1] > 0) << 1 | (v[T1*T1 + T1] > 0) << 2 | (v[T1] > 0) << 3
+				| (v[1] > 0) << 4 | (v[T1*T1 + 1] > 0) << 5 | (v[T1*T1 + T1 + 1] > 0) << 6 | (v[T1 + 1] > 0) << 7;
+		};
+
+		// min/max pyramid: the tiles of the grid, then the blocks, each overlapping 2^3 tiles, then the slabs
+		// a block has surface only if its nodes have both signs
+		std::vector<ValueType> tileMin(nTilesXYZ), tileMax(nTilesXYZ);
+#pragma omp parallel for
+		for (int t = 0; t < nTilesXYZ; t++)
+		{
+			const int tx = t / (nTiles[1] * nTiles[2]), ty = (t / nTiles[2]) % nTiles[1], tz = t % nTiles[2];
+			if (isTiled() && m_tileOffset[t] < 0)
 			{
-				mesh.vertex_list.push_back(ldp::Float3(
-					i + m_value[index(i, j, k)] / (m_value[index(i, j, k)] - m_value[index(i + 1, j, k)]), j, k)
-					);
-				x_vertices[index(i, j, k)] = mesh.vertex_list.size() - 1;
+				tileMin[t] = tileMax[t] = m_tileFar[t];
+				continue;
 			}
-			//Add y_vertices
-			if (j + 1 != m_size[1])	
-			if (m_value[index(i, j, k)] <= 0 && m_value[index(i, j + 1, k)] >= 0 ||
-				m_value[index(i, j, k)] >= 0 && m_value[index(i, j + 1, k)] <= 0)
+			ValueType vmin = ValueType(MY_INFINITE), vmax = -ValueType(MY_INFINITE);
+			for (int x = tx*T; x < Min((tx + 1)*T, m_size[0]); x++)
+			for (int y = ty*T; y < Min((ty + 1)*T, m_size[1]); y++)
+			for (int z = tz*T; z < Min((tz + 1)*T, m_size[2]); z++)
 			{
-				mesh.vertex_list.push_back(ldp::Float3(i, 
-					j + m_value[index(i, j, k)] / (m_value[index(i, j, k)] - m_value[index(i, j + 1, k)]), k)
-					);
-				y_vertices[index(i, j, k)] = mesh.vertex_list.size() - 1;
+				const ValueType v = *value(x, y, z);
+				vmin = Min(vmin, v);
+				vmax = Max(vmax, v);
 			}
-			//Add z_vertices
-			if (k + 1 != m_size[2]) 
-			if (m_value[index(i, j, k)] <= 0 && m_value[index(i, j, k + 1)] >= 0 ||
-				m_value[index(i, j, k)] >= 0 && m_value[index(i, j, k + 1)] <= 0)
+			tileMin[t] = vmin;
+			tileMax[t] = vmax;
+		} // end for t
+		std::vector<unsigned char> blockActive(nBlocks[0] * nBlocksYZ, 0), slabActive(nBlocks[0], 0);
+#pragma omp parallel for
+		for (int bx = 0; bx < nBlocks[0]; bx++)
+		{
+			for (int by = 0; by < nBlocks[1]; by++)
+			for (int bz = 0; bz < nBlocks[2]; bz++)
 			{
-				mesh.vertex_list.push_back(ldp::Float3(i, j,
-					k + m_value[index(i, j, k)] / (m_value[index(i, j, k)] - m_value[index(i, j, k + 1)]))
-					);
-				z_vertices[index(i, j, k)] = mesh.vertex_list.size() - 1;
+				const ldp::Int3 b(bx, by, bz);
+				ldp::Int3 t0, t1;
+				ValueType vmin = ValueType(MY_INFINITE), vmax = -ValueType(MY_INFINITE);
+				for (int k = 0; k < 3; k++)
+				{
+					const int n0 = b[k] * T - 1, n1 = Min(b[k] * T + T - 1, m_size[k]);
+					if (n0 < 0 || n1 >= m_size[k])
+						vmax = ValueType(MY_INFINITE);
+					t0[k] = Max(n0, 0) >> TILE_BITS;
+					t1[k] = Min(n1, m_size[k] - 1) >> TILE_BITS;
+				}
+				for (int tx = t0[0]; tx <= t1[0]; tx++)
+				for (int ty = t0[1]; ty <= t1[1]; ty++)
+				for (int tz = t0[2]; tz <= t1[2]; tz++)
+				{
+					const int t = (tx*nTiles[1] + ty)*nTiles[2] + tz;
+					vmin = Min(vmin, tileMin[t]);
+					vmax = Max(vmax, tileMax[t]);
+				}
+				if (vmin <= 0 && vmax > 0)
+					blockActive[bx*nBlocksYZ + by*nBlocks[2] + bz] = slabActive[bx] = 1;
 			}
+		} // end for bx
+
+		// pass 1: the edge cache of each slab, i.e., the local vertex ids on the edges of its non-empty blocks,
+		//	and the number of triangles
+		struct Slab
+		{
+			std::vector<int> blockSlot;			// block yz -> its TILE_CELLS * 3 edges in edgeVerts, -1 if empty
+			std::vector<int> edgeVerts;			// -1 if the edge has no crossing
+			int nVerts = 0;
+			int nFaces = 0;
+		};
+		std::vector<Slab> slabs(nBlocks[0]);
+#pragma omp parallel
+		{
+			std::vector<ValueType> v(T1*T1*T1);
+#pragma omp for schedule(dynamic)
+			for (int bx = 0; bx < nBlocks[0]; bx++)
+			{
+				if (!slabActive[bx])
+					continue;
+				Slab& slab = slabs[bx];
+				slab.blockSlot.assign(nBlocksYZ, -1);
+				const int na = Min(T, m_size[0] + 1 - bx*T);
+				for (int by = 0; by < nBlocks[1]; by++)
+				for (int bz = 0; bz < nBlocks[2]; bz++)
+				{
+					if (!blockActive[bx*nBlocksYZ + by*nBlocks[2] + bz])
+						continue;
+					const int slot = (int)slab.edgeVerts.size() / BLOCK_EDGES;
+					slab.blockSlot[by*nBlocks[2] + bz] = slot;
+					slab.edgeVerts.resize(slab.edgeVerts.size() + BLOCK_EDGES, -1);
+					int* edges = slab.edgeVerts.data() + slot * BLOCK_EDGES;
+					fetchBlock(bx, by, bz, v.data());
+					const int nb = Min(T, m_size[1] + 1 - by*T), nc = Min(T, m_size[2] + 1 - bz*T);
+					for (int a = 0; a < na; a++)
+					for (int b = 0; b < nb; b++)
+					for (int c = 0; c < nc; c++)
+					{
+						const ValueType* p = v.data() + (a*T1 + b)*T1 + c;
+						int* e = edges + ((a*T + b)*T + c) * 3;
+						if ((p[0] > 0) != (p[T1*T1] > 0))
+							e[0] = slab.nVerts++;
+						if ((p[0] > 0) != (p[T1] > 0))
+							e[1] = slab.nVerts++;
+						if ((p[0] > 0) != (p[1] > 0))
+							e[2] = slab.nVerts++;
+						slab.nFaces += nTriangles[cubeIndex(p)];
+					}
+				}
+			} // end for bx
+		} // end omp parallel
+
+		std::vector<int> vertOffset(nBlocks[0] + 1, 0), faceOffset(nBlocks[0] + 1, 0);
+		for (int bx = 0; bx < nBlocks[0]; bx++)
+		{
+			vertOffset[bx + 1] = vertOffset[bx] + slabs[bx].nVerts;
+			faceOffset[bx + 1] = faceOffset[bx] + slabs[bx].nFaces;
 		}
+		mesh.clear();
+		mesh.vertex_list.resize(vertOffset.back());
+		mesh.face_list.resize(faceOffset.back());
 
-		FOR_EVERY_CELL if (i != m_size[0] - 1 && j != m_size[1] - 1 && k != m_size[2] - 1)
+		// the vertex of an edge in the shifted coordinates, its block has been cached as it has both signs
+		auto edgeVertex = [&](int x, int y, int z, int axis)->int
 		{
-			int CubeIndex = 0;
-			if (m_value[index(i, j, k)]>0.0) CubeIndex |= 1;
-			if (m_value[index(i + 1, j, k)]>0.0) CubeIndex |= 2;
-			if (m_value[index(i + 1, j + 1, k)]>0.0) CubeIndex |= 4;
-			if (m_value[index(i, j + 1, k)]>0.0) CubeIndex |= 8;
-			if (m_value[index(i, j, k + 1)]>0.0) CubeIndex |= 16;
-			if (m_value[index(i + 1, j, k + 1)]>0.0) CubeIndex |= 32;
-			if (m_value[index(i + 1, j + 1, k + 1)]>0.0) CubeIndex |= 64;
-			if (m_value[index(i, j + 1, k + 1)]>0.0) CubeIndex |= 128;
+			const Slab& slab = slabs[x >> TILE_BITS];
+			const int slot = slab.blockSlot[(y >> TILE_BITS)*nBlocks[2] + (z >> TILE_BITS)];
+			const int local = (((x & (T - 1))*T + (y & (T - 1)))*T + (z & (T - 1))) * 3 + axis;
+			return vertOffset[x >> TILE_BITS] + slab.edgeVerts[slot * BLOCK_EDGES + local];
+		};
 
-			int id;
-			for (id = 0; triTable[CubeIndex][id] != -1; id++)
+		// pass 2: write the vertices and the triangles of each slab in place
+#pragma omp parallel
+		{
+			std::vector<ValueType> v(T1*T1*T1);
+#pragma omp for schedule(dynamic)
+			for (int bx = 0; bx < nBlocks[0]; bx++)
 			{
-				int ti = id % 3;
-				if (ti == 0)
-					mesh.face_list.push_back(ObjMesh::obj_face());
-				ObjMesh::obj_face& f = mesh.face_list.back();
-				f.vertex_count = 3;
-				if (triTable[CubeIndex][id] == 0)	f.vertex_index[ti] = x_vertices[index(i, j, k)];
-				if (triTable[CubeIndex][id] == 1)	f.vertex_index[ti] = y_vertices[index(i + 1, j, k)];
-				if (triTable[CubeIndex][id] == 2)	f.vertex_index[ti] = x_vertices[index(i, j + 1, k)];
-				if (triTable[CubeIndex][id] == 3)	f.vertex_index[ti] = y_vertices[index(i, j, k)];
-
-				if (triTable[CubeIndex][id] == 4)	f.vertex_index[ti] = x_vertices[index(i, j, k + 1)];
-				if (triTable[CubeIndex][id] == 5)	f.vertex_index[ti] = y_vertices[index(i + 1, j, k + 1)];
-				if (triTable[CubeIndex][id] == 6)	f.vertex_index[ti] = x_vertices[index(i, j + 1, k + 1)];
-				if (triTable[CubeIndex][id] == 7)	f.vertex_index[ti] = y_vertices[index(i, j, k + 1)];
-
-				if (triTable[CubeIndex][id] == 8)	f.vertex_index[ti] = z_vertices[index(i, j, k)];
-				if (triTable[CubeIndex][id] == 9)	f.vertex_index[ti] = z_vertices[index(i + 1, j, k)];
-				if (triTable[CubeIndex][id] == 10)	f.vertex_index[ti] = z_vertices[index(i + 1, j + 1, k)];
-				if (triTable[CubeIndex][id] == 11)	f.vertex_index[ti] = z_vertices[index(i, j + 1, k)];
-			}
-		}
+				if (!slabActive[bx])
+					continue;
+				const Slab& slab = slabs[bx];
+				int iFace = faceOffset[bx];
+				const int na = Min(T, m_size[0] + 1 - bx*T);
+				for (int by = 0; by < nBlocks[1]; by++)
+				for (int bz = 0; bz < nBlocks[2]; bz++)
+				{
+					const int slot = slab.blockSlot[by*nBlocks[2] + bz];
+					if (slot < 0)
+						continue;
+					const int* edges = slab.edgeVerts.data() + slot * BLOCK_EDGES;
+					fetchBlock(bx, by, bz, v.data());
+					const int nb = Min(T, m_size[1] + 1 - by*T), nc = Min(T, m_size[2] + 1 - bz*T);
+					for (int a = 0; a < na; a++)
+					for (int b = 0; b < nb; b++)
+					for (int c = 0; c < nc; c++)
+					{
+						const ValueType* p = v.data() + (a*T1 + b)*T1 + c;
+						const int* e = edges + ((a*T + b)*T + c) * 3;
+						const int stride[3] = { T1*T1, T1, 1 };
+						const ldp::Int3 u(bx*T + a, by*T + b, bz*T + c);
+						for (int axis = 0; axis < 3; axis++)
+						{
+							if (e[axis] < 0)
+								continue;
+							ldp::Float3 pos(float(u[0] - 1), float(u[1] - 1), float(u[2] - 1));
+							pos[axis] += p[0] / (p[0] - p[stride[axis]]);
+							mesh.vertex_list[vertOffset[bx] + e[axis]] = pos;
+						}
+						const int cube = cubeIndex(p);
+						for (int id = 0; id < nTriangles[cube] * 3; id++)
+						{
+							ObjMesh::obj_face& f = mesh.face_list[iFace + id / 3];
+							const int* en = edgeNode[triTable[cube][id]];
+							f.vertex_count = 3;
+							f.vertex_index[id % 3] = edgeVertex(u[0] + en[0], u[1] + en[1], u[2] + en[2], en[3]);
+						}
+						iFace += nTriangles[cube];
+					}
+				}
+			} // end for bx
+		} // end omp parallel
 
 		mesh.scaleBy(m_step, 0);
 		mesh.translate(m_start);
 	}
 
-	void LevelSet3D::load(std::string filename)
+	// versioned file layout (little endian): LevelSetFileHeader, int tileOffsets[nTiles], float tileFarValues[nTiles],
+	//	then the allocated tiles, nAllocatedTiles * TILE_CELLS values of float, half or int16 by the quantization.
+	// All sections are 4-byte aligned, so that the float tiles can be read in place from the mapped file.
+	struct LevelSetFileHeader
+	{
+		char magic[4];
+		int version;
+		int quantization;
+		float scale;				// of FileFixed16, value = code * scale
+		ldp::Int3 size;
+		ldp::Float3 start;
+		float step;
+		float band;
+		int nTiles;
+		int nAllocatedTiles;
+	};
+	static const char g_lvset_magic[4] = { 'C', 'D', 'L', 'V' };
+	enum{ LEVEL_SET_FILE_VERSION = 1 };
+	// the saturated codes are decoded as infinite
+	enum{ LEVEL_SET_FIXED16_MAX = 32767 };
+	static const float g_lvset_half_max = 65504.f;
+
+	void LevelSet3D::load(std::string filename, RedistanceMethod method)
+	{
+		std::shared_ptr<MappedFile> file(new MappedFile());
+		file->open(filename);
+		LevelSetFileHeader h;
+		if (file->size() < sizeof(h) || memcmp(file->data(), g_lvset_magic, sizeof(g_lvset_magic)) != 0)
+		{
+			file->close();
+			loadLegacy(filename, method);
+			return;
+		}
+		memcpy(&h, file->data(), sizeof(h));
+		if (h.version != LEVEL_SET_FILE_VERSION)
+			throw std::exception(("not a supported level set version: " + filename).c_str());
+		const size_t valueBytes = h.quantization == FileFloat32 ? sizeof(float) : sizeof(short);
+		int nTiles = 1;
+		for (int k = 0; k < 3; k++)
+			nTiles *= (h.size[k] + TILE_SIZE - 1) / TILE_SIZE;
+		if (h.nTiles != nTiles || h.nAllocatedTiles < 0 || h.quantization < FileFloat32 || h.quantization > FileFixed16
+			|| file->size() != sizeof(h) + size_t(nTiles) * (sizeof(int) + sizeof(float)) 
+			+ size_t(h.nAllocatedTiles) * TILE_CELLS * valueBytes)
+			throw std::exception(("broken level set file: " + filename).c_str());
+		const int* offsets = (const int*)(file->data() + sizeof(h));
+		const float* farValues = (const float*)(offsets + nTiles);
+		const void* tiles = farValues + nTiles;
+		setTileLayout(h.size, h.start, h.step, h.band, offsets, farValues, h.nAllocatedTiles);
+
+		const int nValues = h.nAllocatedTiles * TILE_CELLS;
+		switch (h.quantization)
+		{
+		case FileFloat32:
+			m_mappedFile = file;
+			m_mappedTiles = (const ValueType*)tiles;
+			m_nMappedTiles = h.nAllocatedTiles;
+			break;
+		case FileHalf:
+			m_tileValues.resize(nValues);
+#pragma omp parallel for
+			for (int i = 0; i < nValues; i++)
+			{
+				const float v = half_float::detail::half2float(((const half_float::detail::uint16*)tiles)[i]);
+				m_tileValues[i] = fabs(v) >= g_lvset_half_max ? SIGN(v) * ValueType(MY_INFINITE) : v;
+			}
+			break;
+		case FileFixed16:
+			m_tileValues.resize(nValues);
+#pragma omp parallel for
+			for (int i = 0; i < nValues; i++)
+			{
+				const short c = ((const short*)tiles)[i];
+				m_tileValues[i] = abs(c) >= LEVEL_SET_FIXED16_MAX ? SIGN(c) * ValueType(MY_INFINITE) : c * h.scale;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	void LevelSet3D::save(std::string filename, FileQuantization quantization)const
+	{
+		if (!isTiled())
+		{
+			LevelSet3D tiled(*this);
+			tiled.toTiled();
+			if (!tiled.isTiled())
+				throw std::exception("LevelSet3D::save(): empty level set");
+			tiled.save(filename, quantization);
+			return;
+		}
+		LevelSetFileHeader h;
+		memcpy(h.magic, g_lvset_magic, sizeof(h.magic));
+		h.version = LEVEL_SET_FILE_VERSION;
+		h.quantization = quantization;
+		h.scale = 1.f;
+		h.size = m_size;
+		h.start = m_start;
+		h.step = m_step;
+		h.band = m_tileBand;
+		h.nTiles = numTiles();
+		h.nAllocatedTiles = numAllocatedTiles();
+		const int nValues = h.nAllocatedTiles * TILE_CELLS;
+		const ValueType* values = tileValues();
+		if (quantization == FileFixed16)
+		{
+			// uniform over the finite values
+			ValueType maxAbs = ValueType(1);
+			for (int i = 0; i < nValues; i++)
+			if (fabs(values[i]) < ValueType(MY_INFINITE))
+				maxAbs = Max(maxAbs, ValueType(fabs(values[i])));
+			h.scale = maxAbs / float(LEVEL_SET_FIXED16_MAX - 1);
+		}
+
+		std::fstream output(filename, std::ios::out | std::ios::binary);
+		if (output.fail())
+			throw std::exception(("IOError: " + filename).c_str());
+		output.write((const char*)&h, sizeof(h));
+		output.write((const char*)m_tileOffset.data(), h.nTiles * sizeof(int));
+		output.write((const char*)m_tileFar.data(), h.nTiles * sizeof(float));
+		if (quantization == FileFloat32)
+			output.write((const char*)values, size_t(nValues) * sizeof(float));
+		else
+		{
+			std::vector<short> codes(nValues);
+#pragma omp parallel for
+			for (int i = 0; i < nValues; i++)
+			{
+				if (quantization == FileHalf)
+					codes[i] = (short)half_float::detail::float2half<std::round_to_nearest>(values[i]);
+				else
+				{
+					// keep the inside cells negative
+					codes[i] = (short)floor(Max(-float(LEVEL_SET_FIXED16_MAX), Min(float(LEVEL_SET_FIXED16_MAX),
+						values[i] / h.scale)) + 0.5f);
+					if (codes[i] == 0 && values[i] < 0)
+						codes[i] = -1;
+				}
+			}
+			output.write((const char*)codes.data(), size_t(nValues) * sizeof(short));
+		}
+		if (output.fail())
+			throw std::exception(("IOError, write failed: " + filename).c_str());
+		output.close();
+	}
+
+	void LevelSet3D::loadLegacy(std::string filename, RedistanceMethod method)
 	{
 		std::fstream input(filename, std::ios::in | std::ios::binary);
 		if (input.fail())
@@ -566,12 +1306,19 @@ namespace ldp
 		input.close();
 		printf("load data from file %s successfully.\n", filename.c_str());
 #ifdef NDEBUG
-		fastMarching(); // ldp debug, debug mode, this is slow, just turn it off.
+		redistance(method); // ldp debug, debug mode, this is slow, just turn it off.
 #endif
 	}
 
-	void LevelSet3D::save(std::string filename)const
+	void LevelSet3D::saveLegacy(std::string filename)const
 	{
+		if (isTiled())
+		{
+			LevelSet3D dense(*this);
+			dense.toDense();
+			dense.saveLegacy(filename);
+			return;
+		}
 		std::fstream output(filename, std::ios::out | std::ios::binary);
 		if (output.fail())
 			throw std::exception(("IOError: " + filename).c_str());
@@ -737,6 +1484,127 @@ namespace ldp
 		}
 	}
 
+	void LevelSet3D::fastSweeping(const int band_width)
+	{
+		const int nCells = (int)m_value.size();
+		const int nbOffset[6][3] = { { -1, 0, 0 }, { 1, 0, 0 }, { 0, -1, 0 }, { 0, 1, 0 }, { 0, 0, -1 }, { 0, 0, 1 } };
+
+		// Initialize the distance function, as fastMarching() without boundary
+#pragma omp parallel for
+		for (int i = 0; i < m_size[0]; i++)
+		for (int j = 0; j < m_size[1]; j++)
+		for (int k = 0; k < m_size[2]; k++)
+		{
+			ValueType& v = m_value[index(i, j, k)];
+			if (i<BUFFER || j<BUFFER || k<BUFFER || i>m_size[0] - BUFFER
+				|| j>m_size[1] - BUFFER || k>m_size[2] - BUFFER)
+				v = 1;
+			if (fabsf(v) < EPSILON)
+				v = EPSILON*SIGN(v);
+		}
+
+		// Reinitialize the distances of surface cells, they are frozen during sweeping;
+		//	the same as Process_Surface_Cell(), but gathered on each cell to be parallel.
+		std::vector<char> frozen(nCells, 0);
+		{
+			const std::vector<ValueType> p = m_value;
+#pragma omp parallel for
+			for (int i = 0; i < m_size[0]; i++)
+			for (int j = 0; j < m_size[1]; j++)
+			for (int k = 0; k < m_size[2]; k++)
+			{
+				const int id = index(i, j, k);
+				ValueType v = p[id];
+				for (int n = 0; n < 6; n++)
+				{
+					const int ni = i + nbOffset[n][0], nj = j + nbOffset[n][1], nk = k + nbOffset[n][2];
+					if (ni < 0 || nj < 0 || nk < 0 || ni >= m_size[0] || nj >= m_size[1] || nk >= m_size[2])
+						continue;
+					const ValueType q = p[index(ni, nj, nk)];
+					ValueType pos = 0, neg = 0;
+					if (p[id] < 0 && q >= 0 && q != MY_INFINITE)
+						pos = q, neg = p[id];
+					else if (p[id] >= 0 && q < 0 && p[id] != MY_INFINITE)
+						pos = p[id], neg = q;
+					else
+						continue;
+					frozen[id] = 1;
+					if (pos - neg > 1)
+						v = Min_By_Abs(p[id] / (pos - neg), v);
+				} // end for n
+				m_value[id] = frozen[id] ? v : ValueType(MY_INFINITE)*SIGN(v);
+			}
+		}
+
+		// Gauss-Seidel sweeps in the 8 orders. The grid is tiled into columns of SWEEP_TILE x SWEEP_TILE x nz;
+		//	in a sweep, a column only depends on its upwind neighbors, thus the columns on a diagonal
+		//	(ti + tj = L) are swept in parallel, and the result equals the serial sweeping.
+		const int maxRounds = 8;
+		const ldp::Int3 nTiles((m_size[0] + SWEEP_TILE - 1) / SWEEP_TILE, (m_size[1] + SWEEP_TILE - 1) / SWEEP_TILE, 1);
+		ValueType maxChange = 0;
+		for (int round = 0; round < maxRounds; round++)
+		{
+			maxChange = 0;
+#pragma omp parallel
+			{
+				ValueType localChange = 0;
+				for (int dir = 0; dir < 8; dir++)
+				for (int L = 0; L < nTiles[0] + nTiles[1] - 1; L++)
+				{
+					const int tBegin = Max(0, L - (nTiles[1] - 1));
+					const int tEnd = Min(nTiles[0] - 1, L);
+#pragma omp for schedule(dynamic)
+					for (int ti = tBegin; ti <= tEnd; ti++)
+					{
+						const int tx = (dir & 1) ? nTiles[0] - 1 - ti : ti;
+						const int ty = (dir & 2) ? nTiles[1] - 1 - (L - ti) : L - ti;
+						const int x0 = tx * SWEEP_TILE, x1 = Min(x0 + SWEEP_TILE, m_size[0]);
+						const int y0 = ty * SWEEP_TILE, y1 = Min(y0 + SWEEP_TILE, m_size[1]);
+						for (int ii = 0; ii < x1 - x0; ii++)
+						for (int jj = 0; jj < y1 - y0; jj++)
+						for (int kk = 0; kk < m_size[2]; kk++)
+						{
+							const int i = (dir & 1) ? x1 - 1 - ii : x0 + ii;
+							const int j = (dir & 2) ? y1 - 1 - jj : y0 + jj;
+							const int k = (dir & 4) ? m_size[2] - 1 - kk : kk;
+							const int id = index(i, j, k);
+							if (frozen[id])
+								continue;
+							// as fast marching, the sign is given by the upwind neighbors
+							ValueType a = MY_INFINITE, b = MY_INFINITE, c = MY_INFINITE, nearest = MY_INFINITE;
+							if (i > 0) Sweep_Neighbor(m_value[id - sizeYZ()], a, nearest);
+							if (i + 1 < m_size[0]) Sweep_Neighbor(m_value[id + sizeYZ()], a, nearest);
+							if (j > 0) Sweep_Neighbor(m_value[id - m_size[2]], b, nearest);
+							if (j + 1 < m_size[1]) Sweep_Neighbor(m_value[id + m_size[2]], b, nearest);
+							if (k > 0) Sweep_Neighbor(m_value[id - 1], c, nearest);
+							if (k + 1 < m_size[2]) Sweep_Neighbor(m_value[id + 1], c, nearest);
+							const ValueType u = Eikonal_Update(a, b, c);
+							const ValueType old = fabsf(m_value[id]);
+							if (u < old)
+							{
+								localChange = Max(localChange, old - u);
+								m_value[id] = u * SIGN(nearest);
+							}
+						} // end for ii, jj, kk
+					} // end for ti
+				} // end for dir, L
+#pragma omp critical
+				maxChange = Max(maxChange, localChange);
+			} // end omp parallel
+			// in cells; usually the second round only verifies the first one
+			if (maxChange < ValueType(1e-2))
+				break;
+		} // end for round
+		if (maxChange >= ValueType(1e-2))
+			printf("WARNING: not converged in %d rounds, max change %f cells (Fast Sweeping).\n", maxRounds, maxChange);
+
+		// Update the remaining cells
+#pragma omp parallel for
+		for (int id = 0; id < nCells; id++)
+		if (m_value[id] >= band_width)
+			m_value[id] = MY_INFINITE;
+	}
+
 	void LevelSet3D::processCell(int i, int j, int k, HEAP <LEVEL_SET_CELL_DATA *> &heap_tree, 
 		ValueType band_width, std::vector<LEVEL_SET_CELL_DATA>& c)
 	{
@@ -4,15 +4,41 @@
 #include "INTERSECTION.h"
 #include "DISTANCE.h"
 #include "HEAP.h"
+#include <memory>
 class ObjMesh;
 namespace ldp
 {
 	class LEVEL_SET_CELL_DATA;
+	class MappedFile;
+	// Signed distance on a regular grid, in cells.
+	// The values are either dense, or tiled after toTiled(): TILE_SIZE^3 tiles touching the narrow band are
+	//	allocated, and each far tile keeps a single value, i.e., its sign times the distance nearest to the surface.
+	//	Queries behave the same in both modes; writing a far tile via value(x, y, z) allocates it.
+	// A level set loaded from a float32 file reads its tiles directly from the memory mapped file, 
+	//	the tiles are copied to memory on the first non-const access.
 	class LevelSet3D
 	{
 	public:
 		typedef float ValueType;
 		typedef ldp::ldp_basic_vec3<ValueType> Vec3;
+		enum{
+			TILE_BITS = 3,
+			TILE_SIZE = 1 << TILE_BITS,
+			TILE_CELLS = TILE_SIZE * TILE_SIZE * TILE_SIZE,
+		};
+		// the way the signed distances are propagated from the surface cells
+		enum RedistanceMethod
+		{
+			RedistanceFastMarching,		// serial, heap based
+			RedistanceFastSweeping,		// parallel sweeping over the diagonal planes, in place on the values
+		};
+		// the precision of the tile values in the saved file
+		enum FileQuantization
+		{
+			FileFloat32,				// exact, loaded by memory mapping without copy
+			FileHalf,					// half precision float
+			FileFixed16,				// 16-bit fixed point, uniform over the range of the finite values
+		};
 	public:
 		LevelSet3D();
 		~LevelSet3D();
@@ -20,21 +46,69 @@ namespace ldp
 		void clear();
 		void create(ldp::Int3 sz, Vec3 start, ValueType step);
 		void setStartPos(Vec3 start);
-		void fromMesh(const ObjMesh& mesh); // call create before this method
+		// recompute the signed distances from the zero crossing, outside distances beyond band_width are infinite
+		void redistance(RedistanceMethod method, int band_width = 6);
+		// call create before this method
+		// the parallel version gives exactly the same values as the serial one
+		void fromMesh(const ObjMesh& mesh, bool parallel = true, RedistanceMethod method = RedistanceFastMarching);
+		// the zero iso-surface as an indexed mesh, closed at the grid boundary; extracted in parallel, tiles without 
+		//	a sign change are skipped, each edge vertex is shared by its cells
 		void marchingCubeToMesh(ObjMesh& mesh)const;
-		void load(std::string filename);
-		void save(std::string filename)const;
+		// both the versioned and the legacy files are readable, the method is only used to redistance legacy files
+		void load(std::string filename, RedistanceMethod method = RedistanceFastMarching);
+		// versioned binary file of the tiled storage; a dense level set is tiled first, 
+		//	which is lossless for the redistanced ones, whose far cells are all infinite
+		void save(std::string filename, FileQuantization quantization = FileFloat32)const;
+		// the legacy file: the raw cells with |value| < 3, without header
+		void saveLegacy(std::string filename)const;
+
+		// narrow band storage: tiles with any |value| < band are kept
+		void toTiled(ValueType band = 6);
+		void toDense();
+		bool isTiled()const { return !m_tileOffset.empty(); }
+		int numTiles()const { return (int)m_tileOffset.size(); }
+		int numAllocatedTiles()const { return isMapped() ? m_nMappedTiles : (int)m_tileValues.size() / TILE_CELLS; }
+		bool isMapped()const { return m_mappedFile.get() != nullptr; }
+		size_t memoryBytes()const;
+		ValueType tileBand()const { return m_tileBand; }
+		// the raw tiled storage, e.g., for binary caches; nullptr if not tiled
+		const int* tileOffsets()const { return m_tileOffset.data(); }
+		const ValueType* tileFarValues()const { return m_tileFar.data(); }
+		const ValueType* tileValues()const { return isMapped() ? m_mappedTiles : m_tileValues.data(); }
+		// the counterpart of the raw accessors above, numTiles() offsets and far values are read
+		void createTiled(ldp::Int3 sz, Vec3 start, ValueType step, ValueType band, const int* tileOffsets,
+			const ValueType* tileFarValues, const ValueType* tileValues, int nAllocatedTiles);
 
 		Vec3 getStartPos()const { return m_start; }
 		ValueType getStep()const { return m_step; }
 		ldp::Int3 size()const { return m_size; }
-		int sizeXYZ()const { return (int)m_value.size(); }
+		int sizeXYZ()const { return m_size[0] * m_size[1] * m_size[2]; }
 		int sizeYZ()const { return m_size[1] * m_size[2]; }
+		// the dense array, nullptr if tiled
 		const ValueType* value()const { return m_value.data(); }
 		ValueType* value() { return m_value.data(); }
 		int index(int x, int y, int z)const { return x*sizeYZ() + y*m_size[2] + z; }
-		const ValueType* value(int x, int y, int z)const { return m_value.data() + index(x, y, z); }
-		ValueType* value(int x, int y, int z) { return m_value.data() + index(x, y, z); }
+		int tileIndex(int x, int y, int z)const 
+		{ 
+			return ((x >> TILE_BITS)*m_tileSize[1] + (y >> TILE_BITS))*m_tileSize[2] + (z >> TILE_BITS); 
+		}
+		const ValueType* value(int x, int y, int z)const 
+		{ 
+			if (!isTiled())
+				return m_value.data() + index(x, y, z); 
+			const int t = tileIndex(x, y, z);
+			if (m_tileOffset[t] < 0)
+				return m_tileFar.data() + t;
+			return tileValues() + m_tileOffset[t] + ((((x & (TILE_SIZE - 1)) << TILE_BITS)
+				+ (y & (TILE_SIZE - 1))) << TILE_BITS) + (z & (TILE_SIZE - 1));
+		}
+		ValueType* value(int x, int y, int z) 
+		{ 
+			if (!isTiled())
+				return m_value.data() + index(x, y, z);
+			allocateTile(tileIndex(x, y, z));
+			return const_cast<ValueType*>(static_cast<const LevelSet3D*>(this)->value(x, y, z));
+		}
 		const ValueType* value(ldp::Int3 idx)const { return value(idx[0], idx[1], idx[2]); }
 		ValueType* value(ldp::Int3 idx) { return value(idx[0], idx[1], idx[2]); }
 
@@ -93,8 +167,77 @@ namespace ldp
 		{
 			localGradient((p - m_start) / m_step, g);
 		}
+
+		// fused trilinear value and its analytic gradient from a single fetch of the 8 corners, in cells
+		// either value or grad can be nullptr; out of the valid range, the value is MY_INFINITE and the gradient zero
+		void localSample(Vec3 p, ValueType* value, Vec3* grad)const
+		{
+			if (p[0]<2 || p[1]<2 || p[2]<2 || p[0]>m_size[0] - 3 || p[1]>m_size[1] - 3 || p[2]>m_size[2] - 3)
+			{
+				if (value)
+					*value = MY_INFINITE;
+				if (grad)
+					*grad = Vec3(0);
+				return;
+			}
+			const int i = std::floor(p[0]), j = std::floor(p[1]), k = std::floor(p[2]);
+			const ValueType a = p[0] - i, b = p[1] - j, c = p[2] - k;
+			ValueType v[8];
+			fetchCorners(i, j, k, v);
+			// interpolate along z first, then y, then x
+			const ValueType v00 = v[0] + (v[1] - v[0])*c, v01 = v[2] + (v[3] - v[2])*c;
+			const ValueType v10 = v[4] + (v[5] - v[4])*c, v11 = v[6] + (v[7] - v[6])*c;
+			const ValueType v0 = v00 + (v01 - v00)*b, v1 = v10 + (v11 - v10)*b;
+			if (value)
+				*value = v0 + (v1 - v0)*a;
+			if (grad)
+			{
+				const ValueType dz00 = v[1] - v[0], dz01 = v[3] - v[2], dz10 = v[5] - v[4], dz11 = v[7] - v[6];
+				(*grad)[0] = v1 - v0;
+				(*grad)[1] = (1 - a)*(v01 - v00) + a*(v11 - v10);
+				(*grad)[2] = (1 - a)*((1 - b)*dz00 + b*dz01) + a*((1 - b)*dz10 + b*dz11);
+			}
+		}
+
+		// the same as localSample, but p is in world coordinates; value and grad are still in cells, 
+		//	the same as globalValue() and globalGradient()
+		void globalSample(Vec3 p, ValueType* value, Vec3* grad)const
+		{
+			localSample((p - m_start) / m_step, value, grad);
+		}
+
+		// batched globalSample, values or grads can be nullptr; 4 points per sse register, the same results
+		void globalSampleMany(const Vec3* p, int n, ValueType* values, Vec3* grads)const;
 	protected:
+		// the signed distance in a narrow band of the mesh, other cells are +-999999
+		void narrowBandFromMesh(const ObjMesh& mesh);
+		void narrowBandFromMeshParallel(const ObjMesh& mesh);
 		void fastMarching(const int band_width = 6, bool reinitialize = true, bool boundary = false);
+		void fastSweeping(const int band_width = 6);
+		// 4 points of globalSampleMany(), the coordinates and the interpolation in sse, the corners fetched per point
+		void globalSampleFour(const Vec3* p, ValueType* values, Vec3* grads)const;
+		void allocateTile(int t);
+		void setTileLayout(ldp::Int3 sz, Vec3 start, ValueType step, ValueType band, const int* tileOffsets,
+			const ValueType* tileFarValues, int nAllocatedTiles);
+		void loadLegacy(std::string filename, RedistanceMethod method);
+		// the 8 corners of cell (i, j, k), [x][y][z] with z fastest
+		void fetchCorners(int i, int j, int k, ValueType v[8])const
+		{
+			if (!isTiled())
+			{
+				const int sz = m_size[2], syz = sizeYZ();
+				const ValueType* p = m_value.data() + index(i, j, k);
+				v[0] = p[0];		v[1] = p[1];
+				v[2] = p[sz];		v[3] = p[sz + 1];
+				v[4] = p[syz];		v[5] = p[syz + 1];
+				v[6] = p[syz + sz];	v[7] = p[syz + sz + 1];
+				return;
+			}
+			for (int x = 0; x < 2; x++)
+			for (int y = 0; y < 2; y++)
+			for (int z = 0; z < 2; z++)
+				v[(x << 2) + (y << 1) + z] = value(i + x, j + y, k + z)[0];
+		}
 		void processCell(int i, int j, int k, HEAP <LEVEL_SET_CELL_DATA *> &heap_tree, 
 			LevelSet3D::ValueType band_width, std::vector<LEVEL_SET_CELL_DATA>& c);
 		ValueType computeExtendedDistance(int i, int j, int k, ValueType &sign,
@@ -103,6 +246,14 @@ namespace ldp
 		ldp::Int3 m_size;
 		Vec3 m_start;
 		ValueType m_step;
-		std::vector<ValueType> m_value;
+		std::vector<ValueType> m_value;				// dense values, empty if tiled
+		ldp::Int3 m_tileSize;						// number of tiles in each dimension
+		ValueType m_tileBand;
+		std::vector<int> m_tileOffset;				// position of each tile in m_tileValues, -1 for a far tile
+		std::vector<ValueType> m_tileFar;			// the value of each far tile
+		std::vector<ValueType> m_tileValues;		// allocated tiles, [x][y][z], z fastest
+		std::shared_ptr<const MappedFile> m_mappedFile;	// if not null, the allocated tiles are read from it
+		const ValueType* m_mappedTiles;
+		int m_nMappedTiles;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,171 @@
+#include "LevelSetCache.h"
+#include "LevelSet3D.h"
+#include "Renderable\ObjMesh.h"
+#include "ldputil.h"
+#include <windows.h>
+#include <algorithm>
+#include <cstdio>
+#undef min
+#undef max
+
+namespace ldp
+{
+	LevelSetCache& LevelSetCache::instance()
+	{
+		static LevelSetCache s_cache;
+		return s_cache;
+	}
+
+	LevelSetCache::LevelSetCache()
+	{
+		m_budget = size_t(2) << 30;
+	}
+
+	void LevelSetCache::setFolder(std::string folder)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_folder = folder;
+		if (!m_folder.empty())
+			ldp::mkdir(m_folder);
+	}
+
+	void LevelSetCache::setBudget(size_t bytes)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_budget = bytes;
+		if (!m_folder.empty())
+			evict();
+	}
+
+	LevelSetCache::Key LevelSetCache::computeKey(const ObjMesh& body, int resolution)
+	{
+		TopologyFingerprint fp;
+		fp.add(VERSION);
+		fp.add(resolution);
+		fp.add((int)body.vertex_list.size());
+		if (body.vertex_list.size())
+			fp.add(body.vertex_list.data(), body.vertex_list.size() * sizeof(body.vertex_list[0]));
+		fp.add((int)body.face_list.size());
+		for (const auto& f : body.face_list)
+		{
+			fp.add(f.vertex_count);
+			fp.add(f.vertex_index, f.vertex_count * sizeof(int));
+		}
+		return fp.value();
+	}
+
+	std::string LevelSetCache::filename(Key key)const
+	{
+		char name[32];
+		sprintf(name, "%016llx.lvc", key);
+		return ldp::fullfile(m_folder, name);
+	}
+
+	bool LevelSetCache::load(Key key, LevelSet3D& lvSet)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_folder.empty())
+			return false;
+		const std::string name = filename(key);
+		if (!ldp::fileExists(name))
+		{
+			m_nMisses++;
+			return false;
+		}
+		try
+		{
+			lvSet.load(name);
+			if (!lvSet.isTiled())
+				throw std::exception(("not a level set cache: " + name).c_str());
+		} catch (std::exception e)
+		{
+			printf("warning: %s\n", e.what());
+			DeleteFileA(name.c_str());
+			m_nMisses++;
+			return false;
+		}
+
+		// refresh the modification time for the lru order
+		HANDLE hFile = CreateFileA(name.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE 
+			| FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hFile != INVALID_HANDLE_VALUE)
+		{
+			FILETIME ft;
+			GetSystemTimeAsFileTime(&ft);
+			SetFileTime(hFile, NULL, NULL, &ft);
+			CloseHandle(hFile);
+		}
+		m_nHits++;
+		return true;
+	}
+
+	void LevelSetCache::store(Key key, const LevelSet3D& lvSet)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_folder.empty())
+			return;
+		if (!lvSet.isTiled())
+		{
+			printf("warning: LevelSetCache::store(), only tiled level sets are cached\n");
+			return;
+		}
+		// write then rename, so that a crash or another process never sees a broken file
+		const std::string name = filename(key);
+		const std::string tmpName = name + "." + std::to_string(GetCurrentProcessId()) + ".tmp";
+		bool failed = false;
+		try
+		{
+			lvSet.save(tmpName);
+		} catch (std::exception e)
+		{
+			printf("warning: %s\n", e.what());
+			failed = true;
+		}
+		if (failed || !MoveFileExA(tmpName.c_str(), name.c_str(), MOVEFILE_REPLACE_EXISTING))
+		{
+			printf("warning: LevelSetCache::store(), write failed: %s\n", name.c_str());
+			DeleteFileA(tmpName.c_str());
+			return;
+		}
+		evict();
+	}
+
+	void LevelSetCache::evict()
+	{
+		struct Entry
+		{
+			std::string name;
+			unsigned long long time;
+			unsigned long long bytes;
+		};
+		std::vector<Entry> entries;
+		unsigned long long total = 0;
+		WIN32_FIND_DATAA fd;
+		HANDLE hFind = FindFirstFileA(ldp::validWindowsPath(ldp::fullfile(m_folder, "*.lvc")).c_str(), &fd);
+		if (hFind == INVALID_HANDLE_VALUE)
+			return;
+		do
+		{
+			if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				continue;
+			Entry e;
+			e.name = ldp::fullfile(m_folder, fd.cFileName);
+			e.time = ((unsigned long long)fd.ftLastWriteTime.dwHighDateTime << 32) | fd.ftLastWriteTime.dwLowDateTime;
+			e.bytes = ((unsigned long long)fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+			total += e.bytes;
+			entries.push_back(e);
+		} while (FindNextFileA(hFind, &fd));
+		FindClose(hFind);
+		if (total <= m_budget)
+			return;
+
+		// the newest file is always kept
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b){ return a.time < b.time; });
+		for (size_t i = 0; i + 1 < entries.size() && total > m_budget; i++)
+		{
+			// may fail if mapped by another process, just skip it
+			if (DeleteFileA(entries[i].name.c_str()))
+				total -= entries[i].bytes;
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include "SparseStructureCache.h"
+
+class ObjMesh;
+namespace ldp
+{
+	class LevelSet3D;
+	// An on-disk cache of tiled body level sets, keyed by the hash of the body mesh and the grid resolution,
+	//	so that the same smpl shape and pose is only converted once, over all batch runs.
+	// Each entry is a file <folder>/<key>.lvc, the float32 versioned file of LevelSet3D::save(), i.e., only the
+	//	narrow band tiles are stored, and the loaded level sets read them from the memory mapped file. 
+	// The folder is kept in a size budget by dropping the least recently used files, a hit refreshes the 
+	//	modification time of its file.
+	// The cache is shared by all cloth managers and is thread-safe.
+	class LevelSetCache
+	{
+	public:
+		enum{ VERSION = 2 };
+		typedef TopologyFingerprint::ValueType Key;
+	public:
+		static LevelSetCache& instance();
+
+		// empty to disable the cache
+		void setFolder(std::string folder);
+		std::string folder()const{ return m_folder; }
+		bool isEnabled()const{ return !m_folder.empty(); }
+		void setBudget(size_t bytes);
+		size_t budget()const{ return m_budget; }
+
+		// the hash of the body vertices, faces and the grid resolution
+		static Key computeKey(const ObjMesh& body, int resolution);
+
+		// false if not found or broken
+		bool load(Key key, LevelSet3D& lvSet);
+		// the level set should be tiled
+		void store(Key key, const LevelSet3D& lvSet);
+
+		int numHits()const{ return m_nHits; }
+		int numMisses()const{ return m_nMisses; }
+	protected:
+		LevelSetCache();
+		std::string filename(Key key)const;
+		void evict();
+	private:
+		std::string m_folder;
+		size_t m_budget;
+		int m_nHits = 0;
+		int m_nMisses = 0;
+		std::mutex m_mutex;
+	};
+}
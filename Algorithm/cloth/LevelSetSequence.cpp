@@ -0,0 +1,166 @@
+#include "LevelSetSequence.h"
+#include "LevelSet3D.h"
+#include <cstring>
+
+namespace ldp
+{
+	// the same fixed point with LevelSet3D::FileFixed16, the saturated codes are decoded as infinite
+	enum{ FIXED16_MAX = 32767 };
+
+	LevelSetSequence::LevelSetSequence()
+	{
+
+	}
+
+	LevelSetSequence::~LevelSetSequence()
+	{
+
+	}
+
+	void LevelSetSequence::clear()
+	{
+		m_size = ldp::Int3(0);
+		m_start = ldp::Float3(0);
+		m_step = 0.f;
+		m_band = 0.f;
+		m_scale = 0.f;
+		m_nTiles = 0;
+		m_keyframes.clear();
+		m_tileCodes.clear();
+	}
+
+	void LevelSetSequence::create(ldp::Int3 size, ldp::Float3 start, float step, float band)
+	{
+		clear();
+		m_size = size;
+		m_start = start;
+		m_step = step;
+		m_band = band;
+		m_nTiles = 1;
+		for (int k = 0; k < 3; k++)
+			m_nTiles *= (m_size[k] + LevelSet3D::TILE_SIZE - 1) / LevelSet3D::TILE_SIZE;
+
+		// a cell of a band tile is within the band plus the tile diagonal to the surface
+		m_scale = (m_band + 2.f * LevelSet3D::TILE_SIZE) / float(FIXED16_MAX - 1);
+	}
+
+	int LevelSetSequence::numStoredTiles()const
+	{
+		return (int)m_tileCodes.size() / LevelSet3D::TILE_CELLS;
+	}
+
+	size_t LevelSetSequence::memoryBytes()const
+	{
+		return m_tileCodes.size() * sizeof(short) + m_keyframes.size() * m_nTiles * (sizeof(int) + sizeof(float));
+	}
+
+	float LevelSetSequence::decode(short code)const
+	{
+		return abs(code) >= FIXED16_MAX ? SIGN(code) * float(MY_INFINITE) : code * m_scale;
+	}
+
+	void LevelSetSequence::addKeyframe(const LevelSet3D& lvSet, float time)
+	{
+		if (m_nTiles == 0)
+			throw std::exception("LevelSetSequence::addKeyframe(): call create() first");
+		if (lvSet.size() != m_size || lvSet.getStartPos() != m_start || lvSet.getStep() != m_step)
+			throw std::exception("LevelSetSequence::addKeyframe(): not the grid of the sequence");
+		if (!m_keyframes.empty() && time <= m_keyframes.back().time)
+			throw std::exception("LevelSetSequence::addKeyframe(): keyframe time not increasing");
+		if (!lvSet.isTiled())
+		{
+			LevelSet3D tiled(lvSet);
+			tiled.toTiled(m_band);
+			addKeyframe(tiled, time);
+			return;
+		}
+
+		const int TILE_CELLS = LevelSet3D::TILE_CELLS;
+		const int* offsets = lvSet.tileOffsets();
+		const float* values = lvSet.tileValues();
+		m_keyframes.push_back(Keyframe());
+		Keyframe& key = m_keyframes.back();
+		const Keyframe* prev = m_keyframes.size() > 1 ? &m_keyframes[m_keyframes.size() - 2] : nullptr;
+		key.time = time;
+		key.tileFar.assign(lvSet.tileFarValues(), lvSet.tileFarValues() + m_nTiles);
+		key.tileOffset.assign(m_nTiles, -1);
+
+		// quantize the band tiles, keeping the inside cells negative
+		std::vector<int> bandTiles;
+		for (int t = 0; t < m_nTiles; t++)
+		if (offsets[t] >= 0)
+			bandTiles.push_back(t);
+		std::vector<short> codes(bandTiles.size() * TILE_CELLS);
+#pragma omp parallel for
+		for (int i = 0; i < (int)codes.size(); i++)
+		{
+			const float v = values[offsets[bandTiles[i / TILE_CELLS]] + i % TILE_CELLS];
+			codes[i] = (short)floor(Max(-float(FIXED16_MAX), Min(float(FIXED16_MAX), v / m_scale)) + 0.5f);
+			if (codes[i] == 0 && v < 0)
+				codes[i] = -1;
+		}
+
+		// store the tiles changed since the previous keyframe
+		for (size_t i = 0; i < bandTiles.size(); i++)
+		{
+			const int t = bandTiles[i];
+			const short* c = codes.data() + i * TILE_CELLS;
+			if (prev && prev->tileOffset[t] >= 0
+				&& memcmp(m_tileCodes.data() + prev->tileOffset[t], c, TILE_CELLS * sizeof(short)) == 0)
+			{
+				key.tileOffset[t] = prev->tileOffset[t];
+				continue;
+			}
+			key.tileOffset[t] = (int)m_tileCodes.size();
+			m_tileCodes.insert(m_tileCodes.end(), c, c + TILE_CELLS);
+		} // end for i
+	}
+
+	void LevelSetSequence::interpolate(float time, LevelSet3D& lvSet)const
+	{
+		if (m_keyframes.empty())
+			throw std::exception("LevelSetSequence::interpolate(): no keyframes");
+
+		// the neighbouring keyframes of the time
+		int k0 = 0;
+		while (k0 + 1 < numKeyframes() && m_keyframes[k0 + 1].time <= time)
+			k0++;
+		const int k1 = Min(k0 + 1, numKeyframes() - 1);
+		const Keyframe& key0 = m_keyframes[k0];
+		const Keyframe& key1 = m_keyframes[k1];
+		const float w = k1 == k0 ? 0.f : Max(0.f, Min(1.f, (time - key0.time) / (key1.time - key0.time)));
+
+		// a tile in the band of either keyframe is in the band of the blend
+		const int TILE_CELLS = LevelSet3D::TILE_CELLS;
+		std::vector<int> offsets(m_nTiles, -1), bandTiles;
+		std::vector<float> farValues(m_nTiles);
+		for (int t = 0; t < m_nTiles; t++)
+		{
+			farValues[t] = key0.tileFar[t] + (key1.tileFar[t] - key0.tileFar[t]) * w;
+			if (key0.tileOffset[t] < 0 && (w == 0.f || key1.tileOffset[t] < 0))
+				continue;
+			offsets[t] = (int)bandTiles.size() * TILE_CELLS;
+			bandTiles.push_back(t);
+		} // end for t
+		std::vector<float> values(bandTiles.size() * TILE_CELLS);
+#pragma omp parallel for
+		for (int i = 0; i < (int)bandTiles.size(); i++)
+		{
+			const int t = bandTiles[i];
+			float* v = values.data() + i * TILE_CELLS;
+			for (int c = 0; c < TILE_CELLS; c++)
+			{
+				const float v0 = key0.tileOffset[t] < 0 ? key0.tileFar[t] : decode(m_tileCodes[key0.tileOffset[t] + c]);
+				if (w == 0.f)
+				{
+					v[c] = v0;
+					continue;
+				}
+				const float v1 = key1.tileOffset[t] < 0 ? key1.tileFar[t] : decode(m_tileCodes[key1.tileOffset[t] + c]);
+				v[c] = v0 + (v1 - v0) * w;
+			}
+		} // end for i
+		lvSet.createTiled(m_size, m_start, m_step, m_band, offsets.data(), farValues.data(), values.data(),
+			(int)bandTiles.size());
+	}
+}
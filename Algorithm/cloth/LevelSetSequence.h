@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include "ldpMat\ldp_basic_vec.h"
+
+namespace ldp
+{
+	class LevelSet3D;
+	// Keyframes of the level set of a moving body, e.g., along a pose trajectory of a smpl body,
+	//	so that a step of the motion costs a blend of the two neighbouring keyframes instead of a rebuild.
+	// All keyframes are on the grid given to create(), stored like the tiled LevelSet3D: a single value for
+	//	each far tile, and 16-bit fixed point codes for the band tiles. A band tile with the same codes as in the
+	//	previous keyframe is stored once, thus the body parts that do not move cost nothing per keyframe.
+	// The blend is linear and exact at the keyframes; they should be dense enough that the surface
+	//	moves less than the band between two of them.
+	class LevelSetSequence
+	{
+	public:
+		LevelSetSequence();
+		~LevelSetSequence();
+
+		void clear();
+		// band: the band of the tiled level sets given to addKeyframe(), see LevelSet3D::toTiled()
+		void create(ldp::Int3 size, ldp::Float3 start, float step, float band = 6);
+		// the level set should be on the grid of create(), and the time greater than the last keyframe
+		void addKeyframe(const LevelSet3D& lvSet, float time);
+		// the tiled level set at the given time, clamped to the first and the last keyframe
+		void interpolate(float time, LevelSet3D& lvSet)const;
+
+		bool empty()const { return m_keyframes.empty(); }
+		int numKeyframes()const { return (int)m_keyframes.size(); }
+		float keyframeTime(int i)const { return m_keyframes.at(i).time; }
+		int numStoredTiles()const;
+		size_t memoryBytes()const;
+	protected:
+		struct Keyframe
+		{
+			float time = 0.f;
+			std::vector<int> tileOffset;		// in m_tileCodes, -1 for a far tile
+			std::vector<float> tileFar;
+		};
+		float decode(short code)const;
+	private:
+		ldp::Int3 m_size;
+		ldp::Float3 m_start;
+		float m_step = 0.f;
+		float m_band = 0.f;
+		float m_scale = 0.f;					// value = code * scale
+		int m_nTiles = 0;
+		std::vector<Keyframe> m_keyframes;
+		std::vector<short> m_tileCodes;
+	};
+}
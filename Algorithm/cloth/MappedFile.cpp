@@ -0,0 +1,57 @@
+#include "MappedFile.h"
+#include <windows.h>
+#include <exception>
+
+namespace ldp
+{
+	MappedFile::MappedFile()
+	{
+		m_file = INVALID_HANDLE_VALUE;
+		m_mapping = nullptr;
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+	void MappedFile::open(std::string filename)
+	{
+		close();
+		m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, 
+			NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (m_file == INVALID_HANDLE_VALUE)
+			throw std::exception(("IOError: " + filename).c_str());
+		LARGE_INTEGER sz;
+		if (!GetFileSizeEx(m_file, &sz) || sz.QuadPart == 0)
+		{
+			close();
+			throw std::exception(("IOError, empty file: " + filename).c_str());
+		}
+		m_size = (size_t)sz.QuadPart;
+		m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (m_mapping)
+			m_data = (const unsigned char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+		if (m_data == nullptr)
+		{
+			close();
+			throw std::exception(("IOError, mapping failed: " + filename).c_str());
+		}
+	}
+
+	void MappedFile::close()
+	{
+		if (m_data)
+			UnmapViewOfFile(m_data);
+		if (m_mapping)
+			CloseHandle(m_mapping);
+		if (m_file != INVALID_HANDLE_VALUE)
+			CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+		m_mapping = nullptr;
+		m_data = nullptr;
+		m_size = 0;
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+namespace ldp
+{
+	// A read-only memory mapped file, the whole file is mapped on open().
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+		MappedFile(const MappedFile& rhs) = delete;
+		MappedFile& operator = (const MappedFile& rhs) = delete;
+
+		// throw if failed
+		void open(std::string filename);
+		void close();
+		bool isOpen()const{ return m_data != nullptr; }
+		const unsigned char* data()const{ return m_data; }
+		size_t size()const{ return m_size; }
+	private:
+		void* m_file;
+		void* m_mapping;
+		const unsigned char* m_data;
+		size_t m_size;
+	};
+}
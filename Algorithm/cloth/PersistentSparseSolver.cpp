@@ -0,0 +1,128 @@
+#include "PersistentSparseSolver.h"
+#include <algorithm>
+
+namespace ldp
+{
+	PersistentSparseSolver::PersistentSparseSolver()
+	{
+		m_factorReuseTol = 0;
+		m_pcgMaxIter = 20;
+		m_pcgTol = 1e-8;
+		clear();
+	}
+
+	PersistentSparseSolver::~PersistentSparseSolver()
+	{
+
+	}
+
+	void PersistentSparseSolver::clear()
+	{
+		m_outerIndex.clear();
+		m_innerIndex.clear();
+		m_factoredValues.clear();
+		m_analyzed = false;
+		m_factored = false;
+		m_nAnalyzes = 0;
+		m_nFactorizations = 0;
+		m_nFactorReuses = 0;
+		m_info = "";
+	}
+
+	bool PersistentSparseSolver::samePattern(const SpMat& A)const
+	{
+		if (!A.isCompressed() || A.outerSize() + 1 != (int)m_outerIndex.size()
+			|| A.nonZeros() != (int)m_innerIndex.size())
+			return false;
+		return std::equal(m_outerIndex.begin(), m_outerIndex.end(), A.outerIndexPtr())
+			&& std::equal(m_innerIndex.begin(), m_innerIndex.end(), A.innerIndexPtr());
+	}
+
+	PersistentSparseSolver::real PersistentSparseSolver::relativeChange(const SpMat& A)const
+	{
+		real diff = 0, norm = 0;
+		const real* v = A.valuePtr();
+		for (size_t i = 0; i < m_factoredValues.size(); i++)
+		{
+			diff += (v[i] - m_factoredValues[i]) * (v[i] - m_factoredValues[i]);
+			norm += m_factoredValues[i] * m_factoredValues[i];
+		}
+		return sqrt(diff / std::max(norm, real(1e-30)));
+	}
+
+	bool PersistentSparseSolver::pcg(const SpMat& A, const Vec& b, Vec& x, int& iter, real& err)const
+	{
+		const real norm_b = b.norm();
+		x.setZero(b.size());
+		iter = 0;
+		err = 0;
+		if (norm_b == 0)
+			return true;
+		Vec r = b;
+		Vec z = m_solver.solve(r);
+		Vec p = z;
+		real rz = r.dot(z);
+		for (iter = 1; iter <= m_pcgMaxIter; iter++)
+		{
+			const Vec Ap = A * p;
+			const real pAp = p.dot(Ap);
+			const real alpha = (pAp == 0) ? 0 : rz / pAp;
+			x += alpha * p;
+			r -= alpha * Ap;
+			err = r.norm() / norm_b;
+			if (err < m_pcgTol)
+				return true;
+			z = m_solver.solve(r);
+			const real old_rz = rz;
+			rz = r.dot(z);
+			p = z + ((old_rz == 0) ? 0 : rz / old_rz) * p;
+		} // end for iter
+		return false;
+	}
+
+	bool PersistentSparseSolver::solve(const SpMat& A, const Vec& b, Vec& x)
+	{
+		if (!A.isCompressed())
+			throw std::exception("PersistentSparseSolver::solve(): A must be compressed!");
+
+		// the pattern changed: ordering and symbolic analysis
+		bool analyzed = false;
+		if (!m_analyzed || !samePattern(A))
+		{
+			m_solver.analyzePattern(A);
+			m_outerIndex.assign(A.outerIndexPtr(), A.outerIndexPtr() + A.outerSize() + 1);
+			m_innerIndex.assign(A.innerIndexPtr(), A.innerIndexPtr() + A.nonZeros());
+			m_analyzed = true;
+			m_factored = false;
+			m_nAnalyzes++;
+			analyzed = true;
+		}
+
+		// the matrix changed little, try the old factor as the preconditioner
+		if (m_factored && m_factorReuseTol > 0 && relativeChange(A) < m_factorReuseTol)
+		{
+			int iter = 0;
+			real err = 0;
+			if (pcg(A, b, x, iter, err))
+			{
+				m_nFactorReuses++;
+				m_info = "ldlt-pcg, iter " + std::to_string(iter) + ", err " + std::to_string(err);
+				return true;
+			}
+		}
+
+		// numeric factorization only
+		m_solver.factorize(A);
+		m_factored = m_solver.info() == Eigen::Success;
+		if (!m_factored)
+		{
+			m_info = "ldlt, factorization failed";
+			return false;
+		}
+		m_factoredValues.assign(A.valuePtr(), A.valuePtr() + A.nonZeros());
+		m_nFactorizations++;
+		x = m_solver.solve(b);
+		m_info = analyzed ? "ldlt, analyze+factor" : "ldlt, factor";
+		return true;
+	}
+}
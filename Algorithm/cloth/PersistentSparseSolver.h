@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <eigen\Sparse>
+
+namespace ldp
+{
+	// A sparse cholesky solver that persists across time steps:
+	//	the ordering and symbolic analysis (analyzePattern) are done only when the sparsity pattern
+	//	of A changes, e.g., on topology or stitch changes; otherwise only the numeric factorization is redone.
+	//	Optionally, if A changed little since the last factorization, the old factor is reused as
+	//	the preconditioner of a pcg and the refactorization is skipped.
+	class PersistentSparseSolver
+	{
+	public:
+		typedef double real;
+		typedef Eigen::SparseMatrix<real> SpMat;
+		typedef Eigen::Matrix<real, -1, 1> Vec;
+	public:
+		PersistentSparseSolver();
+		~PersistentSparseSolver();
+
+		void clear();
+
+		// if |A-A_factored|_F < tol * |A_factored|_F, the old factor is reused as the pcg preconditioner
+		// tol <= 0 disables the reuse, which is the default
+		void setFactorReuseTolerance(real tol){ m_factorReuseTol = tol; }
+		real getFactorReuseTolerance()const{ return m_factorReuseTol; }
+		void setPcgParam(int maxIter, real tol){ m_pcgMaxIter = maxIter; m_pcgTol = tol; }
+
+		// solve A*x = b, A must be symmetric and compressed
+		// return false if the factorization failed
+		bool solve(const SpMat& A, const Vec& b, Vec& x);
+
+		int numAnalyzes()const{ return m_nAnalyzes; }
+		int numFactorizations()const{ return m_nFactorizations; }
+		int numFactorReuses()const{ return m_nFactorReuses; }
+		// what the last solve() did
+		std::string getInfo()const{ return m_info; }
+	protected:
+		bool samePattern(const SpMat& A)const;
+		real relativeChange(const SpMat& A)const;
+		bool pcg(const SpMat& A, const Vec& b, Vec& x, int& iter, real& err)const;
+	private:
+		Eigen::SimplicialLDLT<SpMat> m_solver;
+		std::vector<int> m_outerIndex;
+		std::vector<int> m_innerIndex;
+		std::vector<real> m_factoredValues;
+		bool m_analyzed;
+		bool m_factored;
+		real m_factorReuseTol;
+		int m_pcgMaxIter;
+		real m_pcgTol;
+		int m_nAnalyzes;
+		int m_nFactorizations;
+		int m_nFactorReuses;
+		std::string m_info;
+	};
+}
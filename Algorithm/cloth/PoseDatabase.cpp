@@ -0,0 +1,290 @@
+#include "PoseDatabase.h"
+#include "MappedFile.h"
+#include "tinyxml\tinyxml.h"
+#include "ldpMat\half.hpp"
+#include "ldputil.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+
+namespace ldp
+{
+	// versioned file layout (little endian): PoseDatabaseHeader, Clip clips[nClips], Frame frames[nFrames],
+	//	char names[namesBytes] padded to 4 bytes, then nPoses * nVars poses of float or half by the storage.
+	struct PoseDatabaseHeader
+	{
+		char magic[4];
+		int version;
+		int storage;
+		int nVars;
+		int nClips;
+		int nFrames;
+		int nPoses;
+		int namesBytes;				// padded to 4 bytes
+	};
+	static const char g_pose_db_magic[4] = { 'C', 'D', 'P', 'D' };
+	enum{ POSE_DATABASE_VERSION = 1 };
+
+	static std::string poseDbLower(std::string s)
+	{
+		std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+		return s;
+	}
+
+	PoseDatabase::PoseDatabase()
+	{
+
+	}
+
+	PoseDatabase::~PoseDatabase()
+	{
+
+	}
+
+	void PoseDatabase::clear()
+	{
+		m_file.reset();
+		m_storage = StorageFloat32;
+		m_nVars = 0;
+		m_nClips = 0;
+		m_nFrames = 0;
+		m_nPoses = 0;
+		m_clips = nullptr;
+		m_frames = nullptr;
+		m_names = nullptr;
+		m_poses = nullptr;
+		m_clipIds.clear();
+	}
+
+	std::string PoseDatabase::defaultFilename(std::string poseRoot)
+	{
+		return ldp::fullfile(poseRoot, "poses.pdb");
+	}
+
+	void PoseDatabase::open(std::string filename)
+	{
+		clear();
+		std::shared_ptr<MappedFile> file(new MappedFile());
+		file->open(filename);
+		PoseDatabaseHeader h;
+		if (file->size() < sizeof(h) || memcmp(file->data(), g_pose_db_magic, sizeof(g_pose_db_magic)) != 0)
+			throw std::exception(("not a pose database: " + filename).c_str());
+		memcpy(&h, file->data(), sizeof(h));
+		if (h.version != POSE_DATABASE_VERSION)
+			throw std::exception(("not a supported pose database version: " + filename).c_str());
+		const size_t valueBytes = h.storage == StorageFloat32 ? sizeof(float) : sizeof(short);
+		if (h.storage < StorageFloat32 || h.storage > StorageHalf || h.nVars <= 0 || h.nClips < 0 || h.nFrames < 0
+			|| h.nPoses < 0 || h.namesBytes < 0 || h.namesBytes % 4 != 0
+			|| file->size() != sizeof(h) + size_t(h.nClips) * sizeof(Clip) + size_t(h.nFrames) * sizeof(Frame)
+			+ h.namesBytes + size_t(h.nPoses) * h.nVars * valueBytes)
+			throw std::exception(("broken pose database: " + filename).c_str());
+		const Clip* clips = (const Clip*)(file->data() + sizeof(h));
+		const Frame* frames = (const Frame*)(clips + h.nClips);
+		const char* names = (const char*)(frames + h.nFrames);
+		for (int i = 0; i < h.nClips; i++)
+		{
+			const Clip& c = clips[i];
+			if (c.firstFrame < 0 || c.nFrames < 0 || c.firstFrame + c.nFrames > h.nFrames || c.nameOffset < 0
+				|| c.nameLength < 0 || c.nameOffset + c.nameLength > h.namesBytes)
+				throw std::exception(("broken pose database: " + filename).c_str());
+			m_clipIds[std::string(names + c.nameOffset, c.nameLength)] = i;
+		}
+		for (int i = 0; i < h.nFrames; i++)
+		if (frames[i].pose < 0 || frames[i].pose >= h.nPoses)
+			throw std::exception(("broken pose database: " + filename).c_str());
+
+		m_file = file;
+		m_storage = h.storage;
+		m_nVars = h.nVars;
+		m_nClips = h.nClips;
+		m_nFrames = h.nFrames;
+		m_nPoses = h.nPoses;
+		m_clips = clips;
+		m_frames = frames;
+		m_names = names;
+		m_poses = names + h.namesBytes;
+	}
+
+	std::string PoseDatabase::clipName(int clip)const
+	{
+		const Clip& c = m_clips[clip];
+		return std::string(m_names + c.nameOffset, c.nameLength);
+	}
+
+	int PoseDatabase::clipFirstFrame(int clip)const
+	{
+		return m_clips[clip].firstFrame;
+	}
+
+	int PoseDatabase::clipNumFrames(int clip)const
+	{
+		return m_clips[clip].nFrames;
+	}
+
+	int PoseDatabase::findClip(std::string name)const
+	{
+		auto iter = m_clipIds.find(name);
+		return iter == m_clipIds.end() ? -1 : iter->second;
+	}
+
+	int PoseDatabase::frameSourceId(int frame)const
+	{
+		return m_frames[frame].sourceId;
+	}
+
+	void PoseDatabase::getPose(int frame, float* pose)const
+	{
+		if (frame < 0 || frame >= m_nFrames)
+			throw std::exception("PoseDatabase::getPose(): frame out of range");
+		const size_t begin = size_t(m_frames[frame].pose) * m_nVars;
+		if (m_storage == StorageFloat32)
+			memcpy(pose, (const float*)m_poses + begin, m_nVars * sizeof(float));
+		else
+		{
+			const half_float::detail::uint16* codes = (const half_float::detail::uint16*)m_poses + begin;
+			for (int k = 0; k < m_nVars; k++)
+				pose[k] = half_float::detail::half2float(codes[k]);
+		}
+	}
+
+	void PoseDatabase::getPose(int clip, int frameInClip, std::vector<float>& pose)const
+	{
+		if (clip < 0 || clip >= m_nClips || frameInClip < 0 || frameInClip >= m_clips[clip].nFrames)
+			throw std::exception("PoseDatabase::getPose(): frame out of range");
+		pose.resize(m_nVars);
+		getPose(m_clips[clip].firstFrame + frameInClip, pose.data());
+	}
+
+	void PoseDatabase::pack(std::string poseRoot, std::string filename, Storage storage, float dedupTolerance)
+	{
+		// the clips, the same order with QDir::entryList()
+		std::vector<std::string> files, clipNames;
+		ldp::getAllFilesInDir(poseRoot, files, ".xml");
+		const std::string root = ldp::fullfile(poseRoot, "");
+		for (const auto& f : files)
+		{
+			std::string name = f.substr(root.size());
+			if (name.find_first_of("/\\") == std::string::npos)
+				clipNames.push_back(name);
+		}
+		std::sort(clipNames.begin(), clipNames.end(), [](const std::string& a, const std::string& b){
+			return poseDbLower(a) < poseDbLower(b);
+		});
+		if (clipNames.empty())
+			throw std::exception(("no pose given in " + poseRoot).c_str());
+
+		// parse all frames, a pose within the tolerance of an earlier one of the same cell is shared
+		std::vector<Clip> clips;
+		std::vector<Frame> frames;
+		std::vector<char> names;
+		std::vector<float> poses;
+		std::unordered_map<unsigned long long, std::vector<int>> cells;
+		int nVars = 0;
+		std::vector<float> pose;
+		for (const auto& clipName : clipNames)
+		{
+			const std::string xml = ldp::fullfile(poseRoot, clipName);
+			TiXmlDocument doc;
+			if (!doc.LoadFile(xml.c_str()))
+				throw std::exception(("IOError" + xml + "]: " + doc.ErrorDesc()).c_str());
+			Clip clip;
+			clip.firstFrame = (int)frames.size();
+			clip.nFrames = 0;
+			clip.nameOffset = (int)names.size();
+			clip.nameLength = (int)clipName.size();
+			names.insert(names.end(), clipName.begin(), clipName.end());
+			for (auto coeffElm = doc.FirstChildElement() ? doc.FirstChildElement()->FirstChildElement() : nullptr;
+				coeffElm; coeffElm = coeffElm->NextSiblingElement())
+			{
+				const TiXmlElement* poseElm = coeffElm->FirstChildElement("pose");
+				if (poseElm == nullptr || poseElm->Attribute("value") == nullptr)
+					throw std::exception(("xmlError: no pose value in " + xml).c_str());
+				pose.clear();
+				std::stringstream stm(poseElm->Attribute("value"));
+				float v = 0.f;
+				while (stm >> v)
+					pose.push_back(v);
+				if (nVars == 0)
+					nVars = (int)pose.size();
+				if (nVars == 0 || (int)pose.size() != nVars)
+					throw std::exception(("xmlError: pose size not consistent in " + xml).c_str());
+
+				Frame frame;
+				frame.pose = -1;
+				frame.sourceId = 0;
+				coeffElm->QueryIntAttribute("frameId", &frame.sourceId);
+				unsigned long long cellKey = 1469598103934665603ull;
+				if (dedupTolerance > 0.f)
+				{
+					for (int k = 0; k < nVars; k++)
+						cellKey = (cellKey ^ (unsigned long long)(long long)floor(pose[k] / dedupTolerance))
+						* 1099511628211ull;
+					for (int p : cells[cellKey])
+					{
+						float diff = 0.f;
+						for (int k = 0; k < nVars; k++)
+							diff = std::max(diff, fabsf(poses[size_t(p) * nVars + k] - pose[k]));
+						if (diff <= dedupTolerance)
+						{
+							frame.pose = p;
+							break;
+						}
+					}
+				}
+				if (frame.pose < 0)
+				{
+					frame.pose = (int)(poses.size() / nVars);
+					poses.insert(poses.end(), pose.begin(), pose.end());
+					if (dedupTolerance > 0.f)
+						cells[cellKey].push_back(frame.pose);
+				}
+				frames.push_back(frame);
+				clip.nFrames++;
+			} // end for coeffElm
+			// a clip without frames can not be sampled, thus not packed
+			if (clip.nFrames == 0)
+			{
+				printf("warning: PoseDatabase::pack(), no frame in %s, skipped\n", xml.c_str());
+				names.resize(clip.nameOffset);
+				continue;
+			}
+			clips.push_back(clip);
+		} // end for clipName
+		if (clips.empty())
+			throw std::exception(("no pose frame given in " + poseRoot).c_str());
+		names.resize((names.size() + 3) / 4 * 4, 0);
+
+		PoseDatabaseHeader h;
+		memcpy(h.magic, g_pose_db_magic, sizeof(h.magic));
+		h.version = POSE_DATABASE_VERSION;
+		h.storage = storage;
+		h.nVars = nVars;
+		h.nClips = (int)clips.size();
+		h.nFrames = (int)frames.size();
+		h.nPoses = (int)(poses.size() / nVars);
+		h.namesBytes = (int)names.size();
+		std::fstream output(filename, std::ios::out | std::ios::binary);
+		if (output.fail())
+			throw std::exception(("IOError: " + filename).c_str());
+		output.write((const char*)&h, sizeof(h));
+		output.write((const char*)clips.data(), clips.size() * sizeof(Clip));
+		output.write((const char*)frames.data(), frames.size() * sizeof(Frame));
+		output.write(names.data(), names.size());
+		if (storage == StorageFloat32)
+			output.write((const char*)poses.data(), poses.size() * sizeof(float));
+		else
+		{
+			std::vector<half_float::detail::uint16> codes(poses.size());
+			for (size_t i = 0; i < poses.size(); i++)
+				codes[i] = half_float::detail::float2half<std::round_to_nearest>(poses[i]);
+			output.write((const char*)codes.data(), codes.size() * sizeof(half_float::detail::uint16));
+		}
+		if (output.fail())
+			throw std::exception(("IOError, write failed: " + filename).c_str());
+		output.close();
+	}
+}
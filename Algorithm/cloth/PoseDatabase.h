@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+
+namespace ldp
+{
+	class MappedFile;
+	// An indexed binary database of the mocap pose clips, i.e., a folder of <clip>.smpl.xml files, each a list of
+	//	SmplCoeff elements with a "pose" value; pack() parses them once, and the database is then read from
+	//	the memory mapped file, a frame of any clip at O(1) without any xml parsing.
+	// The clips are in the order of QDir::entryList(), i.e., sorted case insensitive, the same with the batch
+	//	simulation, so that the random pose choices are unchanged.
+	// The poses are float32 or float16; with a dedup tolerance, a frame whose pose falls in the same tolerance cell
+	//	and is within the tolerance (max abs) of an earlier pose shares its storage, e.g., the still frames of a clip.
+	class PoseDatabase
+	{
+	public:
+		enum Storage
+		{
+			StorageFloat32 = 0,
+			StorageHalf,
+		};
+	public:
+		PoseDatabase();
+		~PoseDatabase();
+
+		void clear();
+		// throw if failed
+		void open(std::string filename);
+		bool isOpen()const { return m_file.get() != nullptr; }
+
+		// pack all the clips of poseRoot into filename
+		static void pack(std::string poseRoot, std::string filename,
+			Storage storage = StorageFloat32, float dedupTolerance = 0.f);
+		// the default database of a pose folder, <poseRoot>/poses.pdb
+		static std::string defaultFilename(std::string poseRoot);
+
+		int numClips()const { return m_nClips; }
+		int numFrames()const { return m_nFrames; }
+		int numPoses()const { return m_nPoses; }
+		int numVarsPerPose()const { return m_nVars; }
+		// the xml name of a clip, relative to the pose root, e.g., 01_01.smpl.xml
+		std::string clipName(int clip)const;
+		int clipFirstFrame(int clip)const;
+		int clipNumFrames(int clip)const;
+		// -1 if not found
+		int findClip(std::string name)const;
+		// the "frameId" of the SmplCoeff element, i.e., the frame in the source mocap
+		int frameSourceId(int frame)const;
+
+		// numVarsPerPose() values, the order of SmplManager::setPoseShapeVals()
+		void getPose(int frame, float* pose)const;
+		void getPose(int clip, int frameInClip, std::vector<float>& pose)const;
+	protected:
+		struct Clip
+		{
+			int firstFrame;
+			int nFrames;
+			int nameOffset;				// in the name section, not null-terminated
+			int nameLength;
+		};
+		struct Frame
+		{
+			int pose;
+			int sourceId;
+		};
+	private:
+		std::shared_ptr<MappedFile> m_file;
+		int m_storage = StorageFloat32;
+		int m_nVars = 0;
+		int m_nClips = 0;
+		int m_nFrames = 0;
+		int m_nPoses = 0;
+		const Clip* m_clips = nullptr;
+		const Frame* m_frames = nullptr;
+		const char* m_names = nullptr;
+		const void* m_poses = nullptr;
+		std::map<std::string, int> m_clipIds;
+	};
+}
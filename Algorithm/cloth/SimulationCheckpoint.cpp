@@ -0,0 +1,87 @@
+#include "SimulationCheckpoint.h"
+#include <fstream>
+#include <cstring>
+
+namespace ldp
+{
+	static const char g_checkpoint_magic[4] = { 'C', 'D', 'C', 'K' };
+
+	void SimulationCheckpoint::clear()
+	{
+		fingerprint = 0;
+		curSimulationTime = 0.f;
+		curStitchRatio = 0.f;
+		x.clear();
+		v.clear();
+		last_x.clear();
+		last_v.clear();
+		dv.clear();
+		fixPosition_vw.clear();
+	}
+
+	bool SimulationCheckpoint::isValid()const
+	{
+		const size_t n = x.size();
+		return v.size() == n && last_x.size() == n && last_v.size() == n
+			&& dv.size() == n && fixPosition_vw.size() == n;
+	}
+
+	void SimulationCheckpoint::save(std::string filename)const
+	{
+		if (!isValid())
+			throw std::exception("SimulationCheckpoint::save(): array sizes not matched!");
+		std::fstream output(filename, std::ios::out | std::ios::binary);
+		if (output.fail())
+			throw std::exception(("IOError: " + filename).c_str());
+		const int version = VERSION;
+		const int nVerts = numVerts();
+		output.write(g_checkpoint_magic, sizeof(g_checkpoint_magic));
+		output.write((const char*)&version, sizeof(version));
+		output.write((const char*)&fingerprint, sizeof(fingerprint));
+		output.write((const char*)&nVerts, sizeof(nVerts));
+		output.write((const char*)&curSimulationTime, sizeof(curSimulationTime));
+		output.write((const char*)&curStitchRatio, sizeof(curStitchRatio));
+		for (const std::vector<Float3>* a : { &x, &v, &last_x, &last_v, &dv })
+			output.write((const char*)a->data(), nVerts*sizeof(Float3));
+		output.write((const char*)fixPosition_vw.data(), nVerts*sizeof(Float4));
+		if (output.fail())
+			throw std::exception(("IOError, write failed: " + filename).c_str());
+		output.close();
+	}
+
+	void SimulationCheckpoint::load(std::string filename)
+	{
+		std::fstream input(filename, std::ios::in | std::ios::binary);
+		if (input.fail())
+			throw std::exception(("IOError: " + filename).c_str());
+		char magic[4] = { 0 };
+		int version = 0, nVerts = 0;
+		input.read(magic, sizeof(magic));
+		input.read((char*)&version, sizeof(version));
+		if (memcmp(magic, g_checkpoint_magic, sizeof(magic)) != 0 || version != VERSION)
+			throw std::exception(("not a supported simulation checkpoint: " + filename).c_str());
+		input.read((char*)&fingerprint, sizeof(fingerprint));
+		input.read((char*)&nVerts, sizeof(nVerts));
+		input.read((char*)&curSimulationTime, sizeof(curSimulationTime));
+		input.read((char*)&curStitchRatio, sizeof(curStitchRatio));
+		if (input.fail() || nVerts < 0)
+			throw std::exception(("broken simulation checkpoint: " + filename).c_str());
+		// the arrays must fill the rest of the file, checked before allocating them
+		const std::streamoff arrayBegin = input.tellg();
+		input.seekg(0, std::ios::end);
+		const std::streamoff arrayBytes = input.tellg() - arrayBegin;
+		input.seekg(arrayBegin, std::ios::beg);
+		if (input.fail() || arrayBytes != std::streamoff(nVerts) * (5 * sizeof(Float3) + sizeof(Float4)))
+			throw std::exception(("broken simulation checkpoint: " + filename).c_str());
+		for (std::vector<Float3>* a : { &x, &v, &last_x, &last_v, &dv })
+		{
+			a->resize(nVerts);
+			input.read((char*)a->data(), nVerts*sizeof(Float3));
+		}
+		fixPosition_vw.resize(nVerts);
+		input.read((char*)fixPosition_vw.data(), nVerts*sizeof(Float4));
+		if (input.fail())
+			throw std::exception(("broken simulation checkpoint: " + filename).c_str());
+		input.close();
+	}
+}
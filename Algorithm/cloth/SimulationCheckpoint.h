@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "ldpMat\ldp_basic_vec.h"
+#include "SparseStructureCache.h"
+
+namespace ldp
+{
+	// The numeric state of a cloth simulation, restorable into a simulator of the same topology:
+	//	positions, velocities, fixed constraints and the stitching progress.
+	// Binary file layout (little endian):
+	//	magic "CDCK", int version, uint64 fingerprint, int nVerts, float curSimulationTime, float curStitchRatio,
+	//	then x, v, last_x, last_v, dv (nVerts Float3 each) and fixPosition_vw (nVerts Float4).
+	class SimulationCheckpoint
+	{
+	public:
+		enum{ VERSION = 1 };
+	public:
+		TopologyFingerprint::ValueType fingerprint = 0;
+		float curSimulationTime = 0.f;
+		float curStitchRatio = 0.f;
+		std::vector<Float3> x;
+		std::vector<Float3> v;
+		std::vector<Float3> last_x;
+		std::vector<Float3> last_v;
+		std::vector<Float3> dv;					// the last velocity change, for pcg warm start
+		std::vector<Float4> fixPosition_vw;		// (target, weight) of each vertex
+	public:
+		void clear();
+		int numVerts()const{ return (int)x.size(); }
+		bool isValid()const;					// all arrays of the same size
+
+		void save(std::string filename)const;
+		void load(std::string filename);
+	};
+}
@@ -0,0 +1,172 @@
+#include "SimulationProfiler.h"
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+namespace ldp
+{
+	SimulationProfiler::ScopedTimer::ScopedTimer(SimulationProfiler& profiler, const char* name)
+		: m_profiler(profiler), m_name(name)
+	{
+		if (m_profiler.isEnabled())
+			m_begin = m_profiler.now();
+	}
+
+	SimulationProfiler::ScopedTimer::~ScopedTimer()
+	{
+		if (m_profiler.isEnabled())
+			m_profiler.addTimer(m_name, m_begin, m_profiler.now());
+	}
+
+	SimulationProfiler::SimulationProfiler()
+	{
+		m_records.resize(4096);
+		clear();
+	}
+
+	SimulationProfiler::~SimulationProfiler()
+	{
+
+	}
+
+	void SimulationProfiler::clear()
+	{
+		m_head = 0;
+		m_nRecords = 0;
+		m_step = 0;
+		m_origin = gtime_now();
+	}
+
+	void SimulationProfiler::setCapacity(int n)
+	{
+		// keep the newest records
+		std::vector<Record> records;
+		for (int i = std::max(0, m_nRecords - n); i < m_nRecords; i++)
+			records.push_back(record(i));
+		m_nRecords = (int)records.size();
+		records.resize(std::max(1, n));
+		m_records.swap(records);
+		m_head = m_nRecords % (int)m_records.size();
+	}
+
+	const SimulationProfiler::Record& SimulationProfiler::record(int i)const
+	{
+		const int cap = (int)m_records.size();
+		return m_records[(m_head - m_nRecords + i + cap) % cap];
+	}
+
+	double SimulationProfiler::now()const
+	{
+		return gtime_seconds(m_origin, gtime_now()) * 1e6;
+	}
+
+	void SimulationProfiler::addTimer(const char* name, double beginTime, double endTime)
+	{
+		if (!m_enabled)
+			return;
+		Record r;
+		r.name = name;
+		r.type = RecordTimer;
+		r.step = m_step;
+		r.time = beginTime;
+		r.value = endTime - beginTime;
+		push(r);
+	}
+
+	void SimulationProfiler::addCounter(const char* name, double value)
+	{
+		if (!m_enabled)
+			return;
+		Record r;
+		r.name = name;
+		r.type = RecordCounter;
+		r.step = m_step;
+		r.time = now();
+		r.value = value;
+		push(r);
+	}
+
+	void SimulationProfiler::push(const Record& r)
+	{
+		m_records[m_head] = r;
+		m_head = (m_head + 1) % (int)m_records.size();
+		m_nRecords = std::min(m_nRecords + 1, (int)m_records.size());
+	}
+
+	std::string SimulationProfiler::getSummary()const
+	{
+		if (m_nRecords == 0)
+			return "";
+		const int nSteps = std::max(1, record(m_nRecords - 1).step - record(0).step + 1);
+		std::vector<const Record*> firsts;
+		std::vector<double> sums;
+		std::vector<int> cnts;
+		for (int i = 0; i < m_nRecords; i++)
+		{
+			const Record& r = record(i);
+			size_t k = 0;
+			for (; k < firsts.size(); k++)
+			if (firsts[k]->type == r.type && strcmp(firsts[k]->name, r.name) == 0)
+				break;
+			if (k == firsts.size())
+			{
+				firsts.push_back(&r);
+				sums.push_back(0.0);
+				cnts.push_back(0);
+			}
+			sums[k] += r.value;
+			cnts[k]++;
+		} // end for i
+
+		std::string info;
+		char buf[256];
+		for (size_t k = 0; k < firsts.size(); k++)
+		{
+			if (firsts[k]->type == RecordTimer)
+				sprintf(buf, "%s%s %.3fms", info.empty() ? "" : ", ", firsts[k]->name, sums[k] / nSteps * 1e-3);
+			else
+				sprintf(buf, "%s%s %.1f", info.empty() ? "" : ", ", firsts[k]->name, sums[k] / cnts[k]);
+			info += buf;
+		}
+		return info;
+	}
+
+	void SimulationProfiler::exportCsv(std::string filename)const
+	{
+		std::ofstream stm(filename);
+		if (stm.fail())
+			throw std::exception(("IOError: " + filename).c_str());
+		stm << "step,type,name,time_us,value\n";
+		char buf[512];
+		for (int i = 0; i < m_nRecords; i++)
+		{
+			const Record& r = record(i);
+			sprintf(buf, "%d,%s,%s,%.3f,%.3f\n", r.step, r.type == RecordTimer ? "timer" : "counter",
+				r.name, r.time, r.value);
+			stm << buf;
+		}
+		stm.close();
+	}
+
+	void SimulationProfiler::exportChromeTrace(std::string filename)const
+	{
+		std::ofstream stm(filename);
+		if (stm.fail())
+			throw std::exception(("IOError: " + filename).c_str());
+		stm << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		char buf[512];
+		for (int i = 0; i < m_nRecords; i++)
+		{
+			const Record& r = record(i);
+			if (r.type == RecordTimer)
+				sprintf(buf, "{\"name\":\"%s\",\"cat\":\"sim\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+				"\"pid\":0,\"tid\":0,\"args\":{\"step\":%d}}", r.name, r.time, r.value, r.step);
+			else
+				sprintf(buf, "{\"name\":\"%s\",\"cat\":\"sim\",\"ph\":\"C\",\"ts\":%.3f,"
+				"\"pid\":0,\"tid\":0,\"args\":{\"value\":%g}}", r.name, r.time, r.value);
+			stm << buf << (i + 1 < m_nRecords ? ",\n" : "\n");
+		}
+		stm << "]}\n";
+		stm.close();
+	}
+}
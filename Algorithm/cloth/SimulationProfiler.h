@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include "ldpMat\ldpdef.h"
+
+namespace ldp
+{
+	// Per-stage timers and counters of the simulation steps, kept in a ring buffer:
+	//	the oldest records are overwritten when the capacity is exceeded.
+	// Records can be exported as csv, or as chrome trace json (chrome://tracing).
+	// Not thread-safe: each simulator owns its profiler, records are only added out of parallel regions.
+	// Disabled by default, since the gpu stages are synchronized when profiling; call setEnabled() to record.
+	class SimulationProfiler
+	{
+	public:
+		enum RecordType
+		{
+			RecordTimer,
+			RecordCounter,
+		};
+		struct Record
+		{
+			const char* name = nullptr;		// should be a string literal
+			RecordType type = RecordTimer;
+			int step = 0;
+			double time = 0.0;				// microseconds since the profiler cleared
+			double value = 0.0;				// duration in microseconds for timers
+		};
+		// measures the enclosing scope
+		class ScopedTimer
+		{
+		public:
+			ScopedTimer(SimulationProfiler& profiler, const char* name);
+			~ScopedTimer();
+		private:
+			SimulationProfiler& m_profiler;
+			const char* m_name = nullptr;
+			double m_begin = 0.0;
+		};
+	public:
+		SimulationProfiler();
+		~SimulationProfiler();
+
+		void clear();
+		void setEnabled(bool enable){ m_enabled = enable; }
+		bool isEnabled()const{ return m_enabled; }
+		void setCapacity(int n);
+		int capacity()const{ return (int)m_records.size(); }
+		int numRecords()const{ return m_nRecords; }
+		const Record& record(int i)const;	// 0 is the oldest
+
+		// each simulation step should call it once at its beginning
+		void beginStep(){ m_step++; }
+		int currentStep()const{ return m_step; }
+
+		// microseconds since the profiler cleared
+		double now()const;
+		void addTimer(const char* name, double beginTime, double endTime);
+		void addCounter(const char* name, double value);
+
+		// average of each timer/counter over the recorded steps
+		std::string getSummary()const;
+
+		// step,type,name,time_us,value
+		void exportCsv(std::string filename)const;
+		void exportChromeTrace(std::string filename)const;
+	protected:
+		void push(const Record& r);
+	private:
+		std::vector<Record> m_records;
+		int m_head = 0;		// the next position to write
+		int m_nRecords = 0;
+		int m_step = 0;
+		bool m_enabled = false;
+		gtime_t m_origin;
+	};
+}
@@ -8,7 +8,10 @@
 #include "BFGS\BFGSFit.h"
 #include "LMSolver.h"
 #include "TinyXML\tinyxml.h"
+#include "MappedFile.h"
 #include <fstream>
+#include <sys\stat.h>
+#include <process.h>
 
 #pragma region --mat_utils
 
@@ -723,6 +726,20 @@ void SmplManager::clear()
 	m_curVerts.clear();
 	m_curFNormals.clear();
 	m_curVNormals.clear();
+	m_curCacheValid = false;
+	m_cachedShapes.resize(0, 0);
+	m_cachedPoseVec.resize(0, 0);
+	m_curVShaped.resize(0, 0);
+	m_curPoseBlend.resize(0, 0);
+	m_skinnedVPosed.clear();
+	m_skinnedJrots.clear();
+	m_skinnedJtrans.clear();
+	m_vertFaceBegin.clear();
+	m_vertFaces.clear();
+	m_batchCache.reset();
+	m_shapeFitJrots.clear();
+	m_shapeFitA.resize(0, 0);
+	m_shapeFitH.resize(0, 0);
 	m_bbox[0] = 0;
 	m_bbox[1] = 0;
 	m_selectedNode = 0;
@@ -811,41 +828,339 @@ void SmplManager::loadFromMat(const char* filename)
 	// close
 	Mat_Close(file);
 	m_inited = true;
+	m_curCacheValid = false;
 
 	updateCurMesh();
 }
 
+#pragma region --binary model
+
+// versioned binary model (little endian): SmplModelFileHeader, int faces[nFaces * 3], int kintree_table[nJoints],
+//	int vert_sym_idxs[nSymIdxs], float J[nJoints * 3], v_template[nVerts * 3], shapedirs[3 * nVerts * nShapes],
+//	posedirs[3 * nVerts * nPoseDirs], all column major, then the CSR sparse matrices: J_regressor and 
+//	J_regressor_prior of nJoints rows, weights and weights_prior of nVerts rows, each int rowBegin[rows + 1], 
+//	int cols[nnz], float values[nnz]. All sections are 4-byte aligned, read in place from the mapped file.
+struct SmplModelFileHeader
+{
+	char magic[4];
+	int version;
+	long long matBytes;			// the size and modification time of the source .mat, 0 if none
+	long long matTime;
+	int bsStyle;
+	int bsType;
+	int nVerts;
+	int nFaces;
+	int nJoints;
+	int nShapes;
+	int nPoseDirs;
+	int nSymIdxs;
+	int nnz[4];					// J_regressor, J_regressor_prior, weights, weights_prior
+};
+static const char g_smpl_model_magic[4] = { 'C', 'D', 'S', 'M' };
+enum{ SMPL_MODEL_FILE_VERSION = 1 };
+typedef Eigen::SparseMatrix<float, Eigen::RowMajor, int> SpMatCsrf;
+
+static void write_dense(std::fstream& out, const DMat& A)
+{
+	Eigen::MatrixXf Af = A.cast<float>();
+	out.write((const char*)Af.data(), Af.size() * sizeof(float));
+}
+
+static void write_csr(std::fstream& out, const SpMatCsrf& A)
+{
+	out.write((const char*)A.outerIndexPtr(), (A.rows() + 1) * sizeof(int));
+	out.write((const char*)A.innerIndexPtr(), A.nonZeros() * sizeof(int));
+	out.write((const char*)A.valuePtr(), A.nonZeros() * sizeof(float));
+}
+
+static const unsigned char* read_dense(DMat& out, const unsigned char* p, int rows, int cols)
+{
+	out = Eigen::Map<const Eigen::MatrixXf>((const float*)p, rows, cols).cast<real>();
+	return p + size_t(rows) * cols * sizeof(float);
+}
+
+static const unsigned char* read_csr(Eigen::SparseMatrix<real, Eigen::RowMajor, int>& out, 
+	const unsigned char* p, int rows, int cols, int nnz)
+{
+	const int* rowBegin = (const int*)p;
+	const int* colIds = rowBegin + rows + 1;
+	const float* values = (const float*)(colIds + nnz);
+	CHECK_THROW_EXCPT(rowBegin[0] == 0 && rowBegin[rows] == nnz);
+	for (int i = 0; i < rows; i++)
+		CHECK_THROW_EXCPT(rowBegin[i] <= rowBegin[i + 1]);
+	for (int i = 0; i < nnz; i++)
+		CHECK_THROW_EXCPT(colIds[i] >= 0 && colIds[i] < cols);
+	out.resize(rows, cols);
+	out.resizeNonZeros(nnz);
+	std::copy(rowBegin, rowBegin + rows + 1, out.outerIndexPtr());
+	std::copy(colIds, colIds + nnz, out.innerIndexPtr());
+	for (int i = 0; i < nnz; i++)
+		out.valuePtr()[i] = values[i];
+	return (const unsigned char*)(values + nnz);
+}
+
+// the size and modification time of a file, false if not exist
+static bool file_stamp(const std::string& filename, long long& bytes, long long& time)
+{
+	struct _stat64 st;
+	if (_stat64(filename.c_str(), &st) != 0)
+		return false;
+	bytes = st.st_size;
+	time = st.st_mtime;
+	return true;
+}
+
+void SmplManager::loadModel(std::string filename)
+{
+	ldp::MappedFile file;
+	file.open(filename);
+	SmplModelFileHeader h;
+	if (file.size() < sizeof(h) || memcmp(file.data(), g_smpl_model_magic, sizeof(g_smpl_model_magic)) != 0)
+		throw std::exception(("not a smpl model file: " + filename).c_str());
+	memcpy(&h, file.data(), sizeof(h));
+	if (h.version != SMPL_MODEL_FILE_VERSION)
+		throw std::exception(("not a supported smpl model version: " + filename).c_str());
+	const int N = h.nVerts, J = h.nJoints;
+	size_t expectedBytes = sizeof(h) + (size_t(h.nFaces) * 3 + J + h.nSymIdxs + J * 3 + N * 3) * sizeof(int)
+		+ size_t(N) * 3 * (h.nShapes + h.nPoseDirs) * sizeof(float) + (size_t(J) * 2 + N * 2 + 4) * sizeof(int);
+	for (int k = 0; k < 4; k++)
+		expectedBytes += size_t(h.nnz[k]) * (sizeof(int) + sizeof(float));
+	if (N <= 0 || J <= 0 || h.nFaces < 0 || h.nShapes < 0 || h.nPoseDirs < 0 || h.nSymIdxs < 0
+		|| file.size() != expectedBytes)
+		throw std::exception(("broken smpl model file: " + filename).c_str());
+
+	clear();
+	m_bsStyle = (BsStyle)h.bsStyle;
+	m_bsType = (BsType)h.bsType;
+	const int* ints = (const int*)(file.data() + sizeof(h));
+	m_faces.resize(h.nFaces);
+	for (int i = 0; i < h.nFaces; i++)
+	for (int k = 0; k < 3; k++)
+	{
+		m_faces[i][k] = ints[i * 3 + k];
+		CHECK_THROW_EXCPT(m_faces[i][k] >= 0 && m_faces[i][k] < N);
+	}
+	ints += h.nFaces * 3;
+	m_kintree_table.assign(ints, ints + J);
+	ints += J;
+	m_vert_sym_idxs.assign(ints, ints + h.nSymIdxs);
+	ints += h.nSymIdxs;
+
+	const unsigned char* p = (const unsigned char*)ints;
+	p = read_dense(m_J, p, J, 3);
+	p = read_dense(m_v_template, p, N, 3);
+	p = read_dense(m_shapedirs, p, N * 3, h.nShapes);
+	p = read_dense(m_posedirs, p, N * 3, h.nPoseDirs);
+	Eigen::SparseMatrix<real, Eigen::RowMajor, int> csr;
+	p = read_csr(csr, p, J, N, h.nnz[0]);
+	m_J_regressor = csr;
+	p = read_csr(csr, p, J, N, h.nnz[1]);
+	m_J_regressor_prior = csr;
+	// the vertex rows, i.e., the column major joints x vertices
+	p = read_csr(csr, p, N, J, h.nnz[2]);
+	m_weights = csr.transpose();
+	p = read_csr(csr, p, N, J, h.nnz[3]);
+	m_weights_prior = csr.transpose();
+	file.close();
+
+	m_curPoses.resize(J, 3);
+	m_curPoses.setZero();
+	m_curShapes.resize(h.nShapes, 1);
+	m_curShapes.setZero();
+	m_inited = true;
+	m_curCacheValid = false;
+	updateCurMesh();
+}
+
+void SmplManager::saveModel(std::string filename)const
+{
+	saveModel(filename, 0, 0);
+}
+
+void SmplManager::saveModel(std::string filename, long long matBytes, long long matTime)const
+{
+	if (!m_inited)
+		throw std::exception("SmplManager::saveModel(): not initialized");
+	SpMatCsrf csr[4];
+	csr[0] = m_J_regressor.cast<float>();
+	csr[1] = m_J_regressor_prior.cast<float>();
+	csr[2] = SpMat(m_weights.transpose()).cast<float>();
+	csr[3] = SpMat(m_weights_prior.transpose()).cast<float>();
+	SmplModelFileHeader h;
+	memcpy(h.magic, g_smpl_model_magic, sizeof(h.magic));
+	h.version = SMPL_MODEL_FILE_VERSION;
+	h.matBytes = matBytes;
+	h.matTime = matTime;
+	h.bsStyle = m_bsStyle;
+	h.bsType = m_bsType;
+	h.nVerts = numVerts();
+	h.nFaces = (int)m_faces.size();
+	h.nJoints = (int)m_J.rows();
+	h.nShapes = (int)m_shapedirs.cols();
+	h.nPoseDirs = (int)m_posedirs.cols();
+	h.nSymIdxs = (int)m_vert_sym_idxs.size();
+	for (int k = 0; k < 4; k++)
+	{
+		csr[k].makeCompressed();
+		h.nnz[k] = (int)csr[k].nonZeros();
+	}
+
+	std::fstream output(filename, std::ios::out | std::ios::binary);
+	if (output.fail())
+		throw std::exception(("IOError: " + filename).c_str());
+	output.write((const char*)&h, sizeof(h));
+	output.write((const char*)m_faces.data(), m_faces.size() * sizeof(Face));
+	output.write((const char*)m_kintree_table.data(), m_kintree_table.size() * sizeof(int));
+	output.write((const char*)m_vert_sym_idxs.data(), m_vert_sym_idxs.size() * sizeof(int));
+	write_dense(output, m_J);
+	write_dense(output, m_v_template);
+	write_dense(output, m_shapedirs);
+	write_dense(output, m_posedirs);
+	for (int k = 0; k < 4; k++)
+		write_csr(output, csr[k]);
+	if (output.fail())
+		throw std::exception(("IOError, write failed: " + filename).c_str());
+	output.close();
+	printf("Write data into file %s successfully.\n", filename.c_str());
+}
+
+void SmplManager::loadFromMatCached(const char* filename)
+{
+	std::string binName = filename;
+	const size_t dot = binName.find_last_of('.');
+	if (dot != std::string::npos && binName.find_first_of("/\\", dot) == std::string::npos)
+		binName = binName.substr(0, dot);
+	binName += ".smplbin";
+
+	// the cache is valid if built from the same .mat, or if the .mat is not shipped
+	long long matBytes = 0, matTime = 0, binBytes = 0, binTime = 0;
+	const bool hasMat = file_stamp(filename, matBytes, matTime);
+	if (file_stamp(binName, binBytes, binTime))
+	{
+		SmplModelFileHeader h;
+		std::fstream input(binName, std::ios::in | std::ios::binary);
+		input.read((char*)&h, sizeof(h));
+		if (!input.fail() && (!hasMat || (h.matBytes == matBytes && h.matTime == matTime)))
+		{
+			try
+			{
+				loadModel(binName);
+				return;
+			} catch (std::exception e)
+			{
+				printf("warning: %s\n", e.what());
+			}
+		}
+	}
+
+	// else rebuild it, write then rename so that another process never sees a broken file
+	loadFromMat(filename);
+	const std::string tmpName = binName + "." + std::to_string(_getpid()) + ".tmp";
+	try
+	{
+		saveModel(tmpName, matBytes, matTime);
+		std::remove(binName.c_str());
+		if (std::rename(tmpName.c_str(), binName.c_str()) != 0)
+			throw std::exception(("IOError, rename failed: " + binName).c_str());
+	} catch (std::exception e)
+	{
+		printf("warning: %s\n", e.what());
+		std::remove(tmpName.c_str());
+	}
+}
+
+#pragma endregion
+
+// a vertex whose rest position moved less than this since its last skinning is not re-skinned,
+//	the pose blend of a joint changes the far vertices by tiny values only
+static const real SMPL_SKIN_TOLERANCE = 1e-7;
+// the pose blend is recomputed once such incremental updates, against the accumulated round-off
+enum{ SMPL_POSE_BLEND_REFRESH = 32 };
+
 void SmplManager::updateCurMesh()
 {
+	const int nVerts = (int)m_v_template.rows();
+	const int nJoints = (int)m_curPoses.rows();
+	if (m_vertFaceBegin.empty())
+	{
+		// the faces around each vertex, for the partial normal update and evaluateBatch()
+		m_vertFaceBegin.assign(nVerts + 1, 0);
+		for (size_t i = 0; i < m_faces.size(); i++)
+		for (int k = 0; k < 3; k++)
+			m_vertFaceBegin[m_faces[i][k] + 1]++;
+		for (int i = 0; i < nVerts; i++)
+			m_vertFaceBegin[i + 1] += m_vertFaceBegin[i];
+		m_vertFaces.resize(m_vertFaceBegin.back());
+		std::vector<int> pos(m_vertFaceBegin.begin(), m_vertFaceBegin.end() - 1);
+		for (size_t i = 0; i < m_faces.size(); i++)
+		for (int k = 0; k < 3; k++)
+			m_vertFaces[pos[m_faces[i][k]]++] = (int)i;
+	}
+
 	// 1. update vertices-------------------------------------------------
 
-	// apply shape vec
-	DMat v_shaped = m_shapedirs * m_curShapes;
-	v_shaped.resize(m_v_template.rows(), m_v_template.cols());
-	v_shaped += m_v_template;
-	m_curJ = m_J_regressor * v_shaped;
+	// apply shape vec, only if changed
+	if (!m_curCacheValid || m_cachedShapes.size() != m_curShapes.size() || m_cachedShapes != m_curShapes)
+	{
+		m_curVShaped = m_shapedirs * m_curShapes;
+		m_curVShaped.resize(m_v_template.rows(), m_v_template.cols());
+		m_curVShaped += m_v_template;
+		m_curJ = m_J_regressor * m_curVShaped;
+		m_cachedShapes = m_curShapes;
+	}
 
-	// apply pose vec
-	DMat v_posed, poseVec;
+	// apply pose vec, by the columns of the joints whose features changed
+	DMat poseVec;
 	calcPoseVector207(m_curPoses, poseVec);
-	v_posed = m_posedirs * poseVec;
-	v_posed.resize(m_v_template.rows(), m_v_template.cols());
-	v_posed += v_shaped;
-
-	// updating to the vertex buffer
-	m_curVerts.resize(m_v_template.rows());
-	for (size_t i = 0; i < m_curVerts.size(); i++)
-	for (int k = 0; k < 3; k++)
-		m_curVerts[i][k] = v_posed(i, k);
+	std::vector<int> changedFeatures;
+	if (m_curCacheValid && m_curPoseBlendUpdates < SMPL_POSE_BLEND_REFRESH)
+	{
+		for (int j = 1; j < nJoints; j++)
+		if (poseVec.middleRows((j - 1) * 9, 9) != m_cachedPoseVec.middleRows((j - 1) * 9, 9))
+			changedFeatures.push_back(j - 1);
+	}
+	if (!m_curCacheValid || m_curPoseBlendUpdates >= SMPL_POSE_BLEND_REFRESH || (int)changedFeatures.size() * 2 > nJoints)
+	{
+		m_curPoseBlend = m_posedirs * poseVec;
+		m_curPoseBlendUpdates = 0;
+	}
+	else if (!changedFeatures.empty())
+	{
+		for (int f : changedFeatures)
+			m_curPoseBlend += m_posedirs.middleCols(f * 9, 9) * (poseVec.middleRows(f * 9, 9) 
+			- m_cachedPoseVec.middleRows(f * 9, 9));
+		m_curPoseBlendUpdates++;
+	}
+	m_cachedPoseVec = poseVec;
 
-	// apply joint rotations
+	// the joints whose global transforms changed since the last skinning, a rotation changes its sub tree
 	calcGlobalTrans();
+	std::vector<char> jointChanged(nJoints, 1);
+	if (m_curCacheValid)
+	{
+		for (int j = 0; j < nJoints; j++)
+			jointChanged[j] = m_curJrots[j] != m_skinnedJrots[j] || m_curJtrans[j] != m_skinnedJtrans[j];
+	}
+	m_skinnedJrots = m_curJrots;
+	m_skinnedJtrans = m_curJtrans;
+
+	// apply joint rotations to the vertices affected
+	m_curVerts.resize(nVerts);
+	m_skinnedVPosed.resize(nVerts);
+	std::vector<char> vertChanged(nVerts, 0);
 #pragma omp parallel for
-	for (int iVerts = 0; iVerts < (int)m_curVerts.size(); iVerts++)
+	for (int iVerts = 0; iVerts < nVerts; iVerts++)
 	{
-		Vec3 v = m_curVerts[iVerts];
+		Vec3 v;
+		for (int k = 0; k < 3; k++)
+			v[k] = m_curVShaped(iVerts, k) + m_curPoseBlend(k * nVerts + iVerts);
 		int wb = m_weights.outerIndexPtr()[iVerts];
 		int we = m_weights.outerIndexPtr()[iVerts + 1];
+		bool changed = !m_curCacheValid || (v - m_skinnedVPosed[iVerts]).cwiseAbs().maxCoeff() > SMPL_SKIN_TOLERANCE;
+		for (int iw = wb; iw < we && !changed; iw++)
+			changed = jointChanged[m_weights.innerIndexPtr()[iw]] != 0;
+		if (!changed)
+			continue;
 		Vec3 v_transformed = Vec3::Zero();
 		for (int iw = wb; iw < we; iw++)
 		{
@@ -854,31 +1169,192 @@ void SmplManager::updateCurMesh()
 			v_transformed += jointW * (m_curJrots[jointId] * v + m_curJtrans[jointId]);
 		}
 		m_curVerts[iVerts] = v_transformed;
+		m_skinnedVPosed[iVerts] = v;
+		vertChanged[iVerts] = 1;
 	} // iVerts
 
 	// 2. update normals and bounds ------------------------------------
 	m_curFNormals.resize(m_faces.size());
 	m_curVNormals.resize(m_curVerts.size());
-	std::fill(m_curVNormals.begin(), m_curVNormals.end(), Vec3::Zero());
-	m_bbox[0] = FLT_MAX;
-	m_bbox[1] = FLT_MIN;
-	for (size_t i = 0; i < m_faces.size(); i++)
+	std::vector<char> faceChanged(m_faces.size(), 0);
+#pragma omp parallel for
+	for (int i = 0; i < (int)m_faces.size(); i++)
 	{
 		const Face &f = m_faces[i];
+		if (!vertChanged[f[0]] && !vertChanged[f[1]] && !vertChanged[f[2]])
+			continue;
 		Vec3 nm = (m_curVerts[f[1]] - m_curVerts[f[0]]).cross(m_curVerts[f[2]] - m_curVerts[f[0]]);
-		for (int k = 0; k < 3; k++)
-			m_curVNormals[f[k]] += nm;
 		m_curFNormals[i] = nm.normalized();
+		faceChanged[i] = 1;
 	}
-	for (size_t i = 0; i < m_curVNormals.size(); i++)
+#pragma omp parallel for
+	for (int i = 0; i < nVerts; i++)
+	{
+		bool changed = false;
+		for (int k = m_vertFaceBegin[i]; k < m_vertFaceBegin[i + 1] && !changed; k++)
+			changed = faceChanged[m_vertFaces[k]] != 0;
+		if (!changed)
+			continue;
+		Vec3 nm = Vec3::Zero();
+		for (int k = m_vertFaceBegin[i]; k < m_vertFaceBegin[i + 1]; k++)
+		{
+			const Face &f = m_faces[m_vertFaces[k]];
+			nm += (m_curVerts[f[1]] - m_curVerts[f[0]]).cross(m_curVerts[f[2]] - m_curVerts[f[0]]);
+		}
+		m_curVNormals[i] = nm.normalized();
+	} // i
+	m_bbox[0] = FLT_MAX;
+	m_bbox[1] = FLT_MIN;
+	for (size_t i = 0; i < m_curVerts.size(); i++)
 	{
-		m_curVNormals[i].normalize();
 		for (int k = 0; k < 3; k++)
 		{
 			m_bbox[0][k] = std::min(m_bbox[0][k], (float)m_curVerts[i][k]);
 			m_bbox[1][k] = std::max(m_bbox[1][k], (float)m_curVerts[i][k]);
 		}
 	} // i
+	m_curCacheValid = true;
+}
+
+// the chunk of bodies whose blend shapes are evaluated by one GEMM
+enum{ SMPL_BATCH_CHUNK = 64 };
+
+// blend: the shape and pose offsets of the chunk, (3 * nVerts) x nBodies, each column [x..., y..., z...]
+template<class Mat>
+static void smplSkinBatch(const Mat& blend, const DMat& v_template, const SpMat& weights, 
+	const std::vector<Mat3>& rots, const std::vector<Vec3>& trans, int nJoints, ldp::Float3* verts)
+{
+	const int nVerts = (int)v_template.rows();
+	const int nBodies = (int)blend.cols();
+#pragma omp parallel for
+	for (int id = 0; id < nBodies * nVerts; id++)
+	{
+		const int iBody = id / nVerts, iVert = id % nVerts;
+		Vec3 v;
+		for (int k = 0; k < 3; k++)
+			v[k] = v_template(iVert, k) + real(blend(k * nVerts + iVert, iBody));
+		Vec3 v_transformed = Vec3::Zero();
+		for (int iw = weights.outerIndexPtr()[iVert]; iw < weights.outerIndexPtr()[iVert + 1]; iw++)
+		{
+			const int jointId = iBody * nJoints + weights.innerIndexPtr()[iw];
+			v_transformed += weights.valuePtr()[iw] * (rots[jointId] * v + trans[jointId]);
+		}
+		verts[id] = ldp::Float3(float(v_transformed[0]), float(v_transformed[1]), float(v_transformed[2]));
+	} // end for id
+}
+
+void SmplManager::evaluateBatch(int nBodies, const float* shapes, const float* poses, ldp::Float3* verts,
+	ldp::Float3* normals, bool singlePrecision)const
+{
+	CHECK_THROW_EXCPT(m_inited);
+	const int nVerts = numVerts();
+	const int nShapes = numShapes();
+	const int nJoints = numPoses();
+	const int nVarPose = numVarEachPose();
+	const int nPoseDirs = (int)m_posedirs.cols();
+
+	// the model dependent part is built once; concurrent first calls may both build it, which is harmless
+	std::shared_ptr<const BatchCache> cache = std::atomic_load(&m_batchCache);
+	if (cache == nullptr)
+	{
+		std::shared_ptr<BatchCache> c(new BatchCache);
+		// the rest pose joints are linear in the shapes: J = J_regressor * (v_template + shapedirs * shapes)
+		c->J_template = m_J_regressor * m_v_template;
+		for (int k = 0; k < 3; k++)
+			c->J_dirs[k] = m_J_regressor * m_shapedirs.middleRows(k * nVerts, nVerts);
+		c->shapedirs_f = m_shapedirs.cast<float>();
+		c->posedirs_f = m_posedirs.cast<float>();
+		cache = c;
+		std::atomic_store(&m_batchCache, cache);
+	}
+	const DMat& J_template = cache->J_template;
+	const DMat* J_dirs = cache->J_dirs;
+
+	// the faces around each vertex, for the normals, built by updateCurMesh() when the model is loaded
+	CHECK_THROW_EXCPT((int)m_vertFaceBegin.size() == nVerts + 1);
+	const std::vector<int>& vertFaceBegin = m_vertFaceBegin;
+	const std::vector<int>& vertFaces = m_vertFaces;
+	std::vector<ldp::Float3> faceNormals;
+
+	for (int bodyBegin = 0; bodyBegin < nBodies; bodyBegin += SMPL_BATCH_CHUNK)
+	{
+		const int nChunk = std::min(int(SMPL_BATCH_CHUNK), nBodies - bodyBegin);
+
+		// the blend shape coefficients and the joint transforms of each body
+		DMat shapeCoefs(nShapes, nChunk), poseCoefs(nPoseDirs, nChunk);
+		std::vector<Mat3> rots(nChunk * nJoints);
+		std::vector<Vec3> trans(nChunk * nJoints);
+#pragma omp parallel for
+		for (int iBody = 0; iBody < nChunk; iBody++)
+		{
+			const float* shape = shapes + size_t(bodyBegin + iBody) * nShapes;
+			const float* pose = poses + size_t(bodyBegin + iBody) * nJoints * nVarPose;
+			for (int i = 0; i < nShapes; i++)
+				shapeCoefs(i, iBody) = shape[i];
+			Mat3* R = rots.data() + iBody * nJoints;
+			Vec3* T = trans.data() + iBody * nJoints;
+			for (int iJoint = 0; iJoint < nJoints; iJoint++)
+			{
+				const Mat3 Rj = angles2rot(Vec3(pose[iJoint * nVarPose], pose[iJoint * nVarPose + 1],
+					pose[iJoint * nVarPose + 2]));
+				if (iJoint > 0)
+				for (int k = 0; k < 9; k++)
+					poseCoefs((iJoint - 1) * 9 + k, iBody) = Rj.data()[k] - real(k % 4 == 0);
+				Vec3 v;
+				for (int k = 0; k < 3; k++)
+					v[k] = J_template(iJoint, k) + J_dirs[k].row(iJoint).dot(shapeCoefs.col(iBody));
+				const int iParent = m_kintree_table[iJoint];
+				if (iParent < 0)
+				{
+					R[iJoint] = Rj;
+					T[iJoint] = v - R[iJoint] * v;
+				}
+				else
+				{
+					R[iJoint] = R[iParent] * Rj;
+					T[iJoint] = R[iParent] * v + T[iParent] - R[iJoint] * v;
+				}
+			} // end for iJoint
+		} // end for iBody
+
+		// blend shapes and skinning
+		ldp::Float3* chunkVerts = verts + size_t(bodyBegin) * nVerts;
+		if (singlePrecision)
+		{
+			const Eigen::MatrixXf blend = cache->shapedirs_f * shapeCoefs.cast<float>() 
+				+ cache->posedirs_f * poseCoefs.cast<float>();
+			smplSkinBatch(blend, m_v_template, m_weights, rots, trans, nJoints, chunkVerts);
+		}
+		else
+		{
+			const DMat blend = m_shapedirs * shapeCoefs + m_posedirs * poseCoefs;
+			smplSkinBatch(blend, m_v_template, m_weights, rots, trans, nJoints, chunkVerts);
+		}
+		if (normals == nullptr)
+			continue;
+
+		// area weighted vertex normals, the same with updateCurMesh()
+		const int nFaces = (int)m_faces.size();
+		faceNormals.resize(size_t(nChunk) * nFaces);
+#pragma omp parallel for
+		for (int id = 0; id < nChunk * nFaces; id++)
+		{
+			const ldp::Float3* v = chunkVerts + size_t(id / nFaces) * nVerts;
+			const Face& f = m_faces[id % nFaces];
+			faceNormals[id] = ldp::Float3(v[f[1]] - v[f[0]]).cross(v[f[2]] - v[f[0]]);
+		}
+		ldp::Float3* chunkNormals = normals + size_t(bodyBegin) * nVerts;
+#pragma omp parallel for
+		for (int id = 0; id < nChunk * nVerts; id++)
+		{
+			const int iBody = id / nVerts, iVert = id % nVerts;
+			ldp::Float3 nm(0.f);
+			for (int i = vertFaceBegin[iVert]; i < vertFaceBegin[iVert + 1]; i++)
+				nm += faceNormals[size_t(iBody) * nFaces + vertFaces[i]];
+			const float len = nm.length();
+			chunkNormals[id] = len > 0.f ? nm / len : nm;
+		}
+	} // end for bodyBegin
 }
 
 void SmplManager::setMaxShapeCoef(real c)
@@ -936,6 +1412,12 @@ void SmplManager::fittingShapes(const std::vector<ldp::Float3>& newVertices, boo
 	if (newVertices.size() != m_curVerts.size())
 		throw std::exception("fittingShapes: given vertices size not matched!");
 
+	if (m_shapeFitMode == ShapeFitLinear)
+	{
+		fittingShapesLinear(newVertices, showInfo);
+		return;
+	}
+
 	// solve the fitting problem
 	std::vector<real> minb(m_curShapes.size(), m_minShapeCoef), maxb(m_curShapes.size(), m_maxShapeCoef);
 	std::vector<long> btype(m_curShapes.size(), 2);
@@ -946,6 +1428,152 @@ void SmplManager::fittingShapes(const std::vector<ldp::Float3>& newVertices, boo
 		printf("warning: bfgs solver not converged %d\n", status);
 }
 
+// min 0.5 * x' * H * x - g' * x, s.t. lb <= x <= ub, H positive definite, by the primal active set method
+// x: the initial guess, clamped into the bounds; ldlt: the factorization of H, used when no bound is active
+// return the iterations, or -1 if not converged
+static int solveBoundedQuadratic(const DMat& H, const Eigen::LDLT<DMat>& ldlt, const DMat& g,
+	real lb, real ub, DMat& x)
+{
+	const int n = (int)g.size();
+	std::vector<int> bound(n, 0);			// -1: at lb, 1: at ub, 0: free
+	for (int i = 0; i < n; i++)
+	{
+		x(i) = std::min(ub, std::max(lb, x(i)));
+		bound[i] = x(i) <= lb ? -1 : (x(i) >= ub ? 1 : 0);
+	}
+	const int maxIter = 10 * n + 10;
+	for (int iter = 0; iter < maxIter; iter++)
+	{
+		// the step to the minimizer over the free coeffs, with the bounded ones fixed
+		const DMat grad = H * x - g;
+		std::vector<int> freeIds;
+		for (int i = 0; i < n; i++)
+		if (bound[i] == 0)
+			freeIds.push_back(i);
+		const int nFree = (int)freeIds.size();
+		DMat p = DMat::Zero(n, 1);
+		if (nFree == n)
+			p = ldlt.solve(-grad);
+		else if (nFree > 0)
+		{
+			DMat Hf(nFree, nFree), gf(nFree, 1);
+			for (int i = 0; i < nFree; i++)
+			{
+				gf(i) = -grad(freeIds[i]);
+				for (int j = 0; j < nFree; j++)
+					Hf(i, j) = H(freeIds[i], freeIds[j]);
+			}
+			const DMat pf = Hf.ldlt().solve(gf);
+			for (int i = 0; i < nFree; i++)
+				p(freeIds[i]) = pf(i);
+		}
+
+		// move along the step, until a free coeff hits its bound
+		real alpha = 1;
+		int block = -1;
+		for (int i : freeIds)
+		{
+			const real a = p(i) < 0 ? (lb - x(i)) / p(i) : (p(i) > 0 ? (ub - x(i)) / p(i) : 1);
+			if (a < alpha)
+			{
+				alpha = a;
+				block = i;
+			}
+		}
+		x += alpha * p;
+		if (block >= 0)
+		{
+			bound[block] = p(block) < 0 ? -1 : 1;
+			x(block) = p(block) < 0 ? lb : ub;
+			continue;
+		}
+
+		// else at the minimizer of the current set: release the bound of the most negative multiplier, or stop
+		const DMat gradMin = H * x - g;
+		int release = -1;
+		real maxViolation = 0;
+		for (int i = 0; i < n; i++)
+		{
+			const real violation = bound[i] * gradMin(i);
+			if (bound[i] != 0 && violation > maxViolation)
+			{
+				maxViolation = violation;
+				release = i;
+			}
+		}
+		if (release < 0)
+			return iter + 1;
+		bound[release] = 0;
+	} // end for iter
+	return -1;
+}
+
+void SmplManager::fittingShapesLinear(const std::vector<ldp::Float3>& newVertices, bool showInfo)
+{
+	const int nVerts = numVerts();
+	const int nShapes = (int)m_curShapes.size();
+
+	// the blended rotation and translation of each vertex, as the ShapeSolver
+	std::vector<Mat3> vertsR(nVerts);
+	std::vector<Vec3> vertsT(nVerts);
+#pragma omp parallel for
+	for (int iVerts = 0; iVerts < nVerts; iVerts++)
+	{
+		int wb = m_weights.outerIndexPtr()[iVerts];
+		int we = m_weights.outerIndexPtr()[iVerts + 1];
+		Vec3 sumT = Vec3::Zero();
+		Mat3 sumR = Mat3::Zero();
+		for (int iw = wb; iw < we; iw++)
+		{
+			int jointId = m_weights.innerIndexPtr()[iw];
+			real jointW = m_weights.valuePtr()[iw];
+			sumR += jointW * m_curJrots[jointId];
+			sumT += jointW * m_curJtrans[jointId];
+		}
+		vertsR[iVerts] = sumR;
+		vertsT[iVerts] = sumT;
+	} // iVerts
+
+	// 1. the posed shape dirs and the factorization of the normal equations, only if the rotations changed
+	if (m_shapeFitJrots != m_curJrots || m_shapeFitA.rows() != 3 * nVerts || m_shapeFitA.cols() != nShapes)
+	{
+		m_shapeFitA.resize(3 * nVerts, nShapes);
+#pragma omp parallel for
+		for (int iVerts = 0; iVerts < nVerts; iVerts++)
+		for (int s = 0; s < nShapes; s++)
+		{
+			const Vec3 d(m_shapedirs(iVerts, s), m_shapedirs(nVerts + iVerts, s), m_shapedirs(2 * nVerts + iVerts, s));
+			const Vec3 a = vertsR[iVerts] * d;
+			for (int k = 0; k < 3; k++)
+				m_shapeFitA(iVerts * 3 + k, s) = a[k];
+		}
+		m_shapeFitH = m_shapeFitA.transpose() * m_shapeFitA;
+		m_shapeFitLDLT.compute(m_shapeFitH);
+		m_shapeFitJrots = m_curJrots;
+	}
+
+	// 2. the right hand side: the target minus the posed template
+	DMat b(3 * nVerts, 1);
+#pragma omp parallel for
+	for (int iVerts = 0; iVerts < nVerts; iVerts++)
+	{
+		const Vec3 v(m_v_template(iVerts, 0), m_v_template(iVerts, 1), m_v_template(iVerts, 2));
+		const Vec3 c = vertsR[iVerts] * v + vertsT[iVerts];
+		for (int k = 0; k < 3; k++)
+			b(iVerts * 3 + k) = newVertices[iVerts][k] - c[k];
+	} // iVerts
+	const DMat g = m_shapeFitA.transpose() * b;
+
+	// 3. the bounded least squares
+	DMat x = m_curShapes;
+	const int nIter = solveBoundedQuadratic(m_shapeFitH, m_shapeFitLDLT, g, m_minShapeCoef, m_maxShapeCoef, x);
+	if (nIter < 0)
+		printf("warning: bounded shape fitting not converged\n");
+	else if (showInfo)
+		printf("shape fitting: %d active set iterations, residual %f\n", nIter, (m_shapeFitA * x - b).norm());
+	m_curShapes = x;
+}
+
 void SmplManager::fittingPoses(std::vector<ldp::Float3>& newVertices, bool showInfo)
 {
 	if (newVertices.size() != m_curVerts.size())
@@ -976,10 +1604,15 @@ void SmplManager::fittingShapePoses(std::vector<ldp::Float3>& newVertices, bool
 
 		// fitting shapes
 		oldShape = m_curShapes;
-		shapeSolver.initialize(this, newVertices);
-		auto status = shapeSolver.runSolver();
-		if (status != SolverExitStatus::success)
-			printf("warning: bfgs solver not converged %d\n", status);
+		if (m_shapeFitMode == ShapeFitLinear)
+			fittingShapesLinear(newVertices, showInfo);
+		else
+		{
+			shapeSolver.initialize(this, newVertices);
+			auto status = shapeSolver.runSolver();
+			if (status != SolverExitStatus::success)
+				printf("warning: bfgs solver not converged %d\n", status);
+		}
 
 		// compute the diff
 		double poseDif = (oldPose - m_curPoses).norm() / (1e-5 + m_curPoses.norm());
@@ -19,6 +19,11 @@ public:
 	{
 		LROTMIN = 0,
 	};
+	enum ShapeFitMode
+	{
+		ShapeFitLinear = 0,		// closed form bounded least squares, see fittingShapes()
+		ShapeFitBFGS,
+	};
 	typedef double real;
 	typedef ldp::Int3 Face;
 	typedef Eigen::SparseMatrix<real> SpMat;
@@ -53,21 +58,41 @@ public:
 	int selectedJointId()const { return m_selectedNode; }
 
 	void loadFromMat(const char* filename);
+	// the binary model of saveModel(): float32 dense arrays and CSR sparse matrices, read from the mapped file
+	void loadModel(std::string filename);
+	void saveModel(std::string filename)const;
+	// load the binary model next to the .mat file, i.e., xx.mat -> xx.smplbin, which is created from the .mat 
+	//	on the first use and rebuilt when the .mat is modified; the .mat is not needed once the model exists
+	void loadFromMatCached(const char* filename);
 	void toObjMesh(ObjMesh& mesh)const;
 	int numShapes()const { return m_curShapes.size(); }
 	int numVarEachPose()const { return m_curPoses.cols(); }
 	int numPoses()const { return m_curPoses.rows(); }
 	void setPoseShapeVals(const std::vector<float>* poses = nullptr, const std::vector<float>* shapes = nullptr);
+	int numVerts()const { return (int)m_v_template.rows(); }
+
+	// evaluate nBodies bodies at once, without changing the current state
+	// shapes: nBodies * numShapes(); poses: nBodies * numPoses() * numVarEachPose(), the order of setPoseShapeVals()
+	// verts (and normals if not nullptr): nBodies * numVerts(), the same with updateCurMesh()
+	// the blend shapes of a chunk of bodies are single GEMMs, in float if singlePrecision, 
+	//	the skinning and normals are parallel over the bodies and vertices
+	void evaluateBatch(int nBodies, const float* shapes, const float* poses, ldp::Float3* verts,
+		ldp::Float3* normals = nullptr, bool singlePrecision = true)const;
 
 	real getMaxShapeCoef()const { return m_maxShapeCoef; }
 	void setMaxShapeCoef(real c);
 	real getMinShapeCoef()const { return m_minShapeCoef; }
 	void setMinShapeCoef(real c);
+	ShapeFitMode getShapeFitMode()const { return m_shapeFitMode; }
+	void setShapeFitMode(ShapeFitMode mode) { m_shapeFitMode = mode; }
 
 	// rigid-fitting the given vertex to self
 	void rigidFitting(std::vector<ldp::Float3>& newVertices);
 
-	// fitting shape coeffs from given vertices
+	// fitting shape coeffs from given vertices, with the current pose fixed
+	// ShapeFitLinear: the posed vertices are linear in the shape coeffs, the normal equations are solved directly,
+	//	with the bounds by an active set; the posed shape dirs and the factorization are kept for the next fits
+	//	of the same pose, i.e., a fit then costs a product of the shape dirs with the target
 	void fittingShapes(const std::vector<ldp::Float3>& newVertices, bool showInfo = false);
 
 	// fitting pose coeffs from given vertices
@@ -77,6 +102,9 @@ public:
 	void fittingShapePoses(std::vector<ldp::Float3>& newVertices, bool showInfo = false);
 
 	// compute the mesh data based on the current shapes and rots
+	// incremental: the shaped rest pose and joints are cached until the shapes change, the pose blend shape is 
+	//	updated by the columns of the joints whose rotations changed, and only the vertices skinned to a joint 
+	//	whose global transform changed (or whose rest position moved) are re-skinned, with their normals
 	void updateCurMesh();
 
 	// update the global rotation/translation from the local ones
@@ -100,6 +128,8 @@ public:
 	void setCurPoseCoef(int idx, int axis, real val) { m_curPoses(idx, axis) = val; }
 	const SpMat& weights()const { return m_weights; }
 protected:
+	void saveModel(std::string filename, long long matBytes, long long matTime)const;
+	void fittingShapesLinear(const std::vector<ldp::Float3>& newVertices, bool showInfo);
 	void calcPoseVector207(const DMat& poses_24x3, DMat& poses_207);
 	void selectAction_mouseMove(int selectedId);
 	void selectAction_mousePress(int selectedId);
@@ -120,6 +150,7 @@ private:
 	// params
 	real m_maxShapeCoef = 5;
 	real m_minShapeCoef = -5;
+	ShapeFitMode m_shapeFitMode = ShapeFitLinear;
 
 	// model data -----------------------------------
 
@@ -149,6 +180,36 @@ private:
 	std::vector<Vec3> m_curFNormals;
 	ldp::Float3 m_bbox[2];
 
+	// cache of updateCurMesh() -----------------------------------
+
+	bool m_curCacheValid = false;
+	int m_curPoseBlendUpdates = 0;			// incremental updates since the last full pose blend
+	DMat m_cachedShapes;
+	DMat m_cachedPoseVec;
+	DMat m_curVShaped;						// nVerts x 3, the template with the shape blend
+	DMat m_curPoseBlend;					// (3 * nVerts) x 1, the pose blend shape
+	std::vector<Vec3> m_skinnedVPosed;		// the rest positions and joint transforms of the last skinning
+	std::vector<Mat3> m_skinnedJrots;
+	std::vector<Vec3> m_skinnedJtrans;
+	std::vector<int> m_vertFaceBegin;		// the faces around each vertex, in m_vertFaces, built once per model
+	std::vector<int> m_vertFaces;
+
+	// cache of evaluateBatch(), built on its first call and never modified, thus shared by the copies --------
+	struct BatchCache
+	{
+		DMat J_template;						// nJoints x 3, J_regressor * v_template
+		DMat J_dirs[3];							// nJoints x nShapes, J_regressor * shapedirs of x, y and z
+		Eigen::MatrixXf shapedirs_f;			// float copies of the blend shapes, for the single precision GEMM
+		Eigen::MatrixXf posedirs_f;
+	};
+	mutable std::shared_ptr<const BatchCache> m_batchCache;
+
+	// cache of fittingShapesLinear(), valid for the joint rotations it was built with -----------------
+	std::vector<Mat3> m_shapeFitJrots;
+	DMat m_shapeFitA;						// (3 * nVerts) x nShapes, the shape dirs posed, rows of [x y z] per vertex
+	DMat m_shapeFitH;						// A' * A
+	Eigen::LDLT<DMat> m_shapeFitLDLT;
+
 	// ui related ---------------------------------------
 	const ldp::Camera* m_renderCam = nullptr;
 	AxisRenderMode m_axisRenderMode;
@@ -0,0 +1,75 @@
+#include "SparseStructureCache.h"
+#include <algorithm>
+
+namespace ldp
+{
+	void TopologyFingerprint::add(const void* data, size_t bytes)
+	{
+		const unsigned char* p = (const unsigned char*)data;
+		for (size_t i = 0; i < bytes; i++)
+		{
+			m_value ^= p[i];
+			m_value *= 1099511628211ull;
+		}
+	}
+
+	SparseStructureCache& SparseStructureCache::instance()
+	{
+		static SparseStructureCache s_cache;
+		return s_cache;
+	}
+
+	SparseStructureCache::SparseStructureCache()
+	{
+
+	}
+
+	SparseStructureCache::EntryPtr SparseStructureCache::find(SimulationBackend backend,
+		TopologyFingerprint::ValueType key)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto iter = m_entries.find(Key(backend, key));
+		if (iter == m_entries.end())
+		{
+			m_nMisses++;
+			return nullptr;
+		}
+		m_nHits++;
+		return iter->second;
+	}
+
+	void SparseStructureCache::insert(SimulationBackend backend, TopologyFingerprint::ValueType key, EntryPtr entry)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		const Key k(backend, key);
+		if (m_entries.find(k) == m_entries.end())
+			m_insertOrder.push_back(k);
+		m_entries[k] = entry;
+		shrink();
+	}
+
+	void SparseStructureCache::clear()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_entries.clear();
+		m_insertOrder.clear();
+		m_nHits = 0;
+		m_nMisses = 0;
+	}
+
+	void SparseStructureCache::setCapacity(int n)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_capacity = std::max(0, n);
+		shrink();
+	}
+
+	void SparseStructureCache::shrink()
+	{
+		while ((int)m_insertOrder.size() > m_capacity)
+		{
+			m_entries.erase(m_insertOrder.front());
+			m_insertOrder.pop_front();
+		}
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include "ldpMat\ldp_basic_vec.h"
+#include "definations.h"
+
+namespace ldp
+{
+	// 64-bit FNV-1a hash of the cloth topology, i.e., the index data of faces, edges and stitches.
+	// Two systems with the same fingerprint have the same sparse structure.
+	class TopologyFingerprint
+	{
+	public:
+		typedef unsigned long long ValueType;
+	public:
+		TopologyFingerprint(){ reset(); }
+		void reset(){ m_value = 14695981039346656037ull; }
+		void add(const void* data, size_t bytes);
+		void add(int v){ add(&v, sizeof(int)); }
+		template<class T, size_t N> void add(const ldp_basic_vec<T, N>& v){ add(v.ptr(), sizeof(T)*N); }
+		ValueType value()const{ return m_value; }
+
+		// the sparse structure related topology of GpuSim/CpuSim
+		template<class EdgeData, class StitchPair>
+		static ValueType compute(int nVerts, const std::vector<Int4>& faces, const std::vector<EdgeData>& edges,
+			const std::vector<StitchPair>& stitchPairs, const std::vector<EdgeData>& stitchEdges)
+		{
+			TopologyFingerprint fp;
+			fp.add(nVerts);
+			fp.add((int)faces.size());
+			for (const auto& f : faces)
+				fp.add(f);
+			for (const std::vector<EdgeData>* eds : { &edges, &stitchEdges })
+			{
+				fp.add((int)eds->size());
+				for (const auto& ed : *eds)
+				{
+					fp.add(ed.edge_idxWorld);
+					fp.add(ed.faceIdx);
+				}
+			}
+			fp.add((int)stitchPairs.size());
+			for (const auto& stp : stitchPairs)
+				fp.add(stp.first);
+			return fp.value();
+		}
+	private:
+		ValueType m_value = 0;
+	};
+
+	// The precomputed arrays of setup_sparse_structure(), keyed by the topology fingerprint,
+	//	so that a known pattern (e.g., a new body in batch simulation) only needs a numeric reset.
+	// All arrays are on host; the cache is shared by all simulators and is thread-safe.
+	class SparseStructureCache
+	{
+	public:
+		struct Entry
+		{
+			int nVerts = 0;
+			std::vector<Int2> vertFacePairs;		// (vert, face), one-ring faces of each vertex, sorted
+			std::vector<Int2> A_blocks;				// (row, col) of nnz blocks of A, sorted
+			std::vector<int> A_Ids_start;			// the starting position of each face/edge/stitch in beforScan_A
+			std::vector<int> b_Ids_start;			// the last value is the size of beforScan
+			// CpuSim: for each nnz block/vertex, the range of its scattered positions
+			std::vector<int> A_scanPtr;
+			std::vector<int> A_scanIdx;
+			std::vector<int> b_scanPtr;
+			std::vector<int> b_scanIdx;
+			// GpuSim: host copies of the device arrays
+			std::vector<size_t> A_Ids;
+			std::vector<size_t> A_Ids_unique;
+			std::vector<int> A_Ids_unique_pos;
+			std::vector<int> A_order;
+			std::vector<int> A_invOrder;
+			std::vector<int> b_Ids;
+			std::vector<int> b_Ids_unique;
+			std::vector<int> b_Ids_unique_pos;
+			std::vector<int> b_order;
+			std::vector<int> b_invOrder;
+		};
+		typedef std::shared_ptr<const Entry> EntryPtr;
+	public:
+		static SparseStructureCache& instance();
+
+		// nullptr if not found
+		EntryPtr find(SimulationBackend backend, TopologyFingerprint::ValueType key);
+		void insert(SimulationBackend backend, TopologyFingerprint::ValueType key, EntryPtr entry);
+		void clear();
+
+		// the oldest entries are dropped when exceeded
+		void setCapacity(int n);
+		int capacity()const{ return m_capacity; }
+		int size()const{ return (int)m_entries.size(); }
+		int numHits()const{ return m_nHits; }
+		int numMisses()const{ return m_nMisses; }
+	protected:
+		SparseStructureCache();
+		typedef std::pair<int, TopologyFingerprint::ValueType> Key;
+		void shrink();
+	private:
+		std::map<Key, EntryPtr> m_entries;
+		std::deque<Key> m_insertOrder;
+		int m_capacity = 16;
+		int m_nHits = 0;
+		int m_nMisses = 0;
+		std::mutex m_mutex;
+	};
+}
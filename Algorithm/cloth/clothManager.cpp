@@ -1,5 +1,8 @@
 #include "clothManager.h"
 #include "LevelSet3D.h"
+#include "ArticulatedLevelSet.h"
+#include "BodyProxy.h"
+#include "LevelSetSequence.h"
 #include "clothPiece.h"
 #include "TransformInfo.h"
 #include "SmplManager.h"
@@ -18,14 +21,22 @@
 #include "kdtree\PointTree.h"
 #include <cuda_runtime_api.h>
 #include <fstream>
+#include <omp.h>
+#include <mutex>
 #include <QString>
 #include "GpuSim.h"
+#include "CpuSim.h"
+#include "SimulationCheckpoint.h"
+#include "LevelSetCache.h"
 
 namespace ldp
 {
 	enum{ LEVEL_SET_RESOLUTION = 128 };
 	std::shared_ptr<SmplManager> ClothManager::m_smplMale;
 	std::shared_ptr<SmplManager> ClothManager::m_smplFemale;
+	static std::mutex g_smpl_mutex;
+	static const char* g_smpl_male_file = "data/smpl/basicModel_m_lbs_10_207_0_v1.0.0_wrap.mat";
+	static const char* g_smpl_female_file = "data/smpl/basicModel_f_lbs_10_207_0_v1.0.0_wrap.mat";
 
 	inline SmplManager::Mat3 convert(ldp::Mat3d A)
 	{
@@ -57,14 +68,60 @@ namespace ldp
 
 	void ClothManager::initSmplDatabase()
 	{
+		std::lock_guard<std::mutex> lock(g_smpl_mutex);
 		if (m_smplMale.get() == nullptr)
 			m_smplMale.reset(new SmplManager);
 		if (m_smplFemale.get() == nullptr)
 			m_smplFemale.reset(new SmplManager);
-		if (!m_smplMale->isInitialized())
-			m_smplMale->loadFromMat("data/smpl/basicModel_m_lbs_10_207_0_v1.0.0_wrap.mat");
-		if (!m_smplFemale->isInitialized())
-			m_smplFemale->loadFromMat("data/smpl/basicModel_f_lbs_10_207_0_v1.0.0_wrap.mat");
+	}
+
+	void ClothManager::usePrivateSmplModels()
+	{
+		if (m_useSmplPrivate)
+			return;
+		m_useSmplPrivate = true;
+		if (m_smplBody && m_smplBody == m_smplMale.get())
+			m_smplBody = smplMale();
+		if (m_smplBody && m_smplBody == m_smplFemale.get())
+			m_smplBody = smplFemale();
+	}
+
+	SmplManager* ClothManager::smplModel(bool male)
+	{
+		std::shared_ptr<SmplManager>& shared = male ? m_smplMale : m_smplFemale;
+		std::shared_ptr<SmplManager>& priv = male ? m_smplMalePrivate : m_smplFemalePrivate;
+		if (priv.get())
+			return priv.get();
+		{
+			// loaded once, by the first manager using it
+			std::lock_guard<std::mutex> lock(g_smpl_mutex);
+			if (!shared->isInitialized())
+				shared->loadFromMatCached(male ? g_smpl_male_file : g_smpl_female_file);
+		}
+		if (!m_useSmplPrivate)
+			return shared.get();
+		priv.reset(new SmplManager(*shared));
+		return priv.get();
+	}
+
+	SmplManager* ClothManager::smplMale()
+	{
+		return smplModel(true);
+	}
+
+	SmplManager* ClothManager::smplFemale()
+	{
+		return smplModel(false);
+	}
+
+	const SmplManager* ClothManager::smplMale()const
+	{
+		return m_smplMalePrivate.get() ? m_smplMalePrivate.get() : m_smplMale.get();
+	}
+
+	const SmplManager* ClothManager::smplFemale()const
+	{
+		return m_smplFemalePrivate.get() ? m_smplFemalePrivate.get() : m_smplFemale.get();
 	}
 
 	ClothManager::ClothManager()
@@ -74,8 +131,15 @@ namespace ldp
 		m_bodyTransform.reset(new TransformInfo);
 		m_bodyTransform->setIdentity();
 		m_bodyLvSet.reset(new LevelSet3D);
+		m_bodyArticulatedLvSet.reset(new ArticulatedLevelSet);
+		m_bodyProxy.reset(new BodyProxy);
+		m_bodyLvSetPending.reset(new LevelSet3D);
+		m_bodyLvSequence.reset(new LevelSetSequence);
 		m_graph2mesh.reset(new Graph2Mesh);
-		m_gpuSim.reset(new GpuSim);
+		int nCudaDevices = 0;
+		if (cudaGetDeviceCount(&nCudaDevices) != cudaSuccess || nCudaDevices == 0)
+			m_simulationBackend = SimulationBackendCpu;
+		m_clothSim.reset(AbstractClothSimulator::create(m_simulationBackend));
 		m_fullClothSubdiv.reset(new LoopSubdiv);
 		initSmplDatabase();
 	}
@@ -88,12 +152,20 @@ namespace ldp
 	void ClothManager::clear()
 	{
 		simulationDestroy();
+		waitBodyLevelSetBuild();
 
 		m_bodyTransform->setIdentity();
 		m_bodyMeshInit->clear();
 		m_bodyMesh->clear();
 		m_bodyLvSet->clear();
-		m_gpuSim->clear();
+		m_bodyArticulatedLvSet->clear();
+		m_bodyArticulatedSmpl = nullptr;
+		m_bodyProxy->clear();
+		m_bodyLvSetPending->clear();
+		m_bodyProxyStepsLeft = 0;
+		m_bodyLvSequence->clear();
+		m_bodyAnimSteps = m_bodyAnimStep = 0;
+		m_clothSim->clear();
 
 		m_fps = 0;
 		m_smplBody = nullptr;
@@ -126,9 +198,9 @@ namespace ldp
 		if (m_simulationMode != SimulationOn)
 			return;
 		m_curDragInfo.target = target;
-		if (m_curDragInfo.vert_id >= 0 && m_gpuSim.get())
+		if (m_curDragInfo.vert_id >= 0 && m_clothSim.get())
 		{
-			auto x0 = m_gpuSim->getCurrentVertPositions()[m_curDragInfo.vert_id];
+			auto x0 = m_clothSim->getCurrentVertPositions()[m_curDragInfo.vert_id];
 			m_curDragInfo.dir = target - x0;
 			m_curDragInfo.dir.normalizeLocal();
 			m_curDragInfo.dir *= (target - x0).length() * 0.1f;
@@ -153,7 +225,9 @@ namespace ldp
 		m_shouldTriangulate = true;
 		updateDependency();
 		triangulate();
-		m_gpuSim->init(this);
+		m_clothSim->init(this);
+		m_clothSim->getEquilibriumMonitor().setParam(m_equilibriumParam);
+		m_clothSim->getEquilibriumMonitor().reset();
 		mergePieces();
 		buildTopology();
 		buildStitch();
@@ -174,7 +248,10 @@ namespace ldp
 
 		updateDependency();
 		if (m_shouldLevelSetUpdate)
+		{
 			calcLevelSet();
+			m_clothSim->updateBodyCollider();
+		}
 		if (m_shouldTriangulate)
 			triangulate();
 		if (m_shouldMergePieces)
@@ -188,32 +265,44 @@ namespace ldp
 		std::vector<int> fixIds;
 		std::vector<ldp::Float3> fixTars;
 		if (m_curDragInfo.vert_id >= 0)
-		for (size_t i = 0; i < m_gpuSim->getCurrentVertPositions().size(); i++)
+		for (size_t i = 0; i < m_clothSim->getCurrentVertPositions().size(); i++)
 		{
-			auto x0 = m_gpuSim->getCurrentVertPositions()[m_curDragInfo.vert_id];
-			auto x = m_gpuSim->getCurrentVertPositions()[i];
+			auto x0 = m_clothSim->getCurrentVertPositions()[m_curDragInfo.vert_id];
+			auto x = m_clothSim->getCurrentVertPositions()[i];
 			if ((x0 - x).length() < 0.001)
 			{
 				fixIds.push_back(i);
 				fixTars.push_back(x + m_curDragInfo.dir);
 			}
 		}
-		m_gpuSim->setFixPositions(fixIds.size(), fixIds.data(), fixTars.data());
+		m_clothSim->setFixPositions(fixIds.size(), fixIds.data(), fixTars.data());
+
+		if (isBodyAnimating())
+			updateBodyAnimation();
 
 		// perform simulation for one step
-		m_gpuSim->run_one_step();
-		m_gpuSim->getResultClothPieces();
+		m_clothSim->run_one_step();
+		if (m_bodyProxyStepsLeft > 0 && --m_bodyProxyStepsLeft == 0)
+			endBodyProxy();
+		SimulationProfiler& profiler = m_clothSim->getProfiler();
+		{
+			SimulationProfiler::ScopedTimer timer(profiler, "getResultClothPieces");
+			m_clothSim->getResultClothPieces();
+		}
 
-		if (m_shouldSubdivBuild)
-			buildSubdiv();
-		updateSubdiv();
+		{
+			SimulationProfiler::ScopedTimer timer(profiler, "updateSubdiv");
+			if (m_shouldSubdivBuild)
+				buildSubdiv();
+			updateSubdiv();
+		}
 
 		gtime_t tend = gtime_now();
 		m_fps = 1.f / gtime_seconds(tbegin, tend);
 
 		char fps_ary[10];
 		sprintf(fps_ary, "%.1f", m_fps);
-		m_simulationInfo = std::string("[fps ") + fps_ary + "]" + m_gpuSim->getSolverInfo();
+		m_simulationInfo = std::string("[fps ") + fps_ary + "]" + m_clothSim->getSolverInfo();
 	}
 
 	void ClothManager::simulationDestroy()
@@ -235,8 +324,8 @@ namespace ldp
 		auto lastParam = m_simulationParam;
 		m_simulationParam = param;
 		
-		if (m_gpuSim.get())
-			m_gpuSim->updateParam();
+		if (m_clothSim.get())
+			m_clothSim->updateParam();
 	}
 
 	void ClothManager::setClothDesignParam(ClothDesignParam param)
@@ -246,8 +335,8 @@ namespace ldp
 		if (fabs(lastParam.triangulateThre - g_designParam.triangulateThre)
 			>= std::numeric_limits<float>::epsilon())
 			m_shouldTriangulate = true;
-		if (m_gpuSim.get())
-			m_gpuSim->updateParam();
+		if (m_clothSim.get())
+			m_clothSim->updateParam();
 	}
 
 	void ClothManager::setPieceParam(const ClothPiece* piece, PieceParam param)
@@ -264,13 +353,94 @@ namespace ldp
 			pc->param() = param;
 			changed = true;
 		}
-		if (changed && m_gpuSim.get())
-			m_gpuSim->updateParam();
+		if (changed && m_clothSim.get())
+			m_clothSim->updateParam();
+	}
+
+	void ClothManager::setSimulationBackend(SimulationBackend backend)
+	{
+		if (backend == m_simulationBackend && m_clothSim.get())
+			return;
+		m_simulationBackend = backend;
+		m_clothSim.reset(AbstractClothSimulator::create(m_simulationBackend));
+		if (m_simulationBackend == SimulationBackendGpu && !m_shouldLevelSetUpdate)
+			uploadLevelSetToDevice();
+		m_clothSim->getEquilibriumMonitor().setParam(m_equilibriumParam);
+		if (m_simulationMode != SimulationNotInit)
+			m_clothSim->init(this);
+	}
+
+	void ClothManager::setEquilibriumParam(EquilibriumMonitor::Param param)
+	{
+		m_equilibriumParam = param;
+		if (m_clothSim.get())
+			m_clothSim->getEquilibriumMonitor().setParam(m_equilibriumParam);
+	}
+
+	void ClothManager::resetEquilibrium()
+	{
+		if (m_clothSim.get())
+			m_clothSim->getEquilibriumMonitor().reset();
+	}
+
+	SimulationProfiler* ClothManager::simulationProfiler()
+	{
+		if (m_clothSim.get() == nullptr)
+			return nullptr;
+		return &m_clothSim->getProfiler();
+	}
+
+	void ClothManager::saveSimulationCheckpoint(std::string filename)
+	{
+		if (m_clothSim.get() == nullptr || m_simulationMode == SimulationNotInit)
+			throw std::exception("ClothManager::saveSimulationCheckpoint: simulation not initialized!");
+		SimulationCheckpoint cp;
+		m_clothSim->getCheckpoint(cp);
+		cp.save(filename);
+	}
+
+	void ClothManager::loadSimulationCheckpoint(std::string filename)
+	{
+		if (m_clothSim.get() == nullptr || m_simulationMode == SimulationNotInit)
+			throw std::exception("ClothManager::loadSimulationCheckpoint: simulation not initialized!");
+		SimulationCheckpoint cp;
+		cp.load(filename);
+
+		// the same topology as simulationUpdate() is required for the fingerprint
+		updateDependency();
+		if (m_shouldLevelSetUpdate)
+		{
+			calcLevelSet();
+			m_clothSim->updateBodyCollider();
+		}
+		if (m_shouldTriangulate)
+			triangulate();
+		if (m_shouldMergePieces)
+			mergePieces();
+		if (m_shouldTopologyUpdate)
+			buildTopology();
+		if (m_shouldStitchUpdate)
+			buildStitch();
+		m_clothSim->setCheckpoint(cp);
+		m_clothSim->getResultClothPieces();
+		if (m_shouldSubdivBuild)
+			buildSubdiv();
+		updateSubdiv();
+	}
+
+	bool ClothManager::isSimulationSettled()const
+	{
+		if (m_clothSim.get() == nullptr || m_simulationMode == SimulationNotInit)
+			return false;
+		// the drape on the body proxy is not the final one
+		if (isBodyProxyActive())
+			return false;
+		return m_clothSim->getEquilibriumMonitor().isSettled();
 	}
 
 	ldp::Float3 ClothManager::getVertexByGlobalId(int id)const 
 	{ 
-		return m_gpuSim->getCurrentVertPositions()[id]; 
+		return m_clothSim->getCurrentVertPositions()[id]; 
 	}
 
 	int ClothManager::pieceVertId2GlobalVertId(const ObjMesh* piece, int pieceVertId)const
@@ -386,6 +556,9 @@ namespace ldp
 
 	void ClothManager::setBodyMeshTransform(const TransformInfo& info)
 	{
+		waitBodyLevelSetBuild();	// the pending build is of the old body
+		m_bodyLvSequence->clear();	// a new body stops the animation
+		m_bodyAnimSteps = m_bodyAnimStep = 0;
 		*m_bodyTransform = info;
 		m_bodyMesh->cloneFrom(m_bodyMeshInit.get());
 		m_bodyTransform->apply(*m_bodyMesh);
@@ -394,21 +567,21 @@ namespace ldp
 
 	void ClothManager::exportClothsMerged(ObjMesh& mesh, bool mergeStitchedVertex)const
 	{
-		mesh.cloneFrom(&m_gpuSim->getResultClothMesh());
+		mesh.cloneFrom(&m_clothSim->getResultClothMesh());
 	}
 
 	void ClothManager::exportClothsSeparated(std::vector<ObjMesh>& meshes)const
 	{
-		std::vector<ldp::Float3> vmerged = m_gpuSim->getCurrentVertPositions();
-		std::vector<float> wmerged(m_gpuSim->getCurrentVertPositions().size(), 1.f);
+		std::vector<ldp::Float3> vmerged = m_clothSim->getCurrentVertPositions();
+		std::vector<float> wmerged(m_clothSim->getCurrentVertPositions().size(), 1.f);
 
 		for (const auto& stp : m_stitches)
 		{
 			int sm = std::min(stp.first, stp.second);
 			int lg = std::max(stp.first, stp.second);
-			vmerged[sm] += m_gpuSim->getCurrentVertPositions()[lg];
+			vmerged[sm] += m_clothSim->getCurrentVertPositions()[lg];
 			wmerged[sm]++;
-			vmerged[lg] += m_gpuSim->getCurrentVertPositions()[sm];
+			vmerged[lg] += m_clothSim->getCurrentVertPositions()[sm];
 			wmerged[lg]++;
 		}
 		for (size_t i = 0; i < vmerged.size(); i++)
@@ -615,9 +788,9 @@ namespace ldp
 		if (m_smplBody == nullptr)
 			return;
 		m_vertex_smplJointBind.reset(new SpMat);
-		m_vertex_smpl_defaultPosition = m_gpuSim->getCurrentVertPositions();
+		m_vertex_smpl_defaultPosition = m_clothSim->getCurrentVertPositions();
 
-		const int nVerts = (int)m_gpuSim->getCurrentVertPositions().size();
+		const int nVerts = (int)m_clothSim->getCurrentVertPositions().size();
 		const int nJoints = m_smplBody->numPoses();
 		const static int K = 4;
 
@@ -635,7 +808,7 @@ namespace ldp
 
 		for (int iVert = 0; iVert < nVerts; iVert++)
 		{
-			KdTree::Point v(m_gpuSim->getCurrentVertPositions()[iVert]);
+			KdTree::Point v(m_clothSim->getCurrentVertPositions()[iVert]);
 			ValueType dist = 0;
 			auto nv = tree.nearestPoint(v, dist);
 
@@ -658,7 +831,7 @@ namespace ldp
 	{
 		if (m_smplBody == nullptr || m_vertex_smplJointBind == nullptr)
 			return;
-		std::vector<Float3> mX = m_gpuSim->getCurrentVertPositions();
+		std::vector<Float3> mX = m_clothSim->getCurrentVertPositions();
 		auto bR = m_bodyTransform->transform().getRotationPart();
 		auto bT = m_bodyTransform->transform().getTranslationPart();
 		m_smplBody->calcGlobalTrans();
@@ -680,8 +853,8 @@ namespace ldp
 			} // end for j
 			mX[iVert] = bR * (Rsum * bR.inv() * (v - bT) + Tsum) / wsum + bT;
 		} // end for iVert
-		m_gpuSim->setCurrentVertPositions(mX);
-		m_gpuSim->getResultClothPieces();
+		m_clothSim->setCurrentVertPositions(mX);
+		m_clothSim->getResultClothPieces();
 	}
 
 	bool ClothManager::setClothColorAsBoneWeights()
@@ -734,7 +907,7 @@ namespace ldp
 		if (m_shouldMergePieces)
 			mergePieces();
 
-		m_gpuSim->updateTopology();
+		m_clothSim->updateTopology();
 
 		// parameter
 		m_shouldTopologyUpdate = false;
@@ -745,12 +918,15 @@ namespace ldp
 		updateDependency();
 		if (m_shouldTopologyUpdate)
 			buildTopology();
-		m_gpuSim->updateStitch();
+		m_clothSim->updateStitch();
 		m_shouldStitchUpdate = false;
 	}
 
 	void ClothManager::calcLevelSet()
 	{
+		// a pending background build is of the old body
+		waitBodyLevelSetBuild();
+
 		m_bodyMesh->updateBoundingBox();
 		auto bmin = m_bodyMesh->boundingBox[0];
 		auto bmax = m_bodyMesh->boundingBox[1];
@@ -760,16 +936,230 @@ namespace ldp
 		const float step = powf(brag[0] * brag[1] * brag[2], 1.f / 3.f) / float(LEVEL_SET_RESOLUTION);
 		ldp::Int3 res = (bmax - bmin) / step;
 		ldp::Float3 start = bmin;
-		m_bodyLvSet->create(res, start, step);
-		m_bodyLvSet->fromMesh(*m_bodyMesh);
-		auto sz = m_bodyLvSet->size();
-		std::vector<float> transposeLv(m_bodyLvSet->sizeXYZ(), 0.f);
+		std::shared_ptr<const ArticulatedLevelSet> articulated = prepareArticulatedLevelSet();
+		if (beginBodyProxy())
+		{
+			// the smpl body and the body mesh are only touched by this thread, the build takes private copies
+			std::shared_ptr<ObjMesh> body;
+			if (articulated.get() == nullptr)
+			{
+				body.reset(new ObjMesh);
+				body->cloneFrom(m_bodyMesh.get());
+			}
+			const ldp::Mat4f bodyTransform = m_bodyTransform->transform();
+			std::shared_ptr<LevelSet3D> lvSet = m_bodyLvSetPending;
+			// the same number of omp threads with the caller, e.g., a batch worker
+			const int nThreads = omp_get_max_threads();
+			m_bodyLvSetBuild = std::async(std::launch::async, 
+				[lvSet, articulated, body, bodyTransform, res, start, step, nThreads]()
+			{
+				omp_set_num_threads(nThreads);
+				buildLevelSet(*lvSet, articulated.get(), body.get(), bodyTransform, res, start, step);
+			});
+			m_shouldLevelSetUpdate = false;
+			return;
+		}
+		buildLevelSet(*m_bodyLvSet, articulated.get(), m_bodyMesh.get(), m_bodyTransform->transform(), res, start, step);
+		if (m_simulationBackend == SimulationBackendGpu)
+			uploadLevelSetToDevice();
+		m_shouldLevelSetUpdate = false;
+	}
+
+	void ClothManager::buildLevelSet(LevelSet3D& lvSet, const ArticulatedLevelSet* articulated, const ObjMesh* body,
+		const ldp::Mat4f& bodyTransform, ldp::Int3 res, ldp::Float3 start, float step, bool cached)
+	{
+		if (articulated)
+		{
+			articulated->resample(lvSet, res, start, step, bodyTransform);
+			lvSet.toTiled();
+			return;
+		}
+		LevelSetCache& cache = LevelSetCache::instance();
+		cached = cached && cache.isEnabled();
+		const LevelSetCache::Key key = cached ? LevelSetCache::computeKey(*body, LEVEL_SET_RESOLUTION) : 0;
+		if (!cached || !cache.load(key, lvSet))
+		{
+			lvSet.create(res, start, step);
+			lvSet.fromMesh(*body);
+			lvSet.toTiled();
+			if (cached)
+				cache.store(key, lvSet);
+		}
+	}
+
+	std::shared_ptr<const ArticulatedLevelSet> ClothManager::prepareArticulatedLevelSet()
+	{
+		// the rigid bones cannot follow a bended or flipped body
+		if (!m_articulatedBodyCollision || m_smplBody == nullptr || m_bodyTransform->hasCylinderTransform()
+			|| m_bodyTransform->isFlipNormal())
+			return nullptr;
+
+		// rebuild only when the body shape changed, a new pose just moves the bones
+		std::vector<float> shapes(m_smplBody->numShapes());
+		for (int i = 0; i < (int)shapes.size(); i++)
+			shapes[i] = (float)m_smplBody->getCurShapeCoef(i);
+		if (m_bodyArticulatedSmpl != m_smplBody || shapes != m_bodyArticulatedShapes || !m_bodyArticulatedLvSet->isValid())
+		{
+			m_bodyArticulatedLvSet->build(*m_smplBody, LEVEL_SET_RESOLUTION);
+			m_bodyArticulatedSmpl = m_smplBody;
+			m_bodyArticulatedShapes = shapes;
+		}
+		m_smplBody->calcGlobalTrans();
+		m_bodyArticulatedLvSet->updatePose(*m_smplBody);
+		return m_bodyArticulatedLvSet;
+	}
+
+	bool ClothManager::beginBodyProxy()
+	{
+		m_bodyProxy->clear();
+		m_bodyProxyStepsLeft = 0;
+		if (m_bodyProxySteps <= 0 || m_smplBody == nullptr || m_bodyTransform->hasCylinderTransform()
+			|| m_bodyTransform->isFlipNormal())
+			return false;
+		m_bodyProxy->fromSmpl(*m_smplBody, *m_bodyMesh, m_bodyTransform->transform());
+		if (m_bodyProxy->empty())
+			return false;
+		m_bodyProxyStepsLeft = m_bodyProxySteps;
+		return true;
+	}
+
+	void ClothManager::endBodyProxy()
+	{
+		waitBodyLevelSetBuild();
+		m_bodyLvSet.swap(m_bodyLvSetPending);
+		m_bodyLvSetPending->clear();
+		m_bodyProxy->clear();
+		m_bodyProxyStepsLeft = 0;
+		if (m_simulationBackend == SimulationBackendGpu)
+			uploadLevelSetToDevice();
+		m_clothSim->updateBodyCollider();
+		m_clothSim->getEquilibriumMonitor().reset();	// settle again on the real body
+	}
+
+	void ClothManager::waitBodyLevelSetBuild()
+	{
+		if (m_bodyLvSetBuild.valid())
+			m_bodyLvSetBuild.get();	// rethrow the exception of the build, if any
+	}
+
+	void ClothManager::setBodyProxySteps(int nSteps)
+	{
+		m_bodyProxySteps = std::max(0, nSteps);
+		if (m_bodyProxySteps == 0 && m_bodyProxyStepsLeft > 0)
+			endBodyProxy();
+	}
+
+	void ClothManager::animateSmplBodyPose(const std::vector<float>& poses, int nSteps, int nKeyframes)
+	{
+		if (m_smplBody == nullptr)
+			throw std::exception("ClothManager::animateSmplBodyPose: no smpl body!");
+		const int nVars = m_smplBody->numPoses() * m_smplBody->numVarEachPose();
+		if ((int)poses.size() != nVars)
+			throw std::exception("ClothManager::animateSmplBodyPose: pose size mismatch!");
+		waitBodyLevelSetBuild();
+		m_bodyProxy->clear();
+		m_bodyProxyStepsLeft = 0;
+		m_bodyLvSetPending->clear();
+		m_bodyAnimPoseBegin.resize(nVars);
+		for (int j = 0; j < m_smplBody->numPoses(); j++)
+		for (int k = 0; k < m_smplBody->numVarEachPose(); k++)
+			m_bodyAnimPoseBegin[j * m_smplBody->numVarEachPose() + k] = (float)m_smplBody->getCurPoseCoef(j, k);
+		m_bodyAnimPoseEnd = poses;
+		nKeyframes = std::max(2, nKeyframes);
+
+		// the common grid of the keyframes: the body bounding box over them, with the margin of calcLevelSet(),
+		//	and the finest step of them
+		ldp::Float3 bmin = FLT_MAX, bmax = -FLT_MAX;
+		float step = FLT_MAX;
+		for (int i = 0; i < nKeyframes; i++)
+		{
+			poseSmplBodyMesh(float(i) / float(nKeyframes - 1));
+			m_bodyMesh->updateBoundingBox();
+			const auto brag = m_bodyMesh->boundingBox[1] - m_bodyMesh->boundingBox[0];
+			for (int k = 0; k < 3; k++)
+			{
+				bmin[k] = std::min(bmin[k], m_bodyMesh->boundingBox[0][k] - 0.2f * brag[k]);
+				bmax[k] = std::max(bmax[k], m_bodyMesh->boundingBox[1][k] + 0.2f * brag[k]);
+			}
+			step = std::min(step, powf(brag[0] * brag[1] * brag[2], 1.f / 3.f) / float(LEVEL_SET_RESOLUTION));
+		} // end for i
+		const ldp::Int3 res = (bmax - bmin) / step;
+		m_bodyLvSequence->create(res, bmin, step);
+		LevelSet3D lvSet;
+		for (int i = 0; i < nKeyframes; i++)
+		{
+			const float t = float(i) / float(nKeyframes - 1);
+			poseSmplBodyMesh(t);
+			std::shared_ptr<const ArticulatedLevelSet> articulated = prepareArticulatedLevelSet();
+			buildLevelSet(lvSet, articulated.get(), m_bodyMesh.get(), m_bodyTransform->transform(), res, bmin, step,
+				false);
+			m_bodyLvSequence->addKeyframe(lvSet, t);
+		} // end for i
+
+		// start from the current pose
+		m_bodyAnimSteps = std::max(1, nSteps);
+		m_bodyAnimStep = 0;
+		poseSmplBodyMesh(0.f);
+		m_bodyLvSequence->interpolate(0.f, *m_bodyLvSet);
+		if (m_simulationBackend == SimulationBackendGpu)
+			uploadLevelSetToDevice();
+		m_shouldLevelSetUpdate = false;
+		if (m_simulationMode != SimulationNotInit)
+			m_clothSim->updateBodyCollider();
+	}
+
+	void ClothManager::poseSmplBodyMesh(float t)
+	{
+		std::vector<float> poses(m_bodyAnimPoseBegin.size());
+		for (size_t i = 0; i < poses.size(); i++)
+			poses[i] = m_bodyAnimPoseBegin[i] + (m_bodyAnimPoseEnd[i] - m_bodyAnimPoseBegin[i]) * t;
+		m_smplBody->setPoseShapeVals(&poses, nullptr);
+		m_smplBody->toObjMesh(*m_bodyMeshInit);
+		m_bodyMesh->cloneFrom(m_bodyMeshInit.get());
+		m_bodyTransform->apply(*m_bodyMesh);
+	}
+
+	void ClothManager::updateBodyAnimation()
+	{
+		SimulationProfiler::ScopedTimer timer(m_clothSim->getProfiler(), "bodyAnimation");
+		m_bodyAnimStep++;
+		const float t = float(m_bodyAnimStep) / float(m_bodyAnimSteps);
+		poseSmplBodyMesh(t);
+		m_bodyLvSequence->interpolate(t, *m_bodyLvSet);
+		if (m_simulationBackend == SimulationBackendGpu)
+			uploadLevelSetToDevice();
+		m_clothSim->updateBodyCollider();
+		m_clothSim->getEquilibriumMonitor().reset();	// never settled while the body moves
+		if (!isBodyAnimating())
+			m_bodyLvSequence->clear();
+	}
+
+	void ClothManager::setArticulatedBodyCollision(bool enable)
+	{
+		if (enable == m_articulatedBodyCollision)
+			return;
+		m_articulatedBodyCollision = enable;
+		if (!enable)
+		{
+			// a new one, the old may still be read by a background build
+			m_bodyArticulatedLvSet.reset(new ArticulatedLevelSet);
+			m_bodyArticulatedSmpl = nullptr;
+		}
+		m_shouldLevelSetUpdate = true;
+	}
+
+	void ClothManager::uploadLevelSetToDevice()
+	{
+		const LevelSet3D& lvSet = *m_bodyLvSet;	// const access, not to allocate the far tiles
+		if (lvSet.sizeXYZ() == 0)
+			return;
+		auto sz = lvSet.size();
+		std::vector<float> transposeLv(lvSet.sizeXYZ(), 0.f);
 		for (int z = 0; z < sz[2]; z++)
 		for (int y = 0; y < sz[1]; y++)
 		for (int x = 0; x < sz[0]; x++)
-			transposeLv[x + y*sz[0] + z*sz[0] * sz[1]] = m_bodyLvSet->value(x, y, z)[0];
+			transposeLv[x + y*sz[0] + z*sz[0] * sz[1]] = lvSet.value(x, y, z)[0];
 		m_bodyLvSet_d.fromHost(transposeLv.data(), make_int3(sz[0], sz[1], sz[2]));
-		m_shouldLevelSetUpdate = false;
 	}
 
 	void ClothManager::buildSubdiv()
@@ -787,7 +1177,7 @@ namespace ldp
 			subPiece->init(&mesh);
 		} // end for ipiece
 
-		m_fullClothSubdiv->init(&m_gpuSim->getResultClothMesh());
+		m_fullClothSubdiv->init(&m_clothSim->getResultClothMesh());
 
 		m_shouldSubdivBuild = false;
 	}
@@ -1069,7 +1459,7 @@ namespace ldp
 		m_shouldLevelSetUpdate = true;
 
 		// 5. load body
-		m_smplBody = m_smplFemale.get();
+		m_smplBody = smplFemale();
 		m_smplBody->toObjMesh(*m_bodyMeshInit);
 		ldp::TransformInfo info;
 		info.setIdentity();
@@ -1665,13 +2055,13 @@ namespace ldp
 			} // end for BodyMesh
 			else if (pele->Value() == std::string("SmplBody"))
 			{
-				m_smplBody = m_smplFemale.get(); // by default, use the female model
+				m_smplBody = smplFemale(); // by default, use the female model
 				if (pele->Attribute("Gender"))
 				{
 					if (std::string(pele->Attribute("Gender")) == "female")
-						m_smplBody = m_smplFemale.get();
+						m_smplBody = smplFemale();
 					else if (std::string(pele->Attribute("Gender")) == "male")
-						m_smplBody = m_smplMale.get();
+						m_smplBody = smplMale();
 				}
 				for (auto child = pele->FirstChildElement(); child; child = child->NextSiblingElement())
 				{
@@ -1795,9 +2185,9 @@ namespace ldp
 		{
 			TiXmlElement* smpl_ele = new TiXmlElement("SmplBody");
 			root->LinkEndChild(smpl_ele);
-			if (m_smplBody == m_smplFemale.get())
+			if (m_smplBody == smplFemale())
 				smpl_ele->SetAttribute("Gender", "female");
-			else if (m_smplBody == m_smplMale.get())
+			else if (m_smplBody == smplMale())
 				smpl_ele->SetAttribute("Gender", "male");
 
 			// joints
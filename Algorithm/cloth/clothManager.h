@@ -2,11 +2,14 @@
 
 #include <vector>
 #include <memory>
+#include <future>
 #include "cudpp\device_array.h"
 #include "ldpMat\ldp_basic_vec.h"
+#include "ldpMat\ldp_basic_mat.h"
 #include <map>
 #include <set>
 #include "definations.h"
+#include "EquilibriumMonitor.h"
 #include "graph\AbstractGraphObject.h"
 #include "cudpp\Cuda3DArray.h"
 #ifndef __CUDACC__
@@ -22,16 +25,23 @@ class SmplManager;
 namespace ldp
 {
 	class LoopSubdiv;
+	class AbstractClothSimulator;
+	class SimulationProfiler;
 	class GpuSim;
+	class CpuSim;
 	class GraphsSewing;
 	class GraphPoint;
 	class Graph2Mesh;
 	class ClothPiece;
 	class LevelSet3D;
+	class ArticulatedLevelSet;
+	class BodyProxy;
+	class LevelSetSequence;
 	class TransformInfo;
 	class ClothManager
 	{
 		friend class GpuSim;
+		friend class CpuSim;
 	public:
 		typedef float ValueType;
 		typedef ldp::ldp_basic_vec3<ValueType> Vec3;
@@ -76,10 +86,20 @@ namespace ldp
 		void setSimulationParam(SimulationParam param);
 		void setClothDesignParam(ClothDesignParam param);
 		void setPieceParam(const ClothPiece* piece, PieceParam param);
+		void setSimulationBackend(SimulationBackend backend);	// gpu by default if a cuda device exists
+		void setEquilibriumParam(EquilibriumMonitor::Param param);
+		void resetEquilibrium();						// restart the settle detection, e.g., after the body pose changed
+		bool isSimulationSettled()const;				// the cloth reached the static equilibrium, or timeout
+		SimulationProfiler* simulationProfiler();		// stage timers and counters of the simulation steps
+		// binary snapshot of the simulation state, restorable only into the same cloth topology
+		void saveSimulationCheckpoint(std::string filename);
+		void loadSimulationCheckpoint(std::string filename);
 		float getFps()const { return m_fps; }
 		std::string getSimulationInfo()const{ return m_simulationInfo; }
 		SimulationMode getSimulationMode()const { return m_simulationMode; }
 		SimulationParam getSimulationParam()const { return m_simulationParam; }
+		SimulationBackend getSimulationBackend()const { return m_simulationBackend; }
+		EquilibriumMonitor::Param getEquilibriumParam()const { return m_equilibriumParam; }
 		static ClothDesignParam getClothDesignParam() { return g_designParam; }
 
 		/// mesh backup related
@@ -118,12 +138,33 @@ namespace ldp
 		const LevelSet3D* bodyLevelSet()const { return m_bodyLvSet.get(); }
 		LevelSet3D* bodyLevelSet() { return m_bodyLvSet.get(); }
 		const Cuda3DArray<ValueType>& bodyLevelSetDevice()const{ return m_bodyLvSet_d; }
+		// for a smpl body, resample the body level set from rigid per-bone level sets when the pose changes,
+		//	instead of converting the whole posed mesh, see ArticulatedLevelSet
+		void setArticulatedBodyCollision(bool enable);
+		bool isArticulatedBodyCollision()const { return m_articulatedBodyCollision; }
+		const ArticulatedLevelSet* bodyArticulatedLevelSet()const { return m_bodyArticulatedLvSet.get(); }
+		// for a smpl body, collide with an analytic proxy (see BodyProxy) in the first nSteps steps after each body
+		//	change, while the level set is built in background; 0 to disable
+		void setBodyProxySteps(int nSteps);
+		int getBodyProxySteps()const { return m_bodyProxySteps; }
+		bool isBodyProxyActive()const { return m_bodyProxyStepsLeft > 0; }
+		const BodyProxy* bodyProxy()const { return m_bodyProxy.get(); }
+		// move the smpl body from its current pose to the given one in the next nSteps simulation steps, linear in
+		//	the pose coefficients; the level sets of nKeyframes poses on the way are built here and blended
+		//	per step, see LevelSetSequence. The cloth is not skinned, it follows the body by collision.
+		void animateSmplBodyPose(const std::vector<float>& poses, int nSteps, int nKeyframes);
+		bool isBodyAnimating()const { return m_bodyAnimStep < m_bodyAnimSteps; }
+		const LevelSetSequence* bodyLevelSetSequence()const { return m_bodyLvSequence.get(); }
 		SmplManager* bodySmplManager() { return m_smplBody; }
 		const SmplManager* bodySmplManager()const { return m_smplBody; }
 		void updateSmplBody();
 		void bindClothesToSmplJoints();
 		void clearBindClothesToSmplJoints();
 		void updateClothBySmplJoints();
+		// by default, the smpl models are shared by all cloth managers;
+		// call this to pose the body independently, e.g., when several managers run in parallel.
+		// the private copies are made on the first use of each model
+		void usePrivateSmplModels();
 
 		/// cloth pieces
 		int numClothPieces()const { return (int)m_clothPieces.size(); }
@@ -166,8 +207,27 @@ namespace ldp
 		bool setClothColorAsBoneWeights();
 	protected:
 		static void initSmplDatabase();
+		// the smpl models are loaded on the first use, from the binary models cached next to the .mat files
+		SmplManager* smplMale();
+		SmplManager* smplFemale();
+		SmplManager* smplModel(bool male);
+		// without loading, i.e., the models not used yet are not initialized
+		const SmplManager* smplMale()const;
+		const SmplManager* smplFemale()const;
 		void updateDependency();
 		void calcLevelSet();
+		// reads only the given snapshots, thus runs in a background thread: resampled from the posed articulated
+		//	level set if given, else from the body mesh, through the LevelSetCache if cached
+		static void buildLevelSet(LevelSet3D& lvSet, const ArticulatedLevelSet* articulated, const ObjMesh* body,
+			const ldp::Mat4f& bodyTransform, ldp::Int3 res, ldp::Float3 start, float step, bool cached = true);
+		// the articulated level set posed as the current smpl body, nullptr if not used; touches the smpl body
+		std::shared_ptr<const ArticulatedLevelSet> prepareArticulatedLevelSet();
+		bool beginBodyProxy();
+		void endBodyProxy();
+		void waitBodyLevelSetBuild();
+		void poseSmplBodyMesh(float t);
+		void updateBodyAnimation();
+		void uploadLevelSetToDevice();
 		void mergePieces();
 		void buildTopology();
 		void buildStitch();
@@ -182,13 +242,30 @@ namespace ldp
 		std::vector<std::shared_ptr<LoopSubdiv>> m_piecesSubdiv;
 		std::shared_ptr<ObjMesh> m_bodyMesh, m_bodyMeshInit;
 		static std::shared_ptr<SmplManager> m_smplMale, m_smplFemale;
+		std::shared_ptr<SmplManager> m_smplMalePrivate, m_smplFemalePrivate;
+		bool m_useSmplPrivate = false;
 		SmplManager* m_smplBody = nullptr;
 		std::shared_ptr<TransformInfo> m_bodyTransform;
-		std::shared_ptr<GpuSim> m_gpuSim;				// gpu cloth simulator
+		std::shared_ptr<AbstractClothSimulator> m_clothSim;	// cloth simulator, gpu or cpu
 		std::shared_ptr<LevelSet3D> m_bodyLvSet;
 		Cuda3DArray<ValueType> m_bodyLvSet_d;
+		std::shared_ptr<ArticulatedLevelSet> m_bodyArticulatedLvSet;
+		const SmplManager* m_bodyArticulatedSmpl = nullptr;		// the smpl and shape the articulated level set built from
+		std::vector<float> m_bodyArticulatedShapes;
+		bool m_articulatedBodyCollision = false;
+		std::shared_ptr<BodyProxy> m_bodyProxy;
+		std::shared_ptr<LevelSet3D> m_bodyLvSetPending;		// built in background while the proxy is active
+		std::future<void> m_bodyLvSetBuild;
+		int m_bodyProxySteps = 0;
+		int m_bodyProxyStepsLeft = 0;
+		std::shared_ptr<LevelSetSequence> m_bodyLvSequence;
+		std::vector<float> m_bodyAnimPoseBegin, m_bodyAnimPoseEnd;
+		int m_bodyAnimSteps = 0;
+		int m_bodyAnimStep = 0;
 		SimulationMode m_simulationMode = SimulationNotInit;
 		SimulationParam m_simulationParam;
+		SimulationBackend m_simulationBackend = SimulationBackendGpu;
+		EquilibriumMonitor::Param m_equilibriumParam;
 		ValueType m_fps = ValueType(0);
 		bool m_shouldTriangulate = false;
 		bool m_shouldMergePieces = false;
@@ -42,6 +42,7 @@ namespace ldp
 		bending_k = 1;
 		spring_k = 1;
 		gravity = ldp::Float3(0, 0, -9.8);
+		pcg_warm_start = PcgWarmStartZero;
 	}
 
 	bool pointInPolygon(int n, const Float2* v, Float2 p, int* nearestEdgeId, float* minDistPtr)
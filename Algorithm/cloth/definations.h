@@ -15,12 +15,21 @@ namespace ldp
 		void setDefaultParam();
 	};
 
+	// the initial guess of the velocity change dv for the pcg solver
+	enum PcgWarmStart
+	{
+		PcgWarmStartZero,			// dv = 0
+		PcgWarmStartLast,			// dv = dv of the last step
+		PcgWarmStartExtrapolate,	// dv = 2*dv[n-1] - dv[n-2]
+	};
+
 	struct SimulationParam
 	{
 		float bending_k = 0.f;					// related to the thickness of the cloth
 		float spring_k = 0.f;					// related to the elasticity of the cloth
 		bool enable_self_collistion = false;
 		ldp::Float3 gravity;
+		PcgWarmStart pcg_warm_start = PcgWarmStartZero;
 		SimulationParam();
 		void setDefaultParam();
 	};
@@ -74,6 +83,12 @@ namespace ldp
 		SimulationPause,
 	};
 
+	enum SimulationBackend
+	{
+		SimulationBackendGpu,	// cuda, cusparse and cublas based, GpuSim
+		SimulationBackendCpu,	// openmp based host implementation, CpuSim
+	};
+
 	enum BatchSimulateMode
 	{
 		BatchSimNotInit,
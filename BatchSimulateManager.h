@@ -1,4 +1,5 @@
 #include "Algorithm/cloth/definations.h"
+#include "Algorithm/cloth/PoseDatabase.h"
 #include <QString>
 #include <vector>
 #include "Algorithm/tinyxml/tinyxml.h"
@@ -15,13 +16,27 @@ struct BatchSimulateManager
 		m_shapeXml = "./data/spring/sprint_femal.smpl.xml";
 		m_maxBodyNum = 1000;
 		m_timerIntervals = 5000;
+		m_pollIntervals = 100;
+		m_useEquilibrium = true;
+		m_maxSimSteps = 2000;
 		m_curPatternId = 0;
 		m_maxShapeNum = 0;
 		m_batchSimMode = ldp::BatchSimNotInit;
 		init();
 	}
+	// from the packed pose database if exists, see ldp::PoseDatabase
 	void recordPoseFiles()
 	{
+		m_poseDb.clear();
+		const std::string poseDbFile = ldp::PoseDatabase::defaultFilename(m_poseRoot.toStdString());
+		if (QFileInfo(QString::fromStdString(poseDbFile)).exists())
+		{
+			m_poseDb.open(poseDbFile);
+			m_poseFiles.clear();
+			for (int i = 0; i < m_poseDb.numClips(); i++)
+				m_poseFiles.push_back(QString::fromStdString(m_poseDb.clipName(i)));
+			return;
+		}
 		QDir poseDir(m_poseRoot);
 		poseDir.setNameFilters(QStringList("*.xml"));
 		m_poseFiles = poseDir.entryList();
@@ -38,15 +53,23 @@ struct BatchSimulateManager
 		m_batchSimMode = ldp::BatchSimNotInit;
 		m_patternXmls.clear();
 		m_poseFiles.clear();
+		m_poseDb.clear();
 		m_maxShapeNum = 0;
 		m_curPatternId = 0;
 		m_shapeDoc.Clear();
 		m_outputDoc.Clear();
 	}
+	// with the equilibrium monitor, a phase ends once the cloth settled, thus we poll it frequently;
+	// otherwise, each phase takes a fixed time slot.
+	int timerIntervals()const
+	{
+		return m_useEquilibrium ? m_pollIntervals : m_timerIntervals;
+	}
 	QString m_saveRootPath;
 	std::vector<int> m_shapeIndexes;
 	QStringList m_patternXmls;
 	QStringList m_poseFiles;
+	ldp::PoseDatabase m_poseDb;
 	QString m_poseRoot;
 	QString m_shapeXml;
 	QString m_posePath;
@@ -59,6 +82,9 @@ struct BatchSimulateManager
 	int m_maxBodyNum;
 	int m_maxShapeNum;
 	int m_timerIntervals;
+	int m_pollIntervals;
+	bool m_useEquilibrium;
+	int m_maxSimSteps;	// fallback of the equilibrium monitor, a phase ends after so many steps anyway
 	ldp::BatchSimulateMode m_batchSimMode ;
 	BatchSimPhase m_phase;
 
@@ -91,6 +91,32 @@ int randomFromFile(std::string fileName)
 	in.close();
 	return batch_sim_rand() % num;
 }
+// a random mocap frame of the batch simulation, from the packed pose database if exists
+static QString loadRandomBatchPose(BatchSimulateManager* manager, SmplManager* smpl)
+{
+	const QString& poseRoot = manager->m_poseRoot;
+	QString poseFile = manager->m_poseFiles[batch_sim_rand() % (int)manager->m_poseFiles.size()];
+	if (manager->m_poseDb.isOpen())
+	{
+		const int clip = manager->m_poseDb.findClip(poseFile.toStdString());
+		if (clip < 0 || manager->m_poseDb.clipNumFrames(clip) <= 0)
+			throw std::exception(("no frame of " + poseFile.toStdString() + " in the pose database").c_str());
+		std::vector<float> pose;
+		manager->m_poseDb.getPose(clip, batch_sim_rand() % manager->m_poseDb.clipNumFrames(clip), pose);
+		smpl->setPoseShapeVals(&pose, nullptr);
+		return poseFile;
+	}
+	QString txtFile = QString(poseFile).replace(".xml", "_info.txt");
+	int frame_ind = randomFromFile((poseRoot + txtFile).toStdString());
+
+	TiXmlDocument pose_doc;
+	if (!pose_doc.LoadFile((poseRoot + poseFile).toStdString().c_str()))
+		throw std::exception(("IOError" + (poseRoot + poseFile).toStdString() + "]: " + pose_doc.ErrorDesc()).c_str());
+	auto pose_elm = pose_doc.FirstChildElement()->FirstChildElement();
+	for (int j = 0; j < frame_ind; j++, pose_elm = pose_elm->NextSiblingElement());
+	smpl->loadCoeffsFromXml(pose_elm, false, true);
+	return poseFile;
+}
 QString generateRecurFolders(const QString& patternPath)
 {
 	QStringList folders = patternPath.split('/');
@@ -202,7 +228,17 @@ void ClothDesigner::initBatchSimForCurPattern(QString name)
 	m_batchSimManager->m_batchSimMode = ldp::BatchSimOn;
 	m_batchSimManager->m_phase = BatchSimulateManager::BatchSimPhase::INIT;
 	g_dataholder.m_clothManager->setSimulationMode(ldp::SimulationNotInit);
-	m_batchSimulateTimer = startTimer(m_batchSimManager->m_timerIntervals);
+	auto eqParam = g_dataholder.m_clothManager->getEquilibriumParam();
+	eqParam.maxSteps = m_batchSimManager->m_maxSimSteps;
+	g_dataholder.m_clothManager->setEquilibriumParam(eqParam);
+	m_batchSimulateTimer = startTimer(m_batchSimManager->timerIntervals());
+}
+
+bool ClothDesigner::isBatchSimPhaseFinished()const
+{
+	if (!m_batchSimManager->m_useEquilibrium)
+		return true;
+	return g_dataholder.m_clothManager->isSimulationSettled();
 }
 
 void ClothDesigner::recordDataForBatchSimulation()
@@ -242,19 +278,8 @@ void ClothDesigner::updateShapeForBatchSimulation()
 
 void ClothDesigner::updatePoseForBatchSimulation()
 {
-	const QString& poseRoot = m_batchSimManager->m_poseRoot;
-	QString poseFile = m_batchSimManager->m_poseFiles[batch_sim_rand() % (int)m_batchSimManager->m_poseFiles.size()];
-	QString txtFile = QString(poseFile).replace(".xml", "_info.txt");
-	int frame_ind = randomFromFile((poseRoot + txtFile).toStdString());
-
-	TiXmlDocument pose_doc;
-	if (!pose_doc.LoadFile((poseRoot + poseFile).toStdString().c_str()))
-		throw std::exception(("IOError" + (poseRoot + poseFile).toStdString() + "]: " + pose_doc.ErrorDesc()).c_str());
-	auto pose_elm = pose_doc.FirstChildElement()->FirstChildElement();
-	for (int j = 0; j < frame_ind; j++, pose_elm = pose_elm->NextSiblingElement());
-
 	SmplManager* smpl = g_dataholder.m_clothManager->bodySmplManager();
-	smpl->loadCoeffsFromXml(pose_elm, false, true);
+	QString poseFile = loadRandomBatchPose(m_batchSimManager.get(), smpl);
 	updateSmplUI();
 	g_dataholder.m_clothManager->updateSmplBody();
 	m_widget3d->updateGL();
@@ -273,17 +298,7 @@ void ClothDesigner::updateBodyForBatchSimulation()
 	smpl->loadCoeffsFromXml(shape_elm, true, false);
 
 	//load pose coefficient
-	const QString& poseRoot = m_batchSimManager->m_poseRoot;
-	QString poseFile = m_batchSimManager->m_poseFiles[batch_sim_rand() % (int)m_batchSimManager->m_poseFiles.size()];
-	QString txtFile = QString(poseFile).replace(".xml", "_info.txt");
-	int frame_ind = randomFromFile((poseRoot + txtFile).toStdString());
-
-	TiXmlDocument pose_doc;
-	if (!pose_doc.LoadFile((poseRoot + poseFile).toStdString().c_str()))
-		throw std::exception(("IOError" + (poseRoot + poseFile).toStdString() + "]: " + pose_doc.ErrorDesc()).c_str());
-	auto pose_elm = pose_doc.FirstChildElement()->FirstChildElement();
-	for (int j = 0; j < frame_ind; j++, pose_elm = pose_elm->NextSiblingElement());
-	smpl->loadCoeffsFromXml(pose_elm, false, true);
+	QString poseFile = loadRandomBatchPose(m_batchSimManager.get(), smpl);
 	updateSmplUI();
 	g_dataholder.m_clothManager->updateSmplBody();
 	m_widget3d->updateGL();
@@ -341,21 +356,23 @@ void ClothDesigner::timerEvent(QTimerEvent* ev)
 				{
 					std::cout << "init" << std::endl;
 					updateShapeForBatchSimulation();
+					g_dataholder.m_clothManager->resetEquilibrium();
 					g_dataholder.m_clothManager->setSimulationMode(ldp::SimulationOn);
 					phase = BatchSimulateManager::BatchSimPhase::SIM1;
 				}
-				else if (phase == BatchSimulateManager::BatchSimPhase::SIM1)
+				else if (phase == BatchSimulateManager::BatchSimPhase::SIM1 && isBatchSimPhaseFinished())
 				{
-					std::cout << "sim1 finished" << std::endl;
+					std::cout << "sim1 finished: " << g_dataholder.m_clothManager->getSimulationInfo() << std::endl;
 					g_dataholder.m_clothManager->setSimulationMode(ldp::SimulationPause);
 					bindClothesToSmpl();
 					updatePoseForBatchSimulation();
+					g_dataholder.m_clothManager->resetEquilibrium();
 					g_dataholder.m_clothManager->setSimulationMode(ldp::SimulationOn);
 					phase = BatchSimulateManager::BatchSimPhase::SIM2;
 				}
-				else if (phase == BatchSimulateManager::BatchSimPhase::SIM2)
+				else if (phase == BatchSimulateManager::BatchSimPhase::SIM2 && isBatchSimPhaseFinished())
 				{
-					std::cout << "sim2 finished" << std::endl;
+					std::cout << "sim2 finished: " << g_dataholder.m_clothManager->getSimulationInfo() << std::endl;
 					recordDataForBatchSimulation();
 					initBatchSimForCurBody();
 					if (m_batchSimManager->m_shapeInd == m_batchSimManager->m_maxBodyNum)
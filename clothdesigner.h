@@ -106,6 +106,7 @@ protected:
 	void updateShapeForBatchSimulation();
 	void updatePoseForBatchSimulation();
 	void recordDataForBatchSimulation();
+	bool isBatchSimPhaseFinished()const;
 	void resetSmpl();
 	public slots:
 	void on_pbSaveSmplCoeffs_clicked();
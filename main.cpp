@@ -4,9 +4,172 @@
 #include <QFile>
 #include <QTextStream>
 #include <GL\glut.h>
+#include <iostream>
+#include "cloth\BatchSimulationEngine.h"
+#include "cloth\PoseDatabase.h"
+
+static void printBatchSimulationUsage()
+{
+	printf("usage: ClothDesigner --batch batch_simulate_pattern_xmls.txt [options]\n"
+		"	--shape <xml>		pre-recorded smpl shapes\n"
+		"	--pose <folder>		mocap pose root\n"
+		"	--pose-db <file>	packed mocap poses, <pose root>/poses.pdb if exists by default\n"
+		"	--output <folder>	output root\n"
+		"	--bodies <n>		bodies per pattern\n"
+		"	--workers <n>		number of workers, all cores by default\n"
+		"	--max-steps <n>		max simulation steps of each phase\n"
+		"	--seed <n>		random seed\n"
+		"	--merged		export merged cloth meshes\n"
+		"	--profile <folder>	export the step profile of each worker, csv and chrome trace\n"
+		"	--checkpoint <folder>	save/reuse the settled rest pose drape of each pattern and shape\n"
+		"	--lvcache <folder>	cache the body level sets over runs\n"
+		"	--lvcache-mb <n>	size budget of the level set cache, 2048 by default\n"
+		"	--articulated		posed body level sets from the rest pose per-bone ones\n"
+		"	--proxy-steps <n>	collide with a capsule/ellipsoid body proxy in the first n steps\n"
+		"	--pose-steps <n>	move the body to the mocap pose in n steps, instead of at once\n"
+		"	--pose-keyframes <n>	body level sets blended on the way of --pose-steps, 8 by default\n"
+		"	--gpu			use the gpu simulator, with one worker\n");
+}
+
+static void printPackPosesUsage()
+{
+	printf("usage: ClothDesigner --pack-poses <pose folder> [options]\n"
+		"	--output <file>		the pose database, <pose folder>/poses.pdb by default\n"
+		"	--half			store the poses in float16\n"
+		"	--dedup <tol>		share the storage of the poses within tol\n");
+}
+
+// pack the mocap pose xmls into a PoseDatabase
+static int runPackPoses(int argc, char *argv[])
+{
+	const std::string poseRoot = argv[2];
+	std::string output = ldp::PoseDatabase::defaultFilename(poseRoot);
+	ldp::PoseDatabase::Storage storage = ldp::PoseDatabase::StorageFloat32;
+	float dedupTolerance = 0.f;
+	for (int i = 3; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (arg == "--output" && hasValue)
+			output = argv[++i];
+		else if (arg == "--half")
+			storage = ldp::PoseDatabase::StorageHalf;
+		else if (arg == "--dedup" && hasValue)
+			dedupTolerance = (float)atof(argv[++i]);
+		else
+		{
+			printPackPosesUsage();
+			return -1;
+		}
+	} // end for i
+
+	try
+	{
+		ldp::PoseDatabase::pack(poseRoot, output, storage, dedupTolerance);
+		ldp::PoseDatabase db;
+		db.open(output);
+		printf("pose database %s: %d clips, %d frames, %d poses\n", output.c_str(), db.numClips(), db.numFrames(),
+			db.numPoses());
+		return 0;
+	} catch (std::exception e)
+	{
+		std::cout << e.what() << std::endl;
+	} catch (...)
+	{
+		std::cout << "unknown error" << std::endl;
+	}
+	return -1;
+}
+
+// headless batch simulation, no window/gl context is created
+static int runBatchSimulation(int argc, char *argv[])
+{
+	ldp::BatchSimulationEngine::Param param;
+	param.patternList = argv[2];
+	for (int i = 3; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (arg == "--shape" && hasValue)
+			param.shapeXml = argv[++i];
+		else if (arg == "--pose" && hasValue)
+			param.poseRoot = argv[++i];
+		else if (arg == "--pose-db" && hasValue)
+			param.poseDatabase = argv[++i];
+		else if (arg == "--output" && hasValue)
+			param.outputRoot = argv[++i];
+		else if (arg == "--bodies" && hasValue)
+			param.maxBodyNum = atoi(argv[++i]);
+		else if (arg == "--workers" && hasValue)
+			param.numWorkers = atoi(argv[++i]);
+		else if (arg == "--max-steps" && hasValue)
+			param.maxSimSteps = atoi(argv[++i]);
+		else if (arg == "--seed" && hasValue)
+			param.randSeed = (unsigned int)atoi(argv[++i]);
+		else if (arg == "--profile" && hasValue)
+			param.profileFolder = argv[++i];
+		else if (arg == "--checkpoint" && hasValue)
+			param.checkpointFolder = argv[++i];
+		else if (arg == "--lvcache" && hasValue)
+			param.levelSetCacheFolder = argv[++i];
+		else if (arg == "--lvcache-mb" && hasValue)
+			param.levelSetCacheMB = atoi(argv[++i]);
+		else if (arg == "--articulated")
+			param.articulatedBody = true;
+		else if (arg == "--proxy-steps" && hasValue)
+			param.proxySteps = atoi(argv[++i]);
+		else if (arg == "--pose-steps" && hasValue)
+			param.poseSteps = atoi(argv[++i]);
+		else if (arg == "--pose-keyframes" && hasValue)
+			param.poseKeyframes = atoi(argv[++i]);
+		else if (arg == "--merged")
+			param.exportSepMesh = false;
+		else if (arg == "--gpu")
+			param.backend = ldp::SimulationBackendGpu;
+		else
+		{
+			printBatchSimulationUsage();
+			return -1;
+		}
+	} // end for i
+
+	try
+	{
+		ldp::BatchSimulationEngine engine;
+		engine.init(param);
+		engine.run();
+		return engine.numFailedTasks() ? 1 : 0;
+	} catch (std::exception e)
+	{
+		std::cout << e.what() << std::endl;
+	} catch (...)
+	{
+		std::cout << "unknown error" << std::endl;
+	}
+	return -1;
+}
 
 int main(int argc, char *argv[])
 {
+	if (argc > 1 && std::string(argv[1]) == "--batch")
+	{
+		if (argc < 3)
+		{
+			printBatchSimulationUsage();
+			return -1;
+		}
+		return runBatchSimulation(argc, argv);
+	}
+	if (argc > 1 && std::string(argv[1]) == "--pack-poses")
+	{
+		if (argc < 3)
+		{
+			printPackPosesUsage();
+			return -1;
+		}
+		return runPackPoses(argc, argv);
+	}
+
 	QApplication a(argc, argv);
 
 	glutInit(&argc, argv);